@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "tcp_buffer.h"
+
+using xubinh_server::MutableSizeTcpBuffer;
+
+// the byte-by-byte scanning that always starts from the read position
+const char *find_crlf_naively(const MutableSizeTcpBuffer &buffer) {
+    auto begin = buffer.get_read_position();
+    auto end = begin + buffer.get_readable_size();
+
+    for (auto position = begin; position + 1 < end; position++) {
+        if (position[0] == '\r' && position[1] == '\n') {
+            return position;
+        }
+    }
+
+    return nullptr;
+}
+
+const char *find_double_crlf_naively(const MutableSizeTcpBuffer &buffer) {
+    auto begin = buffer.get_read_position();
+    auto end = begin + buffer.get_readable_size();
+
+    for (auto position = begin; position + 3 < end; position++) {
+        if (position[0] == '\r' && position[1] == '\n' && position[2] == '\r'
+            && position[3] == '\n') {
+
+            return position;
+        }
+    }
+
+    return nullptr;
+}
+
+// a request head with the given number of header lines, each of which is
+// about 40 bytes long, as browsers would send
+std::string make_request_head(int number_of_headers) {
+    std::string request_head = "GET /index.html HTTP/1.1\r\n";
+
+    for (int i = 0; i < number_of_headers; i++) {
+        request_head += "X-Header-" + std::to_string(i)
+                        + ": some-reasonably-sized-value\r\n";
+    }
+
+    request_head += "\r\n";
+
+    return request_head;
+}
+
+// splits the request head into lines, as `HttpParser` does
+template <bool IsNaive>
+double run_parsing(const std::string &request_head, int number_of_rounds) {
+    MutableSizeTcpBuffer buffer;
+
+    size_t number_of_lines = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < number_of_rounds; i++) {
+        buffer.append(request_head.c_str(), request_head.size());
+
+        while (true) {
+            auto crlf_position = IsNaive ? find_crlf_naively(buffer)
+                                         : buffer.get_next_crlf_position();
+
+            if (!crlf_position) {
+                break;
+            }
+
+            buffer.forward_read_position(
+                static_cast<size_t>(crlf_position - buffer.get_read_position())
+                + 2
+            );
+
+            ++number_of_lines;
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    if (number_of_lines == 0) {
+        printf("error: unexpected result\n");
+    }
+
+    return static_cast<std::chrono::duration<double>>(end - start).count();
+}
+
+// a slow client sending the request head a few bytes at a time, with the end
+// of the headers being looked for on each arrival
+template <bool IsNaive>
+double run_trickling(
+    const std::string &request_head, size_t chunk_size, int number_of_rounds
+) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < number_of_rounds; i++) {
+        MutableSizeTcpBuffer buffer;
+
+        const char *double_crlf_position = nullptr;
+
+        for (size_t offset = 0; offset < request_head.size();
+             offset += chunk_size) {
+
+            buffer.append(
+                request_head.c_str() + offset,
+                std::min(chunk_size, request_head.size() - offset)
+            );
+
+            double_crlf_position = IsNaive
+                                       ? find_double_crlf_naively(buffer)
+                                       : buffer.get_next_double_crlf_position();
+        }
+
+        if (!double_crlf_position) {
+            printf("error: unexpected result\n");
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    return static_cast<std::chrono::duration<double>>(end - start).count();
+}
+
+void print_result(
+    const char *name, double time, size_t number_of_bytes_per_round, int n
+) {
+    printf(
+        "%s: %f seconds, %.2f MB/s.\n",
+        name,
+        time,
+        static_cast<double>(number_of_bytes_per_round) * n / time / 1e6
+    );
+}
+
+int main() {
+    for (int number_of_headers : {8, 16, 64}) {
+        auto request_head = make_request_head(number_of_headers);
+
+        int number_of_rounds =
+            static_cast<int>(200000000 / request_head.size());
+
+        printf(
+            "Request head of %d headers (%zu bytes), split into lines:\n",
+            number_of_headers,
+            request_head.size()
+        );
+
+        print_result(
+            "  byte-by-byte",
+            run_parsing<true>(request_head, number_of_rounds),
+            request_head.size(),
+            number_of_rounds
+        );
+        print_result(
+            "  vectorized  ",
+            run_parsing<false>(request_head, number_of_rounds),
+            request_head.size(),
+            number_of_rounds
+        );
+
+        printf("\n");
+    }
+
+    for (int number_of_headers : {16, 64}) {
+        auto request_head = make_request_head(number_of_headers);
+
+        size_t chunk_size = 8;
+
+        int number_of_rounds =
+            static_cast<int>(4000000 / request_head.size());
+
+        printf(
+            "Request head of %d headers (%zu bytes), received %zu bytes at a "
+            "time:\n",
+            number_of_headers,
+            request_head.size(),
+            chunk_size
+        );
+
+        print_result(
+            "  byte-by-byte, from scratch",
+            run_trickling<true>(request_head, chunk_size, number_of_rounds),
+            request_head.size(),
+            number_of_rounds
+        );
+        print_result(
+            "  vectorized, resumed       ",
+            run_trickling<false>(request_head, chunk_size, number_of_rounds),
+            request_head.size(),
+            number_of_rounds
+        );
+
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+#!/usr/bin/env bash
+
+set -e
+
+echo "Building..."
+g++ -std=c++17 -Wall -Wextra -Werror -Wconversion -Wshadow -O3 -o benchmark_delimiter_scan benchmark/delimiter_scan/main.cc src/*.cc src/util/*.cc -Iinclude -lpthread -latomic
+echo "Starting benchmarking..."
+echo ""
+./benchmark_delimiter_scan
+rm ./benchmark_delimiter_scan
+echo ""
+echo "Benchmarking completed. ✔️"
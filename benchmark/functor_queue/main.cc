@@ -0,0 +1,137 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "util/blocking_queue.h"
+#include "util/inplace_function.h"
+#include "util/lock_free_queue.h"
+
+using FunctorType = xubinh_server::util::InplaceFunction<void()>;
+
+using xubinh_server::util::BlockingQueue;
+using xubinh_server::util::MpscLockFreeQueue;
+
+struct BlockingQueueAdaptor {
+    // large enough so that producers are never blocked by the capacity
+    BlockingQueue<FunctorType> queue{1 << 30};
+
+    void push(FunctorType functor) {
+        queue.push(std::move(functor));
+    }
+
+    size_t invoke_all() {
+        auto functors = queue.pop_all();
+
+        for (auto &functor : functors) {
+            functor();
+        }
+
+        return functors.size();
+    }
+};
+
+struct MpscLockFreeQueueAdaptor {
+    MpscLockFreeQueue<FunctorType> queue;
+
+    void push(FunctorType functor) {
+        queue.push(std::move(functor));
+    }
+
+    size_t invoke_all() {
+        return queue.pop_all([](FunctorType &functor) {
+            functor();
+        });
+    }
+};
+
+// simulates a number of threads posting functors to a single event loop, which
+// drains the queue in batches as `EventLoop::_invoke_all_functors` does
+template <typename QueueType>
+double run(int number_of_producers, int number_of_functors_per_producer) {
+    QueueType queue;
+
+    std::atomic<bool> is_started{false};
+    uint64_t sum = 0;
+
+    std::vector<std::thread> producers;
+
+    for (int i = 0; i < number_of_producers; i++) {
+        producers.emplace_back([&]() {
+            while (!is_started.load(std::memory_order_acquire)) {
+            }
+
+            for (int j = 0; j < number_of_functors_per_producer; j++) {
+                queue.push([&sum]() {
+                    ++sum;
+                });
+            }
+        });
+    }
+
+    auto total_number_of_functors =
+        static_cast<size_t>(number_of_producers)
+        * static_cast<size_t>(number_of_functors_per_producer);
+    size_t number_of_functors_invoked = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    is_started.store(true, std::memory_order_release);
+
+    while (number_of_functors_invoked < total_number_of_functors) {
+        number_of_functors_invoked += queue.invoke_all();
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    for (auto &producer : producers) {
+        producer.join();
+    }
+
+    if (sum != total_number_of_functors) {
+        printf(
+            "error: %llu functors invoked\n",
+            static_cast<unsigned long long>(sum)
+        );
+    }
+
+    return static_cast<std::chrono::duration<double>>(end - start).count();
+}
+
+int main() {
+    int total_number_of_functors = 3200000;
+
+    printf("Number of functors: %d\n", total_number_of_functors);
+
+    for (int number_of_producers = 1; number_of_producers <= 64;
+         number_of_producers *= 2) {
+
+        auto number_of_functors_per_producer =
+            total_number_of_functors / number_of_producers;
+
+        auto blocking_queue_time = run<BlockingQueueAdaptor>(
+            number_of_producers, number_of_functors_per_producer
+        );
+        auto mpsc_lock_free_queue_time = run<MpscLockFreeQueueAdaptor>(
+            number_of_producers, number_of_functors_per_producer
+        );
+
+        printf("\n");
+        printf("Producers: %d\n", number_of_producers);
+        printf(
+            "BlockingQueue: %f seconds, %d functors per second.\n",
+            blocking_queue_time,
+            static_cast<int>(total_number_of_functors / blocking_queue_time)
+        );
+        printf(
+            "MpscLockFreeQueue: %f seconds, %d functors per second.\n",
+            mpsc_lock_free_queue_time,
+            static_cast<int>(
+                total_number_of_functors / mpsc_lock_free_queue_time
+            )
+        );
+    }
+
+    return 0;
+}
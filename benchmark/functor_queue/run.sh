@@ -0,0 +1,12 @@
+#!/usr/bin/env bash
+
+set -e
+
+echo "Building..."
+g++ -std=c++17 -Wall -Wextra -Werror -Wconversion -Wshadow -O3 -o benchmark_functor_queue benchmark/functor_queue/main.cc src/*.cc src/util/*.cc -Iinclude -lpthread -latomic
+echo "Starting benchmarking..."
+echo ""
+./benchmark_functor_queue
+rm ./benchmark_functor_queue
+echo ""
+echo "Benchmarking completed. ✔️"
@@ -0,0 +1,143 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <thread>
+
+#include "util/inplace_function.h"
+#include "util/lock_free_queue.h"
+
+// counts the allocations made by the whole program
+std::atomic<uint64_t> number_of_allocations{0};
+
+void *operator new(size_t size) {
+    number_of_allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void *ptr = std::malloc(size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+struct Result {
+    double time;
+    double number_of_allocations_per_post;
+};
+
+// simulates a thread posting functors to an event loop running in another
+// thread, with each functor capturing the given number of bytes besides a
+// `std::shared_ptr`, as `std::bind(..., shared_from_this(), ...)` would do
+template <typename FunctorType, size_t NumberOfBytesCaptured>
+Result run(int number_of_posts) {
+    xubinh_server::util::MpscLockFreeQueue<FunctorType> queue;
+
+    auto owner = std::make_shared<uint64_t>(0);
+
+    // warms up the node pool of the queue, so that only the allocations of the
+    // functors are counted
+    for (int i = 0; i < number_of_posts; i++) {
+        queue.push([]() {
+        });
+    }
+
+    queue.pop_all([](FunctorType &functor) {
+        functor();
+    });
+
+    std::atomic<bool> is_producer_done{false};
+
+    auto number_of_allocations_before = number_of_allocations.load();
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::thread producer([&]() {
+        std::array<char, NumberOfBytesCaptured> payload{};
+
+        for (int i = 0; i < number_of_posts; i++) {
+            queue.push([owner, payload]() {
+                *owner += static_cast<uint64_t>(payload.size());
+            });
+        }
+
+        is_producer_done.store(true, std::memory_order_release);
+    });
+
+    while (!is_producer_done.load(std::memory_order_acquire)
+           || !queue.empty()) {
+
+        queue.pop_all([](FunctorType &functor) {
+            functor();
+        });
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    producer.join();
+
+    auto number_of_allocations_after = number_of_allocations.load();
+
+    if (*owner
+        != static_cast<uint64_t>(number_of_posts) * NumberOfBytesCaptured) {
+        printf("error: unexpected result\n");
+    }
+
+    return {
+        static_cast<std::chrono::duration<double>>(end - start).count(),
+        static_cast<double>(
+            number_of_allocations_after - number_of_allocations_before
+        ) / number_of_posts
+    };
+}
+
+void print_result(const char *name, const Result &result, int n) {
+    printf(
+        "%s: %f seconds, %d posts per second, %.2f allocations per post.\n",
+        name,
+        result.time,
+        static_cast<int>(n / result.time),
+        result.number_of_allocations_per_post
+    );
+}
+
+template <size_t NumberOfBytesCaptured>
+void run_both(int number_of_posts) {
+    printf("\nCaptured: std::shared_ptr + %zu bytes\n", NumberOfBytesCaptured);
+
+    print_result(
+        "std::function",
+        run<std::function<void()>, NumberOfBytesCaptured>(number_of_posts),
+        number_of_posts
+    );
+
+    print_result(
+        "InplaceFunction",
+        run<xubinh_server::util::InplaceFunction<void()>,
+            NumberOfBytesCaptured>(number_of_posts),
+        number_of_posts
+    );
+}
+
+int main() {
+    int number_of_posts = 2000000;
+
+    printf("Number of posts: %d\n", number_of_posts);
+
+    run_both<8>(number_of_posts);
+    run_both<24>(number_of_posts);
+    run_both<40>(number_of_posts);
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+#!/usr/bin/env bash
+
+set -e
+
+echo "Building..."
+g++ -std=c++17 -Wall -Wextra -Werror -Wconversion -Wshadow -O3 -o benchmark_inplace_function benchmark/inplace_function/main.cc src/*.cc src/util/*.cc -Iinclude -lpthread -latomic
+echo "Starting benchmarking..."
+echo ""
+./benchmark_inplace_function
+rm ./benchmark_inplace_function
+echo ""
+echo "Benchmarking completed. ✔️"
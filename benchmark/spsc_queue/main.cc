@@ -0,0 +1,124 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "util/inplace_function.h"
+#include "util/lock_free_queue.h"
+
+using FunctorType = xubinh_server::util::InplaceFunction<void()>;
+
+using xubinh_server::util::SpscLockFreeQueue;
+using xubinh_server::util::SpscLockFreeRingQueue;
+
+struct SpscLockFreeQueueAdaptor {
+    SpscLockFreeQueue<FunctorType> queue;
+
+    void push(FunctorType functor) {
+        queue.push(std::move(functor));
+    }
+
+    size_t invoke_all() {
+        size_t number_of_functors_invoked = 0;
+
+        while (auto functor_ptr = queue.pop()) {
+            (*functor_ptr)();
+
+            ++number_of_functors_invoked;
+        }
+
+        return number_of_functors_invoked;
+    }
+};
+
+template <size_t Capacity>
+struct SpscLockFreeRingQueueAdaptor {
+    SpscLockFreeRingQueue<FunctorType> queue{Capacity};
+
+    void push(FunctorType functor) {
+        queue.push(std::move(functor));
+    }
+
+    size_t invoke_all() {
+        return queue.pop_all([](FunctorType &functor) {
+            functor();
+        });
+    }
+};
+
+// simulates a thread posting functors to an event loop running in another
+// thread, which drains the queue in batches
+template <typename QueueType>
+double run(int number_of_functors) {
+    QueueType queue;
+
+    uint64_t sum = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::thread producer([&]() {
+        for (int i = 0; i < number_of_functors; i++) {
+            queue.push([&sum]() {
+                ++sum;
+            });
+        }
+    });
+
+    size_t number_of_functors_invoked = 0;
+
+    while (number_of_functors_invoked < static_cast<size_t>(number_of_functors)
+    ) {
+        auto number_of_functors_invoked_this_time = queue.invoke_all();
+
+        if (number_of_functors_invoked_this_time == 0) {
+            std::this_thread::yield();
+        }
+
+        number_of_functors_invoked += number_of_functors_invoked_this_time;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    producer.join();
+
+    if (sum != static_cast<uint64_t>(number_of_functors)) {
+        printf("error: unexpected result\n");
+    }
+
+    return static_cast<std::chrono::duration<double>>(end - start).count();
+}
+
+void print_result(const char *name, double time, int n) {
+    printf(
+        "%s: %f seconds, %d functors per second.\n",
+        name,
+        time,
+        static_cast<int>(n / time)
+    );
+}
+
+int main() {
+    int number_of_functors = 4000000;
+
+    printf("Number of functors: %d\n", number_of_functors);
+
+    printf("\n");
+
+    print_result(
+        "SpscLockFreeQueue",
+        run<SpscLockFreeQueueAdaptor>(number_of_functors),
+        number_of_functors
+    );
+    print_result(
+        "SpscLockFreeRingQueue (capacity 1024)",
+        run<SpscLockFreeRingQueueAdaptor<1024>>(number_of_functors),
+        number_of_functors
+    );
+    print_result(
+        "SpscLockFreeRingQueue (capacity 4096)",
+        run<SpscLockFreeRingQueueAdaptor<4096>>(number_of_functors),
+        number_of_functors
+    );
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "timer_container.h"
+
+using xubinh_server::Timer;
+using xubinh_server::TimerContainer;
+using xubinh_server::util::TimeInterval;
+using xubinh_server::util::TimePoint;
+
+struct Result {
+    double insertion;
+    double churning;
+    double expiration;
+};
+
+double get_elapsed_time_interval(
+    std::chrono::high_resolution_clock::time_point start
+) {
+    auto end = std::chrono::high_resolution_clock::now();
+
+    return static_cast<std::chrono::duration<double>>(end - start).count();
+}
+
+// simulates the idle timeouts of long-lived connections, i.e. each connection
+// keeps a timer and resets it (a removal followed by an insertion) whenever
+// there is activity on it
+Result run(
+    TimerContainer::Type type,
+    int number_of_timers,
+    int number_of_resets,
+    int64_t timeout
+) {
+    auto container = TimerContainer::create(type);
+
+    std::mt19937_64 engine(12345);
+    std::uniform_int_distribution<int64_t> offset_distribution(0, timeout);
+
+    TimePoint now;
+
+    std::vector<Timer *> timers(static_cast<size_t>(number_of_timers));
+
+    for (auto &timer_ptr : timers) {
+        timer_ptr = new Timer(now + offset_distribution(engine), 0, 0, []() {});
+    }
+
+    Result result{};
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (auto timer_ptr : timers) {
+        container->insert_one(timer_ptr);
+    }
+
+    result.insertion = get_elapsed_time_interval(start);
+
+    // the timers are allocated beforehand so that only the operations of the
+    // containers are measured
+    std::vector<Timer *> spare_timers(static_cast<size_t>(number_of_resets));
+
+    for (auto &timer_ptr : spare_timers) {
+        timer_ptr = new Timer(
+            now + timeout + offset_distribution(engine) / 60, 0, 0, []() {}
+        );
+    }
+
+    std::vector<size_t> indices(static_cast<size_t>(number_of_resets));
+
+    for (auto &index : indices) {
+        index = static_cast<size_t>(engine() % timers.size());
+    }
+
+    start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        auto &timer_ptr = timers[indices[i]];
+
+        container->remove_one(timer_ptr);
+
+        std::swap(timer_ptr, spare_timers[i]);
+
+        container->insert_one(timer_ptr);
+    }
+
+    result.churning = get_elapsed_time_interval(start);
+
+    // expires everything in steps of one millisecond, as a timerfd would do
+    std::vector<const Timer *> expired_timers;
+    size_t number_of_expired_timers = 0;
+
+    start = std::chrono::high_resolution_clock::now();
+
+    for (auto time_point = now; !container->empty();
+         time_point += TimeInterval::SECOND / 1000) {
+
+        expired_timers.clear();
+
+        container->move_out_before_or_at(time_point, expired_timers);
+
+        number_of_expired_timers += expired_timers.size();
+    }
+
+    result.expiration = get_elapsed_time_interval(start);
+
+    if (number_of_expired_timers != timers.size()) {
+        printf("error: %zu timers expired\n", number_of_expired_timers);
+    }
+
+    for (auto timer_ptr : timers) {
+        delete timer_ptr;
+    }
+
+    for (auto timer_ptr : spare_timers) {
+        delete timer_ptr;
+    }
+
+    return result;
+}
+
+void print_result(const char *name, const Result &result, int n, int m) {
+    printf("%s:\n", name);
+    printf(
+        "Insertion: %f seconds, %d ops per second.\n",
+        result.insertion,
+        static_cast<int>(n / result.insertion)
+    );
+    printf(
+        "Reset (removal + insertion): %f seconds, %d ops per second.\n",
+        result.churning,
+        static_cast<int>(m / result.churning)
+    );
+    printf("Expiration: %f seconds.\n", result.expiration);
+}
+
+int main() {
+    int number_of_timers = 200000;
+    int number_of_resets = 2000000;
+    int64_t timeout = 60 * TimeInterval::SECOND;
+
+    printf("Number of timers: %d\n", number_of_timers);
+    printf("Number of resets: %d\n", number_of_resets);
+
+    printf("\n");
+
+    print_result(
+        "std::set",
+        run(TimerContainer::Type::ORDERED_SET,
+            number_of_timers,
+            number_of_resets,
+            timeout),
+        number_of_timers,
+        number_of_resets
+    );
+
+    printf("\n");
+
+    print_result(
+        "timing wheel",
+        run(TimerContainer::Type::TIMING_WHEEL,
+            number_of_timers,
+            number_of_resets,
+            timeout),
+        number_of_timers,
+        number_of_resets
+    );
+
+    return 0;
+}
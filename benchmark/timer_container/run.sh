@@ -0,0 +1,12 @@
+#!/usr/bin/env bash
+
+set -e
+
+echo "Building..."
+g++ -std=c++17 -Wall -Wextra -Werror -Wconversion -Wshadow -O3 -o benchmark_timer_container benchmark/timer_container/main.cc src/*.cc src/util/*.cc -Iinclude -lpthread -latomic
+echo "Starting benchmarking..."
+echo ""
+./benchmark_timer_container
+rm ./benchmark_timer_container
+echo ""
+echo "Benchmarking completed. ✔️"
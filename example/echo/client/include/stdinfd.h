@@ -24,8 +24,7 @@ public:
 private:
     void _read_event_callback(xubinh_server::util::TimePoint time_stamp);
 
-    std::weak_ptr<TcpConnectSocketfdPtr::element_type>
-        _tcp_connect_socketfd_weak_ptr;
+    TcpConnectSocketfdPtr _tcp_connect_socketfd_ptr;
 
     xubinh_server::PollableFileDescriptor _pollable_file_descriptor;
 };
@@ -22,7 +22,7 @@ Stdinfd::Stdinfd(
     xubinh_server::EventLoop *loop,
     const TcpConnectSocketfdPtr &tcp_connect_socketfd_ptr
 )
-    : _tcp_connect_socketfd_weak_ptr(tcp_connect_socketfd_ptr)
+    : _tcp_connect_socketfd_ptr(tcp_connect_socketfd_ptr)
     , _pollable_file_descriptor(STDIN_FILENO, loop) {
 }
 
@@ -38,9 +38,7 @@ void Stdinfd::_read_event_callback(__attribute__((unused))
                                    xubinh_server::util::TimePoint time_stamp) {
     LOG_TRACE << "stdin read event encountered";
 
-    auto _tcp_connect_socketfd_ptr = _tcp_connect_socketfd_weak_ptr.lock();
-
-    if (!_tcp_connect_socketfd_ptr) {
+    if (_tcp_connect_socketfd_ptr->is_stopped()) {
         LOG_ERROR << "connection closed";
 
         _pollable_file_descriptor.disable_read_event();
@@ -61,7 +61,7 @@ void signal_dispatcher(
 
 void message_callback(
     xubinh_server::TcpConnectSocketfd *tcp_connect_socketfd_ptr,
-    xubinh_server::MutableSizeTcpBuffer *input_buffer,
+    xubinh_server::TcpInputBuffer *input_buffer,
     __attribute__((unused)) xubinh_server::util::TimePoint time_point
 ) {
     while (true) {
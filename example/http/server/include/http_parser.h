@@ -21,7 +21,7 @@ public:
     };
 
     // true = success, false = fail
-    bool parse(MutableSizeTcpBuffer &buffer, util::TimePoint time_stamp);
+    bool parse(TcpInputBuffer &buffer, util::TimePoint time_stamp);
 
     void reset() {
         _parsing_state = EXPECT_REQUEST_LINE;
@@ -47,7 +47,19 @@ public:
         return _request;
     }
 
+    // see above
+    HttpRequest &get_request() {
+        if (!is_success()) {
+            throw std::logic_error("HTTP request is not ready");
+        }
+
+        return _request;
+    }
+
 private:
+    // max number of pieces of the body taken from the buffer at a time
+    static constexpr const int _MAX_NUMBER_OF_BODY_IOVECS = 16;
+
     ParsingState _parsing_state = EXPECT_REQUEST_LINE;
 
     size_t _body_length = 0;
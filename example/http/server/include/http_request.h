@@ -5,6 +5,7 @@
 #include <string>
 #include <unordered_map>
 
+#include "tcp_buffer.h"
 #include "util/slab_allocator.h"
 #include "util/time_point.h"
 
@@ -103,20 +104,40 @@ public:
     }
 
     void set_body(const char *start, const char *end) {
-        _body.assign(start, end);
+        _body.release();
+
+        append_body(start, end);
+    }
+
+    // for the body that arrives piece by piece
+    void append_body(const char *start, const char *end) {
+        _body.append(start, static_cast<size_t>(end - start));
+    }
+
+    // the body is kept as a chain of slabs, so that a large one never needs a
+    // large contiguous allocation (nor the copying when it grows); see
+    // `SlabChainTcpBuffer::get_readable_iovecs` for going through it piece by
+    // piece and `SlabChainTcpBuffer::linearize` for making it contiguous
+    const SlabChainTcpBuffer &get_body() const {
+        return _body;
     }
 
-    const StringType &get_body() const {
+    // see above
+    SlabChainTcpBuffer &get_body() {
         return _body;
     }
 
+    size_t get_body_size() const {
+        return _body.get_readable_size();
+    }
+
     void reset() noexcept {
         _method = UNSUPPORTED_HTTP_METHOD;
         _path.clear();
         _version = UNSUPPORTED_HTTP_VERSION;
         _receive_time_point = 0;
         _headers.clear();
-        _body.clear();
+        _body.release();
     }
 
 private:
@@ -150,7 +171,7 @@ private:
     util::TimePoint _receive_time_point{0};
     std::unordered_map<StringType, StringType> _headers;
     bool _need_close{false};
-    StringType _body;
+    SlabChainTcpBuffer _body;
 };
 
 } // namespace xubinh_server
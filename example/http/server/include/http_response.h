@@ -7,6 +7,7 @@
 
 #include "tcp_buffer.h"
 #include "tcp_connect_socketfd.h"
+#include "util/iovec_builder.h"
 #include "util/slab_allocator.h"
 
 namespace xubinh_server {
@@ -169,9 +170,22 @@ public:
 
     void dump_to_tcp_buffer(MutableSizeTcpBuffer &buffer);
 
-    void send_to_tcp_connection(TcpConnectSocketfd *tcp_connect_socketfd_ptr);
+    // sends the status line, the headers and the body as separate pieces in a
+    // single `sendmsg(2)`, falling back to `dump_to_tcp_buffer` if there are
+    // too many headers
+    //
+    // - `has_more` should be set if the body is sent separately right after,
+    // e.g. by `TcpConnectSocketfd::send_file`, so that the header shares the
+    // same segment with the beginning of the body; see
+    // `TcpConnectSocketfd::send`
+    void send_to_tcp_connection(
+        TcpConnectSocketfd *tcp_connect_socketfd_ptr, bool has_more = false
+    );
 
 private:
+    // 4 pieces per header, i.e. enough for more than 20 headers
+    static constexpr int _MAX_NUMBER_OF_IOVECS = 96;
+
     static const StringType _empty_string;
 
     HttpVersionType _version;
@@ -68,16 +68,43 @@ public:
         );
     }
 
+    void set_if_use_reuse_port(bool use_reuse_port) {
+        _tcp_server.set_if_use_reuse_port(use_reuse_port);
+    }
+
+    void set_if_use_cpu_steering(bool use_cpu_steering) {
+        _tcp_server.set_if_use_cpu_steering(use_cpu_steering);
+    }
+
+    // sends the header and the body of a response, as well as the responses
+    // to pipelined requests, in one go; see
+    // `TcpConnectSocketfd::set_if_use_corked_mode`
+    void set_if_use_corked_mode(bool use_corked_mode) {
+        _tcp_server.set_if_use_corked_mode(use_corked_mode);
+    }
+
     void start();
 
+    // keep-alive connections are closed once the request in flight, if any,
+    // is answered, with the response carrying a "Connection: close" header;
+    // see `TcpServer::stop`
     void stop() {
+        _is_draining.store(true, std::memory_order_relaxed);
+
         _tcp_server.stop();
     }
 
+    // see `TcpServer::set_drain_timeout`
+    void set_drain_timeout(TimeInterval drain_timeout) {
+        _tcp_server.set_drain_timeout(drain_timeout);
+    }
+
     void run_for_each_connection(RunForEachConnectionCallbackType callback) {
         _tcp_server.run_for_each_connection(std::move(callback));
     }
 
+    // closes the connections that stay idle for longer than the given time
+    // interval, which is checked by the worker loops themselves
     void
     set_connection_timeout_interval(TimeInterval connection_timeout_interval) {
         _connection_timeout_interval = connection_timeout_interval;
@@ -90,26 +117,28 @@ private:
 
     void _message_callback(
         TcpConnectSocketfd *tcp_connect_socketfd_ptr,
-        MutableSizeTcpBuffer *input_buffer,
+        TcpInputBuffer *input_buffer,
         TimePoint time_stamp
     );
 
-    void _remove_inactive_connections();
+    // closes the connection right away if it sits between requests, or
+    // otherwise leaves it to the message callback
+    void _drain_callback(TcpConnectSocketfd *tcp_connect_socketfd_ptr);
 
-    void _check_and_remove_inactive_connection(
-        const TcpConnectSocketfdPtr &tcp_connect_socketfd_ptr
-    );
+    static bool
+    _is_between_requests(TcpConnectSocketfd *tcp_connect_socketfd_ptr);
 
     EventLoop *_loop;
 
-    TimePoint _current_time_point{};
-
     TimeInterval _connection_timeout_interval{60 * TimeInterval::SECOND};
 
     ConnectSuccessCallbackType _connect_success_callback;
 
     HttpRequestCallbackType _http_request_callback;
 
+    // read by the worker loops for closing the connections after answering
+    std::atomic<bool> _is_draining{false};
+
     TcpServer _tcp_server;
 };
 
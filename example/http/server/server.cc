@@ -2,7 +2,6 @@
 #include <cstring>
 #include <fcntl.h>
 #include <string>
-#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <unordered_map>
@@ -199,31 +198,12 @@ bool read_file_and_send(
         "Content-Length", xubinh_server::util::to_string<StringType>(file_size)
     );
 
-    response.send_to_tcp_connection(tcp_connect_socketfd_ptr);
+    // the header goes out together with the beginning of the file content
+    response.send_to_tcp_connection(tcp_connect_socketfd_ptr, file_size > 0);
 
-    char *mapped_data = static_cast<char *>(
-        ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0)
-    );
-
-    if (mapped_data == MAP_FAILED) {
-        LOG_SYS_ERROR << "failed to mmap file, path: " << file_path;
-
-        ::close(fd);
-
-        return false;
-    }
-
-    tcp_connect_socketfd_ptr->send(mapped_data, file_size);
-
-    if (::munmap(mapped_data, file_size) == -1) {
-        LOG_SYS_ERROR << "failed to munmap file, path: " << file_path;
-
-        ::close(fd);
-
-        return false;
-    }
-
-    ::close(fd);
+    // the fd is closed by the connection after being sent, and the file
+    // content is streamed by the kernel without entering user space
+    tcp_connect_socketfd_ptr->send_file(fd, 0, file_size);
 
     return true;
 }
@@ -394,7 +374,7 @@ int main(int argc, char *argv[]) {
 #ifdef __HTTP_EXAMPLE_RUN_BENCHMARK
     server.set_connection_timeout_interval(
         xubinh_server::util::TimeInterval::FOREVER
-    ); // FOREVER = don't start timer for checking inactive connections
+    ); // FOREVER = never close idle connections
 #else
     server.set_connection_timeout_interval(
         15 * xubinh_server::util::TimeInterval::SECOND
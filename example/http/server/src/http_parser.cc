@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 #include <string>
 
@@ -7,7 +8,7 @@
 namespace xubinh_server {
 
 bool HttpParser::parse(
-    MutableSizeTcpBuffer &buffer, util::TimePoint time_stamp
+    TcpInputBuffer &buffer, util::TimePoint time_stamp
 ) {
     if (_parsing_state == FAIL) {
         return false;
@@ -130,18 +131,38 @@ bool HttpParser::parse(
 
 goto_header_finished:
     if (_parsing_state == EXPECT_BODY) {
-        // still haven't recieved the whole body
-        if (buffer.get_readable_size() < _body_length) {
-            return true;
-        }
+        // [NOTE]: takes whatever part of the body has arrived instead of
+        // waiting for the whole of it, so that the input buffer never holds (or
+        // linearizes) a large body all at once; the request keeps it as a
+        // chain of slabs, which never gets reallocated as it grows either
+        iovec iovecs[_MAX_NUMBER_OF_BODY_IOVECS];
+
+        while (_request.get_body_size() < _body_length) {
+            auto number_of_iovecs =
+                buffer.get_readable_iovecs(iovecs, _MAX_NUMBER_OF_BODY_IOVECS);
+
+            // still haven't recieved the whole body
+            if (number_of_iovecs == 0) {
+                return true;
+            }
 
-        auto body_start = buffer.get_read_position();
+            size_t number_of_bytes_taken = 0;
 
-        auto body_end = body_start + _body_length;
+            for (int i = 0; i < number_of_iovecs; i++) {
+                auto piece_start =
+                    static_cast<const char *>(iovecs[i].iov_base);
 
-        _request.set_body(body_start, body_end);
+                auto piece_size = std::min(
+                    iovecs[i].iov_len, _body_length - _request.get_body_size()
+                );
 
-        buffer.forward_read_position(_body_length);
+                _request.append_body(piece_start, piece_start + piece_size);
+
+                number_of_bytes_taken += piece_size;
+            }
+
+            buffer.forward_read_position(number_of_bytes_taken);
+        }
 
         _request.set_receive_time_point(time_stamp);
 
@@ -285,14 +285,58 @@ void HttpResponse::dump_to_tcp_buffer(MutableSizeTcpBuffer &buffer) {
 }
 
 void HttpResponse::send_to_tcp_connection(
-    TcpConnectSocketfd *tcp_connect_socketfd_ptr
+    TcpConnectSocketfd *tcp_connect_socketfd_ptr, bool has_more
 ) {
+    if (_status_code == S_NONE) {
+        LOG_FATAL << "tried to send a http response before setting the "
+                     "status code";
+    }
+
+    // the pieces are sent as they are, without being serialized into a
+    // temporary buffer first
+    util::IovecBuilder<_MAX_NUMBER_OF_IOVECS> iovec_builder;
+
+    bool is_fit = iovec_builder.append(get_version_type_as_string())
+                  && iovec_builder.append(" ", 1)
+                  && iovec_builder.append(
+                      get_status_code_and_description_as_string()
+                  )
+                  && iovec_builder.append("\r\n", 2);
+
+    for (const auto &key_value_pair : _headers) {
+        is_fit = is_fit
+                 && iovec_builder.append(
+                     key_value_pair.first.c_str(), key_value_pair.first.length()
+                 )
+                 && iovec_builder.append(":", 1)
+                 && iovec_builder.append(
+                     key_value_pair.second.c_str(),
+                     key_value_pair.second.length()
+                 )
+                 && iovec_builder.append("\r\n", 2);
+    }
+
+    // an empty line is required to end the header section
+    is_fit = is_fit && iovec_builder.append("\r\n", 2)
+             && iovec_builder.append(_body.c_str(), _body.size());
+
+    if (is_fit) {
+        tcp_connect_socketfd_ptr->send(
+            iovec_builder.get_iovecs(),
+            iovec_builder.get_number_of_iovecs(),
+            has_more
+        );
+
+        return;
+    }
+
+    // too many headers
     MutableSizeTcpBuffer buffer;
 
     dump_to_tcp_buffer(buffer);
 
     tcp_connect_socketfd_ptr->send(
-        buffer.get_read_position(), buffer.get_readable_size()
+        buffer.get_read_position(), buffer.get_readable_size(), has_more
     );
 }
 
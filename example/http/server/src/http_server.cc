@@ -19,7 +19,7 @@ void HttpServer::start() {
     _tcp_server.register_message_callback(
         [this](
             TcpConnectSocketfd *tcp_connect_socketfd_ptr,
-            MutableSizeTcpBuffer *input_buffer,
+            TcpInputBuffer *input_buffer,
             TimePoint time_stamp
         ) {
             _message_callback(
@@ -28,19 +28,14 @@ void HttpServer::start() {
         }
     );
 
-    // start the timer for removing inactive connections
-    if (_connection_timeout_interval < TimeInterval{TimeInterval::FOREVER}) {
-        LOG_TRACE << "register event -> main: remove_inactive_connections";
+    _tcp_server.register_drain_callback(
+        [this](TcpConnectSocketfd *tcp_connect_socketfd_ptr) {
+            _drain_callback(tcp_connect_socketfd_ptr);
+        }
+    );
 
-        _loop->run_after_time_interval(
-            _connection_timeout_interval,
-            _connection_timeout_interval,
-            -1,
-            [this]() {
-                _remove_inactive_connections();
-            }
-        );
-    }
+    // connections are expired by their own worker loops
+    _tcp_server.set_idle_timeout(_connection_timeout_interval);
 
     _tcp_server.start();
 }
@@ -58,29 +53,37 @@ void HttpServer::_connect_success_callback_wrapper(
 
 void HttpServer::_message_callback(
     TcpConnectSocketfd *tcp_connect_socketfd_ptr,
-    MutableSizeTcpBuffer *input_buffer,
+    TcpInputBuffer *input_buffer,
     TimePoint time_stamp
 ) {
-    // marking active connections
-    tcp_connect_socketfd_ptr->set_time_stamp(time_stamp);
-
     HttpParser &parser =
         util::any_cast<HttpParser &>(tcp_connect_socketfd_ptr->context);
     // HttpParser &parser =
     //     *util::any_cast<HttpParser *>(&tcp_connect_socketfd_ptr->context);
 
-    bool is_success = parser.parse(*input_buffer, time_stamp);
+    // pipelined requests might arrive together, which are answered one after
+    // another (and sent in one go in corked mode)
+    while (true) {
+        bool is_success = parser.parse(*input_buffer, time_stamp);
 
-    if (!is_success) {
-        LOG_ERROR << "failed to parse HTTP request; connection abort";
+        if (!is_success) {
+            LOG_ERROR << "failed to parse HTTP request; connection abort";
 
-        tcp_connect_socketfd_ptr->abort_from_event_loop();
+            tcp_connect_socketfd_ptr->abort_from_event_loop();
 
-        return;
-    }
+            return;
+        }
 
-    if (parser.is_success()) {
-        const HttpRequest &request = parser.get_request();
+        if (!parser.is_success()) {
+            return;
+        }
+
+        HttpRequest &request = parser.get_request();
+
+        // answered as the last one while draining
+        if (_is_draining.load(std::memory_order_relaxed)) {
+            request.set_need_close(true);
+        }
 
         // may abort the TCP connection early when `send()` detected an `EPIPE`
         _http_request_callback(tcp_connect_socketfd_ptr, request);
@@ -102,60 +105,52 @@ void HttpServer::_message_callback(
             else {
                 tcp_connect_socketfd_ptr->shutdown_write();
             }
-        }
 
-        else {
-            parser.reset();
+            return;
         }
-    }
-}
 
-void HttpServer::_remove_inactive_connections() {
-    LOG_TRACE << "enter event: remove_inactive_connections";
+        parser.reset();
 
-    LOG_TRACE << "current number of TCP connections: "
-              << _tcp_server.get_number_of_tcp_connections();
-
-    // draw a line to determine which connections are inactive
-    _current_time_point = TimePoint();
-
-    _tcp_server.run_for_each_connection(
-        [this](const TcpConnectSocketfdPtr &tcp_connect_socketfd_ptr) {
-            _check_and_remove_inactive_connection(tcp_connect_socketfd_ptr);
+        if (input_buffer->get_readable_size() == 0) {
+            return;
         }
-    );
+    }
 }
 
-void HttpServer::_check_and_remove_inactive_connection(
-    const TcpConnectSocketfdPtr &tcp_connect_socketfd_ptr
+void HttpServer::_drain_callback(TcpConnectSocketfd *tcp_connect_socketfd_ptr
 ) {
-    LOG_TRACE << "checking inactive tcp connection, id: "
-              << tcp_connect_socketfd_ptr->get_id();
-
-    TimePoint time_stamp = tcp_connect_socketfd_ptr->get_time_stamp();
-
-    // first check if the connection is inactive in current loop
-    if (_current_time_point - time_stamp > _connection_timeout_interval) {
-        LOG_TRACE << "tcp connection might be inactive, id: "
-                  << tcp_connect_socketfd_ptr->get_id();
-
-        auto current_time_point = _current_time_point;
-        auto connection_timeout_interval = _connection_timeout_interval;
-
-        tcp_connect_socketfd_ptr->check_and_abort_from_event_loop(
-            // double check if the connection is still inactive in the
-            // worker loop and actually abort it
-            [current_time_point,
-             connection_timeout_interval,
-             &tcp_connect_socketfd_ptr]() {
-                return (
-                    current_time_point
-                        - tcp_connect_socketfd_ptr->get_time_stamp()
-                    > connection_timeout_interval
-                );
+    // the response to the last request is still being sent
+    if (tcp_connect_socketfd_ptr->is_writing()) {
+        tcp_connect_socketfd_ptr->register_write_complete_callback(
+            [](TcpConnectSocketfd *this_tcp_connect_socketfd_ptr) {
+                if (_is_between_requests(this_tcp_connect_socketfd_ptr)) {
+                    this_tcp_connect_socketfd_ptr->shutdown_write();
+                }
             }
         );
     }
+
+    else if (_is_between_requests(tcp_connect_socketfd_ptr)) {
+        tcp_connect_socketfd_ptr->shutdown_write();
+    }
+}
+
+bool HttpServer::_is_between_requests(
+    TcpConnectSocketfd *tcp_connect_socketfd_ptr
+) {
+    // the context is gone along with the write end
+    if (tcp_connect_socketfd_ptr->is_write_end_shutdown()) {
+        return false;
+    }
+
+    HttpParser &parser =
+        util::any_cast<HttpParser &>(tcp_connect_socketfd_ptr->context);
+
+    // [NOTE]: the parser might have taken a part of the next request out of
+    // the input buffer already, in which case the connection does not count
+    // as sitting between requests even if it is idle
+    return parser.get_state() == HttpParser::EXPECT_REQUEST_LINE
+           && tcp_connect_socketfd_ptr->is_idle();
 }
 
-} // namespace xubinh_server
\ No newline at end of file
+} // namespace xubinh_server
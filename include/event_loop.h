@@ -3,6 +3,7 @@
 
 #include <atomic>
 #include <functional>
+#include <memory>
 #include <unistd.h>
 
 #include "event_poller.h"
@@ -12,6 +13,7 @@
 #include "timer_identifier.h"
 #include "timerfd.h"
 #include "util/blocking_queue.h"
+#include "util/inplace_function.h"
 #include "util/this_thread.h"
 #ifdef __USE_LOCK_FREE_QUEUE
 #include "util/lock_free_queue.h"
@@ -32,13 +34,35 @@ private:
     using EventfdPilotLampType = struct alignas(64) { std::atomic<bool> flag; };
 
 public:
-    using FunctorType = std::function<void()>;
-#ifdef __USE_LOCK_FREE_QUEUE
+    using FunctorType = util::InplaceFunction<void()>;
+#ifdef __USE_MPSC_LOCK_FREE_QUEUE
+    using FunctorQueue = util::MpscLockFreeQueue<EventLoop::FunctorType>;
+#elif defined(__USE_LOCK_FREE_RING_QUEUE)
+    using FunctorQueue = util::SpscLockFreeRingQueue<EventLoop::FunctorType>;
+#elif defined(__USE_LOCK_FREE_QUEUE)
     using FunctorQueue = util::SpscLockFreeQueue<EventLoop::FunctorType>;
 #else
     using FunctorQueue = util::BlockingQueue<EventLoop::FunctorType>;
 #endif
 
+    using TimerContainerType = TimerContainer::Type;
+
+    // for the loops that are not given a timer container type explicitly,
+    // e.g. the ones created by thread pools
+    static void
+    set_default_timer_container_type(TimerContainerType timer_container_type
+    ) noexcept {
+        _default_timer_container_type = timer_container_type;
+    }
+
+    // for the loops that are not given a busy-poll budget explicitly; see
+    // `set_max_busy_poll_budget`
+    static void
+    set_default_max_busy_poll_budget(TimeInterval max_busy_poll_budget
+    ) noexcept {
+        _default_max_busy_poll_budget = max_busy_poll_budget;
+    }
+
     static void set_alarm_advancing_threshold(int64_t alarm_advancing_threshold
     ) noexcept {
         _alarm_advancing_threshold = alarm_advancing_threshold;
@@ -47,7 +71,9 @@ public:
     // should be initialized in the owner thread in order to get the tid
     // properly
     EventLoop(
-        uint64_t loop_index = 0, size_t number_of_functor_blocking_queues = 1
+        uint64_t loop_index = 0,
+        size_t number_of_functor_blocking_queues = 1,
+        TimerContainerType timer_container_type = _default_timer_container_type
     );
 
     ~EventLoop() noexcept;
@@ -56,6 +82,143 @@ public:
         return _loop_index;
     }
 
+    // the time point taken right after the latest polling, which is cheaper
+    // than reading the clock again for the bookkeepings that do not need to be
+    // exact
+    TimePoint get_iteration_time_point() const noexcept {
+        return _iteration_time_point;
+    }
+
+    // load counters for choosing loops (see `EventLoopThreadPool`), which may
+    // be read from any thread and are only approximate
+
+    // connections are counted by `TcpConnectSocketfd` from `start()` until
+    // this loop lets go of them, i.e. until they are closed or aborted
+    void increment_number_of_connections() noexcept {
+        _number_of_connections.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void decrement_number_of_connections() noexcept {
+        _number_of_connections.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    size_t get_number_of_connections() const noexcept {
+        return _number_of_connections.load(std::memory_order_relaxed);
+    }
+
+    // output bytes held in memory by the connections of this loop, which are
+    // accounted by the connections themselves as their output queues change
+    void increase_number_of_buffered_output_bytes(size_t number_of_bytes
+    ) noexcept {
+        _number_of_buffered_output_bytes.fetch_add(
+            number_of_bytes, std::memory_order_relaxed
+        );
+    }
+
+    void decrease_number_of_buffered_output_bytes(size_t number_of_bytes
+    ) noexcept {
+        _number_of_buffered_output_bytes.fetch_sub(
+            number_of_bytes, std::memory_order_relaxed
+        );
+    }
+
+    size_t get_number_of_buffered_output_bytes() const noexcept {
+        return _number_of_buffered_output_bytes.load(std::memory_order_relaxed);
+    }
+
+    // opts in to counting the functors posted by other threads, which costs
+    // every posting an extra atomic increment and is therefore off by default
+    //
+    // - should be called before the loop is shared with other threads, so that
+    // no functor is invoked without having been counted
+    void set_counting_pending_functors(bool is_counting_pending_functors
+    ) noexcept {
+        _is_counting_pending_functors = is_counting_pending_functors;
+    }
+
+    // functors posted by other threads and not yet invoked, which stays zero
+    // unless counting is opted in (see `set_counting_pending_functors`)
+    size_t get_number_of_pending_functors() const noexcept {
+        auto number_of_functors_invoked =
+            _number_of_functors_invoked.load(std::memory_order_relaxed);
+        auto number_of_functors_posted =
+            _number_of_functors_posted.load(std::memory_order_relaxed);
+
+        return number_of_functors_posted > number_of_functors_invoked
+                   ? number_of_functors_posted - number_of_functors_invoked
+                   : 0;
+    }
+
+    // opts in to busy-polling: before blocking in the poller, the loop keeps
+    // polling without blocking (and invoking the functors posted meanwhile)
+    // for a while, saving the wake-up latency if something arrives soon
+    //
+    // - the actual time spent spinning adapts to the recent arrival rate, i.e.
+    // it grows when the loop keeps getting woken up shortly after blocking and
+    // shrinks down to zero when it does not, so that idle loops still sleep
+    // - a zero budget disables busy-polling
+    // - not thread-safe; should be called in the owner thread
+    void set_max_busy_poll_budget(TimeInterval max_busy_poll_budget) noexcept {
+        _max_busy_poll_budget = max_busy_poll_budget;
+
+        if (_busy_poll_budget > _max_busy_poll_budget) {
+            _busy_poll_budget = _max_busy_poll_budget;
+        }
+    }
+
+    // the current spinning time; see `set_max_busy_poll_budget`
+    TimeInterval get_busy_poll_budget() const noexcept {
+        return _busy_poll_budget;
+    }
+
+    // caps the output bytes held in memory by all connections of this loop
+    // together; a connection that queues more output while the cap is reached
+    // pauses reading as if its own high-water mark was crossed, see
+    // `TcpConnectSocketfd::set_output_water_marks`
+    //
+    // - `0` disables the cap, which is the default
+    // - not thread-safe; should be called in the owner thread
+    void set_max_number_of_buffered_output_bytes(
+        size_t max_number_of_buffered_output_bytes
+    ) noexcept {
+        _max_number_of_buffered_output_bytes =
+            max_number_of_buffered_output_bytes;
+    }
+
+    bool is_buffered_output_capped() const noexcept {
+        return _max_number_of_buffered_output_bytes > 0
+               && get_number_of_buffered_output_bytes()
+                      >= _max_number_of_buffered_output_bytes;
+    }
+
+    // a place for the other modules to keep per-loop state of their own, e.g.
+    // the connections recycled by the loop, which the loop owns without knowing
+    // its type, and destroys before anything else at shutdown
+    //
+    // - each module should take an index once from `allocate_module_slot_index`
+    // - not thread-safe; should only be touched in the owner thread
+    static size_t allocate_module_slot_index() noexcept {
+        return _number_of_module_slots.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::shared_ptr<void> &get_module_slot(size_t module_slot_index) {
+        if (module_slot_index >= _module_slots.size()) {
+            _module_slots.resize(module_slot_index + 1);
+        }
+
+        return _module_slots[module_slot_index];
+    }
+
+#ifdef __USE_IO_URING_POLLER
+    // for taking the data received by the poller on behalf of the fds, see
+    // `PollableFileDescriptor::ReadMode`
+    //
+    // - not thread-safe; should only be touched in the owner thread
+    EventPoller &get_event_poller() noexcept {
+        return _event_poller;
+    }
+#endif
+
     bool is_in_owner_thread() {
         return util::this_thread::get_tid() == _owner_thread_tid;
     }
@@ -72,6 +235,18 @@ public:
 
     void run(FunctorType functor, size_t functor_blocking_queue_index = 0);
 
+    // runs the functor once the current iteration has handled everything,
+    // i.e. the active events, the posted functors and the expired timers,
+    // right before polling again; for batching up the work caused by several
+    // events of the same iteration, e.g. flushing the corked output of a
+    // connection (see `TcpConnectSocketfd::set_if_use_corked_mode`)
+    //
+    // - functors queued by the ones being run are run in the same round
+    // - not thread-safe; should be called in the owner thread
+    void run_at_end_of_iteration(FunctorType functor) {
+        _end_of_iteration_functors.push_back(std::move(functor));
+    }
+
     void invoke_all_functors(size_t functor_blocking_queue_index = 0) {
         run(
             [this]() {
@@ -120,8 +295,28 @@ private:
 
     void _wake_up_this_loop(size_t functor_blocking_queue_index);
 
+    // a lit pilot lamp means that some functor has been posted since the
+    // corresponding eventfd was last consumed
+    bool _is_any_eventfd_pilot_lamp_lit() const noexcept {
+        for (const auto &eventfd_pilot_lamp : _eventfd_pilot_lamps) {
+            if (eventfd_pilot_lamp.flag.load(std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // busy-polls within the current budget before blocking, and adapts the
+    // budget afterwards
+    void _poll_for_active_events(
+        std::vector<PollableFileDescriptor *> &event_dispatchers
+    );
+
     void _invoke_all_functors();
 
+    void _invoke_end_of_iteration_functors();
+
     void _set_alarm_at_time_point(TimePoint time_point) {
         _timerfd.set_alarm_at_time_point(time_point);
     }
@@ -148,11 +343,24 @@ private:
 
 #ifndef __USE_LOCK_FREE_QUEUE
     static constexpr int _FUNCTOR_QUEUE_CAPACITY = 1000;
+#elif defined(__USE_LOCK_FREE_RING_QUEUE)
+    // one cache line per slot, i.e. 256 KB per queue
+    static constexpr size_t _FUNCTOR_RING_QUEUE_CAPACITY = 4096;
 #endif
 
+    // the budget is grown from this value when it is zero, and falls back to
+    // zero when shrunk below it
+    static constexpr int64_t _MIN_BUSY_POLL_BUDGET = 10 * 1000; // 10 us
+
     // in seconds
     static int64_t _alarm_advancing_threshold;
 
+    static TimeInterval _default_max_busy_poll_budget;
+
+    static TimerContainerType _default_timer_container_type;
+
+    static std::atomic<size_t> _number_of_module_slots;
+
     const uint64_t _loop_index;
 
     EventPoller _event_poller;
@@ -164,13 +372,34 @@ private:
     bool _eventfd_triggered = false;
 
     Timerfd _timerfd;
-    TimerContainer _timer_container{};
+    std::unique_ptr<TimerContainer> _timer_container;
+    std::vector<const Timer *> _expired_timers; // reused across expirations
     bool _timerfd_triggered = false;
     TimePoint _next_earliest_expiration_time{TimePoint::FOREVER};
 
+    std::vector<FunctorType> _end_of_iteration_functors;
+    std::vector<FunctorType> _end_of_iteration_functors_being_invoked;
+
+    std::vector<std::shared_ptr<void>> _module_slots;
+
+    TimePoint _iteration_time_point;
+
+    TimeInterval _max_busy_poll_budget;
+    TimeInterval _busy_poll_budget{0};
+
+    size_t _max_number_of_buffered_output_bytes{0};
+
     pid_t _owner_thread_tid;
 
     std::atomic<bool> _need_stop{false};
+
+    bool _is_counting_pending_functors{false};
+
+    // load counters
+    alignas(64) std::atomic<size_t> _number_of_connections{0};
+    alignas(64) std::atomic<size_t> _number_of_functors_posted{0};
+    alignas(64) std::atomic<size_t> _number_of_functors_invoked{0};
+    alignas(64) std::atomic<size_t> _number_of_buffered_output_bytes{0};
 };
 
 } // namespace xubinh_server
@@ -19,7 +19,9 @@ public:
     explicit EventLoopThread(
         const std::string &thread_name,
         ThreadInitializationCallbackType thread_initialization_callback,
-        uint64_t loop_index = 0
+        uint64_t loop_index = 0,
+        size_t number_of_functor_blocking_queues = 1,
+        bool is_counting_pending_functors = false
     );
 
     // no copy
@@ -59,7 +61,11 @@ public:
     }
 
 private:
-    void _worker_function(uint64_t loop_index);
+    void _worker_function(
+        uint64_t loop_index,
+        size_t number_of_functor_blocking_queues,
+        bool is_counting_pending_functors
+    );
 
     ThreadInitializationCallbackType _thread_initialization_callback;
 
@@ -1,11 +1,13 @@
 #ifndef __XUBINH_SERVER_EVENT_LOOP_THREAD_POOL
 #define __XUBINH_SERVER_EVENT_LOOP_THREAD_POOL
 
+#include <functional>
 #include <memory>
 #include <vector>
 
 #include "event_loop.h"
 #include "event_loop_thread.h"
+#include "inet_address.h"
 
 namespace xubinh_server {
 
@@ -15,6 +17,34 @@ public:
     using ThreadInitializationCallbackType =
         EventLoopThread::ThreadInitializationCallbackType;
 
+    // how `get_next_loop` chooses a loop, based on the load counters that the
+    // loops keep (see `EventLoop::get_number_of_connections`)
+    //
+    // - the connection counters only change once a worker loop starts the
+    // connections handed to it, so least-connections might send a whole batch
+    // of accepted connections to the same loop
+    // - power-of-two-choices picks the less loaded one of two random loops,
+    // which avoids both scanning all loops and herding onto the same one when
+    // the counters lag behind
+    // - hashing keeps the connections from the same peer IP on the same loop,
+    // and falls back to round-robin if no peer address is given
+    // - pending functors are only counted by the loops of a pool started with
+    // the policy that uses them, so custom selectors that read them should set
+    // that policy as well
+    enum class LoopSelectionPolicy {
+        ROUND_ROBIN,
+        LEAST_CONNECTIONS,
+        POWER_OF_TWO_CHOICES_BY_CONNECTIONS,
+        POWER_OF_TWO_CHOICES_BY_PENDING_FUNCTORS,
+        HASH_BY_PEER_ADDRESS
+    };
+
+    // custom policy; returns the index of the chosen loop, with the peer
+    // address being null if not given
+    using LoopSelectorType = std::function<size_t(
+        const EventLoopThreadPool &thread_pool, const InetAddress *peer_address
+    )>;
+
     EventLoopThreadPool(size_t thread_pool_capasity);
 
     ~EventLoopThreadPool();
@@ -46,9 +76,52 @@ public:
     // join all the worker threads
     void join();
 
-    EventLoop *get_next_loop();
+    // should be set before `start`
+    void set_loop_selection_policy(LoopSelectionPolicy loop_selection_policy) {
+        _loop_selection_policy = loop_selection_policy;
+    }
+
+    // takes precedence over the selection policy
+    void register_loop_selector(LoopSelectorType loop_selector) {
+        _loop_selector = std::move(loop_selector);
+    }
+
+    EventLoop *get_next_loop(const InetAddress *peer_address = nullptr);
+
+    EventLoop *get_loop(size_t loop_index) const {
+        return _thread_pool[loop_index]->get_loop();
+    }
+
+    size_t size() const {
+        return _thread_pool_capasity;
+    }
 
 private:
+    // the finalizer of SplitMix64, which spreads consecutive numbers evenly
+    static uint64_t _scramble(uint64_t x) noexcept {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+        return x ^ (x >> 31);
+    }
+
+    size_t _get_next_loop_index_by_round_robin() {
+        return static_cast<size_t>(_next_loop_index_counter.fetch_add(
+                   1, std::memory_order_relaxed
+               ))
+               % _thread_pool_capasity;
+    }
+
+    size_t _get_next_loop_index_by_least_connections() const;
+
+    template <typename LoadGetterType>
+    size_t _get_next_loop_index_by_power_of_two_choices(
+        const LoadGetterType &load_getter
+    );
+
+    size_t _get_next_loop_index_by_peer_address(const InetAddress &peer_address
+    ) const;
+
     const size_t _thread_pool_capasity;
 
     ThreadInitializationCallbackType _thread_initialization_callback;
@@ -57,8 +130,12 @@ private:
     bool _is_stopped = false;
     bool _is_joined = false;
 
+    LoopSelectionPolicy _loop_selection_policy =
+        LoopSelectionPolicy::ROUND_ROBIN;
+    LoopSelectorType _loop_selector;
+
     std::vector<std::shared_ptr<EventLoopThread>> _thread_pool;
-    std::atomic<int> _next_loop_index_counter{0};
+    std::atomic<uint64_t> _next_loop_index_counter{0};
 };
 
 } // namespace xubinh_server
@@ -1,16 +1,29 @@
 #ifndef __XUBINH_SERVER_EVENT_POLLER
 #define __XUBINH_SERVER_EVENT_POLLER
 
+#include <cstdint>
 #include <sys/epoll.h>
 #include <unordered_set>
 #include <vector>
 
+#ifdef __USE_IO_URING_POLLER
+#include <linux/io_uring.h>
+#endif
+
 #include "pollable_file_descriptor.h"
 #include "util/type_traits.h"
 
 namespace xubinh_server {
 
 // not thread-safe
+//
+// - backed by epoll by default, or by io_uring if `__USE_IO_URING_POLLER` is
+// defined, in which case the readiness of each fd is watched by a poll request
+// (multishot for edge-triggered fds) and all registration changes are batched
+// into the next `io_uring_enter(2)` instead of costing one `epoll_ctl(2)` each
+// - with io_uring, the fds could also be read by the poller itself through
+// multishot accept or receive requests, see
+// `PollableFileDescriptor::ReadMode`
 class EventPoller {
 private:
     using EventTypeEnumUnderlyingType =
@@ -54,11 +67,192 @@ public:
     }
 
     // pass by reference to prevent unnecessary memory allocations
+    //
+    // - returns immediately even if there are no active events when
+    // `should_block` is false
     void poll_for_active_events_of_all_fds(
-        std::vector<PollableFileDescriptor *> &event_dispatchers
+        std::vector<PollableFileDescriptor *> &event_dispatchers,
+        bool should_block = true
     );
 
+#ifdef __USE_IO_URING_POLLER
+    // the data received by a multishot receive request, given by a completion
+    // with `IORING_CQE_F_BUFFER` set, lives in one of the buffers provided by
+    // the poller, which should be given back as soon as it is consumed
+    const char *get_provided_buffer(uint16_t buffer_id) const {
+        return _provided_buffers
+               + static_cast<size_t>(buffer_id) * _PROVIDED_BUFFER_SIZE;
+    }
+
+    void recycle_provided_buffer(uint16_t buffer_id);
+#endif
+
 private:
+#ifdef __USE_IO_URING_POLLER
+    using ReadMode = PollableFileDescriptor::ReadMode;
+
+    struct Registration {
+        PollableFileDescriptor *event_dispatcher;
+
+        // epoll-style event mask, including `EPOLLET`
+        uint32_t events;
+
+        // distinguishes the current poll request of the fd from the stale
+        // ones, whose completions might still be in the completion queue
+        uint32_t generation;
+
+        // accumulated within a single poll
+        uint32_t active_events;
+
+        // same as `generation` but for the accept or receive request, which
+        // is only made if the fd is read by the poller itself and is being
+        // read (i.e. `EPOLLIN` is in `events`)
+        //
+        // - only bumped when the fd is detached (or falls back to readiness),
+        // since the results of a request cancelled for a pause are still
+        // taken by the owner once it resumes reading
+        uint32_t read_generation;
+
+        ReadMode read_mode;
+
+        // stays set until the terminating completion arrives, even if being
+        // cancelled
+        bool is_read_request_armed;
+
+        bool is_read_request_cancelled;
+    };
+
+    // whether the accept or receive request should be there
+    static bool _should_be_read(const Registration &registration) {
+        return registration.read_mode != ReadMode::READ_MODE_READINESS
+               && (registration.events & EPOLLIN);
+    }
+
+    // the events watched by the poll request, which leaves out the readable
+    // side if it is served by the accept or receive request
+    static uint32_t _get_poll_events(const Registration &registration) {
+        return registration.read_mode == ReadMode::READ_MODE_READINESS
+                   ? registration.events
+                   : registration.events & ~EVENT_TYPE_READ;
+    }
+
+    // fills the next submission queue entry, submitting all pending ones first
+    // if the submission queue is full
+    io_uring_sqe *_get_submission_queue_entry();
+
+    void _prepare_poll_add(int fd);
+
+    void _prepare_poll_remove(int fd);
+
+    void _prepare_poll_update(int fd);
+
+    // multishot accept or receive, depending on the read mode of the fd
+    void _prepare_read_request(int fd);
+
+    void _prepare_read_request_cancel(int fd);
+
+    // submits all pending entries and waits for at least the given number of
+    // completions
+    //
+    // - deferred completions are only posted when waiting for some, or when
+    // `should_get_events` is true
+    void _submit_and_wait(
+        unsigned int min_number_of_completions, bool should_get_events = false
+    );
+
+    void _handle_completion(
+        const io_uring_cqe &completion_queue_entry,
+        std::vector<PollableFileDescriptor *> &event_dispatchers
+    );
+
+    void _handle_read_completion(
+        int fd,
+        uint32_t generation,
+        const io_uring_cqe &completion_queue_entry,
+        std::vector<PollableFileDescriptor *> &event_dispatchers
+    );
+
+    // releases what a result nobody is going to take holds, i.e. the accepted
+    // fd or the provided buffer
+    void _discard_read_completion(
+        ReadMode read_mode, int32_t result, uint32_t flags
+    );
+
+    void _add_active_events(
+        Registration &registration,
+        uint32_t active_events,
+        std::vector<PollableFileDescriptor *> &event_dispatchers
+    );
+
+    // dispatches the results held while the fds were not being read, see
+    // `_handle_read_completion`
+    void _add_held_read_completions(
+        std::vector<PollableFileDescriptor *> &event_dispatchers
+    );
+
+    // the poll requests are of `READ_MODE_READINESS` in terms of the kind
+    static uint64_t
+    _make_user_data(int fd, uint32_t generation, ReadMode request_kind) {
+        return (static_cast<uint64_t>(request_kind) << 62)
+               | (static_cast<uint64_t>(generation & _GENERATION_MASK) << 32)
+               | static_cast<uint32_t>(fd);
+    }
+
+    // the top two bits of the user data are taken by the kind of the request
+    static constexpr uint32_t _GENERATION_MASK = 0x3fffffff;
+
+    // for completions of the requests that are made by the poller for itself,
+    // e.g. removals and cancellations
+    static constexpr uint64_t _INTERNAL_USER_DATA = ~static_cast<uint64_t>(0);
+
+    static constexpr uint16_t _PROVIDED_BUFFER_GROUP_ID = 0;
+
+    // must be a power of two
+    static constexpr unsigned int _NUMBER_OF_PROVIDED_BUFFERS = 1024;
+
+    static constexpr size_t _PROVIDED_BUFFER_SIZE = 4 * 1024;
+
+    static constexpr unsigned int _NUMBER_OF_SUBMISSION_QUEUE_ENTRIES = 1024;
+
+    static constexpr unsigned int _NUMBER_OF_COMPLETION_QUEUE_ENTRIES =
+        16 * 1024;
+
+    int _ring_fd;
+
+    void *_submission_queue_ring;
+    size_t _submission_queue_ring_size;
+    void *_completion_queue_ring;
+    size_t _completion_queue_ring_size;
+
+    unsigned int *_submission_queue_head;
+    unsigned int *_submission_queue_tail;
+    unsigned int *_submission_queue_flags;
+    unsigned int _submission_queue_local_tail;
+    unsigned int _submission_queue_mask;
+    unsigned int _number_of_submission_queue_entries;
+    io_uring_sqe *_submission_queue_entries;
+    size_t _submission_queue_entries_size;
+    unsigned int _number_of_pending_submissions{0};
+
+    unsigned int *_completion_queue_head;
+    unsigned int *_completion_queue_tail;
+    unsigned int _completion_queue_mask;
+    io_uring_cqe *_completion_queue_entries;
+
+    // null if the kernel does not support provided buffer rings, in which
+    // case the fds asking for multishot receive are watched for readiness
+    // instead
+    io_uring_buf_ring *_provided_buffer_ring{nullptr};
+    size_t _provided_buffer_ring_size{0};
+    uint16_t _provided_buffer_ring_local_tail{0};
+    char *_provided_buffers{nullptr};
+
+    size_t _max_number_of_registrations;
+    Registration *_registrations;
+
+    // the fds that resume reading with some results held
+    std::vector<int> _fds_with_held_read_completions;
+#else
     // - ignored but still must be greater than zero since Linux 2.6.8
     // - only used by `epoll_create`
     static constexpr int _SIZE_ARGUMENT_FOR_EPOLL_CREATE = 1;
@@ -69,6 +263,7 @@ private:
     int _epoll_fd;
     size_t _max_size_of_event_array;
     epoll_event *_event_array;
+#endif
     bool *_fds_that_are_listening_on;
     size_t _number_of_fds_that_are_listening_on{0};
 };
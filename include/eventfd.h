@@ -1,6 +1,7 @@
 #ifndef __XUBINH_SERVER_EVENTFD
 #define __XUBINH_SERVER_EVENTFD
 
+#include <functional>
 #include <sys/eventfd.h>
 
 #include "pollable_file_descriptor.h"
@@ -1,7 +1,9 @@
 #ifndef __XUBINH_SERVER_LISTEN_SOCKETFD
 #define __XUBINH_SERVER_LISTEN_SOCKETFD
 
+#include <atomic>
 #include <functional>
+#include <vector>
 
 #include "inet_address.h"
 #include "pollable_file_descriptor.h"
@@ -19,23 +21,50 @@ public:
         util::TimePoint time_stamp
     )>;
 
+    using AcceptBatchEndCallbackType = std::function<void()>;
+
     static void set_socketfd_as_address_reusable(int socketfd);
 
+    // allows multiple listen socketfds to be bound to the same address, with
+    // incoming connections load-balanced among them by the kernel
+    static void set_socketfd_as_port_reusable(int socketfd);
+
+    // attaches a classic BPF program to the reuseport group of the given
+    // socketfd, which picks the socketfd whose owner thread is pinned to the
+    // CPU handling the incoming connection
+    //
+    // - `cpus_of_socketfds[i]` is the CPU that the owner thread of the i-th
+    // socketfd within the group is pinned to; the CPUs must be distinct
+    // - connections handled by any other CPU fall back to the socketfd whose
+    // index equals that CPU modulo the group size
+    // - returns false on failure, in which case the kernel keeps distributing
+    // connections by hashing
+    static bool attach_cpu_steering_program_to_reuse_port_group(
+        int socketfd, const std::vector<int> &cpus_of_socketfds
+    );
+
     static void bind(int socketfd, const InetAddress &local_address);
 
     static void listen(int socketfd);
 
-    static void set_max_number_of_new_connections_at_a_time(
+    ListenSocketfd(int fd, EventLoop *event_loop);
+
+    ~ListenSocketfd();
+
+    // the budget of accepting for each readiness event, so that a connection
+    // storm could not starve the other fds of the same loop
+    //
+    // - 1000 by default
+    // - does not apply to the multishot accepts made by the io_uring poller,
+    // which hand over whatever the kernel has accepted so far
+    // - should be called before `start()`
+    void set_max_number_of_new_connections_at_a_time(
         int max_number_of_new_connections_at_a_time
     ) {
         _max_number_of_new_connections_at_a_time =
             max_number_of_new_connections_at_a_time;
     }
 
-    ListenSocketfd(int fd, EventLoop *event_loop);
-
-    ~ListenSocketfd();
-
     // used by internal framework
     void register_new_connection_callback(
         NewConnectionCallbackType new_connection_callback
@@ -43,6 +72,28 @@ public:
         _new_connection_callback = std::move(new_connection_callback);
     }
 
+    // called after each readiness event once the connections accepted are all
+    // passed to the new connection callback, so that the work piled up by the
+    // latter could be flushed in batches
+    //
+    // - used by internal framework
+    void register_accept_batch_end_callback(
+        AcceptBatchEndCallbackType accept_batch_end_callback
+    ) {
+        _accept_batch_end_callback = std::move(accept_batch_end_callback);
+    }
+
+    // thread-safe
+    uint64_t get_number_of_accepted_connections() const {
+        return _number_of_accepted_connections.load(std::memory_order_relaxed);
+    }
+
+    // thread-safe; the number of readiness events that accepted at least one
+    // connection
+    uint64_t get_number_of_accept_batches() const {
+        return _number_of_accept_batches.load(std::memory_order_relaxed);
+    }
+
     void start();
 
     void stop();
@@ -65,7 +116,17 @@ private:
 
     void _read_event_callback(util::TimePoint time_stamp);
 
-    static int _max_number_of_new_connections_at_a_time;
+#ifdef __USE_IO_URING_POLLER
+    // takes the connections accepted by the poller on behalf of this listen
+    // socketfd, to which the accepting budget does not apply
+    uint64_t _accept_all_completed_connections(util::TimePoint time_stamp);
+#endif
+
+    // updates the stats and calls back once the connections accepted for a
+    // readiness event are all handed over
+    void _finish_accept_batch(uint64_t number_of_accepted_connections);
+
+    int _max_number_of_new_connections_at_a_time{1000};
 
     int _spare_fd = -1;
 
@@ -73,6 +134,11 @@ private:
     const int _accept_flags{SOCK_NONBLOCK | SOCK_CLOEXEC};
 
     NewConnectionCallbackType _new_connection_callback;
+    AcceptBatchEndCallbackType _accept_batch_end_callback;
+
+    // only written by the owner loop
+    std::atomic<uint64_t> _number_of_accepted_connections{0};
+    std::atomic<uint64_t> _number_of_accept_batches{0};
 
     PollableFileDescriptor _pollable_file_descriptor;
 
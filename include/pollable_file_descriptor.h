@@ -2,11 +2,12 @@
 #define __XUBINH_SERVER_POLLABLE_FILE_DESCRIPTOR
 
 #include <cstdint>
-#include <functional>
 #include <memory>
 #include <sys/epoll.h>
 #include <unistd.h>
+#include <vector>
 
+#include "util/inplace_function.h"
 #include "util/time_point.h"
 
 namespace xubinh_server {
@@ -22,13 +23,34 @@ private:
 
 public:
     using ReadEventCallbackType =
-        std::function<void(util::TimePoint time_stamp)>;
-
-    using WriteEventCallbackType = std::function<void()>;
-
-    using CloseEventCallbackType = std::function<void()>;
-
-    using ErrorEventCallbackType = std::function<void()>;
+        util::InplaceFunction<void(util::TimePoint time_stamp)>;
+
+    using WriteEventCallbackType = util::InplaceFunction<void()>;
+
+    using CloseEventCallbackType = util::InplaceFunction<void()>;
+
+    using ErrorEventCallbackType = util::InplaceFunction<void()>;
+
+#ifdef __USE_IO_URING_POLLER
+    // the readable side of a fd could be served by the completion-based
+    // requests made by the poller on behalf of the owner, i.e. a multishot
+    // accept for listen socketfds or a multishot receive into the buffers
+    // provided by the poller (see `EventPoller::get_provided_buffer`) for
+    // connect socketfds, in which case the owner takes the results from
+    // `get_completions()` in its read event callback instead of making the
+    // syscalls by itself
+    enum ReadMode : uint8_t {
+        READ_MODE_READINESS,
+        READ_MODE_MULTISHOT_ACCEPT,
+        READ_MODE_MULTISHOT_RECEIVE
+    };
+
+    // `res` and `flags` of a completion queue entry
+    struct Completion {
+        int32_t result;
+        uint32_t flags;
+    };
+#endif
 
     static void set_fd_as_blocking(int fd);
 
@@ -59,50 +81,23 @@ public:
 
     void close_fd() const;
 
-    void register_read_event_callback(
-        const ReadEventCallbackType &read_event_callback
-    ) {
-        _read_event_callback = read_event_callback;
-    }
-
     void
-    register_read_event_callback(ReadEventCallbackType &&read_event_callback) {
+    register_read_event_callback(ReadEventCallbackType read_event_callback) {
         _read_event_callback = std::move(read_event_callback);
     }
 
-    void register_write_event_callback(
-        const WriteEventCallbackType &write_event_callback
-    ) {
-        _write_event_callback = write_event_callback;
-    }
-
     void
-    register_write_event_callback(WriteEventCallbackType &&write_event_callback
-    ) {
+    register_write_event_callback(WriteEventCallbackType write_event_callback) {
         _write_event_callback = std::move(write_event_callback);
     }
 
-    void register_close_event_callback(
-        const CloseEventCallbackType &close_event_callback
-    ) {
-        _close_event_callback = close_event_callback;
-    }
-
     void
-    register_close_event_callback(CloseEventCallbackType &&close_event_callback
-    ) {
+    register_close_event_callback(CloseEventCallbackType close_event_callback) {
         _close_event_callback = std::move(close_event_callback);
     }
 
-    void register_error_event_callback(
-        const ErrorEventCallbackType &error_event_callback
-    ) {
-        _error_event_callback = error_event_callback;
-    }
-
     void
-    register_error_event_callback(ErrorEventCallbackType &&error_event_callback
-    ) {
+    register_error_event_callback(ErrorEventCallbackType error_event_callback) {
         _error_event_callback = std::move(error_event_callback);
     }
 
@@ -114,6 +109,24 @@ public:
 
     void disable_write_event();
 
+    // stops polling for readability without giving up reading, i.e.
+    // `is_reading()` stays unchanged, so that the owner could apply
+    // backpressure to the peer
+    //
+    // - with io_uring, the results that the poller has already received on
+    // behalf of the fd are held and handed over after resuming
+    void pause_read_event();
+
+    void resume_read_event();
+
+    bool is_read_paused() const {
+        return _is_read_paused;
+    }
+
+    // attaches to the poller without polling for reading or writing, i.e. only
+    // for the close and error events, which are always reported
+    void attach_to_poller();
+
     void detach_from_poller();
 
     bool is_reading() const {
@@ -128,6 +141,25 @@ public:
         return _is_detached;
     }
 
+#ifdef __USE_IO_URING_POLLER
+    // should be set before being attached to the poller, which falls back to
+    // `READ_MODE_READINESS` (and sets it here) if the kernel does not support
+    // the requests
+    void set_read_mode(ReadMode read_mode) {
+        _read_mode = read_mode;
+    }
+
+    ReadMode get_read_mode() const {
+        return _read_mode;
+    }
+
+    // filled by the poller, and should be drained by the owner within the read
+    // event callback
+    std::vector<Completion> &get_completions() {
+        return _completions;
+    }
+#endif
+
     // used by poller
     void set_active_events(uint32_t active_events) {
         _active_events = active_events;
@@ -145,6 +177,12 @@ public:
 
     void reset_to(int new_fd);
 
+    // takes over a new fd as if newly constructed, for the owner object being
+    // reused (see `TcpConnectSocketfd::create`)
+    //
+    // - must be detached, with the old fd closed by the owner already
+    void reuse_for(int new_fd);
+
 private:
     void _register_event();
 
@@ -152,6 +190,7 @@ private:
 
     bool _is_reading = false;
     bool _is_writing = false;
+    bool _is_read_paused = false;
     bool _is_detached = true;
 
     int _fd;
@@ -165,6 +204,10 @@ private:
     ErrorEventCallbackType _error_event_callback;
     std::weak_ptr<void> _weak_lifetime_guard;
     bool _is_weak_lifetime_guard_registered = false;
+#ifdef __USE_IO_URING_POLLER
+    ReadMode _read_mode = READ_MODE_READINESS;
+    std::vector<Completion> _completions;
+#endif
 };
 
 } // namespace xubinh_server
@@ -1,6 +1,8 @@
 #ifndef __XUBINH_SERVER_PRECONNECT_SOCKETFD
 #define __XUBINH_SERVER_PRECONNECT_SOCKETFD
 
+#include <functional>
+
 #include "inet_address.h"
 #include "pollable_file_descriptor.h"
 #include "socketfd.h"
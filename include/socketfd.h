@@ -10,6 +10,16 @@ struct Socketfd {
     static int get_socketfd_errno(int socketfd);
 
     static void disable_socketfd_nagle_algorithm(int socketfd);
+
+    // lets the kernel busy-poll the device queue for up to the given time when
+    // the socketfd is read with no data available, and prefer doing so over
+    // deferring to softirq processing
+    //
+    // - returns false if any of the options is rejected by the kernel, e.g.
+    // too old to know it, or the time exceeds `net.core.busy_read` without
+    // `CAP_NET_ADMIN`
+    static bool
+    enable_socketfd_busy_polling(int socketfd, int busy_poll_microseconds);
 };
 
 } // namespace xubinh_server
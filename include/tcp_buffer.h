@@ -4,7 +4,9 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstring>
+#include <deque>
 #include <string>
+#include <sys/uio.h>
 #include <vector>
 
 #include "util/slab_allocator.h"
@@ -16,6 +18,9 @@ class MutableSizeTcpBuffer {
 public:
     using StringType = util::StringType;
 
+    // max capacity kept by `clear()`
+    static constexpr const size_t MAX_RETAINED_CAPACITY = 16 * 1024; // 16 KB
+
     MutableSizeTcpBuffer() noexcept {
         _volatile_buffer_begin_ptr = const_cast<char *>(_buffer.c_str());
     }
@@ -29,6 +34,7 @@ public:
         _volatile_buffer_begin_ptr = const_cast<char *>(_buffer.c_str());
         _read_offset = 0;
         _write_offset = 0;
+        _reset_scan_offsets();
     }
 
     void release() noexcept {
@@ -43,6 +49,33 @@ public:
         // the malloc'ed memory off
         ::new (&_buffer) StringType();
         _volatile_buffer_begin_ptr = nullptr;
+
+        // keeps the spare space empty rather than negative, so that writing
+        // after releasing simply reallocates
+        _read_offset = 0;
+        _write_offset = 0;
+        _reset_scan_offsets();
+    }
+
+    // discards the data but keeps the memory for the next use, e.g. by the
+    // next connection taking over a recycled connection object, unless it
+    // grew beyond `MAX_RETAINED_CAPACITY`
+    void clear() noexcept {
+        if (!_volatile_buffer_begin_ptr
+            || _buffer.size() > MAX_RETAINED_CAPACITY) {
+
+            reset();
+
+            return;
+        }
+
+        _read_offset = 0;
+        _write_offset = 0;
+        _reset_scan_offsets();
+    }
+
+    size_t get_capacity() const {
+        return _buffer.size();
     }
 
     const char *get_read_position() const {
@@ -58,10 +91,80 @@ public:
             std::min(_read_offset + number_of_bytes_read, _write_offset);
     }
 
+    // begin address of the spare space, into which the outside (e.g.
+    // `readv(2)`) could write directly
+    char *get_write_position() {
+        return _volatile_buffer_begin_ptr + _write_offset;
+    }
+
+    // size of the spare space that can be written without reallocation
+    size_t get_writable_size() const {
+        return _buffer.size() - _write_offset;
+    }
+
+    // commits the data written directly into the spare space
+    void forward_write_position(size_t number_of_bytes_written) {
+        _write_offset = std::min(
+            _write_offset + number_of_bytes_written, _buffer.size()
+        );
+    }
+
+    // makes sure the spare space is at least the given size, by compacting or
+    // reallocating the buffer
+    void ensure_writable_size(size_t size);
+
+    // [NOTE]: the three functions below exist for being interchangeable with
+    // `SlabChainTcpBuffer`, whose data and spare space may span multiple
+    // segments; this buffer always has at most one of each
+
+    // fills the iovec array with the readable data and returns the number of
+    // entries filled
+    int get_readable_iovecs(iovec *iovecs, int max_number_of_iovecs) const {
+        if (max_number_of_iovecs < 1 || get_readable_size() == 0) {
+            return 0;
+        }
+
+        iovecs[0].iov_base = const_cast<char *>(get_read_position());
+        iovecs[0].iov_len = get_readable_size();
+
+        return 1;
+    }
+
+    // fills the iovec array with the spare space and returns the number of
+    // entries filled
+    int get_writable_iovecs(iovec *iovecs, int max_number_of_iovecs) {
+        if (max_number_of_iovecs < 1) {
+            return 0;
+        }
+
+        iovecs[0].iov_base = get_write_position();
+        iovecs[0].iov_len = get_writable_size();
+
+        return 1;
+    }
+
+    // returns the begin address of the first `size` readable bytes, which are
+    // made contiguous in memory if not already
+    const char *linearize(__attribute__((unused)) size_t size) {
+        return get_read_position();
+    }
+
+    // [NOTE]: the delimiter searches below resume from where the previous
+    // search of the same kind stopped, so that the data trickling in is not
+    // scanned over and over again
+
     const char *get_next_newline_position();
 
     const char *get_next_crlf_position();
 
+    // i.e. the end of the headers of an HTTP message
+    const char *get_next_double_crlf_position();
+
+    // not resumable; scans from the read position every time
+    const char *get_next_delimiter_position(
+        const char *delimiter, size_t delimiter_size
+    ) const;
+
     // appends size-known external (i.e. already existed) buffer of data into
     // this TCP buffer
     void append(const char *external_buffer, size_t external_buffer_size) {
@@ -91,21 +194,482 @@ public:
     }
 
 private:
-    // makes space (and possibly reallocates memory), default initializes with
-    // `\0`, and return the begin address of the newly made space (the size of
-    // which is exactly the size that passed in)
+    // makes space (and possibly reallocates memory) and return the begin
+    // address of the newly made space (the size of which is exactly the size
+    // that passed in)
     //
     // - the buffer size will always be added by the size of the newly made
     // space, whether or not any data is written into it
     // - returns `nullptr` if the size passed in is zero
     char *_make_space(size_t size);
 
+    // searches from the recorded scan offset, and records where the next
+    // search should start from
+    template <typename FinderType>
+    const char *_find_resumably(
+        size_t &scan_offset, size_t delimiter_size, FinderType finder
+    );
+
+    void _reset_scan_offsets() noexcept {
+        _newline_scan_offset = 0;
+        _crlf_scan_offset = 0;
+        _double_crlf_scan_offset = 0;
+    }
+
+    // [NOTE]: the size of the underlying string always covers the whole
+    // allocated space so that the spare space after the write offset can be
+    // written directly; only the offsets tell where the data is
     StringType _buffer;
     char *_volatile_buffer_begin_ptr{nullptr};
     size_t _read_offset{0};
     size_t _write_offset{0};
+
+    // offsets before which the delimiters are known to be absent
+    size_t _newline_scan_offset{0};
+    size_t _crlf_scan_offset{0};
+    size_t _double_crlf_scan_offset{0};
+};
+
+// not thread-safe
+//
+// - backed by a `memfd` whose pages are mapped twice back-to-back, so that
+// the readable data is always contiguous in memory even if it wraps around the
+// end of the file, and no compaction is ever needed
+// - grows by enlarging the file and remapping it, in which case only the
+// wrapped part of the readable data (if any) is copied; new space is not
+// zero-filled
+// - costs a fd and two mappings per buffer, which are only acquired on the
+// first write and are given back by `release()`
+class RingTcpBuffer {
+public:
+    using StringType = util::StringType;
+
+    // max capacity kept by `clear()`
+    static constexpr const size_t MAX_RETAINED_CAPACITY = 64 * 1024; // 64 KB
+
+    RingTcpBuffer() noexcept = default;
+
+    RingTcpBuffer(const RingTcpBuffer &) = delete;
+    RingTcpBuffer &operator=(const RingTcpBuffer &) = delete;
+
+    ~RingTcpBuffer() {
+        release();
+    }
+
+    void reset() noexcept {
+        release();
+    }
+
+    void release() noexcept;
+
+    // see `MutableSizeTcpBuffer::clear`; the memfd and the mappings are kept
+    // along with the memory
+    void clear() noexcept {
+        if (_capacity > MAX_RETAINED_CAPACITY) {
+            release();
+
+            return;
+        }
+
+        _read_offset = 0;
+        _write_offset = 0;
+        _newline_scan_offset = 0;
+        _crlf_scan_offset = 0;
+        _double_crlf_scan_offset = 0;
+    }
+
+    // size of the ring, i.e. the max readable size without growing
+    size_t get_capacity() const {
+        return _capacity;
+    }
+
+    const char *get_read_position() const {
+        return _mapped_address + _read_offset;
+    }
+
+    size_t get_readable_size() const {
+        return _write_offset - _read_offset;
+    }
+
+    void forward_read_position(size_t number_of_bytes_read) {
+        _read_offset =
+            std::min(_read_offset + number_of_bytes_read, _write_offset);
+
+        // moves back to the first mapping, which shows the same bytes
+        if (_read_offset >= _capacity) {
+            _read_offset -= _capacity;
+            _write_offset -= _capacity;
+
+            _shift_scan_offsets_back();
+        }
+    }
+
+    // see `MutableSizeTcpBuffer::get_write_position`
+    char *get_write_position() {
+        return _mapped_address + _write_offset;
+    }
+
+    size_t get_writable_size() const {
+        return _capacity - get_readable_size();
+    }
+
+    void forward_write_position(size_t number_of_bytes_written) {
+        _write_offset = std::min(
+            _write_offset + number_of_bytes_written, _read_offset + _capacity
+        );
+    }
+
+    // makes sure the spare space is at least the given size, by growing the
+    // ring
+    void ensure_writable_size(size_t size) {
+        if (size > get_writable_size()) {
+            _grow(get_readable_size() + size);
+        }
+    }
+
+    // see `MutableSizeTcpBuffer::get_readable_iovecs`
+    int get_readable_iovecs(iovec *iovecs, int max_number_of_iovecs) const {
+        if (max_number_of_iovecs < 1 || get_readable_size() == 0) {
+            return 0;
+        }
+
+        iovecs[0].iov_base = const_cast<char *>(get_read_position());
+        iovecs[0].iov_len = get_readable_size();
+
+        return 1;
+    }
+
+    int get_writable_iovecs(iovec *iovecs, int max_number_of_iovecs) {
+        if (max_number_of_iovecs < 1) {
+            return 0;
+        }
+
+        iovecs[0].iov_base = get_write_position();
+        iovecs[0].iov_len = get_writable_size();
+
+        return 1;
+    }
+
+    // the readable data is always contiguous
+    const char *linearize(__attribute__((unused)) size_t size) {
+        return get_read_position();
+    }
+
+    // see `MutableSizeTcpBuffer::get_next_newline_position`
+
+    const char *get_next_newline_position();
+
+    const char *get_next_crlf_position();
+
+    const char *get_next_double_crlf_position();
+
+    const char *get_next_delimiter_position(
+        const char *delimiter, size_t delimiter_size
+    ) const;
+
+    void append(const char *external_buffer, size_t external_buffer_size) {
+        if (external_buffer_size == 0) {
+            return;
+        }
+
+        ensure_writable_size(external_buffer_size);
+
+        ::memcpy(get_write_position(), external_buffer, external_buffer_size);
+
+        _write_offset += external_buffer_size;
+    }
+
+    void append(const StringType &external_buffer) {
+        append(external_buffer.c_str(), external_buffer.size());
+    }
+
+    void append_space() {
+        append(" ", 1);
+    }
+
+    void append_newline() {
+        append("\n", 1);
+    }
+
+    void append_crlf() {
+        append("\r\n", 2);
+    }
+
+    void append_colon() {
+        append(":", 1);
+    }
+
+private:
+    // makes the capacity at least the given size, which is rounded up to a
+    // multiple of the page size and at least doubled
+    void _grow(size_t min_capacity);
+
+    // see `MutableSizeTcpBuffer::_find_resumably`
+    template <typename FinderType>
+    const char *_find_resumably(
+        size_t &scan_offset, size_t delimiter_size, FinderType finder
+    );
+
+    // follows the read offset back to the first mapping
+    void _shift_scan_offsets_back() noexcept {
+        _newline_scan_offset = _get_shifted_back_offset(_newline_scan_offset);
+        _crlf_scan_offset = _get_shifted_back_offset(_crlf_scan_offset);
+        _double_crlf_scan_offset =
+            _get_shifted_back_offset(_double_crlf_scan_offset);
+    }
+
+    size_t _get_shifted_back_offset(size_t offset) const noexcept {
+        return offset > _capacity ? offset - _capacity : 0;
+    }
+
+    int _memfd{-1};
+
+    // begin address of the first of the two mappings
+    char *_mapped_address{nullptr};
+
+    size_t _capacity{0};
+
+    // [NOTE]: the read offset always lies within the first mapping, while the
+    // write offset may go into the second one
+    size_t _read_offset{0};
+    size_t _write_offset{0};
+
+    size_t _newline_scan_offset{0};
+    size_t _crlf_scan_offset{0};
+    size_t _double_crlf_scan_offset{0};
+};
+
+// not thread-safe
+//
+// - a chain of fixed-size slabs taken from a thread-local (i.e. per-loop)
+// pool, which grows by appending slabs instead of reallocating and copying the
+// data already received, and gives each slab back as soon as it is consumed,
+// so that a large request body never needs a large contiguous allocation
+// - the data is only contiguous within a slab; `get_readable_iovecs()` shows
+// all of it segment by segment, and `linearize()` makes a prefix of it
+// contiguous on demand
+// - the delimiter searches look across slab boundaries, and the positions
+// returned are always contiguous with the read position, so that parsers
+// written for the other buffers work unchanged
+class SlabChainTcpBuffer {
+public:
+    using StringType = util::StringType;
+
+    static constexpr const size_t SLAB_SIZE = 16 * 1024; // 16 KB
+
+    SlabChainTcpBuffer() noexcept = default;
+
+    SlabChainTcpBuffer(const SlabChainTcpBuffer &) = delete;
+    SlabChainTcpBuffer &operator=(const SlabChainTcpBuffer &) = delete;
+
+    // takes over the slabs, leaving the other one empty
+    SlabChainTcpBuffer(SlabChainTcpBuffer &&other) noexcept {
+        _swap(other);
+    }
+
+    // see above
+    SlabChainTcpBuffer &operator=(SlabChainTcpBuffer &&other) noexcept {
+        if (this != &other) {
+            release();
+
+            _swap(other);
+        }
+
+        return *this;
+    }
+
+    ~SlabChainTcpBuffer() {
+        release();
+    }
+
+    void reset() noexcept {
+        release();
+    }
+
+    void release() noexcept;
+
+    // see `MutableSizeTcpBuffer::clear`; the slabs are given back to the pool
+    // anyway, which is where they are taken from next time
+    void clear() noexcept {
+        release();
+    }
+
+    size_t get_number_of_segments() const {
+        return _segments.size();
+    }
+
+    // begin address of the readable data in the first segment, or `nullptr`
+    // if there is no readable data
+    //
+    // - only `get_contiguous_readable_size()` bytes are contiguous from here
+    const char *get_read_position() const {
+        return _readable_size ? _segments.front().data
+                                    + _segments.front().read_offset
+                              : nullptr;
+    }
+
+    size_t get_contiguous_readable_size() const {
+        return _readable_size ? _segments.front().write_offset
+                                    - _segments.front().read_offset
+                              : 0;
+    }
+
+    size_t get_readable_size() const {
+        return _readable_size;
+    }
+
+    // gives the segments that are fully consumed back to the pool
+    void forward_read_position(size_t number_of_bytes_read);
+
+    // begin address of the spare space in the segment being written
+    char *get_write_position() {
+        return _write_segment_index < _segments.size()
+                   ? _segments[_write_segment_index].data
+                         + _segments[_write_segment_index].write_offset
+                   : nullptr;
+    }
+
+    // size of the spare space in the segment being written, i.e. the max
+    // number of bytes that can be written at `get_write_position()`
+    size_t get_writable_size() const {
+        return _write_segment_index < _segments.size()
+                   ? _segments[_write_segment_index].capacity
+                         - _segments[_write_segment_index].write_offset
+                   : 0;
+    }
+
+    // commits the data written into the spare space, which may span multiple
+    // segments
+    void forward_write_position(size_t number_of_bytes_written);
+
+    // makes sure the spare space in total is at least the given size, by
+    // appending slabs
+    void ensure_writable_size(size_t size);
+
+    int get_readable_iovecs(iovec *iovecs, int max_number_of_iovecs) const;
+
+    // see `MutableSizeTcpBuffer::get_writable_iovecs`
+    //
+    // - makes sure there is some spare space first, which is a few slabs
+    // rather than one if the last commit used up all of it, so that bulk
+    // transfers are read into the chain directly
+    int get_writable_iovecs(iovec *iovecs, int max_number_of_iovecs);
+
+    // see `MutableSizeTcpBuffer::linearize`
+    //
+    // - a prefix that fits into a slab is gathered into the first slab, and
+    // a larger one into a dedicated segment of its own
+    const char *linearize(size_t size);
+
+    // see `MutableSizeTcpBuffer::get_next_newline_position`
+
+    const char *get_next_newline_position();
+
+    const char *get_next_crlf_position();
+
+    const char *get_next_double_crlf_position();
+
+    // not resumable, and may linearize the data before the delimiter
+    const char *
+    get_next_delimiter_position(const char *delimiter, size_t delimiter_size);
+
+    void append(const char *external_buffer, size_t external_buffer_size);
+
+    void append(const StringType &external_buffer) {
+        append(external_buffer.c_str(), external_buffer.size());
+    }
+
+    void append_space() {
+        append(" ", 1);
+    }
+
+    void append_newline() {
+        append("\n", 1);
+    }
+
+    void append_crlf() {
+        append("\r\n", 2);
+    }
+
+    void append_colon() {
+        append(":", 1);
+    }
+
+private:
+    struct Segment {
+        char *data;
+        size_t capacity;
+        size_t read_offset;
+        size_t write_offset;
+
+        // taken from the slab pool, or allocated by `linearize()` otherwise
+        bool is_pooled;
+    };
+
+    static char *_allocate_slab();
+
+    static void _deallocate_slab(char *slab) noexcept;
+
+    void _swap(SlabChainTcpBuffer &other) noexcept;
+
+    static void _deallocate_segment(const Segment &segment) noexcept;
+
+    // moves the given number of bytes out of the segments starting from the
+    // given index into the destination, and drops the segments emptied
+    void _move_out(
+        size_t first_segment_index, char *destination, size_t number_of_bytes
+    );
+
+    void _erase_segment(size_t segment_index) noexcept;
+
+    // whether the delimiter starts at the given offset of the given segment,
+    // looking into the following segments if needed
+    bool _is_delimiter_at(
+        size_t segment_index,
+        size_t offset,
+        const char *delimiter,
+        size_t delimiter_size
+    ) const;
+
+    // searches from the recorded scan offset, which counts from the very
+    // first byte ever written so that it survives slabs being dropped
+    const char *_find_resumably(
+        size_t &scan_offset, const char *delimiter, size_t delimiter_size
+    );
+
+    // max number of slabs kept by each thread for reuse
+    static constexpr const size_t _MAX_NUMBER_OF_CACHED_SLABS = 256; // 4 MB
+
+    // number of spare slabs prepared after the spare space is used up
+    static constexpr const size_t _NUMBER_OF_SLABS_FOR_BULK_READING = 4;
+
+    // [NOTE]: all segments before the one being written are full, and all
+    // segments after it are empty
+    std::deque<Segment> _segments;
+    size_t _write_segment_index{0};
+
+    size_t _readable_size{0};
+
+    // number of bytes consumed since the last release, i.e. the stream offset
+    // of the read position
+    size_t _number_of_bytes_consumed{0};
+
+    bool _is_spare_space_used_up{false};
+
+    size_t _newline_scan_offset{0};
+    size_t _crlf_scan_offset{0};
+    size_t _double_crlf_scan_offset{0};
 };
 
+// the buffer handed to the message callbacks of TCP connections
+#ifdef __USE_RING_TCP_BUFFER
+using TcpInputBuffer = RingTcpBuffer;
+#elif defined(__USE_SLAB_CHAIN_TCP_BUFFER)
+using TcpInputBuffer = SlabChainTcpBuffer;
+#else
+using TcpInputBuffer = MutableSizeTcpBuffer;
+#endif
+
 } // namespace xubinh_server
 
 #endif
\ No newline at end of file
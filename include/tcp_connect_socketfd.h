@@ -1,37 +1,107 @@
 #ifndef __XUBINH_SERVER_TCP_CONNECT_SOCKETFD
 #define __XUBINH_SERVER_TCP_CONNECT_SOCKETFD
 
+#include <algorithm>
 #include <atomic>
+#include <deque>
 
 #include "inet_address.h"
 #include "pollable_file_descriptor.h"
 #include "socketfd.h"
 #include "tcp_buffer.h"
+#include "tcp_output_queue.h"
+#include "timer_identifier.h"
 #include "util/any.h"
+#include "util/inplace_function.h"
+#include "util/intrusive_ptr.h"
+#include "util/slab_allocator.h"
 #include "util/time_point.h"
 
 namespace xubinh_server {
 
+// connections are reference counted intrusively and created by `create`,
+// with the memory taken from the thread-local slab allocator
+//
+// - the worker loop holds a reference of its own from `start()` till the end
+// of the iteration in which the connection is closed, so that the events are
+// dispatched without locking up anything
+// - a connection whose last reference is the one of the worker loop is taken
+// back by the loop for reuse instead of being destroyed, along with its
+// buffers (see `set_max_number_of_recycled_connections_per_loop`)
 class alignas(64) TcpConnectSocketfd
-    : public std::enable_shared_from_this<TcpConnectSocketfd>,
+    : public util::IntrusiveReferenceCounted<
+          TcpConnectSocketfd,
+          util::StaticThreadLocalSlabAllocator<TcpConnectSocketfd>>,
       public Socketfd {
+private:
+    using _Base = util::IntrusiveReferenceCounted<
+        TcpConnectSocketfd,
+        util::StaticThreadLocalSlabAllocator<TcpConnectSocketfd>>;
+
+    friend _Base;
+
 public:
-    using TcpConnectSocketfdPtr = std::shared_ptr<TcpConnectSocketfd>;
+    // could be copied or released in any thread
+    using TcpConnectSocketfdPtr = util::IntrusivePtr<TcpConnectSocketfd>;
 
-    using MessageCallbackType = std::function<void(
+    // must only be copied or released inside the worker loop
+    using LocalTcpConnectSocketfdPtr =
+        util::LocalIntrusivePtr<TcpConnectSocketfd>;
+
+    using MessageCallbackType = util::InplaceFunction<void(
         TcpConnectSocketfd *tcp_connect_socketfd_ptr,
-        MutableSizeTcpBuffer *input_buffer,
+        TcpInputBuffer *input_buffer,
         util::TimePoint time_stamp
     )>;
 
-    using WriteCompleteCallbackType = std::function<void(TcpConnectSocketfd *)>;
+    using WriteCompleteCallbackType =
+        util::InplaceFunction<void(TcpConnectSocketfd *)>;
 
-    using CloseCallbackType =
-        std::function<void(TcpConnectSocketfd *tcp_connect_socketfd_ptr)>;
+    using CloseCallbackType = util::InplaceFunction<void(
+        TcpConnectSocketfd *tcp_connect_socketfd_ptr
+    )>;
 
-    using PredicateType = std::function<bool()>;
+    using WaterMarkCallbackType = util::InplaceFunction<void(
+        TcpConnectSocketfd *tcp_connect_socketfd_ptr,
+        size_t number_of_bytes_buffered
+    )>;
 
-    TcpConnectSocketfd(
+    using PredicateType = util::InplaceFunction<bool()>;
+
+    enum class TimeoutType {
+        IDLE, // neither reading nor writing made any progress
+        READ, // nothing was received while waiting for data
+        WRITE // nothing was sent while data was waiting to be sent
+    };
+
+    using TimeoutCallbackType = util::InplaceFunction<void(
+        TcpConnectSocketfd *tcp_connect_socketfd_ptr, TimeoutType timeout_type
+    )>;
+
+    using StringType = TcpOutputQueue::StringType;
+
+    using SharedOwnerType = TcpOutputQueue::SharedOwnerType;
+
+    // each loop keeps up to the given number of closed connections, which are
+    // handed out again by `create` when called inside the loop, so that
+    // short-lived connections neither construct nor destroy their members,
+    // e.g. the output queue, and the input buffer keeps its memory up to a
+    // bound (see `TcpInputBuffer::clear`)
+    //
+    // - `0` disables recycling
+    // - only takes effect for connections closed afterwards
+    static void set_max_number_of_recycled_connections_per_loop(
+        size_t max_number_of_recycled_connections_per_loop
+    ) {
+        _max_number_of_recycled_connections_per_loop.store(
+            max_number_of_recycled_connections_per_loop,
+            std::memory_order_relaxed
+        );
+    }
+
+    // hides `IntrusiveReferenceCounted::create`; reuses a connection recycled
+    // by the loop if called inside it
+    static TcpConnectSocketfdPtr create(
         int fd,
         EventLoop *loop,
         const uint64_t &id,
@@ -54,44 +124,162 @@ public:
         return _remote_address;
     }
 
-    void register_message_callback(const MessageCallbackType &message_callback
+    void register_message_callback(MessageCallbackType message_callback) {
+        _message_callback = std::move(message_callback);
+    }
+
+    void register_write_complete_callback(
+        WriteCompleteCallbackType write_complete_callback
     ) {
-        _message_callback = message_callback;
+        _write_complete_callback = std::move(write_complete_callback);
     }
 
-    void register_message_callback(MessageCallbackType &&message_callback) {
-        _message_callback = std::move(message_callback);
+    // called inside the worker loop when a deadline is exceeded, instead of
+    // aborting the connection, which is the default
+    //
+    // - the deadline counts as refreshed afterwards if the connection is not
+    // closed by the callback
+    void register_timeout_callback(TimeoutCallbackType timeout_callback) {
+        _timeout_callback = std::move(timeout_callback);
     }
 
-    void register_write_complete_callback(
-        const WriteCompleteCallbackType &write_complete_callback
+    // called when the output held in memory reaches the high-water mark, or
+    // grows while the loop-wide cap is reached (see
+    // `EventLoop::set_max_number_of_buffered_output_bytes`), right after
+    // reading is paused so that no more input piles up more output
+    //
+    // - producers that stream data on their own should hold off from here
+    // until the low-water mark callback
+    void register_high_water_mark_callback(
+        WaterMarkCallbackType high_water_mark_callback
     ) {
-        _write_complete_callback = write_complete_callback;
+        _high_water_mark_callback = std::move(high_water_mark_callback);
     }
 
-    void register_write_complete_callback(
-        WriteCompleteCallbackType &&write_complete_callback
+    // called when the output drains down to the low-water mark afterwards,
+    // right after reading is resumed
+    void register_low_water_mark_callback(
+        WaterMarkCallbackType low_water_mark_callback
     ) {
-        _write_complete_callback = std::move(write_complete_callback);
+        _low_water_mark_callback = std::move(low_water_mark_callback);
     }
 
-    // used by internal framework
-    void register_close_callback(const CloseCallbackType &close_callback) {
-        _close_callback = close_callback;
+    // bounds the output held in memory (i.e. excluding file ranges) for slow
+    // peers; see `register_high_water_mark_callback`
+    //
+    // - a zero high-water mark disables it, which is the default
+    // - the low-water mark is clamped to the high-water mark
+    // - should be called before `start()` or inside the worker loop
+    void
+    set_output_water_marks(size_t high_water_mark, size_t low_water_mark) {
+        _state.high_water_mark = high_water_mark;
+        _state.low_water_mark = std::min(low_water_mark, high_water_mark);
+    }
+
+    // queued in-memory segments no smaller than the threshold are sent with
+    // `MSG_ZEROCOPY`, which pins the pages instead of copying them into the
+    // kernel and holds a reference to the data until the kernel reports the
+    // completion through the error queue of the socket
+    //
+    // - `0` disables zero-copy sending, which is the default
+    // - only worth it for payloads of at least tens of KB, since pinning pages
+    // and reading completions cost more than copying small ones
+    // - only the data whose lifetime is handed over (i.e. strings, shared
+    // slices and mapped regions) is sent with zero-copy, while the data sent
+    // by pointer is always copied, since the caller could reuse it right
+    // after the call
+    // - once closed, the socket and the data of the pending zero-copy sends
+    // are handed over to the worker loop, which keeps them until the sends are
+    // completed (or dropped by resetting the socket if the peer stops
+    // acknowledging for too long), so that the connection itself could be
+    // freed or recycled right away
+    // - should be called before `start()`
+    void set_zero_copy_threshold(size_t zero_copy_threshold) {
+        _state.zero_copy_threshold = zero_copy_threshold;
+    }
+
+    // whether reading is paused due to the output held in memory
+    bool is_output_backpressured() const {
+        return _state.is_output_backpressured;
+    }
+
+    size_t get_number_of_buffered_output_bytes() const {
+        return _output_queue.get_in_memory_size();
+    }
+
+    // holds back the data sent during an iteration of the worker loop and
+    // flushes it at the end of the iteration (see
+    // `EventLoop::run_at_end_of_iteration`), so that e.g. a response header and
+    // its body, or the responses to pipelined requests, go out with a single
+    // `sendmsg(2)` instead of one per `send()`
+    //
+    // - small pieces are coalesced in the output queue in the meanwhile
+    // - the write complete callback is called after the flush
+    // - disabled by default
+    // - should be called before `start()` or inside the worker loop
+    void set_if_use_corked_mode(bool use_corked_mode) {
+        _state.use_corked_mode = use_corked_mode;
+    }
+
+    // deadlines are refreshed by the activities on the connection, which only
+    // records the time points; a single one-off timer of the worker loop is
+    // armed at the earliest deadline and re-armed lazily when it finds the
+    // deadline moved later, so that nothing needs to scan the connections
+    //
+    // - `TimeInterval::FOREVER` disables the timeout, which is the default
+    // - should be called before `start()` or inside the worker loop
+    void set_idle_timeout(util::TimeInterval idle_timeout) {
+        _state.idle_timeout = idle_timeout;
+
+        _arm_deadline_timer_if_started();
+    }
+
+    // see `set_idle_timeout`
+    void set_read_timeout(util::TimeInterval read_timeout) {
+        _state.read_timeout = read_timeout;
+
+        _arm_deadline_timer_if_started();
+    }
+
+    // see `set_idle_timeout`
+    void set_write_timeout(util::TimeInterval write_timeout) {
+        _state.write_timeout = write_timeout;
+
+        _arm_deadline_timer_if_started();
     }
 
     // used by internal framework
-    void register_close_callback(CloseCallbackType &&close_callback) {
+    void register_close_callback(CloseCallbackType close_callback) {
         _close_callback = std::move(close_callback);
     }
 
     // not thread-safe
     void start();
 
-    // used by external user; identical to the internal one, just for
-    // convenience here
+    // drops the reference held by the worker loop since `start()`, for a
+    // connection that is left attached when the worker loop exits
+    //
+    // - must be called after the worker loop exits
+    void release_worker_loop_reference();
+
+    // whether the loop still has room for the connection once its last
+    // reference is gone, e.g. for the outside to decide whether it is worth
+    // moving the destruction elsewhere
+    //
+    // - should only be called inside the worker loop
+    bool could_be_recycled() const;
+
+    // whether the connection is detached from the worker loop, i.e. either not
+    // started yet or already closed
+    bool is_stopped() const {
+        return _is_stopped();
+    }
+
+    // used by external user; whether there is output waiting to be sent, i.e.
+    // either the write event is enabled or the corked output is not flushed
+    // yet, in which case the write complete callback is still to come
     bool is_writing() const {
-        return _pollable_file_descriptor.is_writing();
+        return _is_writing() || _state.is_corked_output_flush_scheduled;
     }
 
     // close local write-end
@@ -103,9 +291,31 @@ public:
     void shutdown_write();
 
     bool is_write_end_shutdown() const {
-        return _is_write_end_shutdown;
+        return _state.is_write_end_shutdown;
+    }
+
+    // whether the connection sits between two messages, i.e. everything
+    // received is taken out of the input buffer and nothing is waiting to be
+    // sent
+    //
+    // - a connection that has received nothing yet does not count as idle,
+    // since its first message is most likely on the way
+    bool is_idle() const {
+        return _state.has_received_data
+               && _input_buffer.get_readable_size() == 0 && !is_writing();
     }
 
+    // shuts down the write end as soon as the connection becomes idle (see
+    // `is_idle`), which is right away if it is idle already, so that the
+    // message in flight, if any, is still answered; for closing the
+    // connection gracefully, e.g. when the server is being stopped
+    //
+    // - only suits protocols whose message callback leaves a partial message
+    // inside the input buffer; the others should tell the boundaries between
+    // messages by themselves
+    // - should only be called inside the worker loop
+    void shutdown_write_when_idle();
+
     // abruptly reset the entire connection
     //
     // - must be called when detached off the worker thread's event loop
@@ -128,8 +338,56 @@ public:
     // - must be called when attached on the worker thread's event loop
     void check_and_abort_from_event_loop(PredicateType predicate);
 
-    // should only be called inside a worker loop
-    void send(const char *data, size_t data_size);
+    // `has_more` tells that more data will be sent right after this, e.g. the
+    // body after the header of a response, so that the data is sent with
+    // `MSG_MORE` and the kernel holds back a partial segment to be filled up
+    // by what comes next, instead of sending it out alone
+    //
+    // - the data that follows must then be sent without `has_more`, otherwise
+    // the held back segment waits for the kernel to flush it
+    // - the data is copied rather than sent with zero-copy (see
+    // `set_zero_copy_threshold`)
+    // - should only be called inside a worker loop
+    void send(const char *data, size_t data_size, bool has_more = false);
+
+    // sends discontiguous pieces of data in order, e.g. a response header
+    // kept apart from a cached body, with `sendmsg(2)` right away if possible,
+    // and only copies what's left into the output queue (see
+    // `util::IovecBuilder` for collecting the pieces)
+    //
+    // - the pieces need not stay alive after the call
+    // - see above for `has_more`
+    // - should only be called inside a worker loop
+    void
+    send(const iovec *iovecs, int number_of_iovecs, bool has_more = false);
+
+    // takes over the ownership of the string so that what's left after the
+    // first try is queued without being copied
+    //
+    // - should only be called inside a worker loop
+    void send(StringType &&data);
+
+    // sends a slice of data that is kept alive by the shared owner until it is
+    // fully sent
+    //
+    // - should only be called inside a worker loop
+    void send(SharedOwnerType shared_owner, const char *data, size_t data_size);
+
+    // takes over the ownership of a region mapped by `mmap(2)`, which will be
+    // unmapped after it is fully sent or the connection is closed
+    //
+    // - should only be called inside a worker loop
+    void send_mapped_region(void *mapped_address, size_t mapped_length);
+
+    // streams a range of the file with `sendfile(2)` as the socket becomes
+    // writable, so that the content never enters user space; fds that can not
+    // be handled by `sendfile(2)` are spliced through a pipe instead
+    //
+    // - takes over the ownership of the fd, which will be closed after the
+    // range is fully sent or the connection is closed
+    // - the write complete callback is called after the whole range is sent
+    // - should only be called inside a worker loop
+    void send_file(int fd, off_t offset, size_t length);
 
     // thread-safe
     void set_time_stamp(util::TimePoint time_stamp) {
@@ -141,6 +399,10 @@ public:
         return _time_stamp.load(std::memory_order_relaxed);
     }
 
+    EventLoop *get_loop() const noexcept {
+        return _loop;
+    }
+
     uint64_t get_loop_index() const noexcept;
 
     // used by user
@@ -151,6 +413,46 @@ public:
     }
 
 private:
+    // see `create`
+    TcpConnectSocketfd(
+        int fd,
+        EventLoop *loop,
+        const uint64_t &id,
+        const InetAddress &local_address,
+        const InetAddress &remote_address,
+        util::TimePoint time_stamp
+    );
+
+    // the callbacks of the connection might still be on the call stack when it
+    // gets detached, so the reference is released at the end of the iteration,
+    // or handed over to the loop for reuse if it is the last one
+    void _release_worker_loop_reference_later();
+
+    // releases the reference of the worker loop, or hands the connection over
+    // to the recycling list of the loop if it is the last one
+    void _release_worker_loop_reference();
+
+    // hands the socket over to the worker loop along with the data of the
+    // zero-copy sends that are still pending (see `LingeringSocket`)
+    void _hand_over_pending_zero_copy_sends();
+
+    // closes the socket with a RST, which also drops the data queued for
+    // sending
+    void _close_with_reset();
+
+    // closes the fd and brings everything else back to the state right after
+    // construction, except that the memory held by the buffers is kept
+    void _recycle();
+
+    // takes over a new connection after `_recycle()`
+    void _reuse(
+        int fd,
+        const uint64_t &id,
+        const InetAddress &local_address,
+        const InetAddress &remote_address,
+        util::TimePoint time_stamp
+    );
+
     // reads in all available data, let the outside process the data, and
     // possibly sends response out
     void _read_event_callback(util::TimePoint time_stamp);
@@ -162,8 +464,13 @@ private:
     // detaches from the poller and let the outside release the resources
     void _close_event_callback();
 
-    // only reads and prints the error happened on the socketfd, after which the
-    // socketfd will still be at the error state
+    // see `shutdown_write_when_idle`; checked whenever the input is processed
+    // or the output is drained
+    void _shutdown_write_if_idle_and_asked_to();
+
+    // collects the zero-copy completions from the error queue of the socketfd
+    // first, then reads and prints the error happened on the socketfd (if
+    // any), after which the socketfd will still be at the error state
     void _error_event_callback();
 
     bool _is_reading() const {
@@ -178,45 +485,236 @@ private:
         return _pollable_file_descriptor.is_detached();
     }
 
-    void _check_and_abort_impl(PredicateType predicate);
+    void _check_and_abort_impl(const PredicateType &predicate);
+
+    // the earliest one among the enabled deadlines, or `TimePoint::FOREVER`
+    util::TimePoint _get_earliest_deadline() const;
+
+    // arms the deadline timer unless an earlier one is already armed
+    void _arm_deadline_timer();
+
+    void _arm_deadline_timer_if_started() {
+        if (_is_reading() || _is_writing()) {
+            _arm_deadline_timer();
+        }
+    }
+
+    void _disarm_deadline_timer();
+
+    // checks the deadlines against the current time and either handles the
+    // timeout or re-arms the timer for a later deadline
+    void _deadline_timer_callback();
+
+    // records the time point at which the connection starts waiting for the
+    // output to be drained
+    void _start_writing();
+
+    // keeps the loop-wide count in line with the output queue, and pauses or
+    // resumes reading if a water mark is crossed
+    //
+    // - must be called whenever the output queue changes
+    void _update_output_backpressure();
 
     // only start reading when a read event is encountered
+    //
+    // - reads directly into the spare space of the input buffer, which may
+    // span a few iovecs, with an overflow area on the stack as the last iovec
     size_t _receive_all_data();
 
+#ifdef __USE_IO_URING_POLLER
+    // takes the data received by the poller on behalf of this connection,
+    // copying it into the input buffer and giving the provided buffers back
+    size_t _receive_all_completed_data();
+#endif
+
     // always start writing first and only enable write event when necessary
     //
     // - SIGPIPE is disabled internally
-    size_t _send_as_many_data(const char *data, size_t data_size);
+    size_t
+    _send_as_many_data(const char *data, size_t data_size, bool has_more);
+
+    // same as above, but for discontiguous pieces of data
+    size_t _send_as_many_iovecs(
+        const iovec *iovecs, int number_of_iovecs, bool has_more
+    );
 
-    // size of space the input buffer should expand each time
+    // flushes the output queue with `sendmsg(2)` for in-memory segments and
+    // `sendfile(2)` for file ranges, until it is empty or the socket's send
+    // buffer is full
     //
-    // - make it half the initial size of the buffer to prevent unnecessary
-    // reallocation
-    static constexpr const size_t _RECEIVE_DATA_SIZE = 4096; // 4 KB
+    // - in-memory segments followed by more queued data, e.g. a response
+    // header followed by a file range, are sent with `MSG_MORE`
+    // - the connection is aborted if a file range could not be sent in full,
+    // e.g. an I/O error or the file being truncated after queued
+    // - SIGPIPE is disabled internally
+    size_t _send_as_many_queued_data();
 
-    char recv_buffer[_RECEIVE_DATA_SIZE];
+    // tries flushing the output queue right away if the write event is not
+    // enabled yet, which otherwise will do it later; in corked mode the flush
+    // is left to the end of the iteration instead
+    void _send_queued_data();
 
-    const uint64_t _id;
-    const InetAddress _local_address;
-    const InetAddress _remote_address;
+    void _flush_queued_data();
+
+    // schedules `_flush_corked_output` once per iteration
+    void _schedule_corked_output_flush();
+
+    void _flush_corked_output();
+
+    // moves the file range into the socket through the splice pipe, with the
+    // same return value convention as `sendfile(2)`
+    ssize_t _splice_file_range(TcpOutputQueue::Segment &file_range);
+
+    void _close_splice_pipe();
+
+    void _enable_zero_copy();
+
+    // sends the front in-memory segment alone with `MSG_ZEROCOPY`, with the
+    // same return value convention as `send(2)`
+    ssize_t _send_front_segment_with_zero_copy();
+
+    void _receive_zero_copy_completions();
+
+    struct ZeroCopyOwner {
+        // the counter kept by the kernel for each successful zero-copy send
+        uint32_t sequence_number;
+
+        SharedOwnerType shared_owner;
+    };
+
+    // reads all completions out of the error queue of the socket and releases
+    // the data whose sending is completed; returns whether the kernel reported
+    // falling back to copying
+    static bool _read_zero_copy_completions(
+        int fd, std::deque<ZeroCopyOwner> &zero_copy_owners
+    );
+
+    static void _release_zero_copy_owners(
+        std::deque<ZeroCopyOwner> &zero_copy_owners,
+        uint32_t first_sequence_number,
+        uint32_t last_sequence_number
+    );
+
+    // how long the loop waits for the completions of a closed connection
+    // before resetting its socket, and how long the data is kept after that
+    static constexpr const int64_t _MAX_ZERO_COPY_COMPLETION_WAITING_TIME =
+        10 * util::TimeInterval::SECOND;
+    static constexpr const int64_t _ZERO_COPY_GRACE_PERIOD_AFTER_RESET =
+        util::TimeInterval::SECOND / 100; // 10 ms
+
+    // the socket of a closed connection with zero-copy sends still pending,
+    // kept by the worker loop; defined in the source file
+    class LingeringSocket;
+
+    // the state that the connections keep for each loop, inside a module slot
+    // of the loop (see `EventLoop::get_module_slot`); defined in the source
+    // file
+    struct LoopLocalState;
+
+    // should be called in the owner thread of the loop
+    static LoopLocalState &_get_loop_local_state(EventLoop *loop);
+
+    // could be set from any thread while the loops are reading it, which only
+    // needs to be seen eventually
+    static std::atomic<size_t> _max_number_of_recycled_connections_per_loop;
+
+    // max number of in-memory segments gathered by a single `sendmsg(2)`
+    static constexpr const int _MAX_NUMBER_OF_IOVECS = 64;
+
+    // max number of iovecs taken from the spare space of the input buffer by
+    // a single `readv(2)`
+    static constexpr const int _MAX_NUMBER_OF_RECEIVE_IOVECS = 8;
+
+    // size of the overflow area on the stack, which takes the data that can
+    // not fit into the spare space of the input buffer in a single `readv(2)`
+    static constexpr const size_t _RECEIVE_OVERFLOW_BUFFER_SIZE =
+        64 * 1024; // 64 KB
+
+    // everything about a connection that starts over when the object is
+    // reused, which `_reuse()` brings back by assigning a value-initialized
+    // instance, so that a new member only needs an initializer here
+    struct State {
+        // see `set_zero_copy_threshold`
+        size_t zero_copy_threshold{0};
+        bool is_zero_copy_enabled{false};
+        uint32_t next_zero_copy_sequence_number{0};
+
+        // deadlines; only touched inside the worker loop once started
+        //
+        // - the last read and write time points start from the time stamp
+        // given to the connection
+        util::TimeInterval idle_timeout{util::TimeInterval::FOREVER};
+        util::TimeInterval read_timeout{util::TimeInterval::FOREVER};
+        util::TimeInterval write_timeout{util::TimeInterval::FOREVER};
+        util::TimePoint last_read_time_point{0};
+        util::TimePoint last_write_time_point{0};
+        bool is_deadline_timer_armed{false};
+        util::TimePoint deadline_timer_expiration_time_point{
+            util::TimePoint::FOREVER
+        };
+        TimerIdentifier deadline_timer_identifier{nullptr};
+
+        // backpressure; only touched inside the worker loop once started
+        size_t high_water_mark{0};
+        size_t low_water_mark{0};
+        size_t number_of_output_bytes_accounted{0}; // counted by the loop
+        bool is_output_backpressured{false};
+
+        // see `start()`
+        bool is_held_by_worker_loop{false};
+
+        // corked mode; see `set_if_use_corked_mode`
+        bool use_corked_mode{false};
+        bool is_corked_output_flush_scheduled{false};
+
+        // see `is_idle` and `shutdown_write_when_idle`
+        bool has_received_data{false};
+        bool need_shutdown_write_when_idle{false};
+
+        bool is_write_end_shutdown{false};
+        bool is_reset{false};
+        bool is_abotrted{false};
+
+        // the fd belongs to the worker loop now, together with the pending
+        // zero-copy sends (see `_hand_over_pending_zero_copy_sends`)
+        bool is_fd_handed_over{false};
+
+        // sitting in the loop for reuse, with the fd closed
+        bool is_recycled{false};
+    };
+
+    // [NOTE]: the members other than `_state` are either taken over by
+    // `_reuse()` or cleared by `_recycle()`, where the buffers keep their
+    // memory
+
+    uint64_t _id;
+    InetAddress _local_address;
+    InetAddress _remote_address;
 
     EventLoop *_loop;
 
     std::atomic<util::TimePoint> _time_stamp;
 
-    MutableSizeTcpBuffer _input_buffer;
-    MutableSizeTcpBuffer
-        _output_buffer; // [TODO]: make it a queue of heterogeneous data
-                        // sources (e.g. std::string, sendFile, mmap,
-                        // etc.) for better performance
+    TcpInputBuffer _input_buffer;
+    TcpOutputQueue _output_queue;
+
+    // created lazily for splicing file ranges; bytes might be left inside the
+    // pipe when the socket's send buffer is full
+    int _splice_pipe_fds[2]{-1, -1};
+    size_t _number_of_bytes_in_splice_pipe{0};
+
+    // data that is handed over to the kernel by `MSG_ZEROCOPY` but not yet
+    // reported as completed, in the order of sending
+    std::deque<ZeroCopyOwner> _zero_copy_owners;
 
     MessageCallbackType _message_callback;
     WriteCompleteCallbackType _write_complete_callback;
     CloseCallbackType _close_callback;
+    TimeoutCallbackType _timeout_callback;
+    WaterMarkCallbackType _high_water_mark_callback;
+    WaterMarkCallbackType _low_water_mark_callback;
 
-    bool _is_write_end_shutdown = false;
-    bool _is_reset = false;
-    bool _is_abotrted = false;
+    State _state;
 
     PollableFileDescriptor _pollable_file_descriptor;
 };
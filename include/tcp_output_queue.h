@@ -0,0 +1,231 @@
+#ifndef __XUBINH_SERVER_TCP_OUTPUT_QUEUE
+#define __XUBINH_SERVER_TCP_OUTPUT_QUEUE
+
+#include <deque>
+#include <memory>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "util/slab_allocator.h"
+
+namespace xubinh_server {
+
+// a queue of heterogeneous data sources waiting to be sent out, so that large
+// payloads can be handed over to the kernel without being copied into user
+// space first
+//
+// - not thread-safe
+class TcpOutputQueue {
+public:
+    using StringType = util::StringType;
+
+    // keeps a borrowed slice of data alive until it is fully sent
+    using SharedOwnerType = std::shared_ptr<const void>;
+
+    enum SegmentType {
+        OWNED_BYTES,   // copied or moved into the queue
+        SHARED_SLICE,  // borrowed and kept alive by a shared owner
+        MAPPED_REGION, // mapped by `mmap(2)` and unmapped after being sent
+        FILE_RANGE     // sent by `sendfile(2)` or `splice(2)` without entering
+                       // user space
+    };
+
+    class Segment {
+    public:
+        explicit Segment(StringType &&owned_bytes) noexcept;
+
+        Segment(
+            SharedOwnerType &&shared_owner, const char *data, size_t data_size
+        ) noexcept;
+
+        Segment(void *mapped_address, size_t mapped_length) noexcept;
+
+        Segment(
+            int fd,
+            off_t offset,
+            size_t size,
+            bool need_close_fd,
+            bool is_seekable
+        ) noexcept;
+
+        Segment(const Segment &) = delete;
+        Segment &operator=(const Segment &) = delete;
+
+        Segment(Segment &&other) noexcept;
+        Segment &operator=(Segment &&) = delete;
+
+        ~Segment() {
+            _release();
+        }
+
+        SegmentType get_type() const {
+            return _type;
+        }
+
+        bool is_in_memory() const {
+            return _type != FILE_RANGE;
+        }
+
+        // only valid for in-memory segments
+        const char *get_data() const {
+            return (_type == OWNED_BYTES ? _owned_bytes.c_str() : _data)
+                   + _number_of_bytes_consumed;
+        }
+
+        // number of bytes left to be sent
+        size_t get_size() const {
+            return _size - _number_of_bytes_consumed;
+        }
+
+        // only valid for file ranges
+        int get_fd() const {
+            return _fd;
+        }
+
+        // only valid for file ranges
+        off_t get_file_offset() const {
+            return _file_offset
+                   + static_cast<off_t>(_number_of_bytes_consumed);
+        }
+
+        // only valid for file ranges; non-seekable fds (e.g. pipes) are read
+        // from their current positions and the offsets are ignored
+        bool is_seekable() const {
+            return _is_seekable;
+        }
+
+        // only valid for file ranges
+        bool is_splice_needed() const {
+            return _is_splice_needed;
+        }
+
+        // falls back to `splice(2)` for fds that `sendfile(2)` can not handle
+        void set_splice_needed() {
+            _is_splice_needed = true;
+        }
+
+        void forward(size_t number_of_bytes_consumed) {
+            _number_of_bytes_consumed += number_of_bytes_consumed;
+        }
+
+    private:
+        friend class TcpOutputQueue;
+
+        void _release() noexcept;
+
+        SegmentType _type;
+
+        // owned bytes
+        StringType _owned_bytes;
+
+        // shared slice & mapped region
+        SharedOwnerType _shared_owner;
+        const char *_data{nullptr};
+
+        // file range
+        int _fd{-1};
+        off_t _file_offset{0};
+        bool _need_close_fd{false};
+        bool _is_seekable{true};
+        bool _is_splice_needed{false};
+
+        size_t _size{0};
+        size_t _number_of_bytes_consumed{0};
+    };
+
+    TcpOutputQueue() = default;
+
+    TcpOutputQueue(const TcpOutputQueue &) = delete;
+    TcpOutputQueue &operator=(const TcpOutputQueue &) = delete;
+
+    bool empty() const {
+        return _segments.empty();
+    }
+
+    size_t get_number_of_segments() const {
+        return _segments.size();
+    }
+
+    // total number of bytes left to be sent, including file ranges
+    size_t get_readable_size() const {
+        return _readable_size;
+    }
+
+    // number of bytes left to be sent that are held in memory, i.e. excluding
+    // file ranges
+    size_t get_in_memory_size() const {
+        return _in_memory_size;
+    }
+
+    // copies the data into the queue; small pieces are coalesced into the last
+    // segment if it is also an owned one
+    void append(const char *data, size_t data_size);
+
+    // takes over the ownership of the string without copying it
+    void append(StringType &&data);
+
+    void append_shared_slice(
+        SharedOwnerType shared_owner, const char *data, size_t data_size
+    );
+
+    // takes over the ownership of a region mapped by `mmap(2)`
+    void append_mapped_region(void *mapped_address, size_t mapped_length);
+
+    // takes over the ownership of the fd if `need_close_fd` is true
+    //
+    // - non-seekable fds are spliced through a pipe from their current
+    // positions
+    void append_file_range(
+        int fd,
+        off_t offset,
+        size_t size,
+        bool need_close_fd,
+        bool is_seekable = true
+    );
+
+    Segment &front() {
+        return _segments.front();
+    }
+
+    bool is_front_file_range() const {
+        return !_segments.empty() && !_segments.front().is_in_memory();
+    }
+
+    // fills the iovec array with the leading in-memory segments and returns the
+    // number of entries filled, stopping at the first file range or the first
+    // segment no smaller than the given size
+    int gather_leading_memory_segments(
+        iovec *iovecs,
+        int max_number_of_iovecs,
+        size_t max_segment_size = static_cast<size_t>(-1)
+    ) const;
+
+    // turns the front in-memory segment into a shared slice if it is not one
+    // already, and returns a new reference to its owner, so that the data
+    // could outlive the segment
+    SharedOwnerType share_front();
+
+    // marks the given number of bytes as sent, releasing the segments that
+    // are fully consumed
+    void forward(size_t number_of_bytes_sent);
+
+    // releases all segments in the current thread
+    void release() noexcept {
+        _segments.clear();
+        _readable_size = 0;
+        _in_memory_size = 0;
+    }
+
+private:
+    // owned segments larger than this are not appended to any more, so that
+    // memory is given back progressively as the queue drains
+    static constexpr const size_t _MAX_COALESCING_SIZE = 64 * 1024; // 64 KB
+
+    std::deque<Segment> _segments;
+    size_t _readable_size{0};
+    size_t _in_memory_size{0};
+};
+
+} // namespace xubinh_server
+
+#endif
\ No newline at end of file
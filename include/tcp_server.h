@@ -1,13 +1,14 @@
 #ifndef __XUBINH_SERVER_TCP_SERVER
 #define __XUBINH_SERVER_TCP_SERVER
 
-#include <map>
+#include <functional>
 
 #include "event_loop_thread_pool.h"
 #include "listen_socketfd.h"
 #include "tcp_connect_socketfd.h"
+#include "util/condition_variable.h"
+#include "util/flat_id_map.h"
 #include "util/mutex.h"
-#include "util/slab_allocator.h"
 
 namespace xubinh_server {
 
@@ -19,25 +20,50 @@ public:
         std::function<void(const TcpConnectSocketfdPtr &tcp_connect_socketfd_ptr
         )>;
 
-    using MessageCallbackType = TcpConnectSocketfd::MessageCallbackType;
+    // [NOTE]: the callbacks below are shared by all connections, so they are
+    // kept copyable here, and each connection is given a forwarder instead
 
-    using WriteCompleteCallbackType =
-        TcpConnectSocketfd::WriteCompleteCallbackType;
+    using MessageCallbackType = std::function<void(
+        TcpConnectSocketfd *tcp_connect_socketfd_ptr,
+        TcpInputBuffer *input_buffer,
+        util::TimePoint time_stamp
+    )>;
+
+    using WriteCompleteCallbackType = std::function<void(TcpConnectSocketfd *)>;
 
     using ThreadInitializationCallbackType =
         EventLoopThreadPool::ThreadInitializationCallbackType;
 
+    using LoopSelectionPolicy = EventLoopThreadPool::LoopSelectionPolicy;
+
+    using LoopSelectorType = EventLoopThreadPool::LoopSelectorType;
+
+    using TimeoutCallbackType = std::function<void(
+        TcpConnectSocketfd *tcp_connect_socketfd_ptr,
+        TcpConnectSocketfd::TimeoutType timeout_type
+    )>;
+
+    using WaterMarkCallbackType = std::function<void(
+        TcpConnectSocketfd *tcp_connect_socketfd_ptr,
+        size_t number_of_bytes_buffered
+    )>;
+
     using RunForEachConnectionCallbackType =
         std::function<void(const TcpConnectSocketfdPtr &tcp_connect_socketfd_ptr
         )>;
 
+    using DrainCallbackType =
+        std::function<void(TcpConnectSocketfd *tcp_connect_socketfd_ptr)>;
+
     TcpServer(EventLoop *loop, const InetAddress &local_address)
         : _loop(loop)
         , _local_address(local_address) {
     }
 
+    // should be called inside the main loop, after `stop()`
     ~TcpServer();
 
+    // invoked in the loop of the new connection, right before it starts
     void register_connect_success_callback(
         ConnectSuccessCallbackType connect_success_callback
     ) {
@@ -54,6 +80,98 @@ public:
         _write_complete_callback = std::move(write_complete_callback);
     }
 
+    // see `TcpConnectSocketfd::register_timeout_callback`
+    void register_timeout_callback(TimeoutCallbackType timeout_callback) {
+        _timeout_callback = std::move(timeout_callback);
+    }
+
+    // see `TcpConnectSocketfd::register_high_water_mark_callback`
+    void register_high_water_mark_callback(
+        WaterMarkCallbackType high_water_mark_callback
+    ) {
+        _high_water_mark_callback = std::move(high_water_mark_callback);
+    }
+
+    // see `TcpConnectSocketfd::register_low_water_mark_callback`
+    void register_low_water_mark_callback(
+        WaterMarkCallbackType low_water_mark_callback
+    ) {
+        _low_water_mark_callback = std::move(low_water_mark_callback);
+    }
+
+    // applied to each new connection; see
+    // `TcpConnectSocketfd::set_output_water_marks`
+    void
+    set_output_water_marks(size_t high_water_mark, size_t low_water_mark) {
+        _high_water_mark = high_water_mark;
+        _low_water_mark = low_water_mark;
+    }
+
+    // applied to each loop that serves connections, i.e. the worker loops, or
+    // the main loop if the thread pool is disabled; see
+    // `EventLoop::set_max_number_of_buffered_output_bytes`
+    void set_max_number_of_buffered_output_bytes_per_loop(
+        size_t max_number_of_buffered_output_bytes
+    ) {
+        _max_number_of_buffered_output_bytes =
+            max_number_of_buffered_output_bytes;
+    }
+
+    // applied to each new connection, whose deadlines are then kept by its own
+    // worker loop; see `TcpConnectSocketfd::set_idle_timeout`
+    void set_idle_timeout(util::TimeInterval idle_timeout) {
+        _idle_timeout = idle_timeout;
+    }
+
+    // see `set_idle_timeout`
+    void set_read_timeout(util::TimeInterval read_timeout) {
+        _read_timeout = read_timeout;
+    }
+
+    // see `set_idle_timeout`
+    void set_write_timeout(util::TimeInterval write_timeout) {
+        _write_timeout = write_timeout;
+    }
+
+    // applied to each new connection; see
+    // `TcpConnectSocketfd::set_if_use_corked_mode`
+    void set_if_use_corked_mode(bool use_corked_mode) {
+        _use_corked_mode = use_corked_mode;
+    }
+
+    // applied to each new connection; see
+    // `TcpConnectSocketfd::set_zero_copy_threshold`
+    void set_zero_copy_threshold(size_t zero_copy_threshold) {
+        _zero_copy_threshold = zero_copy_threshold;
+    }
+
+    // makes each worker loop busy-poll before blocking, see
+    // `EventLoop::set_max_busy_poll_budget`, and asks the kernel to busy-poll
+    // on each new connection for the same amount of time where it allows so
+    //
+    // - the main loop belongs to the outer thread and is left untouched
+    void set_max_busy_poll_budget(util::TimeInterval max_busy_poll_budget) {
+        _max_busy_poll_budget = max_busy_poll_budget;
+    }
+
+    // called inside its loop for each connection once the server starts
+    // draining (see `stop`), for closing the connection gracefully at the next
+    // boundary between requests, instead of calling
+    // `TcpConnectSocketfd::shutdown_write_when_idle`, which is the default
+    void register_drain_callback(DrainCallbackType drain_callback) {
+        _drain_callback = std::move(drain_callback);
+    }
+
+    // the connections left open by the time draining has lasted for so long
+    // are aborted (see `stop`)
+    //
+    // - `TimeInterval::FOREVER` waits for all of them to be closed
+    // gracefully
+    // - 5 seconds by default
+    void set_drain_timeout(util::TimeInterval drain_timeout) {
+        _drain_timeout = drain_timeout;
+    }
+
     void set_thread_pool_capacity(size_t thread_pool_capacity) {
         _thread_pool_capacity = thread_pool_capacity;
     }
@@ -65,36 +183,222 @@ public:
             std::move(thread_initialization_callback);
     }
 
+    // applied to each listen socketfd, i.e. the one of the main loop or the
+    // ones of the worker loops if reuseport is used; see
+    // `ListenSocketfd::set_max_number_of_new_connections_at_a_time`
+    void set_max_number_of_new_connections_at_a_time(
+        int max_number_of_new_connections_at_a_time
+    ) {
+        _max_number_of_new_connections_at_a_time =
+            max_number_of_new_connections_at_a_time;
+    }
+
+    // decides which worker loop each new connection goes to; see
+    // `EventLoopThreadPool::LoopSelectionPolicy`
+    //
+    // - only takes effect if the thread pool is enabled and reuseport is not
+    // used, since the kernel does the distribution in that case
+    void set_loop_selection_policy(LoopSelectionPolicy loop_selection_policy) {
+        _loop_selection_policy = loop_selection_policy;
+    }
+
+    // see `set_loop_selection_policy`; takes precedence over the policy
+    void register_loop_selector(LoopSelectorType loop_selector) {
+        _loop_selector = std::move(loop_selector);
+    }
+
+    // lets each worker loop accept connections on its own `SO_REUSEPORT`
+    // listen socketfd, instead of having the main loop accept all of them and
+    // hand them over one by one
+    //
+    // - only takes effect if the thread pool is enabled
+    void set_if_use_reuse_port(bool use_reuse_port) {
+        _use_reuse_port = use_reuse_port;
+    }
+
+    // steers each connection to the listen socketfd of the worker loop that
+    // runs on the same CPU as the one handling the connection in the kernel,
+    // with each worker thread being pinned to a CPU accordingly
+    //
+    // - only takes effect if reuseport is used
+    // - requires the thread pool capacity to equal the number of CPUs that the
+    // process is allowed to run on, otherwise it is skipped with a warning
+    void set_if_use_cpu_steering(bool use_cpu_steering) {
+        _use_cpu_steering = use_cpu_steering;
+    }
+
     void start();
 
+    // stops accepting new connections and drains the open ones, i.e. each
+    // loop that serves connections closes them gracefully on its own (see
+    // `register_drain_callback`), and aborts the ones left open once the drain
+    // timeout is exceeded (see `set_drain_timeout`)
+    //
+    // - blocks until the worker loops are drained and joined, which signal
+    // back as soon as their last connections are closed
+    // - returns right away if the thread pool is disabled, in which case the
+    // main loop is drained as it goes on running, and whatever is left by the
+    // time the server is destructed is aborted by the destructor
+    // - should be called inside the main loop
     void stop();
 
-    // runs in main loop
+    // broadcasts the callback to each loop that serves connections, where it
+    // is called for every connection of that loop, so that the connections
+    // could be operated on right away
+    //
+    // - the loops go through their own connections concurrently
+    // - should be called inside the main loop
     void
     run_for_each_connection(const RunForEachConnectionCallbackType &callback);
 
-    // runs in main loop
+    // see above
     void run_for_each_connection(RunForEachConnectionCallbackType &&callback);
 
-    size_t get_number_of_tcp_connections() const {
-        return _tcp_connect_socketfds.size();
+    // thread-safe; the sum over the connection tables of all loops, each of
+    // which is only approximate when read from outside the loop
+    size_t get_number_of_tcp_connections() const;
+
+    // thread-safe; see `get_number_of_tcp_connections`
+    //
+    // - the index is the one of the worker loop, or `0` for the main loop if
+    // the thread pool is disabled
+    size_t get_number_of_tcp_connections_in_loop(size_t loop_index) const {
+        return _connection_tables[loop_index]->number_of_tcp_connections.load(
+            std::memory_order_relaxed
+        );
+    }
+
+    // thread-safe; sample it periodically to get the accept rate
+    uint64_t get_number_of_accepted_connections() const;
+
+    // thread-safe; the number of functors posted to the worker loops for
+    // handing over the connections accepted by the main loop, each carrying
+    // all the connections of a single readiness event that go to the same loop
+    uint64_t get_number_of_dispatch_batches() const {
+        return _number_of_dispatch_batches.load(std::memory_order_relaxed);
+    }
+
+    // thread-safe; see `get_number_of_dispatch_batches`
+    uint64_t get_number_of_dispatched_connections() const {
+        return _number_of_dispatched_connections.load(std::memory_order_relaxed
+        );
+    }
+
+    // thread-safe; see `get_number_of_dispatch_batches`
+    uint64_t get_max_dispatch_batch_size() const {
+        return _max_dispatch_batch_size.load(std::memory_order_relaxed);
     }
 
 private:
-    // for listen socketfd
+    // the connections served by a loop, which are only ever touched inside
+    // that loop, so that accepting, closing and iterating them never crosses
+    // threads
+    struct alignas(64) ConnectionTable {
+        util::FlatIdMap<TcpConnectSocketfdPtr> tcp_connect_socketfds;
+
+        // mirrors the size of the table for reading from other threads
+        std::atomic<size_t> number_of_tcp_connections{0};
+
+        size_t max_number_of_tcp_connections{0};
+
+        // set once draining starts, and then once the table becomes empty
+        bool is_draining{false};
+        bool is_drained{false};
+
+        // the drain deadline, which is cancelled once the table is drained, so
+        // that it never goes off after the server is gone
+        TimerIdentifier drain_timer_identifier{nullptr};
+        bool is_drain_timer_armed{false};
+
+#ifdef __USE_SHARED_PTR_DESTRUCTION_TRANSFERING
+        std::vector<TcpConnectSocketfdPtr>
+            tcp_connect_socketfds_to_be_destroyed;
+#endif
+    };
+
+    // accepted by the main loop and waiting to be handed over; the connection
+    // object is only created inside the worker loop, so that it could be
+    // taken from the ones recycled by that loop
+    struct PendingTcpConnection {
+        int connect_socketfd;
+        InetAddress peer_address;
+        util::TimePoint time_stamp;
+    };
+
+    ConnectionTable &_get_connection_table(EventLoop *loop) {
+        auto loop_index =
+            _thread_pool_capacity > 0 ? loop->get_loop_index() : 0;
+
+        return *_connection_tables[loop_index];
+    }
+
+    void _start_listening_in_main_loop();
+
+    void _start_listening_in_worker_loops();
+
+    void _steer_connections_to_cpus_of_worker_loops(int first_listen_socketfd);
+
+    // for listen socketfd of the main loop
     void _new_connection_callback(
         int connect_socketfd,
         const InetAddress &peer_address,
         util::TimePoint time_stamp
     );
 
-    // for tcp connect socketfd
-    void _close_callback(
-        TcpConnectSocketfd *tcp_connect_socketfd_ptr,
-        size_t functor_blocking_queue_index
+    // for listen socketfd of the main loop; posts the connections accepted
+    // during the current readiness event to their worker loops, one functor
+    // for each loop
+    void _dispatch_pending_tcp_connections();
+
+    // for listen socketfds of the worker loops; runs in the given loop
+    void _new_connection_callback_in_worker_loop(
+        EventLoop *loop,
+        int connect_socketfd,
+        const InetAddress &peer_address,
+        util::TimePoint time_stamp
+    );
+
+    // runs in the given loop
+    TcpConnectSocketfdPtr _create_tcp_connect_socketfd(
+        EventLoop *loop,
+        int connect_socketfd,
+        const InetAddress &peer_address,
+        util::TimePoint time_stamp
+    );
+
+    // adds the connection to the table of its loop, registers callbacks and
+    // starts the connection; runs in its own loop
+    void _set_up_and_start_tcp_connect_socketfd(
+        const TcpConnectSocketfdPtr &tcp_connect_socketfd_ptr
     );
 
-    void _transfer_tcp_connections_to_background_thread();
+    // for tcp connect socketfd; removes the connection from the table of its
+    // loop, inside the loop
+    void _close_callback(TcpConnectSocketfd *tcp_connect_socketfd_ptr);
+
+    // asks each connection of the given loop to be closed gracefully and arms
+    // the drain deadline; runs in the given loop
+    void _start_draining(EventLoop *loop);
+
+    void
+    _drain_tcp_connect_socketfd(TcpConnectSocketfd *tcp_connect_socketfd_ptr);
+
+    // aborts the connections left open when the drain deadline is exceeded;
+    // runs in the given loop
+    void _abort_undrained_tcp_connect_socketfds(EventLoop *loop);
+
+    // aborts whatever is left in the table of the given loop, inside the loop
+    void _abort_remaining_tcp_connect_socketfds(EventLoop *loop);
+
+    // signals the end of draining to `stop()` once the table becomes empty,
+    // and cancels the drain deadline; runs in the given loop
+    void _finish_draining_if_drained(EventLoop *loop);
+
+#ifdef __USE_SHARED_PTR_DESTRUCTION_TRANSFERING
+    void _transfer_tcp_connections_to_background_thread(
+        ConnectionTable &connection_table, size_t functor_blocking_queue_index
+    );
+#endif
 
 #ifdef __USE_SHARED_PTR_DESTRUCTION_TRANSFERING
     static constexpr const size_t
@@ -102,6 +406,13 @@ private:
             512;
 #endif
 
+#ifndef __USE_LOCK_FREE_QUEUE
+    // how often `stop()` cleans up the functor queue of the main loop while
+    // waiting for the worker loops to be drained
+    static constexpr const int64_t _FUNCTOR_QUEUE_CLEANING_INTERVAL =
+        util::TimeInterval::SECOND / 10; // 0.1 sec
+#endif
+
     bool _is_started = false;
     bool _is_stopped = false;
 
@@ -109,6 +420,32 @@ private:
 
     MessageCallbackType _message_callback;
     WriteCompleteCallbackType _write_complete_callback;
+    TimeoutCallbackType _timeout_callback;
+    WaterMarkCallbackType _high_water_mark_callback;
+    WaterMarkCallbackType _low_water_mark_callback;
+
+    size_t _high_water_mark{0};
+    size_t _low_water_mark{0};
+    size_t _max_number_of_buffered_output_bytes{0};
+
+    bool _use_corked_mode{false};
+    size_t _zero_copy_threshold{0};
+
+    util::TimeInterval _idle_timeout{util::TimeInterval::FOREVER};
+    util::TimeInterval _read_timeout{util::TimeInterval::FOREVER};
+    util::TimeInterval _write_timeout{util::TimeInterval::FOREVER};
+
+    util::TimeInterval _max_busy_poll_budget{0};
+
+    int _max_number_of_new_connections_at_a_time{1000};
+
+    DrainCallbackType _drain_callback;
+    util::TimeInterval _drain_timeout{5 * util::TimeInterval::SECOND};
+
+    // the number of loops that are not yet drained, which `stop()` waits on
+    size_t _number_of_loops_being_drained{0};
+    util::Mutex _mutex_for_number_of_loops_being_drained;
+    util::ConditionVariable _cond_for_number_of_loops_being_drained;
 
     // event loop belongs to the outer thread, not the server
     EventLoop *_loop;
@@ -117,19 +454,19 @@ private:
 
     std::unique_ptr<ListenSocketfd> _listen_socketfd;
 
-    std::map<
-        uint64_t,
-        TcpConnectSocketfdPtr,
-        std::less<uint64_t>,
-        util::SimpleSlabAllocator<
-            std::pair<const uint64_t, TcpConnectSocketfdPtr>>>
-        _tcp_connect_socketfds;
+    bool _use_reuse_port = false;
+    bool _use_cpu_steering = false;
+
+    // one for each worker loop if reuseport is used
+    std::vector<std::unique_ptr<ListenSocketfd>> _worker_listen_socketfds;
+
+    // one for each worker loop, or a single one for the main loop if the
+    // thread pool is disabled
+    std::vector<std::unique_ptr<ConnectionTable>> _connection_tables;
 
 #ifdef __USE_SHARED_PTR_DESTRUCTION_TRANSFERING
-    std::vector<std::vector<std::shared_ptr<void>>>
+    std::vector<std::vector<TcpConnectSocketfdPtr>>
         _vectors_of_tcp_connect_socketfds_to_be_destroyed;
-    std::vector<std::shared_ptr<void>>
-        _current_vector_of_tcp_connect_socketfds_to_be_destroyed;
     util::Mutex _mutex_for_vectors_of_tcp_connect_socketfds_to_be_destroyed;
     std::unique_ptr<EventLoopThread>
         _tcp_connect_socketfd_destroying_thread_ptr;
@@ -137,11 +474,22 @@ private:
 
     std::atomic<uint64_t> _tcp_connection_id_counter{0};
 
+    // connections accepted by the main loop but not yet handed over, one
+    // vector for each worker loop
+    std::vector<std::vector<PendingTcpConnection>> _pending_tcp_connections;
+
+    // only written by the main loop
+    std::atomic<uint64_t> _number_of_dispatch_batches{0};
+    std::atomic<uint64_t> _number_of_dispatched_connections{0};
+    std::atomic<uint64_t> _max_dispatch_batch_size{0};
+
     size_t _thread_pool_capacity = 0;
     ThreadInitializationCallbackType _thread_initialization_callback;
+    LoopSelectionPolicy _loop_selection_policy =
+        LoopSelectionPolicy::ROUND_ROBIN;
+    LoopSelectorType _loop_selector;
     std::unique_ptr<EventLoopThreadPool> _thread_pool_ptr;
 
-    uint64_t _max_number_of_connections = 0;
 };
 
 } // namespace xubinh_server
@@ -2,8 +2,9 @@
 #define __XUBINH_SERVER_TIMER
 
 #include <algorithm>
-#include <functional>
+#include <cstdint>
 
+#include "util/inplace_function.h"
 #include "util/time_point.h"
 
 namespace xubinh_server {
@@ -15,7 +16,7 @@ private:
     using TimeInterval = util::TimeInterval;
 
 public:
-    using TimerCallbackType = std::function<void()>;
+    using TimerCallbackType = util::InplaceFunction<void()>;
 
     Timer(
         TimePoint expiration_time_point,
@@ -46,10 +47,24 @@ public:
     }
 
 private:
+    // the timing wheel links its timers intrusively so that insertion and
+    // removal take no allocations
+    friend class TimingWheelTimerContainer;
+
+    struct WheelHook {
+        Timer *previous = nullptr;
+        Timer *next = nullptr;
+        uint64_t tick = 0;
+        int level = -1; // -1 for not being in any wheel
+        int slot = 0;
+    };
+
     TimePoint _expiration_time_point;
     TimeInterval _repetition_time_interval; // 0 for one-off timer
     int _number_of_repetitions_left;        // -1 for infinite repetition
     TimerCallbackType _callback;
+
+    WheelHook _wheel_hook;
 };
 
 } // namespace xubinh_server
@@ -1,6 +1,7 @@
 #ifndef __XUBINH_SERVER_TIMER_CONTAINER
 #define __XUBINH_SERVER_TIMER_CONTAINER
 
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -9,34 +10,70 @@
 
 namespace xubinh_server {
 
-// not thread-safe
+// interface of the containers holding the timers of an event loop
+//
+// - not thread-safe
 class TimerContainer {
-private:
+protected:
     using TimePoint = util::TimePoint;
 
 public:
-    TimePoint get_earliest_expiration_time_point() {
+    enum class Type {
+        ORDERED_SET, // O(log n) insertion and removal, exact expiration
+        TIMING_WHEEL // O(1) insertion and removal, millisecond resolution
+    };
+
+    static std::unique_ptr<TimerContainer> create(Type type);
+
+    virtual ~TimerContainer() = default;
+
+    // might be later than the exact one for containers with coarse
+    // resolutions, but never earlier
+    virtual TimePoint get_earliest_expiration_time_point() = 0;
+
+    virtual bool empty() const = 0;
+
+    virtual size_t size() const = 0;
+
+    virtual void insert_one(const Timer *timer_ptr) = 0;
+
+    void insert_all(const std::vector<const Timer *> &timers) {
+        for (const Timer *timer_ptr : timers) {
+            insert_one(timer_ptr);
+        }
+    }
+
+    virtual bool remove_one(const Timer *timer_ptr) = 0;
+
+    // move out all the timers that are supposed to expire before or right at
+    // the given time point, appending them to the given vector so that its
+    // capacity could be reused across expirations
+    virtual void move_out_before_or_at(
+        TimePoint expiration_time_point, std::vector<const Timer *> &timers
+    ) = 0;
+};
+
+class OrderedSetTimerContainer : public TimerContainer {
+public:
+    TimePoint get_earliest_expiration_time_point() override {
         return _timers.empty() ? TimePoint::FOREVER : _timers.begin()->first;
     }
 
-    bool empty() const {
+    bool empty() const override {
         return _timers.empty();
     }
 
-    size_t size() const {
+    size_t size() const override {
         return _timers.size();
     }
 
-    void insert_one(const Timer *timer_ptr);
+    void insert_one(const Timer *timer_ptr) override;
 
-    void insert_all(const std::vector<const Timer *> &timers);
+    bool remove_one(const Timer *timer_ptr) override;
 
-    bool remove_one(const Timer *timer_ptr);
-
-    // move out all the timers that are supposed to expire before or right at
-    // the given time point
-    std::vector<const Timer *>
-    move_out_before_or_at(TimePoint expiration_time_point);
+    void move_out_before_or_at(
+        TimePoint expiration_time_point, std::vector<const Timer *> &timers
+    ) override;
 
 private:
     std::set<std::pair<TimePoint, const Timer *>> _timers;
@@ -44,4 +81,4 @@ private:
 
 } // namespace xubinh_server
 
-#endif
\ No newline at end of file
+#endif
@@ -1,6 +1,7 @@
 #ifndef __XUBINH_SERVER_TIMERFD
 #define __XUBINH_SERVER_TIMERFD
 
+#include <functional>
 #include <sys/timerfd.h>
 
 #include "pollable_file_descriptor.h"
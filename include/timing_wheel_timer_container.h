@@ -0,0 +1,124 @@
+#ifndef __XUBINH_SERVER_TIMING_WHEEL_TIMER_CONTAINER
+#define __XUBINH_SERVER_TIMING_WHEEL_TIMER_CONTAINER
+
+#include <cstdint>
+
+#include "timer_container.h"
+
+namespace xubinh_server {
+
+// a hierarchical timing wheel of millisecond resolution, in which timers are
+// linked into the slots intrusively so that both insertion and removal are
+// O(1) and take no allocations
+//
+// - timers are rounded up to the next tick, so that they are never moved out
+// earlier than their exact expiration time points
+// - the first level covers the next 256 ticks and each of the upper levels
+// covers 64 times more, i.e. about 49.7 days in total; timers beyond that are
+// parked at the end of the top level and re-examined every time it turns
+// - not thread-safe
+class TimingWheelTimerContainer : public TimerContainer {
+public:
+    TimingWheelTimerContainer();
+
+    // no copying
+    TimingWheelTimerContainer(const TimingWheelTimerContainer &) = delete;
+    TimingWheelTimerContainer &
+    operator=(const TimingWheelTimerContainer &) = delete;
+
+    TimePoint get_earliest_expiration_time_point() override;
+
+    bool empty() const override {
+        return _size == 0;
+    }
+
+    size_t size() const override {
+        return _size;
+    }
+
+    void insert_one(const Timer *timer_ptr) override;
+
+    bool remove_one(const Timer *timer_ptr) override;
+
+    void move_out_before_or_at(
+        TimePoint expiration_time_point, std::vector<const Timer *> &timers
+    ) override;
+
+private:
+    static constexpr int64_t _NANOSECONDS_PER_TICK = 1000 * 1000; // 1 ms
+
+    static constexpr int _NUMBER_OF_LEVELS = 5;
+    static constexpr int _NUMBER_OF_BITS_OF_FIRST_LEVEL = 8;
+    static constexpr int _NUMBER_OF_BITS_OF_UPPER_LEVELS = 6;
+    static constexpr int _MAX_NUMBER_OF_SLOTS_PER_LEVEL =
+        1 << _NUMBER_OF_BITS_OF_FIRST_LEVEL;
+    static constexpr int _NUMBER_OF_WORDS_PER_BITMAP =
+        _MAX_NUMBER_OF_SLOTS_PER_LEVEL / 64;
+
+    // number of ticks covered by the whole wheel
+    static constexpr uint64_t _RANGE_OF_WHEEL = static_cast<uint64_t>(1)
+                                                << (_NUMBER_OF_BITS_OF_FIRST_LEVEL
+                                                    + (_NUMBER_OF_LEVELS - 1)
+                                                          * _NUMBER_OF_BITS_OF_UPPER_LEVELS);
+
+    static constexpr uint64_t _NO_TICK = static_cast<uint64_t>(-1);
+
+    static int _get_shift(int level) {
+        return level == 0 ? 0
+                          : _NUMBER_OF_BITS_OF_FIRST_LEVEL
+                                + (level - 1) * _NUMBER_OF_BITS_OF_UPPER_LEVELS;
+    }
+
+    static int _get_number_of_slots(int level) {
+        return 1
+               << (level == 0 ? _NUMBER_OF_BITS_OF_FIRST_LEVEL
+                              : _NUMBER_OF_BITS_OF_UPPER_LEVELS);
+    }
+
+    static uint64_t _get_tick_rounded_up(TimePoint time_point);
+
+    static uint64_t _get_tick_rounded_down(TimePoint time_point);
+
+    void _link(Timer *timer_ptr);
+
+    void _unlink(Timer *timer_ptr);
+
+    // returns the first slot index of the given level that is not processed
+    // yet, i.e. the one that contains the earliest timers of that level
+    uint64_t _get_first_pending_slot_number(int level) const;
+
+    // returns the slot number (i.e. the tick shifted right by the level's
+    // shift) of the first non-empty slot at or after the given one, or
+    // `_NO_TICK` if the level is empty
+    uint64_t
+    _find_first_non_empty_slot_number(int level, uint64_t slot_number) const;
+
+    // the earliest tick at which something needs to be done, i.e. either
+    // expiring a slot of the first level or cascading a slot of an upper level
+    uint64_t _find_next_tick_to_be_processed() const;
+
+    // re-distributes the timers of the upper-level slots that turn at the
+    // current tick and moves out the first-level slot of the current tick
+    void _process_current_tick(std::vector<const Timer *> &timers);
+
+    // for time points beyond the range of the wheel
+    void _move_out_all_before_or_at(
+        uint64_t tick, std::vector<const Timer *> &timers
+    );
+
+    Timer *_slots[_NUMBER_OF_LEVELS][_MAX_NUMBER_OF_SLOTS_PER_LEVEL]{};
+    uint64_t _bitmaps[_NUMBER_OF_LEVELS][_NUMBER_OF_WORDS_PER_BITMAP]{};
+
+    // the earliest tick that is not processed yet
+    uint64_t _current_tick;
+
+    size_t _size{0};
+
+    // cached result of `get_earliest_expiration_time_point`
+    uint64_t _earliest_tick{_NO_TICK};
+    bool _is_earliest_tick_valid{true};
+};
+
+} // namespace xubinh_server
+
+#endif
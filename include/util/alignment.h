@@ -23,7 +23,8 @@ inline size_t get_next_power_of_2(size_t n) {
     //     throw std::invalid_argument("power of 2 is undefined for zero");
     // }
 
-    return 32 - __builtin_clzll(n - 1);
+    // [NOTE]: counts against the width of `unsigned long long`, not `int`
+    return static_cast<size_t>(64 - __builtin_clzll(n - 1));
 }
 
 } // namespace alignment
@@ -2,9 +2,9 @@
 #define __XUBINH_SERVER_UTIL_BLOCKING_QUEUE
 
 #include <deque>
-#include <functional>
 
 #include "util/condition_variable.h"
+#include "util/inplace_function.h"
 #include "util/mutex.h"
 
 namespace xubinh_server {
@@ -51,7 +51,7 @@ private:
 };
 
 // declaration
-extern template class BlockingQueue<std::function<void()>>;
+extern template class BlockingQueue<InplaceFunction<void()>>;
 
 } // namespace util
 
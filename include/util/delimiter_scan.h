@@ -0,0 +1,38 @@
+#ifndef __XUBINH_SERVER_UTIL_DELIMITER_SCAN
+#define __XUBINH_SERVER_UTIL_DELIMITER_SCAN
+
+#include <cstddef>
+
+namespace xubinh_server {
+
+namespace util {
+
+// `memchr`-style scanning over `[begin, end)`, which compares 32 bytes at a
+// time with AVX2 if the CPU supports it, 16 bytes at a time with SSE2
+// otherwise (on x86-64), and falls back to plain loops on other architectures
+//
+// - all functions return the position of the first occurrence, or `nullptr`
+// if not found
+namespace delimiter_scan {
+
+const char *find_byte(const char *begin, const char *end, char byte) noexcept;
+
+// finds two adjacent bytes, e.g. CRLF, in a single pass
+const char *find_byte_pair(
+    const char *begin, const char *end, char first_byte, char second_byte
+) noexcept;
+
+const char *find_sequence(
+    const char *begin,
+    const char *end,
+    const char *sequence,
+    size_t sequence_size
+) noexcept;
+
+} // namespace delimiter_scan
+
+} // namespace util
+
+} // namespace xubinh_server
+
+#endif
@@ -0,0 +1,235 @@
+#ifndef __XUBINH_SERVER_UTIL_FLAT_ID_MAP
+#define __XUBINH_SERVER_UTIL_FLAT_ID_MAP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+namespace xubinh_server {
+
+namespace util {
+
+// hash map from 64-bit ids to values, stored in a single flat array with open
+// addressing, so that looking up, inserting and erasing touch one or two
+// cache lines instead of chasing the nodes of a tree
+//
+// - linear probing with Fibonacci hashing, which spreads sequential ids, e.g.
+// the ones taken from a counter, evenly over the array
+// - erasing shifts the following entries back instead of leaving tombstones,
+// so that the probe sequences never grow longer with churn
+// - the array doubles once it is half full and never shrinks
+// - not thread-safe
+template <typename ValueType>
+class FlatIdMap {
+public:
+    // reserved for marking empty slots
+    static constexpr const uint64_t EMPTY_ID = UINT64_MAX;
+
+    explicit FlatIdMap(size_t initial_capacity = 16) {
+        size_t capacity = _MIN_CAPACITY;
+
+        while (capacity < initial_capacity) {
+            capacity *= 2;
+        }
+
+        _rehash(capacity);
+    }
+
+    size_t size() const noexcept {
+        return _size;
+    }
+
+    bool empty() const noexcept {
+        return _size == 0;
+    }
+
+    size_t get_capacity() const noexcept {
+        return _slots.size();
+    }
+
+    // returns `false` with nothing inserted if the id already exists
+    bool insert(uint64_t id, ValueType value) {
+        if (__builtin_expect(id == EMPTY_ID, false)) {
+            ::fprintf(
+                stderr,
+                "@xubinh_server::util::FlatIdMap::insert: the id is reserved\n"
+            );
+
+            ::abort();
+        }
+
+        if ((_size + 1) * 2 > _slots.size()) {
+            _rehash(_slots.size() * 2);
+        }
+
+        auto index = _get_home_index(id);
+
+        while (_slots[index].id != EMPTY_ID) {
+            if (_slots[index].id == id) {
+                return false;
+            }
+
+            index = (index + 1) & _mask;
+        }
+
+        _slots[index].id = id;
+        _slots[index].value = std::move(value);
+
+        ++_size;
+
+        return true;
+    }
+
+    // returns `nullptr` if not found
+    ValueType *find(uint64_t id) noexcept {
+        auto index = _find_index(id);
+
+        return index == _NOT_FOUND ? nullptr : &_slots[index].value;
+    }
+
+    const ValueType *find(uint64_t id) const noexcept {
+        auto index = _find_index(id);
+
+        return index == _NOT_FOUND ? nullptr : &_slots[index].value;
+    }
+
+    // returns `false` if not found
+    bool erase(uint64_t id) {
+        auto index = _find_index(id);
+
+        if (index == _NOT_FOUND) {
+            return false;
+        }
+
+        // moves the following entries of the same cluster back, unless their
+        // home slots lie in between, which would break their probe sequences
+        auto next_index = index;
+
+        while (true) {
+            next_index = (next_index + 1) & _mask;
+
+            if (_slots[next_index].id == EMPTY_ID) {
+                break;
+            }
+
+            auto home_index = _get_home_index(_slots[next_index].id);
+
+            // whether the home slot lies cyclically within (index, next_index]
+            bool should_stay = index <= next_index
+                                   ? (index < home_index
+                                      && home_index <= next_index)
+                                   : (index < home_index
+                                      || home_index <= next_index);
+
+            if (should_stay) {
+                continue;
+            }
+
+            _slots[index] = std::move(_slots[next_index]);
+
+            index = next_index;
+        }
+
+        _slots[index].id = EMPTY_ID;
+        _slots[index].value = ValueType{};
+
+        --_size;
+
+        return true;
+    }
+
+    // the callback is called as `callback(id, value)`
+    //
+    // - the map must not be modified by the callback
+    template <typename CallbackType>
+    void for_each(CallbackType &&callback) {
+        for (auto &slot : _slots) {
+            if (slot.id != EMPTY_ID) {
+                callback(slot.id, slot.value);
+            }
+        }
+    }
+
+    void clear() {
+        for (auto &slot : _slots) {
+            if (slot.id != EMPTY_ID) {
+                slot.id = EMPTY_ID;
+                slot.value = ValueType{};
+            }
+        }
+
+        _size = 0;
+    }
+
+private:
+    struct Slot {
+        uint64_t id{EMPTY_ID};
+        ValueType value{};
+    };
+
+    static constexpr const size_t _MIN_CAPACITY = 16;
+
+    static constexpr const size_t _NOT_FOUND = SIZE_MAX;
+
+    size_t _get_home_index(uint64_t id) const noexcept {
+        return static_cast<size_t>(
+            (id * 0x9e3779b97f4a7c15ULL) >> _number_of_shift_bits
+        );
+    }
+
+    size_t _find_index(uint64_t id) const noexcept {
+        if (id == EMPTY_ID) {
+            return _NOT_FOUND;
+        }
+
+        auto index = _get_home_index(id);
+
+        while (_slots[index].id != EMPTY_ID) {
+            if (_slots[index].id == id) {
+                return index;
+            }
+
+            index = (index + 1) & _mask;
+        }
+
+        return _NOT_FOUND;
+    }
+
+    // the capacity must be a power of 2
+    void _rehash(size_t new_capacity) {
+        std::vector<Slot> old_slots(new_capacity);
+
+        old_slots.swap(_slots);
+
+        _mask = new_capacity - 1;
+        _number_of_shift_bits =
+            64 - static_cast<int>(__builtin_ctzll(new_capacity));
+
+        for (auto &slot : old_slots) {
+            if (slot.id == EMPTY_ID) {
+                continue;
+            }
+
+            auto index = _get_home_index(slot.id);
+
+            while (_slots[index].id != EMPTY_ID) {
+                index = (index + 1) & _mask;
+            }
+
+            _slots[index] = std::move(slot);
+        }
+    }
+
+    std::vector<Slot> _slots;
+    size_t _size{0};
+    size_t _mask{0};
+    int _number_of_shift_bits{64};
+};
+
+} // namespace util
+
+} // namespace xubinh_server
+
+#endif
@@ -0,0 +1,264 @@
+#ifndef __XUBINH_SERVER_UTIL_INPLACE_FUNCTION
+#define __XUBINH_SERVER_UTIL_INPLACE_FUNCTION
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "util/type_traits.h"
+
+namespace xubinh_server {
+
+namespace util {
+
+// fits the whole object into a single cache line by default
+constexpr const size_t DEFAULT_INPLACE_FUNCTION_CAPACITY =
+    64 - sizeof(void *);
+
+template <
+    typename SignatureType,
+    size_t Capacity = DEFAULT_INPLACE_FUNCTION_CAPACITY>
+class InplaceFunction;
+
+// move-only replacement of `std::function`
+//
+// - callables no larger than the capacity are stored inline, so that no
+// allocation is made when constructing or moving the function object
+// - larger ones (or the ones that may throw when being moved) are allocated on
+// the heap instead, as `std::function` would do
+// - move-only callables are accepted, e.g. lambdas capturing a
+// `std::unique_ptr`
+template <typename ReturnType, typename... ArgTypes, size_t Capacity>
+class InplaceFunction<ReturnType(ArgTypes...), Capacity> {
+private:
+    template <typename CallableType>
+    using _enable_if_is_compatible_callable_t = type_traits::enable_if_t<
+        !std::is_same<
+            type_traits::decay_t<CallableType>,
+            InplaceFunction>::value
+        && !std::is_same<
+            type_traits::decay_t<CallableType>,
+            std::nullptr_t>::value
+        && (std::is_void<ReturnType>::value
+            || std::is_convertible<
+                decltype(std::declval<type_traits::decay_t<CallableType> &>()(
+                    std::declval<ArgTypes>()...
+                )),
+                ReturnType>::value)>;
+
+public:
+    static constexpr const size_t CAPACITY = Capacity;
+
+    // whether the given callable type would be stored inline
+    template <typename CallableType>
+    static constexpr bool is_stored_inline() {
+        return sizeof(CallableType) <= Capacity
+               && alignof(CallableType) <= alignof(std::max_align_t)
+               && std::is_nothrow_move_constructible<CallableType>::value;
+    }
+
+    InplaceFunction() noexcept = default;
+
+    InplaceFunction(std::nullptr_t) noexcept {
+    }
+
+    template <
+        typename CallableType,
+        typename = _enable_if_is_compatible_callable_t<CallableType>>
+    InplaceFunction(CallableType &&callable) {
+        _emplace<type_traits::decay_t<CallableType>>(
+            std::forward<CallableType>(callable)
+        );
+    }
+
+    // no copy
+    InplaceFunction(const InplaceFunction &) = delete;
+    InplaceFunction &operator=(const InplaceFunction &) = delete;
+
+    InplaceFunction(InplaceFunction &&other) noexcept {
+        _move_from(other);
+    }
+
+    InplaceFunction &operator=(InplaceFunction &&other) noexcept {
+        if (this != &other) {
+            reset();
+
+            _move_from(other);
+        }
+
+        return *this;
+    }
+
+    InplaceFunction &operator=(std::nullptr_t) noexcept {
+        reset();
+
+        return *this;
+    }
+
+    template <
+        typename CallableType,
+        typename = _enable_if_is_compatible_callable_t<CallableType>>
+    InplaceFunction &operator=(CallableType &&callable) {
+        reset();
+
+        _emplace<type_traits::decay_t<CallableType>>(
+            std::forward<CallableType>(callable)
+        );
+
+        return *this;
+    }
+
+    ~InplaceFunction() {
+        reset();
+    }
+
+    explicit operator bool() const noexcept {
+        return _operations != nullptr;
+    }
+
+    // the behavior is undefined if the function object is empty
+    ReturnType operator()(ArgTypes... args) const {
+        return _operations->invoke(
+            const_cast<void *>(static_cast<const void *>(&_storage)),
+            std::forward<ArgTypes>(args)...
+        );
+    }
+
+    void reset() noexcept {
+        if (_operations) {
+            _operations->destroy(&_storage);
+
+            _operations = nullptr;
+        }
+    }
+
+private:
+    struct _Operations {
+        ReturnType (*invoke)(void *storage, ArgTypes &&...args);
+
+        // move-constructs the callable into the destination and destroys the
+        // source
+        void (*relocate)(void *destination, void *source) noexcept;
+
+        void (*destroy)(void *storage) noexcept;
+    };
+
+    template <typename CallableType, bool = is_stored_inline<CallableType>()>
+    struct _Manager {
+        static CallableType *get(void *storage) noexcept {
+            return static_cast<CallableType *>(storage);
+        }
+
+        template <typename... Args>
+        static void create(void *storage, Args &&...args) {
+            ::new (storage) CallableType(std::forward<Args>(args)...);
+        }
+
+        static void relocate(void *destination, void *source) noexcept {
+            ::new (destination) CallableType(std::move(*get(source)));
+
+            get(source)->~CallableType();
+        }
+
+        static void destroy(void *storage) noexcept {
+            get(storage)->~CallableType();
+        }
+    };
+
+    template <typename CallableType>
+    struct _Manager<CallableType, false> {
+        static CallableType *get(void *storage) noexcept {
+            return *static_cast<CallableType **>(storage);
+        }
+
+        template <typename... Args>
+        static void create(void *storage, Args &&...args) {
+            *static_cast<CallableType **>(storage) =
+                new CallableType(std::forward<Args>(args)...);
+        }
+
+        // only the pointer is moved
+        static void relocate(void *destination, void *source) noexcept {
+            *static_cast<CallableType **>(destination) = get(source);
+        }
+
+        static void destroy(void *storage) noexcept {
+            delete get(storage);
+        }
+    };
+
+    template <typename CallableType>
+    static ReturnType _invoke(void *storage, ArgTypes &&...args) {
+        // the cast discards the result if the return type is `void`
+        return static_cast<ReturnType>((*_Manager<CallableType>::get(storage))(
+            std::forward<ArgTypes>(args)...
+        ));
+    }
+
+    template <typename CallableType>
+    static const _Operations *_get_operations() noexcept {
+        static constexpr const _Operations operations{
+            &_invoke<CallableType>,
+            &_Manager<CallableType>::relocate,
+            &_Manager<CallableType>::destroy
+        };
+
+        return &operations;
+    }
+
+    template <typename CallableType, typename ArgType>
+    void _emplace(ArgType &&callable) {
+        // [NOTE]: null function pointers are treated as empty, as
+        // `std::function` does
+        if (_is_null(callable)) {
+            return;
+        }
+
+        _Manager<CallableType>::create(
+            &_storage, std::forward<ArgType>(callable)
+        );
+
+        _operations = _get_operations<CallableType>();
+    }
+
+    void _move_from(InplaceFunction &other) noexcept {
+        if (other._operations) {
+            other._operations->relocate(&_storage, &other._storage);
+
+            _operations = other._operations;
+            other._operations = nullptr;
+        }
+    }
+
+    template <typename CallableType>
+    static bool _is_null(const CallableType &callable) noexcept {
+        return _is_null_impl(callable, std::is_pointer<CallableType>{});
+    }
+
+    template <typename CallableType>
+    static bool
+    _is_null_impl(const CallableType &callable, std::true_type) noexcept {
+        return callable == nullptr;
+    }
+
+    template <typename CallableType>
+    static bool _is_null_impl(const CallableType &, std::false_type) noexcept {
+        return false;
+    }
+
+    static_assert(
+        Capacity >= sizeof(void *),
+        "capacity must be able to hold at least a pointer"
+    );
+
+    alignas(std::max_align_t) unsigned char _storage[Capacity];
+
+    const _Operations *_operations{nullptr};
+};
+
+} // namespace util
+
+} // namespace xubinh_server
+
+#endif
@@ -0,0 +1,242 @@
+#ifndef __XUBINH_SERVER_UTIL_INTRUSIVE_PTR
+#define __XUBINH_SERVER_UTIL_INTRUSIVE_PTR
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace xubinh_server {
+
+namespace util {
+
+// smart pointer to an object that carries its own reference count (see
+// `IntrusiveReferenceCounted`)
+//
+// - `IsLocal == false`: the reference is counted atomically and could be
+// copied or released in any thread
+// - `IsLocal == true`: the reference is counted without atomic operations and
+// must only be copied or released in the owner thread of the object
+template <typename T, bool IsLocal>
+class BasicIntrusivePtr {
+public:
+    using element_type = T;
+
+    constexpr BasicIntrusivePtr() noexcept = default;
+
+    constexpr BasicIntrusivePtr(std::nullptr_t) noexcept {
+    }
+
+    explicit BasicIntrusivePtr(T *object) noexcept : _object(object) {
+        _add_reference(_object);
+    }
+
+    BasicIntrusivePtr(const BasicIntrusivePtr &other) noexcept
+        : _object(other._object) {
+        _add_reference(_object);
+    }
+
+    BasicIntrusivePtr(BasicIntrusivePtr &&other) noexcept
+        : _object(std::exchange(other._object, nullptr)) {
+    }
+
+    BasicIntrusivePtr &operator=(BasicIntrusivePtr other) noexcept {
+        swap(other);
+
+        return *this;
+    }
+
+    ~BasicIntrusivePtr() {
+        _release_reference(_object);
+    }
+
+    void swap(BasicIntrusivePtr &other) noexcept {
+        std::swap(_object, other._object);
+    }
+
+    // [NOTE]: the pointer is cleared before the reference is released, since
+    // the object might be holding this very pointer
+    void reset() noexcept {
+        _release_reference(std::exchange(_object, nullptr));
+    }
+
+    T *get() const noexcept {
+        return _object;
+    }
+
+    T &operator*() const noexcept {
+        return *_object;
+    }
+
+    T *operator->() const noexcept {
+        return _object;
+    }
+
+    explicit operator bool() const noexcept {
+        return _object != nullptr;
+    }
+
+    bool operator==(const BasicIntrusivePtr &other) const noexcept {
+        return _object == other._object;
+    }
+
+    bool operator!=(const BasicIntrusivePtr &other) const noexcept {
+        return _object != other._object;
+    }
+
+private:
+    static void _add_reference(T *object) noexcept {
+        if (!object) {
+            return;
+        }
+
+        if constexpr (IsLocal) {
+            object->add_local_reference();
+        }
+
+        else {
+            object->add_reference();
+        }
+    }
+
+    static void _release_reference(T *object) noexcept {
+        if (!object) {
+            return;
+        }
+
+        if constexpr (IsLocal) {
+            object->release_local_reference();
+        }
+
+        else {
+            object->release_reference();
+        }
+    }
+
+    T *_object{nullptr};
+};
+
+template <typename T>
+using IntrusivePtr = BasicIntrusivePtr<T, false>;
+
+template <typename T>
+using LocalIntrusivePtr = BasicIntrusivePtr<T, true>;
+
+// base for objects that carry their own reference count, so that neither a
+// separate control block is allocated, nor a weak count is maintained, as
+// `std::shared_ptr` would do
+//
+// - the references held inside the owner thread are counted apart without
+// atomic operations, and all of them together hold a single atomic
+// reference, so that copying them around never touches the atomic count
+// - objects must be created by `create`, with memory obtained from
+// `Allocator`, which is assumed to be stateless
+// - the object is destroyed by whoever releases the last reference, which
+// could be in any thread
+template <typename Derived, typename Allocator = std::allocator<Derived>>
+class IntrusiveReferenceCounted {
+public:
+    // the constructor of the derived class could be kept private by making
+    // this class a friend
+    template <typename... Args>
+    static IntrusivePtr<Derived> create(Args &&...args) {
+        Allocator allocator;
+
+        auto object = allocator.allocate(1);
+
+        try {
+            ::new (static_cast<void *>(object))
+                Derived(std::forward<Args>(args)...);
+        }
+
+        catch (...) {
+            allocator.deallocate(object, 1);
+
+            throw;
+        }
+
+        return IntrusivePtr<Derived>(object);
+    }
+
+    void add_reference() noexcept {
+        _number_of_references.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release_reference() noexcept {
+        if (_number_of_references.fetch_sub(1, std::memory_order_acq_rel)
+            == 1) {
+
+            _destroy(static_cast<Derived *>(this));
+        }
+    }
+
+    // must only be called inside the owner thread
+    void add_local_reference() noexcept {
+        if (_number_of_local_references++ == 0) {
+            add_reference();
+        }
+    }
+
+    // must only be called inside the owner thread
+    void release_local_reference() noexcept {
+        if (--_number_of_local_references == 0) {
+            release_reference();
+        }
+    }
+
+    // releases the local reference without destroying the object if it is the
+    // only reference left, in which case no new one could ever be taken since
+    // there is nothing to copy it from, so that the object could be reused
+    // instead, e.g. by a pool
+    //
+    // - returns `false` with nothing released otherwise
+    // - must only be called inside the owner thread
+    bool try_releasing_for_reuse() noexcept {
+        // [NOTE]: acquiring pairs with the releases of the other references,
+        // so that whatever they did to the object is seen before reusing it
+        if (_number_of_local_references != 1
+            || _number_of_references.load(std::memory_order_acquire) != 1) {
+
+            return false;
+        }
+
+        _number_of_local_references = 0;
+        _number_of_references.store(0, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    // for debugging only; the local references count as one
+    size_t get_number_of_references() const noexcept {
+        return _number_of_references.load(std::memory_order_relaxed);
+    }
+
+protected:
+    IntrusiveReferenceCounted() noexcept = default;
+
+    // the counts belong to the object itself and are never copied
+    IntrusiveReferenceCounted(const IntrusiveReferenceCounted &) = delete;
+    IntrusiveReferenceCounted &
+    operator=(const IntrusiveReferenceCounted &) = delete;
+
+    ~IntrusiveReferenceCounted() = default;
+
+private:
+    static void _destroy(Derived *object) noexcept {
+        Allocator allocator;
+
+        object->~Derived();
+
+        allocator.deallocate(object, 1);
+    }
+
+    std::atomic<size_t> _number_of_references{0};
+    size_t _number_of_local_references{0};
+};
+
+} // namespace util
+
+} // namespace xubinh_server
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef __XUBINH_SERVER_UTIL_IOVEC_BUILDER
+#define __XUBINH_SERVER_UTIL_IOVEC_BUILDER
+
+#include <cstring>
+#include <sys/uio.h>
+
+namespace xubinh_server {
+
+namespace util {
+
+// collects discontiguous pieces of data as iovecs on the stack, e.g. for
+// `TcpConnectSocketfd::send(const iovec *, int)`
+//
+// - the pieces are only referred to, not copied, so they must stay alive
+// until the iovecs are consumed
+// - a piece that directly follows the previous one in memory is merged into it
+template <int Capacity = 64>
+class IovecBuilder {
+public:
+    static_assert(Capacity > 0, "capacity must be positive");
+
+    // returns `false` with nothing appended if the builder is full
+    bool append(const void *data, size_t data_size) noexcept {
+        if (data_size == 0) {
+            return true;
+        }
+
+        _total_size += data_size;
+
+        if (_number_of_iovecs > 0) {
+            auto &last_iovec = _iovecs[_number_of_iovecs - 1];
+
+            if (static_cast<const char *>(last_iovec.iov_base)
+                    + last_iovec.iov_len
+                == data) {
+
+                last_iovec.iov_len += data_size;
+
+                return true;
+            }
+        }
+
+        if (_number_of_iovecs == Capacity) {
+            _total_size -= data_size;
+
+            return false;
+        }
+
+        _iovecs[_number_of_iovecs].iov_base = const_cast<void *>(data);
+        _iovecs[_number_of_iovecs].iov_len = data_size;
+
+        ++_number_of_iovecs;
+
+        return true;
+    }
+
+    bool append(const char *c_string) noexcept {
+        return append(c_string, ::strlen(c_string));
+    }
+
+    const iovec *get_iovecs() const noexcept {
+        return _iovecs;
+    }
+
+    int get_number_of_iovecs() const noexcept {
+        return _number_of_iovecs;
+    }
+
+    size_t get_total_size() const noexcept {
+        return _total_size;
+    }
+
+    void clear() noexcept {
+        _number_of_iovecs = 0;
+        _total_size = 0;
+    }
+
+private:
+    iovec _iovecs[Capacity];
+    int _number_of_iovecs{0};
+    size_t _total_size{0};
+};
+
+} // namespace util
+
+} // namespace xubinh_server
+
+#endif
@@ -1,9 +1,14 @@
 #ifndef __XUBINH_SERVER_LOCK_FREE_QUEUE
 #define __XUBINH_SERVER_LOCK_FREE_QUEUE
 
+#include <algorithm>
 #include <atomic>
+#include <deque>
 #include <memory>
 
+#include "util/mutex_guard.h"
+#include "util/slab_allocator.h"
+
 namespace xubinh_server {
 
 namespace util {
@@ -163,6 +168,450 @@ private:
     alignas(64) Node *_tail;
 };
 
+// multi-producer, single-consumer, unbounded, and lock-free queue
+//
+// - producers never wait for each other: each push takes one exchange on the
+// tail and one store to link the previous node (i.e. Vyukov's MPSC queue)
+// - elements are stored inline in the nodes, which are pooled in chunks by a
+// slab allocator owned by the queue, so that no allocation is needed once the
+// pool is warmed up
+// - the consumer drains the queue in batches; a batch ends at the tail seen
+// at its beginning, so that it won't be kept busy by the producers forever
+template <typename T>
+class MpscLockFreeQueue {
+private:
+    struct Node {
+        T *get_value() {
+            return reinterpret_cast<T *>(&storage);
+        }
+
+        std::atomic<Node *> next{nullptr};
+
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+public:
+    MpscLockFreeQueue()
+        : _head(_allocate_node())
+        , _tail(_head) {
+    }
+
+    // no copy
+    MpscLockFreeQueue(const MpscLockFreeQueue &) = delete;
+    MpscLockFreeQueue &operator=(const MpscLockFreeQueue &) = delete;
+
+    // no move
+    MpscLockFreeQueue(MpscLockFreeQueue &&) = delete;
+    MpscLockFreeQueue &operator=(MpscLockFreeQueue &&) = delete;
+
+    // not thread-safe
+    ~MpscLockFreeQueue() {
+        // the head node is always a stub whose element is already consumed
+        Node *current_node = _head;
+
+        while (Node *next_node =
+                   current_node->next.load(std::memory_order_acquire)) {
+
+            next_node->get_value()->~T();
+
+            _allocator.deallocate(current_node, 1);
+
+            current_node = next_node;
+        }
+
+        _allocator.deallocate(current_node, 1);
+    }
+
+    // thread-safe
+    template <typename... Args>
+    void push(Args &&...args) {
+        Node *new_node = _allocate_node();
+
+        ::new (static_cast<void *>(new_node->get_value()))
+            T(std::forward<Args>(args)...);
+
+        // the content of the new node is published along with the link
+        Node *previous_node =
+            _tail.exchange(new_node, std::memory_order_acq_rel);
+
+        previous_node->next.store(new_node, std::memory_order_release);
+    }
+
+    // must be called by the consumer only
+    bool empty() const {
+        return !_head->next.load(std::memory_order_acquire);
+    }
+
+    // pops out the first element if any
+    //
+    // - must be called by the consumer only
+    bool pop(T &element) {
+        Node *next_node = _head->next.load(std::memory_order_acquire);
+
+        if (!next_node) {
+            return false;
+        }
+
+        element = std::move(*next_node->get_value());
+
+        _advance_head(next_node);
+
+        return true;
+    }
+
+    // passes the elements to the given callable one by one in order, and
+    // returns the number of elements consumed
+    //
+    // - must be called by the consumer only
+    // - elements pushed after the beginning of the batch are left to the next
+    // one; so are the ones whose producers have not finished linking them
+    template <typename ConsumerType>
+    size_t pop_all(ConsumerType &&consumer) {
+        Node *last_node = _tail.load(std::memory_order_acquire);
+
+        size_t number_of_elements_consumed = 0;
+
+        while (_head != last_node) {
+            Node *next_node = _head->next.load(std::memory_order_acquire);
+
+            if (!next_node) {
+                break;
+            }
+
+            consumer(*next_node->get_value());
+
+            _advance_head(next_node);
+
+            ++number_of_elements_consumed;
+        }
+
+        return number_of_elements_consumed;
+    }
+
+private:
+    Node *_allocate_node() {
+        Node *new_node = _allocator.allocate(1);
+
+        ::new (static_cast<void *>(new_node)) Node;
+
+        return new_node;
+    }
+
+    // the next node becomes the new stub after its element is consumed
+    void _advance_head(Node *next_node) {
+        next_node->get_value()->~T();
+
+        _allocator.deallocate(_head, 1);
+
+        _head = next_node;
+    }
+
+    SemiLockFreeSlabAllocator<Node> _allocator;
+
+    alignas(64) Node *_head;
+    alignas(64) std::atomic<Node *> _tail;
+};
+
+// single-producer, single-consumer, bounded, and lock-free queue
+//
+// - elements are constructed in place inside a ring of slots allocated once at
+// construction, so that neither pushing nor popping allocates
+// - the producer and the consumer each keep a cached copy of the other one's
+// index on their own cache line, and only reload it when the ring looks full
+// (or empty), so that the shared indices are touched as rarely as possible
+// - the capacity is rounded up to a power of two
+// - pushing never blocks: once the ring is full, the elements go to an
+// unbounded overflow list guarded by a mutex until the consumer drains it, so
+// that two threads pushing into each other's full queue could not deadlock
+template <typename T>
+class SpscLockFreeRingQueue {
+private:
+    struct alignas(T) Slot {
+        T *get_value() {
+            return reinterpret_cast<T *>(&storage);
+        }
+
+        unsigned char storage[sizeof(T)];
+    };
+
+public:
+    explicit SpscLockFreeRingQueue(size_t capacity)
+        : _capacity(_round_up_to_power_of_two(capacity))
+        , _mask(_capacity - 1)
+        , _slots(new Slot[_capacity]) {
+    }
+
+    // no copy
+    SpscLockFreeRingQueue(const SpscLockFreeRingQueue &) = delete;
+    SpscLockFreeRingQueue &operator=(const SpscLockFreeRingQueue &) = delete;
+
+    // no move
+    SpscLockFreeRingQueue(SpscLockFreeRingQueue &&) = delete;
+    SpscLockFreeRingQueue &operator=(SpscLockFreeRingQueue &&) = delete;
+
+    // not thread-safe
+    ~SpscLockFreeRingQueue() {
+        auto tail = _tail.load(std::memory_order_acquire);
+
+        for (auto head = _head.load(std::memory_order_relaxed); head != tail;
+             head++) {
+
+            _slots[head & _mask].get_value()->~T();
+        }
+    }
+
+    size_t capacity() const {
+        return _capacity;
+    }
+
+    // must be called by the consumer only
+    bool empty() const {
+        return _head.load(std::memory_order_relaxed)
+                   == _tail.load(std::memory_order_acquire)
+               && !_is_overflowing.load(std::memory_order_acquire);
+    }
+
+    // returns false if the ring is full (or the overflow list is not drained
+    // yet)
+    //
+    // - must be called by the producer only
+    template <typename... Args>
+    bool try_push(Args &&...args) {
+        auto tail = _tail.load(std::memory_order_relaxed);
+
+        if (_is_overflowing.load(std::memory_order_relaxed)
+            || !_has_free_slots(tail, 1)) {
+
+            return false;
+        }
+
+        ::new (static_cast<void *>(_slots[tail & _mask].get_value()))
+            T(std::forward<Args>(args)...);
+
+        _tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // appends to the overflow list instead if the ring is full, or if the
+    // list is not drained yet so that the order is kept
+    //
+    // - must be called by the producer only
+    template <typename... Args>
+    void push(Args &&...args) {
+        // [NOTE]: nothing is constructed from the arguments if it fails
+        if (try_push(std::forward<Args>(args)...)) {
+            return;
+        }
+
+        MutexGuard lock(_overflow_mutex);
+
+        _overflow_elements.emplace_back(std::forward<Args>(args)...);
+
+        // [NOTE]: only cleared by the consumer after taking all the elements
+        // out, under the same mutex
+        _is_overflowing.store(true, std::memory_order_release);
+    }
+
+    // moves as many elements as there is room for from the given range, and
+    // publishes them all at once; returns the number of elements moved
+    //
+    // - must be called by the producer only
+    template <typename InputIterator>
+    size_t try_push_bulk(InputIterator first, size_t number_of_elements) {
+        if (_is_overflowing.load(std::memory_order_relaxed)) {
+            return 0;
+        }
+
+        auto tail = _tail.load(std::memory_order_relaxed);
+
+        if (!_has_free_slots(tail, number_of_elements)) {
+            number_of_elements = _capacity - (tail - _cached_head);
+        }
+
+        for (size_t i = 0; i < number_of_elements; i++, ++first) {
+            ::new (static_cast<void *>(_slots[(tail + i) & _mask].get_value()))
+                T(std::move(*first));
+        }
+
+        _tail.store(tail + number_of_elements, std::memory_order_release);
+
+        return number_of_elements;
+    }
+
+    // returns false if the ring is empty
+    //
+    // - must be called by the consumer only
+    bool try_pop(T &element) {
+        auto head = _head.load(std::memory_order_relaxed);
+
+        if (head == _cached_tail) {
+            // [NOTE]: the flag must be read before the tail, so that every
+            // element pushed into the ring ahead of the overflowing ones is
+            // covered by the tail read afterwards
+            auto is_overflowing =
+                _is_overflowing.load(std::memory_order_acquire);
+
+            _cached_tail = _tail.load(std::memory_order_acquire);
+
+            // the elements in the ring always precede the overflowing ones
+            if (head == _cached_tail) {
+                return is_overflowing && _pop_overflowing_element(element);
+            }
+        }
+
+        auto value = _slots[head & _mask].get_value();
+
+        element = std::move(*value);
+
+        value->~T();
+
+        _head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // passes at most the given number of elements to the given callable one by
+    // one in order, and hands the slots back to the producer all at once;
+    // returns the number of elements consumed
+    //
+    // - must be called by the consumer only
+    // - elements pushed after the beginning of the batch are left to the next
+    // one
+    template <typename ConsumerType>
+    size_t pop_all(
+        ConsumerType &&consumer,
+        size_t max_number_of_elements = static_cast<size_t>(-1)
+    ) {
+        auto head = _head.load(std::memory_order_relaxed);
+
+        // [NOTE]: read before the tail, see `try_pop`
+        auto is_overflowing = _is_overflowing.load(std::memory_order_acquire);
+
+        _cached_tail = _tail.load(std::memory_order_acquire);
+
+        auto number_of_elements =
+            std::min(_cached_tail - head, max_number_of_elements);
+
+        for (size_t i = 0; i < number_of_elements; i++) {
+            auto value = _slots[(head + i) & _mask].get_value();
+
+            consumer(*value);
+
+            value->~T();
+        }
+
+        _head.store(head + number_of_elements, std::memory_order_release);
+
+        // the elements in the ring always precede the overflowing ones, which
+        // could only be taken once the ring is drained
+        if (head + number_of_elements == _cached_tail
+            && number_of_elements < max_number_of_elements && is_overflowing) {
+
+            number_of_elements += _pop_overflowing_elements(
+                consumer, max_number_of_elements - number_of_elements
+            );
+        }
+
+        return number_of_elements;
+    }
+
+private:
+    // [NOTE]: the list is never empty while the flag is seen set, since only
+    // the consumer clears it
+    bool _pop_overflowing_element(T &element) {
+        MutexGuard lock(_overflow_mutex);
+
+        element = std::move(_overflow_elements.front());
+
+        _overflow_elements.pop_front();
+
+        if (_overflow_elements.empty()) {
+            _is_overflowing.store(false, std::memory_order_relaxed);
+        }
+
+        return true;
+    }
+
+    // [NOTE]: the elements are moved out before being consumed, since the
+    // consumer might push into the same queue, e.g. when the producer and the
+    // consumer are the same thread
+    template <typename ConsumerType>
+    size_t _pop_overflowing_elements(
+        ConsumerType &consumer, size_t max_number_of_elements
+    ) {
+        std::deque<T> overflowing_elements;
+
+        {
+            MutexGuard lock(_overflow_mutex);
+
+            if (_overflow_elements.size() <= max_number_of_elements) {
+                overflowing_elements.swap(_overflow_elements);
+
+                _is_overflowing.store(false, std::memory_order_relaxed);
+            }
+
+            else {
+                auto last = _overflow_elements.begin()
+                            + static_cast<std::ptrdiff_t>(max_number_of_elements);
+
+                overflowing_elements.assign(
+                    std::make_move_iterator(_overflow_elements.begin()),
+                    std::make_move_iterator(last)
+                );
+
+                _overflow_elements.erase(_overflow_elements.begin(), last);
+            }
+        }
+
+        for (auto &element : overflowing_elements) {
+            consumer(element);
+        }
+
+        return overflowing_elements.size();
+    }
+
+    static size_t _round_up_to_power_of_two(size_t capacity) {
+        size_t rounded_capacity = 1;
+
+        while (rounded_capacity < capacity) {
+            rounded_capacity <<= 1;
+        }
+
+        return rounded_capacity;
+    }
+
+    // only reloads the index of the consumer when the cached one says there is
+    // not enough room
+    bool _has_free_slots(size_t tail, size_t number_of_slots) {
+        if (_capacity - (tail - _cached_head) >= number_of_slots) {
+            return true;
+        }
+
+        _cached_head = _head.load(std::memory_order_acquire);
+
+        return _capacity - (tail - _cached_head) >= number_of_slots;
+    }
+
+    // read-only
+    alignas(64) const size_t _capacity;
+    const size_t _mask;
+    const std::unique_ptr<Slot[]> _slots;
+
+    // owned by the producer
+    alignas(64) std::atomic<size_t> _tail{0};
+    size_t _cached_head{0};
+
+    // owned by the consumer
+    alignas(64) std::atomic<size_t> _head{0};
+    size_t _cached_tail{0};
+
+    // set by the producer and cleared by the consumer, both under the mutex
+    alignas(64) std::atomic<bool> _is_overflowing{false};
+    Mutex _overflow_mutex;
+    std::deque<T> _overflow_elements;
+};
+
 } // namespace util
 
 } // namespace xubinh_server
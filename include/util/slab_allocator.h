@@ -359,7 +359,7 @@ private:
     static constexpr const size_t _NUMBER_OF_SLABS_PER_CHUNK = 4000;
 
     alignas(64) std::atomic<TaggedLinkedListNodePtr> _linked_list_of_free_slabs{
-        nullptr, 0};
+        TaggedLinkedListNodePtr{nullptr, 0}};
 
     alignas(64) std::vector<void *> _allocated_chunks;
     Mutex _mutex;
@@ -8,7 +8,12 @@ ENABLE_TEST=${ENABLE_TEST:-"on"}
 USE_LOCK_FREE_QUEUE="off"
 USE_BLOCKING_QUEUE_WITH_RAW_POINTER="off"
 USE_LOCK_FREE_QUEUE_WITH_RAW_POINTER="off"
+USE_MPSC_LOCK_FREE_QUEUE="off"
+USE_LOCK_FREE_RING_QUEUE="off"
 USE_SHARED_PTR_DESTRUCTION_TRANSFERING="on"
+USE_IO_URING_POLLER="off"
+USE_RING_TCP_BUFFER="off"
+USE_SLAB_CHAIN_TCP_BUFFER="off"
 
 # configuration specifically for http server example
 HTTP_EXAMPLE_RUN_BENCHMARK=${HTTP_EXAMPLE_RUN_BENCHMARK:-"off"}
@@ -31,7 +36,12 @@ cmake \
     -DUSE_LOCK_FREE_QUEUE="$USE_LOCK_FREE_QUEUE" \
     -DUSE_BLOCKING_QUEUE_WITH_RAW_POINTER="$USE_BLOCKING_QUEUE_WITH_RAW_POINTER" \
     -DUSE_LOCK_FREE_QUEUE_WITH_RAW_POINTER="$USE_LOCK_FREE_QUEUE_WITH_RAW_POINTER" \
+    -DUSE_MPSC_LOCK_FREE_QUEUE="$USE_MPSC_LOCK_FREE_QUEUE" \
+    -DUSE_LOCK_FREE_RING_QUEUE="$USE_LOCK_FREE_RING_QUEUE" \
     -DUSE_SHARED_PTR_DESTRUCTION_TRANSFERING="$USE_SHARED_PTR_DESTRUCTION_TRANSFERING" \
+    -DUSE_IO_URING_POLLER="$USE_IO_URING_POLLER" \
+    -DUSE_RING_TCP_BUFFER="$USE_RING_TCP_BUFFER" \
+    -DUSE_SLAB_CHAIN_TCP_BUFFER="$USE_SLAB_CHAIN_TCP_BUFFER" \
     -DHTTP_EXAMPLE_RUN_BENCHMARK="$HTTP_EXAMPLE_RUN_BENCHMARK" \
     ..
 
@@ -1,25 +1,52 @@
 #include "event_loop.h"
 #include "log_builder.h"
+#include "signalfd.h"
 #include "util/this_thread.h"
 
 namespace xubinh_server {
 
 EventLoop::EventLoop(
-    uint64_t loop_index, size_t number_of_functor_blocking_queues
+    uint64_t loop_index,
+    size_t number_of_functor_blocking_queues,
+    TimerContainerType timer_container_type
 )
     : _loop_index(loop_index)
+#ifdef __USE_MPSC_LOCK_FREE_QUEUE
+    // a single queue is shared by all the producers
+    , _number_of_functor_blocking_queues(1)
+#else
     , _number_of_functor_blocking_queues(
           std::max(number_of_functor_blocking_queues, static_cast<size_t>(1))
       )
+#endif
     , _functor_blocking_queues(_number_of_functor_blocking_queues)
     , _eventfds(_number_of_functor_blocking_queues)
     , _eventfd_pilot_lamps(_number_of_functor_blocking_queues)
     , _timerfd(Timerfd::create_timerfd(0), this)
+    , _timer_container(TimerContainer::create(timer_container_type))
+    , _max_busy_poll_budget(_default_max_busy_poll_budget)
     , _owner_thread_tid(util::this_thread::get_tid()) {
 
+#ifdef __USE_MPSC_LOCK_FREE_QUEUE
+    static_cast<void>(number_of_functor_blocking_queues);
+#endif
+
+    // [NOTE]: `sendfile(2)` and `splice(2)` provide no way like `MSG_NOSIGNAL`
+    // to suppress SIGPIPE, which is directed to the writing thread, so it is
+    // blocked once for the whole lifetime of the loop thread instead of being
+    // ignored process-wide behind the application's back
+    SignalSet sigpipe_set;
+
+    sigpipe_set.add_signal(SIGPIPE);
+
+    Signalfd::block_signals(sigpipe_set);
+
     for (int i = 0; i < static_cast<int>(_number_of_functor_blocking_queues);
          i++) {
-#ifdef __USE_LOCK_FREE_QUEUE
+#ifdef __USE_LOCK_FREE_RING_QUEUE
+        _functor_blocking_queues[i] =
+            new FunctorQueue(_FUNCTOR_RING_QUEUE_CAPACITY);
+#elif defined(__USE_LOCK_FREE_QUEUE)
         _functor_blocking_queues[i] = new FunctorQueue;
 #else
         _functor_blocking_queues[i] = new FunctorQueue(_FUNCTOR_QUEUE_CAPACITY);
@@ -54,6 +81,10 @@ EventLoop::EventLoop(
 }
 
 EventLoop::~EventLoop() noexcept {
+    // destroyed in the owner thread, where their memory might have come from,
+    // and while the loop is still able to serve their clean-ups
+    _module_slots.clear();
+
     _release_all_timers();
 
     for (auto ptr : _functor_blocking_queues) {
@@ -87,6 +118,8 @@ void EventLoop::loop() {
                 // expire the timers as many as possible before exiting
                 _expire_timers_and_update_alarm(current_time_point);
 
+                _invoke_end_of_iteration_functors();
+
                 return;
             }
 
@@ -94,12 +127,14 @@ void EventLoop::loop() {
                      << ", cannot exit event loop now";
         }
 
-        _event_poller.poll_for_active_events_of_all_fds(event_dispatchers);
+        _poll_for_active_events(event_dispatchers);
 
         LOG_TRACE << "number of dispatchers: "
                          + std::to_string(event_dispatchers.size());
 
-        util::TimePoint time_stamp;
+        _iteration_time_point = TimePoint();
+
+        auto time_stamp = _iteration_time_point;
 
         // if the event dispatcher pointer is polled out, it is ensured to be a
         // valid pointer since the unregistering of event dispatchers is fully
@@ -143,6 +178,8 @@ void EventLoop::loop() {
             LOG_TRACE << "nothing happened on timerfd";
         }
 
+        _invoke_end_of_iteration_functors();
+
         LOG_TRACE << "current size of poller: " << _event_poller.size();
     }
 }
@@ -244,6 +281,17 @@ void EventLoop::ask_to_stop() {
 void EventLoop::_leave_to_owner_thread(
     FunctorType functor, size_t functor_blocking_queue_index
 ) {
+#ifdef __USE_MPSC_LOCK_FREE_QUEUE
+    // the index is only meaningful for the queues with a single producer
+    functor_blocking_queue_index = 0;
+#endif
+
+    // counted before being pushed, so that the number of pending functors
+    // never goes below zero
+    if (_is_counting_pending_functors) {
+        _number_of_functors_posted.fetch_add(1, std::memory_order_relaxed);
+    }
+
     _functor_blocking_queues[functor_blocking_queue_index]->push(
         std::move(functor)
     );
@@ -268,7 +316,79 @@ void EventLoop::_wake_up_this_loop(size_t functor_blocking_queue_index) {
     }
 }
 
+void EventLoop::_poll_for_active_events(
+    std::vector<PollableFileDescriptor *> &event_dispatchers
+) {
+    if (_busy_poll_budget) {
+        TimePoint spinning_deadline = TimePoint() + _busy_poll_budget;
+
+        while (true) {
+            _event_poller.poll_for_active_events_of_all_fds(
+                event_dispatchers, false
+            );
+
+            if (!event_dispatchers.empty()
+                || _need_stop.load(std::memory_order_relaxed)) {
+
+                return;
+            }
+
+            // [NOTE]: functors are picked up here as soon as their pilot lamps
+            // are lit, i.e. without waiting for the eventfds, which stay
+            // readable and are consumed by a later iteration as usual
+            if (_is_any_eventfd_pilot_lamp_lit()) {
+                _invoke_all_functors();
+
+                // as if an iteration ended, since the spinning could go on for
+                // a while
+                _invoke_end_of_iteration_functors();
+            }
+
+            if (TimePoint() >= spinning_deadline) {
+                break;
+            }
+
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+    }
+
+    if (!_max_busy_poll_budget) {
+        _event_poller.poll_for_active_events_of_all_fds(event_dispatchers);
+
+        return;
+    }
+
+    TimePoint blocking_start_time_point;
+
+    _event_poller.poll_for_active_events_of_all_fds(event_dispatchers);
+
+    auto blocking_time_interval = TimePoint() - blocking_start_time_point;
+
+    // the loop would have been better off spinning a little longer
+    if (blocking_time_interval <= _max_busy_poll_budget) {
+        _busy_poll_budget = std::min(
+            _busy_poll_budget < TimeInterval(_MIN_BUSY_POLL_BUDGET)
+                ? TimeInterval(_MIN_BUSY_POLL_BUDGET)
+                : _busy_poll_budget * static_cast<int64_t>(2),
+            _max_busy_poll_budget
+        );
+    }
+
+    // spinning would not have helped
+    else {
+        _busy_poll_budget.nanoseconds /= 2;
+
+        if (_busy_poll_budget < TimeInterval(_MIN_BUSY_POLL_BUDGET)) {
+            _busy_poll_budget = 0;
+        }
+    }
+}
+
 void EventLoop::_invoke_all_functors() {
+    size_t number_of_functors_invoked = 0;
+
     for (auto &_functor_blocking_queue_ptr : _functor_blocking_queues) {
 #ifndef __USE_LOCK_FREE_QUEUE
 #ifdef __USE_BLOCKING_QUEUE_WITH_RAW_POINTER
@@ -279,13 +399,23 @@ void EventLoop::_invoke_all_functors() {
 
             delete functor;
         }
+
+        number_of_functors_invoked += queued_functors.size();
 #else
         const auto &queued_functors = _functor_blocking_queue_ptr->pop_all();
 
         for (auto &functor : queued_functors) {
             functor();
         }
+
+        number_of_functors_invoked += queued_functors.size();
 #endif
+#elif defined(__USE_MPSC_LOCK_FREE_QUEUE)                                     \
+    || defined(__USE_LOCK_FREE_RING_QUEUE)
+        number_of_functors_invoked +=
+            _functor_blocking_queue_ptr->pop_all([](FunctorType &functor) {
+                functor();
+            });
 #else
 #ifdef __USE_LOCK_FREE_QUEUE_WITH_RAW_POINTER
         FunctorType *functor_ptr;
@@ -293,25 +423,54 @@ void EventLoop::_invoke_all_functors() {
         while ((functor_ptr = _functor_blocking_queue_ptr->pop())) {
             (*functor_ptr)();
             delete functor_ptr;
+
+            ++number_of_functors_invoked;
         }
 #else
         std::shared_ptr<FunctorType> functor_ptr;
 
         while ((functor_ptr = _functor_blocking_queue_ptr->pop())) {
             (*functor_ptr)();
+
+            ++number_of_functors_invoked;
         }
 #endif
 #endif
     }
+
+    if (!_is_counting_pending_functors) {
+        return;
+    }
+
+    // only written by the owner thread
+    _number_of_functors_invoked.store(
+        _number_of_functors_invoked.load(std::memory_order_relaxed)
+            + number_of_functors_invoked,
+        std::memory_order_relaxed
+    );
+}
+
+void EventLoop::_invoke_end_of_iteration_functors() {
+    while (!_end_of_iteration_functors.empty()) {
+        _end_of_iteration_functors_being_invoked.swap(
+            _end_of_iteration_functors
+        );
+
+        for (auto &functor : _end_of_iteration_functors_being_invoked) {
+            functor();
+        }
+
+        _end_of_iteration_functors_being_invoked.clear();
+    }
 }
 
 void EventLoop::_add_a_timer_and_update_alarm(const Timer *timer_ptr) {
     LOG_TRACE << "entering `_add_a_timer_and_update_alarm`";
 
-    _timer_container.insert_one(timer_ptr);
+    _timer_container->insert_one(timer_ptr);
 
     TimePoint earliest_expiration_time_point_after_insertion =
-        _timer_container.get_earliest_expiration_time_point();
+        _timer_container->get_earliest_expiration_time_point();
 
     LOG_TRACE << "earliest_expiration_time_point_after_insertion: "
               << earliest_expiration_time_point_after_insertion
@@ -343,14 +502,18 @@ void EventLoop::_add_a_timer_and_update_alarm(const Timer *timer_ptr) {
 
 void EventLoop::_cancel_a_timer_and_update_alarm(const Timer *timer_ptr) {
     // might be expired already
-    bool flag_timer_not_exist = !_timer_container.remove_one(timer_ptr);
+    bool flag_timer_not_exist = !_timer_container->remove_one(timer_ptr);
 
     if (flag_timer_not_exist) {
         return;
     }
 
+    // [NOTE]: released before any of the early returns below, since the
+    // functor might be holding a reference to something, e.g. a connection
+    delete timer_ptr;
+
     // cancel alarm if there were no timers left
-    if (_timer_container.empty()) {
+    if (_timer_container->empty()) {
         _cancel_alarm();
 
         _next_earliest_expiration_time = TimePoint::FOREVER;
@@ -359,7 +522,7 @@ void EventLoop::_cancel_a_timer_and_update_alarm(const Timer *timer_ptr) {
     }
 
     TimePoint earliest_expiration_time_point_after_removal =
-        _timer_container.get_earliest_expiration_time_point();
+        _timer_container->get_earliest_expiration_time_point();
 
     // or reset alarm if expiration time is delayed by the removal
     if (_next_earliest_expiration_time
@@ -370,23 +533,24 @@ void EventLoop::_cancel_a_timer_and_update_alarm(const Timer *timer_ptr) {
         _next_earliest_expiration_time =
             earliest_expiration_time_point_after_removal;
     }
-
-    delete timer_ptr;
 }
 
 void EventLoop::_expire_timers_and_update_alarm(TimePoint time_point) {
     LOG_TRACE << "entering _expire_timers_and_update_alarm";
 
-    std::vector<const Timer *> expired_timers =
-        _timer_container.move_out_before_or_at(time_point);
+    auto &expired_timers = _expired_timers;
+
+    expired_timers.clear();
+
+    _timer_container->move_out_before_or_at(time_point, expired_timers);
 
     LOG_TRACE << "moved out " << expired_timers.size() << " timers";
 
     LOG_TRACE << "number of timers left in the container: "
-              << _timer_container.size();
+              << _timer_container->size();
 
     // update alarm status for the callbacks
-    if (_timer_container.empty()) {
+    if (_timer_container->empty()) {
         _cancel_alarm();
 
         _next_earliest_expiration_time = TimePoint::FOREVER;
@@ -395,7 +559,7 @@ void EventLoop::_expire_timers_and_update_alarm(TimePoint time_point) {
     }
     else {
         TimePoint earliest_expiration_time_point_after_removal =
-            _timer_container.get_earliest_expiration_time_point();
+            _timer_container->get_earliest_expiration_time_point();
 
         if (_next_earliest_expiration_time
             < earliest_expiration_time_point_after_removal) {
@@ -417,16 +581,20 @@ void EventLoop::_expire_timers_and_update_alarm(TimePoint time_point) {
         }
     }
 
-    std::vector<const Timer *> timers_that_are_still_valid;
-
     LOG_TRACE << "expiring timers...";
 
     // the callbacks themselves might also add new timers and update the alarm
+    //
+    // - the valid timers are compacted to the front in place so that no extra
+    // vector is needed
+    size_t number_of_timers_that_are_still_valid = 0;
+
     for (const Timer *timer_ptr : expired_timers) {
         auto temp_mutable_timer_ptr = const_cast<Timer *>(timer_ptr);
 
         if (temp_mutable_timer_ptr->expire_until(time_point)) {
-            timers_that_are_still_valid.push_back(timer_ptr);
+            expired_timers[number_of_timers_that_are_still_valid++] =
+                timer_ptr;
         }
 
         else {
@@ -434,10 +602,14 @@ void EventLoop::_expire_timers_and_update_alarm(TimePoint time_point) {
         }
     }
 
+    expired_timers.resize(number_of_timers_that_are_still_valid);
+
+    auto &timers_that_are_still_valid = expired_timers;
+
     LOG_TRACE << "finished expiring timers";
 
     LOG_TRACE << "number of timers left in the container: "
-              << _timer_container.size();
+              << _timer_container->size();
 
     if (timers_that_are_still_valid.empty()) {
         LOG_TRACE << "no valid timers left";
@@ -451,13 +623,13 @@ void EventLoop::_expire_timers_and_update_alarm(TimePoint time_point) {
 
     LOG_TRACE << "inserting valid timers...";
 
-    _timer_container.insert_all(timers_that_are_still_valid);
+    _timer_container->insert_all(timers_that_are_still_valid);
 
     LOG_TRACE << "number of timers left in the container: "
-              << _timer_container.size();
+              << _timer_container->size();
 
     TimePoint earliest_expiration_time_point_after_inserting_all =
-        _timer_container.get_earliest_expiration_time_point();
+        _timer_container->get_earliest_expiration_time_point();
 
     // newly inserted timer advanced the expiration
     if (earliest_expiration_time_point_after_inserting_all
@@ -481,8 +653,9 @@ void EventLoop::_expire_timers_and_update_alarm(TimePoint time_point) {
 }
 
 void EventLoop::_release_all_timers() {
-    std::vector<const Timer *> all_timers =
-        _timer_container.move_out_before_or_at(TimePoint::FOREVER);
+    std::vector<const Timer *> all_timers;
+
+    _timer_container->move_out_before_or_at(TimePoint::FOREVER, all_timers);
 
     for (const Timer *timer_ptr : all_timers) {
         delete timer_ptr;
@@ -501,4 +674,13 @@ void EventLoop::_timerfd_message_callback(__attribute__((unused)) uint64_t value
 
 int64_t EventLoop::_alarm_advancing_threshold = 3;
 
+EventLoop::TimerContainerType EventLoop::_default_timer_container_type =
+    TimerContainerType::ORDERED_SET;
+
+util::TimeInterval EventLoop::_default_max_busy_poll_budget{0};
+
+// [NOTE]: constant-initialized, so that the modules could take their indices
+// during the dynamic initialization of other translation units
+std::atomic<size_t> EventLoop::_number_of_module_slots{0};
+
 } // namespace xubinh_server
\ No newline at end of file
@@ -7,12 +7,21 @@ namespace xubinh_server {
 EventLoopThread::EventLoopThread(
     const std::string &thread_name,
     ThreadInitializationCallbackType thread_initialization_callback,
-    uint64_t loop_index
+    uint64_t loop_index,
+    size_t number_of_functor_blocking_queues,
+    bool is_counting_pending_functors
 )
     : _thread_initialization_callback(std::move(thread_initialization_callback))
     , _thread(
-          [this, loop_index]() {
-              _worker_function(loop_index);
+          [this,
+           loop_index,
+           number_of_functor_blocking_queues,
+           is_counting_pending_functors]() {
+              _worker_function(
+                  loop_index,
+                  number_of_functor_blocking_queues,
+                  is_counting_pending_functors
+              );
           },
           thread_name
       ) {
@@ -36,8 +45,15 @@ void EventLoopThread::start() {
     }
 }
 
-void EventLoopThread::_worker_function(uint64_t loop_index) {
-    EventLoop loop(loop_index);
+void EventLoopThread::_worker_function(
+    uint64_t loop_index,
+    size_t number_of_functor_blocking_queues,
+    bool is_counting_pending_functors
+) {
+    EventLoop loop(loop_index, number_of_functor_blocking_queues);
+
+    // before the loop is handed out
+    loop.set_counting_pending_functors(is_counting_pending_functors);
 
     {
         util::MutexGuard lock(_mutex);
@@ -30,13 +30,22 @@ void EventLoopThreadPool::start() {
         return;
     }
 
+    // posted functors are only counted for the policy that needs them
+    bool is_counting_pending_functors =
+        _loop_selection_policy
+        == LoopSelectionPolicy::POWER_OF_TWO_CHOICES_BY_PENDING_FUNCTORS;
+
     for (int i = 0; i < static_cast<int>(_thread_pool_capasity); i++) {
         std::string thread_name = "worker-thread-" + std::to_string(i);
 
         size_t loop_index = i;
 
         _thread_pool.push_back(std::make_shared<EventLoopThread>(
-            thread_name, _thread_initialization_callback, loop_index
+            thread_name,
+            _thread_initialization_callback,
+            loop_index,
+            1,
+            is_counting_pending_functors
         ));
 
         _thread_pool.back()->start();
@@ -79,12 +88,139 @@ void EventLoopThreadPool::join() {
     LOG_TRACE << "all threads are joined";
 }
 
-EventLoop *EventLoopThreadPool::get_next_loop() {
-    auto next_loop_index =
+EventLoop *EventLoopThreadPool::get_next_loop(const InetAddress *peer_address
+) {
+    size_t next_loop_index;
+
+    if (_loop_selector) {
+        next_loop_index = _loop_selector(*this, peer_address);
+
+        if (next_loop_index >= _thread_pool_capasity) {
+            LOG_FATAL << "loop selector returned an out-of-range index: "
+                      << next_loop_index;
+        }
+
+        return _thread_pool[next_loop_index]->get_loop();
+    }
+
+    switch (_loop_selection_policy) {
+    case LoopSelectionPolicy::LEAST_CONNECTIONS:
+        next_loop_index = _get_next_loop_index_by_least_connections();
+
+        break;
+
+    case LoopSelectionPolicy::POWER_OF_TWO_CHOICES_BY_CONNECTIONS:
+        next_loop_index = _get_next_loop_index_by_power_of_two_choices(
+            [](const EventLoop *loop) {
+                return loop->get_number_of_connections();
+            }
+        );
+
+        break;
+
+    case LoopSelectionPolicy::POWER_OF_TWO_CHOICES_BY_PENDING_FUNCTORS:
+        next_loop_index = _get_next_loop_index_by_power_of_two_choices(
+            [](const EventLoop *loop) {
+                return loop->get_number_of_pending_functors();
+            }
+        );
+
+        break;
+
+    case LoopSelectionPolicy::HASH_BY_PEER_ADDRESS:
+        next_loop_index =
+            peer_address ? _get_next_loop_index_by_peer_address(*peer_address)
+                         : _get_next_loop_index_by_round_robin();
+
+        break;
+
+    default:
+        next_loop_index = _get_next_loop_index_by_round_robin();
+
+        break;
+    }
+
+    return _thread_pool[next_loop_index]->get_loop();
+}
+
+size_t EventLoopThreadPool::_get_next_loop_index_by_least_connections() const {
+    size_t next_loop_index = 0;
+    size_t min_number_of_connections = static_cast<size_t>(-1);
+
+    for (size_t i = 0; i < _thread_pool_capasity; i++) {
+        auto number_of_connections =
+            _thread_pool[i]->get_loop()->get_number_of_connections();
+
+        if (number_of_connections < min_number_of_connections) {
+            next_loop_index = i;
+            min_number_of_connections = number_of_connections;
+        }
+    }
+
+    return next_loop_index;
+}
+
+template <typename LoadGetterType>
+size_t EventLoopThreadPool::_get_next_loop_index_by_power_of_two_choices(
+    const LoadGetterType &load_getter
+) {
+    if (_thread_pool_capasity == 1) {
+        return 0;
+    }
+
+    // [NOTE]: the candidates are derived from a scrambled counter instead of a
+    // random engine, so that this stays thread-safe without any locking
+    auto random_number = _scramble(
         _next_loop_index_counter.fetch_add(1, std::memory_order_relaxed)
+    );
+
+    auto first_loop_index =
+        static_cast<size_t>(random_number % _thread_pool_capasity);
+
+    // distinct from the first one
+    auto second_loop_index =
+        (first_loop_index + 1
+         + static_cast<size_t>(
+             (random_number >> 32) % (_thread_pool_capasity - 1)
+         ))
         % _thread_pool_capasity;
 
-    return _thread_pool[next_loop_index]->get_loop();
+    return load_getter(_thread_pool[second_loop_index]->get_loop())
+                   < load_getter(_thread_pool[first_loop_index]->get_loop())
+               ? second_loop_index
+               : first_loop_index;
+}
+
+size_t EventLoopThreadPool::_get_next_loop_index_by_peer_address(
+    const InetAddress &peer_address
+) const {
+    const unsigned char *ip_bytes;
+    size_t number_of_ip_bytes;
+
+    auto address = peer_address.get_address();
+
+    if (peer_address.is_ipv4()) {
+        auto &ip = reinterpret_cast<const sockaddr_in *>(address)->sin_addr;
+
+        ip_bytes = reinterpret_cast<const unsigned char *>(&ip);
+        number_of_ip_bytes = sizeof(ip);
+    }
+
+    else {
+        auto &ip = reinterpret_cast<const sockaddr_in6 *>(address)->sin6_addr;
+
+        ip_bytes = reinterpret_cast<const unsigned char *>(&ip);
+        number_of_ip_bytes = sizeof(ip);
+    }
+
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < number_of_ip_bytes; i++) {
+        hash = (hash ^ ip_bytes[i]) * 1099511628211ULL;
+    }
+
+    return static_cast<size_t>(_scramble(hash) % _thread_pool_capasity);
 }
 
 } // namespace xubinh_server
\ No newline at end of file
@@ -56,6 +56,8 @@ void EventPoller::
              << " (rlim_cur), " << limit.rlim_max << " (rlim_max)";
 }
 
+#ifndef __USE_IO_URING_POLLER
+
 EventPoller::EventPoller()
     : _epoll_fd(epoll_create1(_EPOLL_CREATE1_FLAGS)) {
 
@@ -129,7 +131,7 @@ void EventPoller::detach_fd(int fd) {
 }
 
 void EventPoller::poll_for_active_events_of_all_fds(
-    std::vector<PollableFileDescriptor *> &event_dispatchers
+    std::vector<PollableFileDescriptor *> &event_dispatchers, bool should_block
 ) {
     LOG_TRACE << "epoll_wait blocked";
 
@@ -141,7 +143,7 @@ void EventPoller::poll_for_active_events_of_all_fds(
             _epoll_fd,
             _event_array,
             static_cast<int>(_max_size_of_event_array),
-            -1
+            should_block ? -1 : 0
         );
 
         if (current_event_array_size == -1) {
@@ -177,4 +179,6 @@ void EventPoller::poll_for_active_events_of_all_fds(
     return;
 }
 
+#endif
+
 } // namespace xubinh_server
@@ -0,0 +1,855 @@
+#ifdef __USE_IO_URING_POLLER
+
+#include <algorithm>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "event_poller.h"
+#include "log_builder.h"
+
+namespace xubinh_server {
+
+namespace {
+
+// [NOTE]: the raw syscalls are used directly so that no extra dependency (e.g.
+// liburing) is introduced
+
+int _io_uring_setup(unsigned int entries, io_uring_params *params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int _io_uring_enter(
+    int ring_fd,
+    unsigned int to_submit,
+    unsigned int min_complete,
+    unsigned int flags
+) {
+    return static_cast<int>(::syscall(
+        __NR_io_uring_enter,
+        ring_fd,
+        to_submit,
+        min_complete,
+        flags,
+        nullptr,
+        0
+    ));
+}
+
+int _io_uring_register(
+    int ring_fd, unsigned int opcode, void *argument, unsigned int count
+) {
+    return static_cast<int>(
+        ::syscall(__NR_io_uring_register, ring_fd, opcode, argument, count)
+    );
+}
+
+void *_map_ring(int ring_fd, size_t size, off_t offset) {
+    auto address = ::mmap(
+        nullptr,
+        size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        ring_fd,
+        offset
+    );
+
+    if (address == MAP_FAILED) {
+        LOG_SYS_FATAL << "failed to map the io_uring ring, offset: " << offset;
+    }
+
+    return address;
+}
+
+} // namespace
+
+EventPoller::EventPoller() {
+    io_uring_params params;
+
+    ::memset(&params, 0, sizeof(params));
+
+    // - `SUBMIT_ALL`: keeps submitting after an entry fails so that a single
+    // bad fd does not stall the whole batch
+    // - `SINGLE_ISSUER` & `DEFER_TASKRUN`: the ring is only ever touched by the
+    // loop thread, so completions could be deferred until it asks for them
+    // with `IORING_ENTER_GETEVENTS`, which it must do even when not waiting
+    // - `TASKRUN_FLAG`: tells whether there are deferred completions to ask
+    // for, so that a non-blocking poll could skip the syscall when there are
+    // none
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL
+                   | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN
+                   | IORING_SETUP_TASKRUN_FLAG;
+    params.cq_entries = _NUMBER_OF_COMPLETION_QUEUE_ENTRIES;
+
+    _ring_fd = _io_uring_setup(_NUMBER_OF_SUBMISSION_QUEUE_ENTRIES, &params);
+
+    // falls back to the plainest setup for older kernels
+    if (_ring_fd == -1 && errno == EINVAL) {
+        LOG_WARN << "io_uring_setup rejected the flags, falling back to the "
+                    "default setup";
+
+        ::memset(&params, 0, sizeof(params));
+
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = _NUMBER_OF_COMPLETION_QUEUE_ENTRIES;
+
+        _ring_fd =
+            _io_uring_setup(_NUMBER_OF_SUBMISSION_QUEUE_ENTRIES, &params);
+    }
+
+    if (_ring_fd == -1) {
+        LOG_SYS_FATAL << "io_uring_setup failed";
+    }
+
+    if (!(params.features & IORING_FEAT_NODROP)) {
+        LOG_WARN << "completions might be dropped by the kernel if the "
+                    "completion queue overflows";
+    }
+
+    _submission_queue_ring_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    _completion_queue_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    bool is_single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+
+    if (is_single_mmap) {
+        _submission_queue_ring_size = _completion_queue_ring_size = std::max(
+            _submission_queue_ring_size, _completion_queue_ring_size
+        );
+    }
+
+    _submission_queue_ring =
+        _map_ring(_ring_fd, _submission_queue_ring_size, IORING_OFF_SQ_RING);
+
+    _completion_queue_ring = is_single_mmap ? _submission_queue_ring
+                                            : _map_ring(
+                                                  _ring_fd,
+                                                  _completion_queue_ring_size,
+                                                  IORING_OFF_CQ_RING
+                                              );
+
+    _submission_queue_entries_size = params.sq_entries * sizeof(io_uring_sqe);
+
+    _submission_queue_entries = static_cast<io_uring_sqe *>(_map_ring(
+        _ring_fd, _submission_queue_entries_size, IORING_OFF_SQES
+    ));
+
+    auto submission_queue_ring =
+        static_cast<char *>(_submission_queue_ring);
+
+    _submission_queue_head = reinterpret_cast<unsigned int *>(
+        submission_queue_ring + params.sq_off.head
+    );
+    _submission_queue_tail = reinterpret_cast<unsigned int *>(
+        submission_queue_ring + params.sq_off.tail
+    );
+    _submission_queue_flags = reinterpret_cast<unsigned int *>(
+        submission_queue_ring + params.sq_off.flags
+    );
+    _submission_queue_mask = *reinterpret_cast<unsigned int *>(
+        submission_queue_ring + params.sq_off.ring_mask
+    );
+    _submission_queue_local_tail = *_submission_queue_tail;
+    _number_of_submission_queue_entries = params.sq_entries;
+
+    // the indirection array is filled once with an identity mapping so that
+    // the n-th entry is always the one being submitted at the n-th slot
+    auto submission_queue_array = reinterpret_cast<unsigned int *>(
+        submission_queue_ring + params.sq_off.array
+    );
+
+    for (unsigned int i = 0; i < params.sq_entries; i++) {
+        submission_queue_array[i] = i;
+    }
+
+    auto completion_queue_ring =
+        static_cast<char *>(_completion_queue_ring);
+
+    _completion_queue_head = reinterpret_cast<unsigned int *>(
+        completion_queue_ring + params.cq_off.head
+    );
+    _completion_queue_tail = reinterpret_cast<unsigned int *>(
+        completion_queue_ring + params.cq_off.tail
+    );
+    _completion_queue_mask = *reinterpret_cast<unsigned int *>(
+        completion_queue_ring + params.cq_off.ring_mask
+    );
+    _completion_queue_entries = reinterpret_cast<io_uring_cqe *>(
+        completion_queue_ring + params.cq_off.cqes
+    );
+
+    // the buffer ring lives in page-aligned memory shared with the kernel,
+    // while the buffers themselves could be anywhere
+    _provided_buffer_ring_size =
+        _NUMBER_OF_PROVIDED_BUFFERS * sizeof(io_uring_buf);
+
+    auto provided_buffer_ring = ::mmap(
+        nullptr,
+        _provided_buffer_ring_size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0
+    );
+
+    if (provided_buffer_ring == MAP_FAILED) {
+        LOG_SYS_FATAL << "failed to allocate the provided buffer ring";
+    }
+
+    io_uring_buf_reg provided_buffer_ring_registration;
+
+    ::memset(
+        &provided_buffer_ring_registration,
+        0,
+        sizeof(provided_buffer_ring_registration)
+    );
+
+    provided_buffer_ring_registration.ring_addr =
+        reinterpret_cast<uint64_t>(provided_buffer_ring);
+    provided_buffer_ring_registration.ring_entries =
+        _NUMBER_OF_PROVIDED_BUFFERS;
+    provided_buffer_ring_registration.bgid = _PROVIDED_BUFFER_GROUP_ID;
+
+    if (_io_uring_register(
+            _ring_fd,
+            IORING_REGISTER_PBUF_RING,
+            &provided_buffer_ring_registration,
+            1
+        )
+        == -1) {
+
+        LOG_WARN << "provided buffer rings are not supported, the connections "
+                    "will be watched for readiness instead, errno: "
+                 << errno;
+
+        ::munmap(provided_buffer_ring, _provided_buffer_ring_size);
+    }
+
+    else {
+        _provided_buffer_ring =
+            static_cast<io_uring_buf_ring *>(provided_buffer_ring);
+
+        _provided_buffers =
+            new char[_NUMBER_OF_PROVIDED_BUFFERS * _PROVIDED_BUFFER_SIZE];
+
+        for (unsigned int i = 0; i < _NUMBER_OF_PROVIDED_BUFFERS; i++) {
+            recycle_provided_buffer(static_cast<uint16_t>(i));
+        }
+    }
+
+    _max_number_of_registrations =
+        get_limit_of_max_number_of_opened_file_descriptors_per_process();
+
+    _registrations = new Registration[_max_number_of_registrations]{};
+    _fds_that_are_listening_on =
+        new bool[_max_number_of_registrations]{false};
+}
+
+EventPoller::~EventPoller() {
+    if (_number_of_fds_that_are_listening_on) {
+        LOG_WARN << "poller closed while there are still fds being listened on";
+    }
+
+    ::munmap(_submission_queue_entries, _submission_queue_entries_size);
+
+    if (_completion_queue_ring != _submission_queue_ring) {
+        ::munmap(_completion_queue_ring, _completion_queue_ring_size);
+    }
+
+    ::munmap(_submission_queue_ring, _submission_queue_ring_size);
+
+    // all pending requests are cancelled by the kernel
+    ::close(_ring_fd);
+
+    if (_provided_buffer_ring) {
+        ::munmap(_provided_buffer_ring, _provided_buffer_ring_size);
+
+        delete[] _provided_buffers;
+    }
+
+    delete[] _fds_that_are_listening_on;
+    delete[] _registrations;
+}
+
+void EventPoller::register_event_for_fd(int fd, const epoll_event *event) {
+    bool is_attached = _fds_that_are_listening_on[fd];
+
+    auto &registration = _registrations[fd];
+
+    auto old_events = registration.events;
+
+    auto old_poll_events = _get_poll_events(registration);
+
+    registration.event_dispatcher =
+        static_cast<PollableFileDescriptor *>(event->data.ptr);
+    registration.events = event->events;
+
+    if (!is_attached) {
+        registration.read_mode = registration.event_dispatcher->get_read_mode();
+
+        if (registration.read_mode == ReadMode::READ_MODE_MULTISHOT_RECEIVE
+            && !_provided_buffer_ring) {
+
+            registration.read_mode = ReadMode::READ_MODE_READINESS;
+
+            registration.event_dispatcher->set_read_mode(registration.read_mode
+            );
+        }
+
+        registration.is_read_request_armed = false;
+        registration.is_read_request_cancelled = false;
+
+        _prepare_poll_add(fd);
+
+        _fds_that_are_listening_on[fd] = true;
+        _number_of_fds_that_are_listening_on += 1;
+    }
+
+    else if (old_events != registration.events
+             && old_poll_events != _get_poll_events(registration)) {
+
+        _prepare_poll_update(fd);
+    }
+
+    bool should_be_read = _should_be_read(registration);
+
+    // [NOTE]: a request that is still being cancelled is re-armed by its
+    // terminating completion instead, if the fd is read again by then
+    if (should_be_read && !registration.is_read_request_armed) {
+        _prepare_read_request(fd);
+    }
+
+    else if (!should_be_read && registration.is_read_request_armed
+             && !registration.is_read_request_cancelled) {
+
+        _prepare_read_request_cancel(fd);
+    }
+
+    // the results that arrived while not being read, e.g. during a pause, are
+    // handed over by the next poll
+    if (should_be_read && is_attached && !(old_events & EPOLLIN)
+        && !registration.event_dispatcher->get_completions().empty()) {
+
+        _fds_with_held_read_completions.push_back(fd);
+    }
+}
+
+void EventPoller::detach_fd(int fd) {
+    bool is_attached = _fds_that_are_listening_on[fd];
+
+    if (!is_attached) {
+        LOG_WARN << "try to detach a fd that is not yet attached";
+
+        return;
+    }
+
+    auto &registration = _registrations[fd];
+
+    _prepare_poll_remove(fd);
+
+    if (registration.is_read_request_armed
+        && !registration.is_read_request_cancelled) {
+
+        _prepare_read_request_cancel(fd);
+    }
+
+    // any completion of the removed requests still on its way becomes stale
+    registration.generation += 1;
+    registration.read_generation += 1;
+
+    // the results the owner is not going to take anymore
+    if (registration.read_mode != ReadMode::READ_MODE_READINESS) {
+        auto &completions = registration.event_dispatcher->get_completions();
+
+        for (const auto &completion : completions) {
+            _discard_read_completion(
+                registration.read_mode, completion.result, completion.flags
+            );
+        }
+
+        completions.clear();
+    }
+
+    _fds_that_are_listening_on[fd] = false;
+    _number_of_fds_that_are_listening_on -= 1;
+}
+
+void EventPoller::poll_for_active_events_of_all_fds(
+    std::vector<PollableFileDescriptor *> &event_dispatchers, bool should_block
+) {
+    event_dispatchers.clear();
+
+    // the buffers consumed since the last poll are handed back to the kernel
+    // before the receive requests out of buffers are re-armed
+    if (_provided_buffer_ring) {
+        __atomic_store_n(
+            &_provided_buffer_ring->tail,
+            _provided_buffer_ring_local_tail,
+            __ATOMIC_RELEASE
+        );
+    }
+
+    // the results held before should not wait for new completions
+    if (should_block && _fds_with_held_read_completions.empty()) {
+        LOG_TRACE << "io_uring_enter blocked";
+
+        // registration changes made since the last poll are submitted here as
+        // well, within the same syscall
+        _submit_and_wait(1);
+
+        LOG_TRACE << "io_uring_enter resume";
+    }
+
+    // the completion queue is shared memory, so a non-blocking poll only
+    // needs a syscall if there are registration changes to submit or deferred
+    // completions to be posted (see the setup flags), in which case it asks
+    // for the completions without waiting for any
+    //
+    // - without `DEFER_TASKRUN` (i.e. the fallback setup), completions are
+    // posted by the kernel on its own and the flag is never raised
+    else if (_number_of_pending_submissions > 0
+             || (__atomic_load_n(_submission_queue_flags, __ATOMIC_RELAXED)
+                 & IORING_SQ_TASKRUN)) {
+
+        _submit_and_wait(0, true);
+    }
+
+    // only the loop thread advances the head
+    auto head = *_completion_queue_head;
+    auto tail = __atomic_load_n(_completion_queue_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++head) {
+        _handle_completion(
+            _completion_queue_entries[head & _completion_queue_mask],
+            event_dispatchers
+        );
+    }
+
+    __atomic_store_n(_completion_queue_head, head, __ATOMIC_RELEASE);
+
+    _add_held_read_completions(event_dispatchers);
+
+    // multiple completions of the same fd are merged into a single dispatch
+    for (auto event_dispatcher_ptr : event_dispatchers) {
+        auto &registration = _registrations[event_dispatcher_ptr->get_fd()];
+
+        event_dispatcher_ptr->set_active_events(registration.active_events);
+
+        registration.active_events = 0;
+    }
+}
+
+void EventPoller::recycle_provided_buffer(uint16_t buffer_id) {
+    // [NOTE]: the entries are not reached through `bufs` of the ring, which is
+    // wrapped together with an empty struct that takes up space in C++; the
+    // fields are set one by one since the tail of the ring overlays the
+    // reserved field of the first entry
+    auto &provided_buffer =
+        reinterpret_cast<io_uring_buf *>(_provided_buffer_ring)
+            [_provided_buffer_ring_local_tail
+             & (_NUMBER_OF_PROVIDED_BUFFERS - 1)];
+
+    provided_buffer.addr =
+        reinterpret_cast<uint64_t>(get_provided_buffer(buffer_id));
+    provided_buffer.len = static_cast<uint32_t>(_PROVIDED_BUFFER_SIZE);
+    provided_buffer.bid = buffer_id;
+
+    // not visible to the kernel until being published by the next poll
+    _provided_buffer_ring_local_tail += 1;
+}
+
+io_uring_sqe *EventPoller::_get_submission_queue_entry() {
+    if (_submission_queue_local_tail
+            - __atomic_load_n(_submission_queue_head, __ATOMIC_ACQUIRE)
+        == _number_of_submission_queue_entries) {
+
+        _submit_and_wait(0);
+    }
+
+    auto submission_queue_entry = &_submission_queue_entries
+        [_submission_queue_local_tail & _submission_queue_mask];
+
+    ::memset(submission_queue_entry, 0, sizeof(io_uring_sqe));
+
+    // not visible to the kernel until being published by `_submit_and_wait`
+    _submission_queue_local_tail += 1;
+    _number_of_pending_submissions += 1;
+
+    return submission_queue_entry;
+}
+
+void EventPoller::_prepare_poll_add(int fd) {
+    const auto &registration = _registrations[fd];
+
+    auto submission_queue_entry = _get_submission_queue_entry();
+
+    submission_queue_entry->opcode = IORING_OP_POLL_ADD;
+    submission_queue_entry->fd = fd;
+
+    // [NOTE]: multishot poll requests are always edge-triggered, so
+    // level-triggered fds are watched by oneshot requests instead, which are
+    // rearmed after each completion and fire again immediately if the fd is
+    // still ready
+    submission_queue_entry->len =
+        (registration.events & EPOLLET) ? IORING_POLL_ADD_MULTI : 0;
+
+    submission_queue_entry->poll32_events =
+        _get_poll_events(registration) & ~EPOLLET;
+    submission_queue_entry->user_data = _make_user_data(
+        fd, registration.generation, ReadMode::READ_MODE_READINESS
+    );
+}
+
+void EventPoller::_prepare_poll_remove(int fd) {
+    auto submission_queue_entry = _get_submission_queue_entry();
+
+    submission_queue_entry->opcode = IORING_OP_POLL_REMOVE;
+    submission_queue_entry->addr = _make_user_data(
+        fd, _registrations[fd].generation, ReadMode::READ_MODE_READINESS
+    );
+    submission_queue_entry->user_data = _INTERNAL_USER_DATA;
+}
+
+void EventPoller::_prepare_poll_update(int fd) {
+    auto &registration = _registrations[fd];
+
+    // oneshot requests are simply replaced as a whole
+    if (!(registration.events & EPOLLET)) {
+        _prepare_poll_remove(fd);
+
+        registration.generation += 1;
+
+        _prepare_poll_add(fd);
+
+        return;
+    }
+
+    auto submission_queue_entry = _get_submission_queue_entry();
+
+    submission_queue_entry->opcode = IORING_OP_POLL_REMOVE;
+    submission_queue_entry->len =
+        IORING_POLL_UPDATE_EVENTS | IORING_POLL_ADD_MULTI;
+    submission_queue_entry->poll32_events =
+        _get_poll_events(registration) & ~EPOLLET;
+    submission_queue_entry->addr = _make_user_data(
+        fd, registration.generation, ReadMode::READ_MODE_READINESS
+    );
+    submission_queue_entry->user_data = _INTERNAL_USER_DATA;
+}
+
+void EventPoller::_prepare_read_request(int fd) {
+    auto &registration = _registrations[fd];
+
+    auto submission_queue_entry = _get_submission_queue_entry();
+
+    submission_queue_entry->fd = fd;
+
+    // keeps producing completions, one for each new connection or each piece
+    // of data received, until being cancelled or terminated by the kernel
+    if (registration.read_mode == ReadMode::READ_MODE_MULTISHOT_ACCEPT) {
+        submission_queue_entry->opcode = IORING_OP_ACCEPT;
+        submission_queue_entry->ioprio = IORING_ACCEPT_MULTISHOT;
+
+        // same as `ListenSocketfd`, since TCP socketfds are always at ET mode
+        submission_queue_entry->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    }
+
+    else {
+        submission_queue_entry->opcode = IORING_OP_RECV;
+        submission_queue_entry->ioprio = IORING_RECV_MULTISHOT;
+        submission_queue_entry->flags = IOSQE_BUFFER_SELECT;
+        submission_queue_entry->buf_group = _PROVIDED_BUFFER_GROUP_ID;
+    }
+
+    submission_queue_entry->user_data = _make_user_data(
+        fd, registration.read_generation, registration.read_mode
+    );
+
+    registration.is_read_request_armed = true;
+    registration.is_read_request_cancelled = false;
+}
+
+void EventPoller::_prepare_read_request_cancel(int fd) {
+    auto &registration = _registrations[fd];
+
+    auto submission_queue_entry = _get_submission_queue_entry();
+
+    submission_queue_entry->opcode = IORING_OP_ASYNC_CANCEL;
+    submission_queue_entry->addr = _make_user_data(
+        fd, registration.read_generation, registration.read_mode
+    );
+    submission_queue_entry->user_data = _INTERNAL_USER_DATA;
+
+    // [NOTE]: the results still on their way are kept, since the data (or the
+    // connections) they carry is already taken from the kernel
+    registration.is_read_request_cancelled = true;
+}
+
+void EventPoller::_submit_and_wait(
+    unsigned int min_number_of_completions, bool should_get_events
+) {
+    // publishes the entries filled so far
+    __atomic_store_n(
+        _submission_queue_tail, _submission_queue_local_tail, __ATOMIC_RELEASE
+    );
+
+    unsigned int flags = min_number_of_completions > 0 || should_get_events
+                             ? IORING_ENTER_GETEVENTS
+                             : 0;
+
+    // might be interrupted by signal handlers, so make a loop for it
+    while (true) {
+        int number_of_entries_submitted = _io_uring_enter(
+            _ring_fd,
+            _number_of_pending_submissions,
+            min_number_of_completions,
+            flags
+        );
+
+        if (number_of_entries_submitted >= 0) {
+            _number_of_pending_submissions -= std::min(
+                _number_of_pending_submissions,
+                static_cast<unsigned int>(number_of_entries_submitted)
+            );
+
+            // some entries might be left unsubmitted only if the kernel ran
+            // out of memory, in which case they are retried on the next call
+            if (_number_of_pending_submissions == 0
+                || min_number_of_completions > 0) {
+
+                break;
+            }
+
+            continue;
+        }
+
+        if (errno == EINTR) {
+            LOG_TRACE << "io_uring_enter got interrupted by signal handlers";
+
+            // completions might already be there
+            if (min_number_of_completions > 0) {
+                break;
+            }
+
+            continue;
+        }
+
+        // the completion queue is overflown and must be reaped first
+        if (errno == EBUSY || errno == EAGAIN) {
+            LOG_WARN << "io_uring completion queue is full";
+
+            break;
+        }
+
+        LOG_SYS_FATAL << "io_uring_enter failed";
+    }
+}
+
+void EventPoller::_handle_completion(
+    const io_uring_cqe &completion_queue_entry,
+    std::vector<PollableFileDescriptor *> &event_dispatchers
+) {
+    auto user_data = completion_queue_entry.user_data;
+    auto result = completion_queue_entry.res;
+
+    if (user_data == _INTERNAL_USER_DATA) {
+        // the target request might have already been terminated on its own
+        if (result < 0 && result != -ENOENT && result != -EALREADY) {
+            LOG_ERROR << "io_uring poll removal failed, errno: " << -result;
+        }
+
+        return;
+    }
+
+    int fd = static_cast<int>(user_data & 0xffffffff);
+    auto generation = static_cast<uint32_t>(user_data >> 32) & _GENERATION_MASK;
+    auto request_kind = static_cast<ReadMode>(user_data >> 62);
+
+    if (request_kind != ReadMode::READ_MODE_READINESS) {
+        _handle_read_completion(
+            fd, generation, completion_queue_entry, event_dispatchers
+        );
+
+        return;
+    }
+
+    auto &registration = _registrations[fd];
+
+    // completions of the requests that are already removed or replaced
+    if (!_fds_that_are_listening_on[fd]
+        || (registration.generation & _GENERATION_MASK) != generation) {
+
+        return;
+    }
+
+    bool is_terminated = !(completion_queue_entry.flags & IORING_CQE_F_MORE);
+
+    uint32_t active_events;
+
+    if (result >= 0) {
+        active_events = static_cast<uint32_t>(result);
+
+        // besides oneshot requests, multishot ones are also terminated by the
+        // kernel from time to time (e.g. when running out of resources)
+        if (is_terminated) {
+            _prepare_poll_add(fd);
+        }
+    }
+
+    else if (result == -ECANCELED) {
+        _prepare_poll_add(fd);
+
+        return;
+    }
+
+    else {
+        LOG_ERROR << "io_uring poll failed, fd: " << fd
+                  << ", errno: " << -result;
+
+        active_events = EPOLLERR;
+    }
+
+    _add_active_events(registration, active_events, event_dispatchers);
+}
+
+void EventPoller::_handle_read_completion(
+    int fd,
+    uint32_t generation,
+    const io_uring_cqe &completion_queue_entry,
+    std::vector<PollableFileDescriptor *> &event_dispatchers
+) {
+    auto user_data = completion_queue_entry.user_data;
+    auto result = completion_queue_entry.res;
+    auto flags = completion_queue_entry.flags;
+
+    auto &registration = _registrations[fd];
+
+    // results of the requests that are already cancelled, which are still
+    // holding on to the resources
+    if (!_fds_that_are_listening_on[fd]
+        || (registration.read_generation & _GENERATION_MASK) != generation) {
+
+        _discard_read_completion(
+            static_cast<ReadMode>(user_data >> 62), result, flags
+        );
+
+        return;
+    }
+
+    bool is_terminated = !(flags & IORING_CQE_F_MORE);
+
+    if (is_terminated) {
+        registration.is_read_request_armed = false;
+        registration.is_read_request_cancelled = false;
+    }
+
+    bool should_be_rearmed = is_terminated && _should_be_read(registration);
+
+    // - the receive request ran out of buffers, which will have been given
+    // back by the time it is submitted again in the next poll
+    // - a cancelled request is only re-armed if the fd is read again by now
+    if (result == -ENOBUFS || result == -ECANCELED) {
+        if (should_be_rearmed) {
+            _prepare_read_request(fd);
+        }
+
+        return;
+    }
+
+    // the kernel does not support the request (or its flags), so the readable
+    // side is watched by the poll request from now on
+    if (result == -EINVAL) {
+        LOG_WARN << "multishot accept or receive is not supported, falling back "
+                    "to polling for readiness, fd: "
+                 << fd;
+
+        registration.read_mode = ReadMode::READ_MODE_READINESS;
+        registration.read_generation += 1;
+        registration.is_read_request_armed = false;
+        registration.is_read_request_cancelled = false;
+
+        registration.event_dispatcher->set_read_mode(registration.read_mode);
+
+        _prepare_poll_update(fd);
+
+        return;
+    }
+
+    // - accept requests go on after errors, e.g. `EMFILE`, just like polling
+    // a level-triggered listen socketfd
+    // - receive requests end for good on EOF or errors
+    if (should_be_rearmed
+        && (registration.read_mode == ReadMode::READ_MODE_MULTISHOT_ACCEPT
+            || result > 0)) {
+
+        _prepare_read_request(fd);
+    }
+
+    registration.event_dispatcher->get_completions().push_back({result, flags}
+    );
+
+    // held until the fd is read again if it is paused (or stopped being read)
+    // in the meantime
+    if (registration.events & EPOLLIN) {
+        _add_active_events(registration, EPOLLIN, event_dispatchers);
+    }
+}
+
+void EventPoller::_discard_read_completion(
+    ReadMode read_mode, int32_t result, uint32_t flags
+) {
+    if (read_mode == ReadMode::READ_MODE_MULTISHOT_ACCEPT && result >= 0) {
+        ::close(result);
+    }
+
+    else if (read_mode == ReadMode::READ_MODE_MULTISHOT_RECEIVE
+             && (flags & IORING_CQE_F_BUFFER)) {
+
+        recycle_provided_buffer(
+            static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT)
+        );
+    }
+}
+
+void EventPoller::_add_active_events(
+    Registration &registration,
+    uint32_t active_events,
+    std::vector<PollableFileDescriptor *> &event_dispatchers
+) {
+    if (active_events == 0) {
+        return;
+    }
+
+    if (registration.active_events == 0) {
+        event_dispatchers.push_back(registration.event_dispatcher);
+    }
+
+    registration.active_events |= active_events;
+}
+
+void EventPoller::_add_held_read_completions(
+    std::vector<PollableFileDescriptor *> &event_dispatchers
+) {
+    for (auto fd : _fds_with_held_read_completions) {
+        auto &registration = _registrations[fd];
+
+        // might have been detached or paused again since
+        if (!_fds_that_are_listening_on[fd]
+            || !(registration.events & EPOLLIN)
+            || registration.event_dispatcher->get_completions().empty()) {
+
+            continue;
+        }
+
+        _add_active_events(registration, EPOLLIN, event_dispatchers);
+    }
+
+    _fds_with_held_read_completions.clear();
+}
+
+} // namespace xubinh_server
+
+#endif
@@ -1,4 +1,5 @@
 #include <fcntl.h>
+#include <linux/filter.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -23,6 +24,84 @@ void ListenSocketfd::set_socketfd_as_address_reusable(int socketfd) {
     }
 }
 
+void ListenSocketfd::set_socketfd_as_port_reusable(int socketfd) {
+    int set = 1;
+
+    if (::setsockopt(
+            socketfd,
+            SOL_SOCKET,
+            SO_REUSEPORT,
+            &set,
+            static_cast<socklen_t>(sizeof set)
+        )
+        == -1) {
+
+        LOG_SYS_FATAL << "failed when setting SO_REUSEPORT to a socketfd";
+    }
+}
+
+bool ListenSocketfd::attach_cpu_steering_program_to_reuse_port_group(
+    int socketfd, const std::vector<int> &cpus_of_socketfds
+) {
+    auto number_of_socketfds_in_group = cpus_of_socketfds.size();
+
+    // A = current CPU; if A == cpu_i return i (for each i); A = A % N; return A
+    std::vector<sock_filter> code;
+
+    code.reserve(1 + 2 * number_of_socketfds_in_group + 2);
+
+    code.push_back(
+        {BPF_LD | BPF_W | BPF_ABS,
+         0,
+         0,
+         static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)}
+    );
+
+    for (size_t i = 0; i < number_of_socketfds_in_group; i++) {
+        code.push_back(
+            {BPF_JMP | BPF_JEQ | BPF_K,
+             0,
+             1,
+             static_cast<uint32_t>(cpus_of_socketfds[i])}
+        );
+        code.push_back({BPF_RET | BPF_K, 0, 0, static_cast<uint32_t>(i)});
+    }
+
+    code.push_back(
+        {BPF_ALU | BPF_MOD | BPF_K,
+         0,
+         0,
+         static_cast<uint32_t>(number_of_socketfds_in_group)}
+    );
+    code.push_back({BPF_RET | BPF_A, 0, 0, 0});
+
+    if (code.size() > BPF_MAXINSNS) {
+        LOG_ERROR << "too many socketfds for the CPU steering program: "
+                  << number_of_socketfds_in_group;
+
+        return false;
+    }
+
+    sock_fprog program{static_cast<unsigned short>(code.size()), code.data()};
+
+    if (::setsockopt(
+            socketfd,
+            SOL_SOCKET,
+            SO_ATTACH_REUSEPORT_CBPF,
+            &program,
+            static_cast<socklen_t>(sizeof program)
+        )
+        == -1) {
+
+        LOG_SYS_ERROR << "failed when attaching CPU steering program to a "
+                         "reuseport group";
+
+        return false;
+    }
+
+    return true;
+}
+
 void ListenSocketfd::bind(int socketfd, const InetAddress &local_address) {
     if (::bind(
             socketfd,
@@ -66,6 +145,14 @@ void ListenSocketfd::start() {
 
     _open_spare_fd();
 
+#ifdef __USE_IO_URING_POLLER
+    // the new connections are accepted by the kernel as they come in, and
+    // handed over as completions
+    _pollable_file_descriptor.set_read_mode(
+        PollableFileDescriptor::READ_MODE_MULTISHOT_ACCEPT
+    );
+#endif
+
     _pollable_file_descriptor.enable_read_event();
 }
 
@@ -150,6 +237,20 @@ void ListenSocketfd::_read_event_callback(util::TimePoint time_stamp) {
         return;
     }
 
+#ifdef __USE_IO_URING_POLLER
+    if (_pollable_file_descriptor.get_read_mode()
+        == PollableFileDescriptor::READ_MODE_MULTISHOT_ACCEPT) {
+
+        _finish_accept_batch(_accept_all_completed_connections(time_stamp));
+
+        LOG_TRACE << "exiting ListenSocketfd::_read_event_callback";
+
+        return;
+    }
+#endif
+
+    uint64_t number_of_accepted_connections = 0;
+
     for (int i = 0; i < _max_number_of_new_connections_at_a_time; i++) {
         LOG_TRACE << "accepting next connection...";
 
@@ -164,6 +265,8 @@ void ListenSocketfd::_read_event_callback(util::TimePoint time_stamp) {
             LOG_TRACE << "connection OK, connect socketfd: "
                       << connect_socketfd;
 
+            ++number_of_accepted_connections;
+
             _new_connection_callback(
                 connect_socketfd, *peer_address_ptr, time_stamp
             );
@@ -212,9 +315,95 @@ void ListenSocketfd::_read_event_callback(util::TimePoint time_stamp) {
         }
     }
 
+    _finish_accept_batch(number_of_accepted_connections);
+
     LOG_TRACE << "exiting ListenSocketfd::_read_event_callback";
 }
 
-int ListenSocketfd::_max_number_of_new_connections_at_a_time = 1000;
+#ifdef __USE_IO_URING_POLLER
+uint64_t
+ListenSocketfd::_accept_all_completed_connections(util::TimePoint time_stamp) {
+    auto &completions = _pollable_file_descriptor.get_completions();
+
+    uint64_t number_of_accepted_connections = 0;
+
+    for (const auto &completion : completions) {
+        // error
+        if (completion.result < 0) {
+            errno = -completion.result;
+
+            // the connection was aborted by the peer, or there are too many
+            // open files, in which case the kernel keeps accepting and
+            // reporting it just like a level-triggered readiness
+            if (errno == ECONNABORTED || errno == EMFILE || errno == ENFILE) {
+                LOG_TRACE << "error: " << errno << "; skipping";
+
+                continue;
+            }
+
+            LOG_SYS_FATAL << "unknown error";
+        }
+
+        auto connect_socketfd = completion.result;
+
+        // the peer address is not given by multishot accepts
+        sockaddr_storage peer_address_temp{};
+        socklen_t peer_address_temp_len = sizeof(sockaddr_storage);
+
+        if (::getpeername(
+                connect_socketfd,
+                reinterpret_cast<sockaddr *>(&peer_address_temp),
+                &peer_address_temp_len
+            )
+            == -1) {
+
+            LOG_TRACE << "connection reset before being handed over, connect "
+                         "socketfd: "
+                      << connect_socketfd;
+
+            ::close(connect_socketfd);
+
+            continue;
+        }
+
+        LOG_TRACE << "connection OK, connect socketfd: " << connect_socketfd;
+
+        ++number_of_accepted_connections;
+
+        _new_connection_callback(
+            connect_socketfd,
+            InetAddress(
+                reinterpret_cast<sockaddr *>(&peer_address_temp),
+                peer_address_temp_len
+            ),
+            time_stamp
+        );
+    }
+
+    completions.clear();
+
+    return number_of_accepted_connections;
+}
+#endif
+
+void ListenSocketfd::_finish_accept_batch(
+    uint64_t number_of_accepted_connections
+) {
+    if (number_of_accepted_connections > 0) {
+        _number_of_accepted_connections.store(
+            _number_of_accepted_connections.load(std::memory_order_relaxed)
+                + number_of_accepted_connections,
+            std::memory_order_relaxed
+        );
+        _number_of_accept_batches.store(
+            _number_of_accept_batches.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed
+        );
+
+        if (_accept_batch_end_callback) {
+            _accept_batch_end_callback();
+        }
+    }
+}
 
 } // namespace xubinh_server
\ No newline at end of file
@@ -61,7 +61,7 @@ LogBuilder::~LogBuilder() {
 }
 
 // definition
-template <typename T, typename = LogBuilder::enable_for_integer_types<T>>
+template <typename T, typename>
 LogBuilder &LogBuilder::operator<<(T integer) {
     if (_entry_buffer.length_of_spare() > _get_number_of_chars<T>()) {
         _entry_buffer.increment_length(
@@ -75,7 +75,9 @@ void PollableFileDescriptor::enable_read_event() {
 
     _is_reading = true;
 
-    _event.events |= EventPoller::EVENT_TYPE_READ;
+    if (!_is_read_paused) {
+        _event.events |= EventPoller::EVENT_TYPE_READ;
+    }
 
     _register_event();
 }
@@ -116,6 +118,48 @@ void PollableFileDescriptor::disable_write_event() {
     _register_event();
 }
 
+void PollableFileDescriptor::pause_read_event() {
+    if (_is_read_paused) {
+        return;
+    }
+
+    _is_read_paused = true;
+
+    if (!_is_reading || _is_detached) {
+        return;
+    }
+
+    _event.events &= ~EventPoller::EVENT_TYPE_READ;
+
+    _register_event();
+}
+
+void PollableFileDescriptor::resume_read_event() {
+    if (!_is_read_paused) {
+        return;
+    }
+
+    _is_read_paused = false;
+
+    if (!_is_reading || _is_detached) {
+        return;
+    }
+
+    // [NOTE]: re-registering re-arms the edge, so the data that arrived while
+    // being paused is reported right away
+    _event.events |= EventPoller::EVENT_TYPE_READ;
+
+    _register_event();
+}
+
+void PollableFileDescriptor::attach_to_poller() {
+    if (!_is_detached) {
+        return;
+    }
+
+    _register_event();
+}
+
 void PollableFileDescriptor::detach_from_poller() {
     if (_is_detached) {
         return;
@@ -125,6 +169,7 @@ void PollableFileDescriptor::detach_from_poller() {
 
     _is_reading = false;
     _is_writing = false;
+    _is_read_paused = false;
 
     _event.events = _initial_epoll_event;
 
@@ -169,6 +214,34 @@ void PollableFileDescriptor::reset_to(int new_fd) {
     _fd = new_fd;
 }
 
+void PollableFileDescriptor::reuse_for(int new_fd) {
+    if (new_fd < 0) {
+        LOG_SYS_FATAL << "invalid file descriptor (must be non-negative)";
+    }
+
+    if (!_is_detached) {
+        LOG_FATAL << "tried to reuse an attached file descriptor";
+    }
+
+    _fd = new_fd;
+
+    _event.events = _initial_epoll_event;
+    _active_events = 0;
+
+    // might be holding on to the resources of the previous owner
+    _read_event_callback = {};
+    _write_event_callback = {};
+    _close_event_callback = {};
+    _error_event_callback = {};
+    _weak_lifetime_guard.reset();
+    _is_weak_lifetime_guard_registered = false;
+
+#ifdef __USE_IO_URING_POLLER
+    // the results left are already discarded by the poller when detaching
+    _read_mode = READ_MODE_READINESS;
+#endif
+}
+
 void PollableFileDescriptor::_register_event() {
     _is_detached = false;
 
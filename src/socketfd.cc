@@ -5,6 +5,11 @@
 #include "log_builder.h"
 #include "socketfd.h"
 
+// added in Linux 5.11
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
 namespace xubinh_server {
 
 int Socketfd::create_socketfd() {
@@ -47,4 +52,40 @@ void Socketfd::disable_socketfd_nagle_algorithm(int socketfd) {
     }
 }
 
+bool Socketfd::enable_socketfd_busy_polling(
+    int socketfd, int busy_poll_microseconds
+) {
+    if (::setsockopt(
+            socketfd,
+            SOL_SOCKET,
+            SO_BUSY_POLL,
+            &busy_poll_microseconds,
+            static_cast<socklen_t>(sizeof busy_poll_microseconds)
+        )
+        == -1) {
+
+        LOG_DEBUG << "failed to set SO_BUSY_POLL, errno: " << errno;
+
+        return false;
+    }
+
+    int set = 1;
+
+    if (::setsockopt(
+            socketfd,
+            SOL_SOCKET,
+            SO_PREFER_BUSY_POLL,
+            &set,
+            static_cast<socklen_t>(sizeof set)
+        )
+        == -1) {
+
+        LOG_DEBUG << "failed to set SO_PREFER_BUSY_POLL, errno: " << errno;
+
+        return false;
+    }
+
+    return true;
+}
+
 } // namespace xubinh_server
\ No newline at end of file
@@ -1,74 +1,142 @@
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+#include "log_builder.h"
 #include "tcp_buffer.h"
+#include "util/alignment.h"
+#include "util/delimiter_scan.h"
 
 namespace xubinh_server {
 
-const char *MutableSizeTcpBuffer::get_next_newline_position() {
-    if (__builtin_expect(_read_offset >= _write_offset, false)) {
+template <typename FinderType>
+const char *MutableSizeTcpBuffer::_find_resumably(
+    size_t &scan_offset, size_t delimiter_size, FinderType finder
+) {
+    auto begin_offset = std::max(scan_offset, _read_offset);
+
+    if (begin_offset >= _write_offset) {
         return nullptr;
     }
 
-    // [TODO]: optimize this, e.g. starts from where previously left
-    for (auto i = _read_offset; i < _write_offset; i++) {
-        if (_volatile_buffer_begin_ptr[i] == '\n') {
-            return _volatile_buffer_begin_ptr + i;
-        }
+    auto position = finder(
+        _volatile_buffer_begin_ptr + begin_offset,
+        _volatile_buffer_begin_ptr + _write_offset
+    );
+
+    if (position) {
+        scan_offset =
+            static_cast<size_t>(position - _volatile_buffer_begin_ptr);
+
+        return position;
     }
 
+    // the last few bytes might be the beginning of a delimiter that is not
+    // fully received yet
+    scan_offset = std::max(
+        _read_offset,
+        _write_offset - std::min(_write_offset, delimiter_size - 1)
+    );
+
     return nullptr;
 }
 
-const char *MutableSizeTcpBuffer::get_next_crlf_position() {
-    if (__builtin_expect(_read_offset >= _write_offset, false)) {
-        return nullptr;
-    }
-
-    // [TODO]: optimize this, e.g. starts from where previously left
-    for (auto i = _read_offset; i < _write_offset - 1; i++) {
-        if (_volatile_buffer_begin_ptr[i] == '\r'
-            && _volatile_buffer_begin_ptr[i + 1] == '\n') {
+const char *MutableSizeTcpBuffer::get_next_newline_position() {
+    return _find_resumably(
+        _newline_scan_offset,
+        1,
+        [](const char *begin, const char *end) {
+            return util::delimiter_scan::find_byte(begin, end, '\n');
+        }
+    );
+}
 
-            return _volatile_buffer_begin_ptr + i;
+const char *MutableSizeTcpBuffer::get_next_crlf_position() {
+    return _find_resumably(
+        _crlf_scan_offset,
+        2,
+        [](const char *begin, const char *end) {
+            return util::delimiter_scan::find_byte_pair(
+                begin, end, '\r', '\n'
+            );
         }
-    }
+    );
+}
 
-    return nullptr;
+const char *MutableSizeTcpBuffer::get_next_double_crlf_position() {
+    return _find_resumably(
+        _double_crlf_scan_offset,
+        4,
+        [](const char *begin, const char *end) {
+            return util::delimiter_scan::find_sequence(
+                begin, end, "\r\n\r\n", 4
+            );
+        }
+    );
 }
 
-char *MutableSizeTcpBuffer::_make_space(size_t size) {
-    if (__builtin_expect(size == 0, false)) {
-        return nullptr;
-    }
+const char *MutableSizeTcpBuffer::get_next_delimiter_position(
+    const char *delimiter, size_t delimiter_size
+) const {
+    return util::delimiter_scan::find_sequence(
+        _volatile_buffer_begin_ptr + _read_offset,
+        _volatile_buffer_begin_ptr + _write_offset,
+        delimiter,
+        delimiter_size
+    );
+}
 
-    auto directly_extendable_size = _buffer.capacity() - _write_offset;
+void MutableSizeTcpBuffer::ensure_writable_size(size_t size) {
+    auto writable_size = get_writable_size();
 
     // if extendable at the end directly
-    if (size <= directly_extendable_size) {
-        _buffer.resize(_write_offset + size);
+    if (size <= writable_size) {
+        return;
     }
 
     // if extendable at the end after compaction
-    else if (size <= directly_extendable_size + _read_offset) {
+    if (size <= writable_size + _read_offset) {
         // do compaction
-        ::memcpy(
+        ::memmove(
             _volatile_buffer_begin_ptr,
             _volatile_buffer_begin_ptr + _read_offset,
             _write_offset - _read_offset
         );
         _write_offset -= _read_offset;
+
+        for (auto scan_offset_ptr :
+             {&_newline_scan_offset,
+              &_crlf_scan_offset,
+              &_double_crlf_scan_offset}) {
+
+            *scan_offset_ptr = *scan_offset_ptr > _read_offset
+                                   ? *scan_offset_ptr - _read_offset
+                                   : 0;
+        }
+
         _read_offset = 0;
 
-        _buffer.resize(_write_offset + size);
+        return;
     }
 
     // otherwise reallocates new memory buffer and skip compaction till the next
     // time
-    else {
-        _buffer.resize(_write_offset + size); // reallocation & copying
+    _buffer.resize(_write_offset + size); // reallocation & copying
+
+    // exposes the whole capacity (which grows geometrically) as spare space
+    _buffer.resize(_buffer.capacity());
 
-        _volatile_buffer_begin_ptr =
-            const_cast<char *>(_buffer.c_str()); // calibration
+    _volatile_buffer_begin_ptr =
+        const_cast<char *>(_buffer.c_str()); // calibration
+}
+
+char *MutableSizeTcpBuffer::_make_space(size_t size) {
+    if (__builtin_expect(size == 0, false)) {
+        return nullptr;
     }
 
+    ensure_writable_size(size);
+
     auto end_ptr_before_extension = _volatile_buffer_begin_ptr + _write_offset;
 
     _write_offset += size; // extension
@@ -76,4 +144,634 @@ char *MutableSizeTcpBuffer::_make_space(size_t size) {
     return end_ptr_before_extension;
 }
 
+void RingTcpBuffer::release() noexcept {
+    if (_mapped_address && ::munmap(_mapped_address, 2 * _capacity) == -1) {
+        LOG_SYS_ERROR << "failed to munmap the ring buffer";
+    }
+
+    if (_memfd != -1 && ::close(_memfd) == -1) {
+        LOG_SYS_ERROR << "failed to close the memfd of the ring buffer";
+    }
+
+    _memfd = -1;
+    _mapped_address = nullptr;
+    _capacity = 0;
+    _read_offset = 0;
+    _write_offset = 0;
+    _newline_scan_offset = 0;
+    _crlf_scan_offset = 0;
+    _double_crlf_scan_offset = 0;
+}
+
+template <typename FinderType>
+const char *RingTcpBuffer::_find_resumably(
+    size_t &scan_offset, size_t delimiter_size, FinderType finder
+) {
+    auto begin_offset = std::max(scan_offset, _read_offset);
+
+    if (begin_offset >= _write_offset) {
+        return nullptr;
+    }
+
+    auto position =
+        finder(_mapped_address + begin_offset, _mapped_address + _write_offset);
+
+    if (position) {
+        scan_offset = static_cast<size_t>(position - _mapped_address);
+
+        return position;
+    }
+
+    scan_offset = std::max(
+        _read_offset,
+        _write_offset - std::min(_write_offset, delimiter_size - 1)
+    );
+
+    return nullptr;
+}
+
+const char *RingTcpBuffer::get_next_newline_position() {
+    return _find_resumably(
+        _newline_scan_offset,
+        1,
+        [](const char *begin, const char *end) {
+            return util::delimiter_scan::find_byte(begin, end, '\n');
+        }
+    );
+}
+
+const char *RingTcpBuffer::get_next_crlf_position() {
+    return _find_resumably(
+        _crlf_scan_offset,
+        2,
+        [](const char *begin, const char *end) {
+            return util::delimiter_scan::find_byte_pair(
+                begin, end, '\r', '\n'
+            );
+        }
+    );
+}
+
+const char *RingTcpBuffer::get_next_double_crlf_position() {
+    return _find_resumably(
+        _double_crlf_scan_offset,
+        4,
+        [](const char *begin, const char *end) {
+            return util::delimiter_scan::find_sequence(
+                begin, end, "\r\n\r\n", 4
+            );
+        }
+    );
+}
+
+const char *RingTcpBuffer::get_next_delimiter_position(
+    const char *delimiter, size_t delimiter_size
+) const {
+    return util::delimiter_scan::find_sequence(
+        _mapped_address + _read_offset,
+        _mapped_address + _write_offset,
+        delimiter,
+        delimiter_size
+    );
+}
+
+void RingTcpBuffer::_grow(size_t min_capacity) {
+    static const auto page_size = util::alignment::get_page_size();
+
+    auto new_capacity = std::max(min_capacity, 2 * _capacity);
+
+    new_capacity = (new_capacity + page_size - 1) / page_size * page_size;
+
+    if (_memfd == -1) {
+        _memfd = ::memfd_create("tcp-buffer", MFD_CLOEXEC);
+
+        if (_memfd == -1) {
+            LOG_SYS_FATAL << "failed to create memfd for the ring buffer";
+        }
+    }
+
+    // the bytes already in the file stay where they are
+    if (::ftruncate(_memfd, static_cast<off_t>(new_capacity)) == -1) {
+        LOG_SYS_FATAL << "failed to enlarge the memfd of the ring buffer";
+    }
+
+    // reserves the address space first so that the two mappings could be
+    // placed back-to-back
+    auto reserved_address = ::mmap(
+        nullptr,
+        2 * new_capacity,
+        PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+        -1,
+        0
+    );
+
+    if (reserved_address == MAP_FAILED) {
+        LOG_SYS_FATAL << "failed to reserve address space for the ring buffer";
+    }
+
+    auto new_mapped_address = static_cast<char *>(reserved_address);
+
+    for (size_t i = 0; i < 2; i++) {
+        if (::mmap(
+                new_mapped_address + i * new_capacity,
+                new_capacity,
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_FIXED,
+                _memfd,
+                0
+            )
+            == MAP_FAILED) {
+
+            LOG_SYS_FATAL << "failed to map the memfd of the ring buffer";
+        }
+    }
+
+    // [NOTE]: the readable data that wrapped around the end of the old ring
+    // is now followed by the newly added space instead of its own beginning,
+    // so that part of it is moved over there; the offsets remain valid
+    if (_write_offset > _capacity) {
+        ::memcpy(
+            new_mapped_address + _capacity,
+            new_mapped_address,
+            _write_offset - _capacity
+        );
+    }
+
+    if (_mapped_address && ::munmap(_mapped_address, 2 * _capacity) == -1) {
+        LOG_SYS_ERROR << "failed to munmap the ring buffer";
+    }
+
+    _mapped_address = new_mapped_address;
+    _capacity = new_capacity;
+}
+
+namespace {
+
+// free slabs kept by the current thread, i.e. by the current event loop
+struct SlabCache {
+    SlabCache() noexcept = default;
+
+    SlabCache(const SlabCache &) = delete;
+    SlabCache &operator=(const SlabCache &) = delete;
+
+    ~SlabCache() noexcept {
+        for (auto slab : free_slabs) {
+            ::free(slab);
+        }
+    }
+
+    std::vector<char *> free_slabs;
+};
+
+thread_local SlabCache slab_cache;
+
+} // namespace
+
+char *SlabChainTcpBuffer::_allocate_slab() {
+    auto &free_slabs = slab_cache.free_slabs;
+
+    if (free_slabs.empty()) {
+        return static_cast<char *>(util::alignment::aalloc(
+            util::alignment::get_level_1_data_cache_line_size(), SLAB_SIZE
+        ));
+    }
+
+    auto slab = free_slabs.back();
+
+    free_slabs.pop_back();
+
+    return slab;
+}
+
+void SlabChainTcpBuffer::_deallocate_slab(char *slab) noexcept {
+    auto &free_slabs = slab_cache.free_slabs;
+
+    // [NOTE]: slabs released by another thread simply migrate to this one
+    if (free_slabs.size() >= _MAX_NUMBER_OF_CACHED_SLABS) {
+        ::free(slab);
+
+        return;
+    }
+
+    free_slabs.push_back(slab);
+}
+
+void SlabChainTcpBuffer::_deallocate_segment(const Segment &segment) noexcept {
+    if (segment.is_pooled) {
+        _deallocate_slab(segment.data);
+    }
+
+    else {
+        ::free(segment.data);
+    }
+}
+
+void SlabChainTcpBuffer::release() noexcept {
+    for (const auto &segment : _segments) {
+        _deallocate_segment(segment);
+    }
+
+    _segments.clear();
+    _write_segment_index = 0;
+    _readable_size = 0;
+    _number_of_bytes_consumed = 0;
+    _is_spare_space_used_up = false;
+    _newline_scan_offset = 0;
+    _crlf_scan_offset = 0;
+    _double_crlf_scan_offset = 0;
+}
+
+void SlabChainTcpBuffer::_swap(SlabChainTcpBuffer &other) noexcept {
+    std::swap(_segments, other._segments);
+    std::swap(_write_segment_index, other._write_segment_index);
+    std::swap(_readable_size, other._readable_size);
+    std::swap(_number_of_bytes_consumed, other._number_of_bytes_consumed);
+    std::swap(_is_spare_space_used_up, other._is_spare_space_used_up);
+    std::swap(_newline_scan_offset, other._newline_scan_offset);
+    std::swap(_crlf_scan_offset, other._crlf_scan_offset);
+    std::swap(_double_crlf_scan_offset, other._double_crlf_scan_offset);
+}
+
+void SlabChainTcpBuffer::forward_read_position(size_t number_of_bytes_read) {
+    number_of_bytes_read = std::min(number_of_bytes_read, _readable_size);
+
+    _readable_size -= number_of_bytes_read;
+    _number_of_bytes_consumed += number_of_bytes_read;
+
+    // the slabs are cheap to get back from the pool, so an idle connection
+    // holds none of them
+    if (_readable_size == 0) {
+        for (const auto &segment : _segments) {
+            _deallocate_segment(segment);
+        }
+
+        _segments.clear();
+        _write_segment_index = 0;
+
+        return;
+    }
+
+    while (number_of_bytes_read > 0) {
+        auto &front_segment = _segments.front();
+
+        auto number_of_bytes_consumed = std::min(
+            number_of_bytes_read,
+            front_segment.write_offset - front_segment.read_offset
+        );
+
+        front_segment.read_offset += number_of_bytes_consumed;
+        number_of_bytes_read -= number_of_bytes_consumed;
+
+        if (front_segment.read_offset == front_segment.capacity) {
+            _erase_segment(0);
+        }
+    }
+}
+
+void SlabChainTcpBuffer::forward_write_position(
+    size_t number_of_bytes_written
+) {
+    while (number_of_bytes_written > 0
+           && _write_segment_index < _segments.size()) {
+
+        auto &write_segment = _segments[_write_segment_index];
+
+        auto number_of_bytes_committed = std::min(
+            number_of_bytes_written,
+            write_segment.capacity - write_segment.write_offset
+        );
+
+        write_segment.write_offset += number_of_bytes_committed;
+        number_of_bytes_written -= number_of_bytes_committed;
+        _readable_size += number_of_bytes_committed;
+
+        if (write_segment.write_offset == write_segment.capacity) {
+            ++_write_segment_index;
+        }
+    }
+
+    _is_spare_space_used_up = _write_segment_index == _segments.size();
+}
+
+void SlabChainTcpBuffer::ensure_writable_size(size_t size) {
+    size_t writable_size = 0;
+
+    for (auto i = _write_segment_index; i < _segments.size(); i++) {
+        writable_size += _segments[i].capacity - _segments[i].write_offset;
+    }
+
+    while (writable_size < size) {
+        _segments.push_back(Segment{_allocate_slab(), SLAB_SIZE, 0, 0, true});
+
+        writable_size += SLAB_SIZE;
+    }
+}
+
+int SlabChainTcpBuffer::get_readable_iovecs(
+    iovec *iovecs, int max_number_of_iovecs
+) const {
+    int number_of_iovecs = 0;
+
+    for (const auto &segment : _segments) {
+        if (number_of_iovecs >= max_number_of_iovecs
+            || segment.read_offset == segment.write_offset) {
+
+            break;
+        }
+
+        iovecs[number_of_iovecs].iov_base = segment.data + segment.read_offset;
+        iovecs[number_of_iovecs].iov_len =
+            segment.write_offset - segment.read_offset;
+
+        ++number_of_iovecs;
+    }
+
+    return number_of_iovecs;
+}
+
+int SlabChainTcpBuffer::get_writable_iovecs(
+    iovec *iovecs, int max_number_of_iovecs
+) {
+    ensure_writable_size(
+        _is_spare_space_used_up ? _NUMBER_OF_SLABS_FOR_BULK_READING * SLAB_SIZE
+                                : SLAB_SIZE
+    );
+
+    int number_of_iovecs = 0;
+
+    for (auto i = _write_segment_index;
+         i < _segments.size() && number_of_iovecs < max_number_of_iovecs;
+         i++) {
+
+        iovecs[number_of_iovecs].iov_base =
+            _segments[i].data + _segments[i].write_offset;
+        iovecs[number_of_iovecs].iov_len =
+            _segments[i].capacity - _segments[i].write_offset;
+
+        ++number_of_iovecs;
+    }
+
+    return number_of_iovecs;
+}
+
+void SlabChainTcpBuffer::append(
+    const char *external_buffer, size_t external_buffer_size
+) {
+    if (external_buffer_size == 0) {
+        return;
+    }
+
+    ensure_writable_size(external_buffer_size);
+
+    auto i = _write_segment_index;
+
+    for (size_t number_of_bytes_copied = 0;
+         number_of_bytes_copied < external_buffer_size;
+         i++) {
+
+        auto &segment = _segments[i];
+
+        auto number_of_bytes_to_copy = std::min(
+            external_buffer_size - number_of_bytes_copied,
+            segment.capacity - segment.write_offset
+        );
+
+        ::memcpy(
+            segment.data + segment.write_offset,
+            external_buffer + number_of_bytes_copied,
+            number_of_bytes_to_copy
+        );
+
+        number_of_bytes_copied += number_of_bytes_to_copy;
+    }
+
+    forward_write_position(external_buffer_size);
+}
+
+void SlabChainTcpBuffer::_erase_segment(size_t segment_index) noexcept {
+    _deallocate_segment(_segments[segment_index]);
+
+    _segments.erase(_segments.begin() + static_cast<long>(segment_index));
+
+    if (segment_index < _write_segment_index) {
+        --_write_segment_index;
+    }
+}
+
+void SlabChainTcpBuffer::_move_out(
+    size_t first_segment_index, char *destination, size_t number_of_bytes
+) {
+    while (number_of_bytes > 0) {
+        auto &segment = _segments[first_segment_index];
+
+        auto number_of_bytes_moved = std::min(
+            number_of_bytes, segment.write_offset - segment.read_offset
+        );
+
+        ::memcpy(
+            destination,
+            segment.data + segment.read_offset,
+            number_of_bytes_moved
+        );
+
+        segment.read_offset += number_of_bytes_moved;
+        destination += number_of_bytes_moved;
+        number_of_bytes -= number_of_bytes_moved;
+
+        if (segment.read_offset == segment.capacity) {
+            _erase_segment(first_segment_index);
+        }
+
+        else {
+            ++first_segment_index;
+        }
+    }
+}
+
+const char *SlabChainTcpBuffer::linearize(size_t size) {
+    size = std::min(size, _readable_size);
+
+    if (size <= get_contiguous_readable_size()) {
+        return get_read_position();
+    }
+
+    // [NOTE]: the first segment must be full here since there is more data
+    // after it, and it stays "full" (i.e. not written anymore) by having its
+    // capacity shrunk to the end of the data gathered
+    auto &front_segment = _segments.front();
+
+    auto front_readable_size =
+        front_segment.write_offset - front_segment.read_offset;
+
+    if (front_segment.is_pooled && size <= SLAB_SIZE) {
+        ::memmove(
+            front_segment.data,
+            front_segment.data + front_segment.read_offset,
+            front_readable_size
+        );
+
+        front_segment.read_offset = 0;
+        front_segment.write_offset = size;
+        front_segment.capacity = size;
+
+        // [NOTE]: erasing from the middle of a deque invalidates references
+        auto data = front_segment.data;
+
+        _move_out(1, data + front_readable_size, size - front_readable_size);
+
+        return data;
+    }
+
+    auto data = static_cast<char *>(::malloc(size));
+
+    if (!data) {
+        LOG_SYS_FATAL << "failed to allocate memory for linearization";
+    }
+
+    _move_out(0, data, size);
+
+    _segments.push_front(Segment{data, size, 0, size, false});
+
+    ++_write_segment_index;
+
+    return data;
+}
+
+bool SlabChainTcpBuffer::_is_delimiter_at(
+    size_t segment_index,
+    size_t offset,
+    const char *delimiter,
+    size_t delimiter_size
+) const {
+    for (size_t i = 0; i < delimiter_size; i++) {
+        while (offset == _segments[segment_index].write_offset) {
+            if (++segment_index > _write_segment_index
+                || segment_index == _segments.size()) {
+
+                return false;
+            }
+
+            offset = _segments[segment_index].read_offset;
+        }
+
+        if (_segments[segment_index].data[offset] != delimiter[i]) {
+            return false;
+        }
+
+        ++offset;
+    }
+
+    return true;
+}
+
+const char *SlabChainTcpBuffer::_find_resumably(
+    size_t &scan_offset, const char *delimiter, size_t delimiter_size
+) {
+    auto end_offset = _number_of_bytes_consumed + _readable_size;
+
+    auto begin_offset = std::max(scan_offset, _number_of_bytes_consumed);
+
+    if (begin_offset >= end_offset) {
+        return nullptr;
+    }
+
+    // stream offset of the read position of the current segment
+    auto segment_begin_offset = _number_of_bytes_consumed;
+
+    for (size_t i = 0; i < _segments.size(); i++) {
+        const auto &segment = _segments[i];
+
+        auto segment_readable_size = segment.write_offset - segment.read_offset;
+
+        if (segment_readable_size == 0) {
+            break;
+        }
+
+        auto segment_end_offset = segment_begin_offset + segment_readable_size;
+
+        if (segment_end_offset > begin_offset) {
+            auto segment_read_position = segment.data + segment.read_offset;
+
+            auto search_begin = segment_read_position
+                                + (std::max(begin_offset, segment_begin_offset)
+                                   - segment_begin_offset);
+            auto search_end = segment_read_position + segment_readable_size;
+
+            auto position = util::delimiter_scan::find_sequence(
+                search_begin, search_end, delimiter, delimiter_size
+            );
+
+            // a delimiter may also straddle the boundary with the next segment
+            if (!position && segment_end_offset < end_offset) {
+                for (auto candidate = std::max(
+                         search_begin,
+                         search_end
+                             - std::min(
+                                 delimiter_size - 1,
+                                 static_cast<size_t>(search_end - search_begin)
+                             )
+                     );
+                     candidate < search_end;
+                     candidate++) {
+
+                    if (_is_delimiter_at(
+                            i,
+                            static_cast<size_t>(candidate - segment.data),
+                            delimiter,
+                            delimiter_size
+                        )) {
+
+                        position = candidate;
+
+                        break;
+                    }
+                }
+            }
+
+            if (position) {
+                auto found_offset =
+                    segment_begin_offset
+                    + static_cast<size_t>(position - segment_read_position);
+
+                scan_offset = found_offset;
+
+                auto relative_offset = found_offset - _number_of_bytes_consumed;
+
+                return linearize(relative_offset + delimiter_size)
+                       + relative_offset;
+            }
+        }
+
+        segment_begin_offset = segment_end_offset;
+    }
+
+    scan_offset = std::max(
+        _number_of_bytes_consumed,
+        end_offset - std::min(end_offset, delimiter_size - 1)
+    );
+
+    return nullptr;
+}
+
+const char *SlabChainTcpBuffer::get_next_newline_position() {
+    return _find_resumably(_newline_scan_offset, "\n", 1);
+}
+
+const char *SlabChainTcpBuffer::get_next_crlf_position() {
+    return _find_resumably(_crlf_scan_offset, "\r\n", 2);
+}
+
+const char *SlabChainTcpBuffer::get_next_double_crlf_position() {
+    return _find_resumably(_double_crlf_scan_offset, "\r\n\r\n", 4);
+}
+
+const char *SlabChainTcpBuffer::get_next_delimiter_position(
+    const char *delimiter, size_t delimiter_size
+) {
+    size_t scan_offset = 0;
+
+    return _find_resumably(scan_offset, delimiter, delimiter_size);
+}
+
 } // namespace xubinh_server
@@ -7,6 +7,11 @@ TcpClient::~TcpClient() {
     if (!_is_started) {
         LOG_FATAL << "tried to destruct tcp client before starting it";
     }
+
+    // the loop is supposed to have exited by now
+    if (_tcp_connect_socketfd_ptr) {
+        _tcp_connect_socketfd_ptr->release_worker_loop_reference();
+    }
 }
 
 void TcpClient::start() {
@@ -99,7 +104,7 @@ void TcpClient::_new_connection_callback(
     InetAddress local_address{connect_socketfd, InetAddress::LOCAL};
     InetAddress peer_address{connect_socketfd, InetAddress::PEER};
 
-    _tcp_connect_socketfd_ptr = std::make_shared<TcpConnectSocketfd>(
+    _tcp_connect_socketfd_ptr = TcpConnectSocketfd::create(
         connect_socketfd, _loop, 0, local_address, peer_address, time_stamp
     );
 
@@ -1,5 +1,14 @@
+#include <algorithm>
+#include <fcntl.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <unordered_map>
 
 #include "event_loop.h"
 #include "log_builder.h"
@@ -9,6 +18,230 @@
 
 namespace xubinh_server {
 
+namespace {
+
+const size_t _LOOP_LOCAL_STATE_SLOT_INDEX =
+    EventLoop::allocate_module_slot_index();
+
+// closes the socket with a RST, which also drops the data queued for sending
+void _close_socketfd_with_reset(int fd) {
+    struct linger linger_opt;
+
+    linger_opt.l_onoff = 1;  // enable linger
+    linger_opt.l_linger = 0; // timeout of 0 seconds (immediate reset)
+
+    // set SO_LINGER with a timeout of 0 to force a TCP RST
+    if (::setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger_opt, sizeof(linger_opt))
+        == -1) {
+        LOG_FATAL << "setsockopt failed";
+    }
+
+    // close the socket to trigger the RST
+    if (::close(fd) == -1) {
+        LOG_FATAL << "close failed";
+    }
+}
+
+} // namespace
+
+// the socket of a closed connection is kept open by the worker loop until the
+// kernel reports its pending zero-copy sends completed, which is woken up by
+// the error events that the completions raise instead of polling
+//
+// - the socket is reset if the completions are not reported in time, after
+// which the data is kept for a grace period, since the RST purges the data
+// queued for sending but the device might still be reading the copies in
+// flight
+// - a connection that is reset already hands over only the data, which is
+// kept for the same grace period
+// - whatever is left when the loop is destroyed is released along with the
+// module slot, where the timers are released by the loop right after
+class TcpConnectSocketfd::LingeringSocket {
+public:
+    // takes over the fd, or only the data if `fd` is `-1`
+    LingeringSocket(
+        int fd, EventLoop *loop, std::deque<ZeroCopyOwner> zero_copy_owners
+    );
+
+    // no copy
+    LingeringSocket(const LingeringSocket &) = delete;
+    LingeringSocket &operator=(const LingeringSocket &) = delete;
+
+    // no move
+    LingeringSocket(LingeringSocket &&) = delete;
+    LingeringSocket &operator=(LingeringSocket &&) = delete;
+
+    ~LingeringSocket();
+
+private:
+    void _receive_zero_copy_completions();
+
+    void _arm_deadline_timer(int64_t time_interval);
+
+    void _expire();
+
+    // closes the socket and leaves the loop at the end of the iteration, since
+    // its callbacks might still be on the call stack
+    void _finish();
+
+    void _close_fd();
+
+    EventLoop *_loop;
+
+    std::deque<ZeroCopyOwner> _zero_copy_owners;
+
+    // null if the socket is reset already
+    std::unique_ptr<PollableFileDescriptor> _pollable_file_descriptor_ptr;
+    bool _is_fd_open{false};
+
+    TimerIdentifier _deadline_timer_identifier{nullptr};
+    bool _is_deadline_timer_armed{false};
+
+    bool _is_finished{false};
+};
+
+struct TcpConnectSocketfd::LoopLocalState {
+    // closed connections kept for reuse, see
+    // `set_max_number_of_recycled_connections_per_loop`
+    std::vector<TcpConnectSocketfdPtr> recycled_tcp_connect_socketfds;
+
+    std::unordered_map<
+        const LingeringSocket *,
+        std::unique_ptr<LingeringSocket>>
+        lingering_sockets;
+};
+
+TcpConnectSocketfd::LingeringSocket::LingeringSocket(
+    int fd, EventLoop *loop, std::deque<ZeroCopyOwner> zero_copy_owners
+)
+    : _loop(loop), _zero_copy_owners(std::move(zero_copy_owners)) {
+
+    if (fd == -1) {
+        _arm_deadline_timer(_ZERO_COPY_GRACE_PERIOD_AFTER_RESET);
+
+        return;
+    }
+
+    _pollable_file_descriptor_ptr =
+        std::make_unique<PollableFileDescriptor>(fd, loop, true, false);
+    _is_fd_open = true;
+
+    // completions are reported as error events, and might keep coming after
+    // the peer closes the connection
+    _pollable_file_descriptor_ptr->register_close_event_callback([this]() {
+        _receive_zero_copy_completions();
+    });
+
+    _pollable_file_descriptor_ptr->register_error_event_callback([this]() {
+        _receive_zero_copy_completions();
+    });
+
+    // [NOTE]: the completions reported before attaching are reported by the
+    // poller right after
+    _pollable_file_descriptor_ptr->attach_to_poller();
+
+    _arm_deadline_timer(_MAX_ZERO_COPY_COMPLETION_WAITING_TIME);
+}
+
+TcpConnectSocketfd::LingeringSocket::~LingeringSocket() {
+    if (_is_fd_open) {
+        _close_fd();
+    }
+}
+
+void TcpConnectSocketfd::LingeringSocket::_receive_zero_copy_completions() {
+    if (!_is_fd_open) {
+        return;
+    }
+
+    _read_zero_copy_completions(
+        _pollable_file_descriptor_ptr->get_fd(), _zero_copy_owners
+    );
+
+    if (_zero_copy_owners.empty()) {
+        _finish();
+    }
+}
+
+void TcpConnectSocketfd::LingeringSocket::_arm_deadline_timer(
+    int64_t time_interval
+) {
+    _deadline_timer_identifier =
+        _loop->run_after_time_interval(time_interval, 0, 1, [this]() {
+            _expire();
+        });
+
+    _is_deadline_timer_armed = true;
+}
+
+void TcpConnectSocketfd::LingeringSocket::_expire() {
+    _is_deadline_timer_armed = false;
+
+    if (!_is_fd_open) {
+        _finish();
+
+        return;
+    }
+
+    auto fd = _pollable_file_descriptor_ptr->get_fd();
+
+    LOG_WARN << "zero-copy sends not completed in time, socket reset, fd: "
+             << fd;
+
+    _pollable_file_descriptor_ptr->detach_from_poller();
+
+    _close_socketfd_with_reset(fd);
+
+    _is_fd_open = false;
+
+    _arm_deadline_timer(_ZERO_COPY_GRACE_PERIOD_AFTER_RESET);
+}
+
+void TcpConnectSocketfd::LingeringSocket::_finish() {
+    if (_is_finished) {
+        return;
+    }
+
+    _is_finished = true;
+
+    if (_is_deadline_timer_armed) {
+        _loop->cancel_a_timer(_deadline_timer_identifier);
+
+        _is_deadline_timer_armed = false;
+    }
+
+    if (_is_fd_open) {
+        _close_fd();
+    }
+
+    _zero_copy_owners.clear();
+
+    auto &lingering_sockets = _get_loop_local_state(_loop).lingering_sockets;
+
+    _loop->run_at_end_of_iteration([&lingering_sockets, this]() {
+        lingering_sockets.erase(this);
+    });
+}
+
+void TcpConnectSocketfd::LingeringSocket::_close_fd() {
+    _pollable_file_descriptor_ptr->detach_from_poller();
+
+    _pollable_file_descriptor_ptr->close_fd();
+
+    _is_fd_open = false;
+}
+
+TcpConnectSocketfd::LoopLocalState &
+TcpConnectSocketfd::_get_loop_local_state(EventLoop *loop) {
+    auto &module_slot = loop->get_module_slot(_LOOP_LOCAL_STATE_SLOT_INDEX);
+
+    if (!module_slot) {
+        module_slot = std::make_shared<LoopLocalState>();
+    }
+
+    return *static_cast<LoopLocalState *>(module_slot.get());
+}
+
 TcpConnectSocketfd::TcpConnectSocketfd(
     int fd,
     EventLoop *loop,
@@ -26,12 +259,46 @@ TcpConnectSocketfd::TcpConnectSocketfd(
           fd, loop, true, false
       ) /* non-blocking or not is always decided by the outside */ {
 
+    _state.last_read_time_point = time_stamp;
+    _state.last_write_time_point = time_stamp;
+
     // [NOTE]: this line is for testing
     // disable_socketfd_nagle_algorithm(fd);
 
     // LOG_TRACE << "TCP connection created, id: " << _id;
 }
 
+TcpConnectSocketfd::TcpConnectSocketfdPtr TcpConnectSocketfd::create(
+    int fd,
+    EventLoop *loop,
+    const uint64_t &id,
+    const InetAddress &local_address,
+    const InetAddress &remote_address,
+    util::TimePoint time_stamp
+) {
+    if (loop->is_in_owner_thread()) {
+        auto &recycled_tcp_connect_socketfds =
+            _get_loop_local_state(loop).recycled_tcp_connect_socketfds;
+
+        if (!recycled_tcp_connect_socketfds.empty()) {
+            auto tcp_connect_socketfd_ptr =
+                std::move(recycled_tcp_connect_socketfds.back());
+
+            recycled_tcp_connect_socketfds.pop_back();
+
+            tcp_connect_socketfd_ptr->_reuse(
+                fd, id, local_address, remote_address, time_stamp
+            );
+
+            return tcp_connect_socketfd_ptr;
+        }
+    }
+
+    return _Base::create(
+        fd, loop, id, local_address, remote_address, time_stamp
+    );
+}
+
 TcpConnectSocketfd::~TcpConnectSocketfd() {
     if (!_is_stopped()) {
         // might occur when the connection is sent to be registered by the
@@ -42,13 +309,45 @@ TcpConnectSocketfd::~TcpConnectSocketfd() {
                  << get_id();
     }
 
-    if (!_is_reset) {
+    bool is_fd_open = !_state.is_reset && !_state.is_fd_handed_over
+                      && !_state.is_recycled;
+
+    if (is_fd_open && !_zero_copy_owners.empty()) {
+        _receive_zero_copy_completions();
+    }
+
+    // destroyed without being released by the worker loop, e.g. after the
+    // loop exited, so that nobody could wait for the completions anymore; the
+    // socket is reset to purge the data queued for sending before the data
+    // is freed
+    if (!_zero_copy_owners.empty()) {
+        LOG_WARN << "tcp connect socketfd object destroyed with pending "
+                    "zero-copy sends, connection reset, id: "
+                 << get_id();
+
+        if (is_fd_open) {
+            _close_with_reset();
+
+            is_fd_open = false;
+        }
+    }
+
+    if (is_fd_open) {
         _pollable_file_descriptor.close_fd();
     }
 
+    _close_splice_pipe();
+
     LOG_TRACE << "TCP connection destroyed, id: " << _id;
 }
 
+bool TcpConnectSocketfd::could_be_recycled() const {
+    return _get_loop_local_state(_loop).recycled_tcp_connect_socketfds.size()
+           < _max_number_of_recycled_connections_per_loop.load(
+               std::memory_order_relaxed
+           );
+}
+
 void TcpConnectSocketfd::start() {
     if (_is_reading()) {
         LOG_ERROR << "try to start an already started tcp connect socketfd";
@@ -79,10 +378,53 @@ void TcpConnectSocketfd::start() {
     });
 
     // must ensure lifetime safety as this exact object could be
-    // destroyed by the callbacks registered inside themselves
-    _pollable_file_descriptor.register_weak_lifetime_guard(shared_from_this());
+    // destroyed by the callbacks registered inside themselves; a reference
+    // held for as long as the connection is attached saves locking up a weak
+    // guard for every dispatch
+    add_local_reference();
+
+    _state.is_held_by_worker_loop = true;
+
+    // counted for as long as the worker loop holds the connection
+    _loop->increment_number_of_connections();
+
+    if (_state.zero_copy_threshold > 0) {
+        _enable_zero_copy();
+    }
+
+#ifdef __USE_IO_URING_POLLER
+    // saves the `readv(2)` (and the `EAGAIN` that ends it) for each readiness
+    _pollable_file_descriptor.set_read_mode(
+        PollableFileDescriptor::READ_MODE_MULTISHOT_RECEIVE
+    );
+#endif
 
     _pollable_file_descriptor.enable_read_event();
+
+    const util::TimeInterval forever{util::TimeInterval::FOREVER};
+
+    // the deadlines belong to the worker loop from now on, which might not be
+    // the current one
+    if (_state.idle_timeout < forever || _state.read_timeout < forever
+        || _state.write_timeout < forever) {
+
+        _loop->run(std::bind(
+            &TcpConnectSocketfd::_arm_deadline_timer,
+            TcpConnectSocketfdPtr(this)
+        ));
+    }
+}
+
+void TcpConnectSocketfd::release_worker_loop_reference() {
+    if (!_state.is_held_by_worker_loop) {
+        return;
+    }
+
+    _state.is_held_by_worker_loop = false;
+
+    _loop->decrement_number_of_connections();
+
+    release_local_reference();
 }
 
 void TcpConnectSocketfd::shutdown_write() {
@@ -90,7 +432,14 @@ void TcpConnectSocketfd::shutdown_write() {
     // connection immediately after he sent out a HTTP request with a
     // "Connection: close" header in it, which will also issue a
     // shutdown_write operation
-    if (_is_write_end_shutdown) {
+    if (_state.is_write_end_shutdown) {
+        return;
+    }
+
+    // the connection is already closed, e.g. EOF is read in right after a
+    // close event within the same dispatch, and the close callback must not be
+    // called once again by aborting it
+    if (_is_stopped()) {
         return;
     }
 
@@ -119,23 +468,35 @@ void TcpConnectSocketfd::shutdown_write() {
 
     _pollable_file_descriptor.disable_write_event();
 
+    // [NOTE]: marked before calling back, since the write complete callback
+    // might be the one that shuts down the write end, e.g. when it is
+    // registered for closing after a pending response is sent
+    _state.is_write_end_shutdown = true;
+
     if (_write_complete_callback) {
         _write_complete_callback(this);
     }
 
-    // empty the output buffer; after which it is the caller's responsibility to
+    // empty the output queue; after which it is the caller's responsibility to
     // keep it that way
-    _output_buffer.release();
+    _output_queue.release();
 
     clear_context();
 
-    _is_write_end_shutdown = true;
+    // reading goes on until the peer closes its write end
+    _update_output_backpressure();
 
     LOG_TRACE << "TCP shutdown write, id: " << _id;
 }
 
+void TcpConnectSocketfd::shutdown_write_when_idle() {
+    _state.need_shutdown_write_when_idle = true;
+
+    _shutdown_write_if_idle_and_asked_to();
+}
+
 void TcpConnectSocketfd::reset_connection() {
-    if (_is_reset) {
+    if (_state.is_reset) {
         LOG_FATAL << "never reaches here";
     }
 
@@ -143,43 +504,44 @@ void TcpConnectSocketfd::reset_connection() {
         _close_callback(this);
     }
 
-    auto fd = _pollable_file_descriptor.get_fd();
-
-    struct linger linger_opt;
+    _close_with_reset();
 
-    linger_opt.l_onoff = 1;  // enable linger
-    linger_opt.l_linger = 0; // timeout of 0 seconds (immediate reset)
+    _input_buffer.release();
+    _output_queue.release();
 
-    // set SO_LINGER with a timeout of 0 to force a TCP RST
-    if (::setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger_opt, sizeof(linger_opt))
-        == -1) {
-        LOG_FATAL << "setsockopt failed";
-    }
+    _update_output_backpressure();
 
-    // close the socket to trigger the RST
-    if (::close(fd) == -1) {
-        LOG_FATAL << "close failed";
-    }
+    // [NOTE]: the data of the pending zero-copy sends is kept until the worker
+    // loop releases the connection, since the kernel might still be reading it
+    // (see `_hand_over_pending_zero_copy_sends`)
 
-    _input_buffer.release();
-    _output_buffer.release();
+    _close_splice_pipe();
 
     clear_context();
 
-    _is_write_end_shutdown = true;
-    _is_reset = true;
+    _state.is_write_end_shutdown = true;
+}
+
+void TcpConnectSocketfd::_close_with_reset() {
+    _close_socketfd_with_reset(_pollable_file_descriptor.get_fd());
+
+    _state.is_reset = true;
 }
 
 void TcpConnectSocketfd::abort_from_event_loop() {
-    if (_is_abotrted) {
+    if (_state.is_abotrted) {
         LOG_FATAL << "never reaches here";
     }
 
     _pollable_file_descriptor.detach_from_poller();
 
+    _disarm_deadline_timer();
+
+    _release_worker_loop_reference_later();
+
     reset_connection();
 
-    _is_abotrted = true;
+    _state.is_abotrted = true;
 
     LOG_TRACE << "TCP connection aborted, id: " << _id;
 }
@@ -191,26 +553,36 @@ void TcpConnectSocketfd::check_and_abort_from_event_loop(PredicateType predicate
     // must use std::bind since move capture lambda is not supported in C++11
     _loop->run(std::bind(
         &TcpConnectSocketfd::_check_and_abort_impl,
-        shared_from_this(),
+        TcpConnectSocketfdPtr(this),
         std::move(predicate)
     ));
 }
 
-void TcpConnectSocketfd::send(const char *data, size_t data_size) {
+void TcpConnectSocketfd::send(
+    const char *data, size_t data_size, bool has_more
+) {
     // could be called after the connection is closed, so check it first
     if (_is_stopped()) {
         return;
     }
 
-    // leave the writing to the event callback if already started listening
-    if (_is_writing()) {
-        _output_buffer.append(data, data_size);
+    // leave the writing to the event callback if already started listening,
+    // or to the end of the iteration if corked
+    if (_is_writing() || _state.use_corked_mode) {
+        _output_queue.append(data, data_size);
+
+        if (!_is_writing()) {
+            _schedule_corked_output_flush();
+        }
+
+        _update_output_backpressure();
 
         return;
     }
 
     // otherwise try sending the data right now
-    auto number_of_bytes_sent = _send_as_many_data(data, data_size);
+    auto number_of_bytes_sent =
+        _send_as_many_data(data, data_size, has_more);
 
     // no need for further writing if all data is sent
     if (number_of_bytes_sent == data_size) {
@@ -222,101 +594,249 @@ void TcpConnectSocketfd::send(const char *data, size_t data_size) {
     }
 
     // otherwise leave what's left to the callback as well
-    _output_buffer.append(
+    _output_queue.append(
         data + number_of_bytes_sent, data_size - number_of_bytes_sent
     );
 
-    _pollable_file_descriptor.enable_write_event();
-}
+    _start_writing();
 
-uint64_t TcpConnectSocketfd::get_loop_index() const noexcept {
-    return _loop->get_loop_index();
+    _update_output_backpressure();
 }
 
-void TcpConnectSocketfd::_read_event_callback(util::TimePoint time_stamp) {
-    LOG_TRACE << "tcp connect socketfd read event encountered, id: " << _id;
+void TcpConnectSocketfd::send(
+    const iovec *iovecs, int number_of_iovecs, bool has_more
+) {
+    if (_is_stopped()) {
+        return;
+    }
 
-    // [NOTE]: read event could be disabled here, but there might still be data
-    // left in the read buffer
+    size_t number_of_bytes_sent = 0;
 
-    // fd -- W --> input buffer
-    auto total_bytes_read = _receive_all_data();
+    // the output queue is empty unless writing or corked
+    if (!_is_writing() && !_state.use_corked_mode) {
+        number_of_bytes_sent =
+            _send_as_many_iovecs(iovecs, number_of_iovecs, has_more);
 
-    // user should call `send()` internally to send the data and possibly start
-    // listening the writing event
-    //
-    // input buffer <-- R -- user -- W --> output buffer
-    if (total_bytes_read) {
-        _message_callback(this, &_input_buffer, time_stamp);
+        // the peer might have closed the connection abruptly
+        if (_is_stopped()) {
+            return;
+        }
     }
 
-    // [NOTE]: the last read event (i.e. EOF) might be encountered after the
-    // outside (an HTTP server, for example) have closed and released the
-    // resources and context needed by the message callback because certain
-    // signals, like a HTTP request with "Connection: close" and an empty body,
-    // could determine the end of the TCP session before EOF does, so here we
-    // need to make sure we don't re-enter the message callback in such cases
-
-    if (!_is_reading()) {
-        _input_buffer.release();
+    // copies what's left, skipping the part that is already sent
+    for (int i = 0; i < number_of_iovecs; i++) {
+        if (number_of_bytes_sent >= iovecs[i].iov_len) {
+            number_of_bytes_sent -= iovecs[i].iov_len;
 
-        // shutdown write if (1) all data is read and processed, (2) the peer
-        // closed its write end first, and (3) no data needs to be sent to the
-        // peer
-        if (!_is_write_end_shutdown && !_is_writing()) {
-            shutdown_write();
+            continue;
         }
+
+        _output_queue.append(
+            static_cast<const char *>(iovecs[i].iov_base)
+                + number_of_bytes_sent,
+            iovecs[i].iov_len - number_of_bytes_sent
+        );
+
+        number_of_bytes_sent = 0;
     }
-}
 
-void TcpConnectSocketfd::_write_event_callback() {
-    LOG_TRACE << "tcp connect socketfd write event encountered, id: " << _id;
+    // no need for further writing if all data is sent
+    if (_output_queue.empty()) {
+        if (_write_complete_callback) {
+            _write_complete_callback(this);
+        }
 
-    // if write event is triggered at this poll, it means the local did not
-    // close its write end when starting this poll, and the close event will be
-    // triggered at least till the next poll; but if the close event is also
-    // triggered at this poll, then it suggests that there might be something
-    // wrong with the peer and the local should stop sending data
-    if (_is_stopped()) {
         return;
     }
 
-    // the write end might just shutdown in the previous read event
-    if (_is_write_end_shutdown) {
+    if (_is_writing()) {
+        _update_output_backpressure();
+
         return;
     }
 
-    auto total_number_of_bytes = _output_buffer.get_readable_size();
+    if (_state.use_corked_mode) {
+        _schedule_corked_output_flush();
+    }
 
-    // might be zero if the outside wants to deal with the writing by himself,
-    // e.g. using zero-copy rather than copying the data back and forth
-    if (total_number_of_bytes > 0) {
-        // output buffer -- W --> fd
-        auto number_of_bytes_sent = _send_as_many_data(
-            _output_buffer.get_read_position(), total_number_of_bytes
-        );
+    // otherwise leave what's left to the callback as well
+    else {
+        _start_writing();
+    }
 
-        _output_buffer.forward_read_position(number_of_bytes_sent);
+    _update_output_backpressure();
+}
 
-        // TCP buffer is full, leave what's left till the next time
-        if (number_of_bytes_sent < total_number_of_bytes) {
-            return;
-        }
+void TcpConnectSocketfd::send(StringType &&data) {
+    if (_is_stopped()) {
+        return;
     }
 
-    // might be re-enabled by the outside, so disable it first for it to be
-    // overwritten
-    _pollable_file_descriptor.disable_write_event();
+    _output_queue.append(std::move(data));
 
-    if (_write_complete_callback) {
-        _write_complete_callback(this);
+    _send_queued_data();
+}
+
+void TcpConnectSocketfd::send(
+    SharedOwnerType shared_owner, const char *data, size_t data_size
+) {
+    if (_is_stopped()) {
+        return;
+    }
+
+    _output_queue.append_shared_slice(std::move(shared_owner), data, data_size);
+
+    _send_queued_data();
+}
+
+void TcpConnectSocketfd::send_mapped_region(
+    void *mapped_address, size_t mapped_length
+) {
+    // the ownership is already taken over, so release it right here
+    if (_is_stopped()) {
+        if (mapped_length > 0
+            && ::munmap(mapped_address, mapped_length) == -1) {
+
+            LOG_SYS_ERROR << "failed to munmap the output region";
+        }
+
+        return;
+    }
+
+    _output_queue.append_mapped_region(mapped_address, mapped_length);
+
+    _send_queued_data();
+}
+
+void TcpConnectSocketfd::send_file(int fd, off_t offset, size_t length) {
+    // the ownership is already taken over, so release it right here
+    if (_is_stopped()) {
+        if (::close(fd) == -1) {
+            LOG_SYS_ERROR << "failed to close the output file, fd: " << fd;
+        }
+
+        return;
+    }
+
+    struct stat file_stat;
+
+    // nothing is queued then, and the file is released right here as well
+    if (::fstat(fd, &file_stat) == -1) {
+        LOG_SYS_ERROR << "failed to get stats of the output file, fd: " << fd;
+
+        if (::close(fd) == -1) {
+            LOG_SYS_ERROR << "failed to close the output file, fd: " << fd;
+        }
+
+        return;
+    }
+
+    // only regular files and block devices are guaranteed to be mmap-able,
+    // which is required by `sendfile(2)`
+    bool is_seekable = S_ISREG(file_stat.st_mode) || S_ISBLK(file_stat.st_mode);
+
+    _output_queue.append_file_range(fd, offset, length, true, is_seekable);
+
+    _send_queued_data();
+}
+
+uint64_t TcpConnectSocketfd::get_loop_index() const noexcept {
+    return _loop->get_loop_index();
+}
+
+void TcpConnectSocketfd::_read_event_callback(util::TimePoint time_stamp) {
+    LOG_TRACE << "tcp connect socketfd read event encountered, id: " << _id;
+
+    // [NOTE]: read event could be disabled here, but there might still be data
+    // left in the read buffer
+
+    // fd -- W --> input buffer
+    auto total_bytes_read = _receive_all_data();
+
+    // user should call `send()` internally to send the data and possibly start
+    // listening the writing event
+    //
+    // input buffer <-- R -- user -- W --> output buffer
+    if (total_bytes_read) {
+        _state.last_read_time_point = time_stamp;
+        _state.has_received_data = true;
+
+        _message_callback(this, &_input_buffer, time_stamp);
+    }
+
+    // [NOTE]: the last read event (i.e. EOF) might be encountered after the
+    // outside (an HTTP server, for example) have closed and released the
+    // resources and context needed by the message callback because certain
+    // signals, like a HTTP request with "Connection: close" and an empty body,
+    // could determine the end of the TCP session before EOF does, so here we
+    // need to make sure we don't re-enter the message callback in such cases
+
+    if (!_is_reading()) {
+        _input_buffer.clear();
+
+        // shutdown write if (1) all data is read and processed, (2) the peer
+        // closed its write end first, and (3) no data needs to be sent to the
+        // peer
+        if (!_state.is_write_end_shutdown && !is_writing()) {
+            shutdown_write();
+        }
+    }
+
+    _shutdown_write_if_idle_and_asked_to();
+}
+
+void TcpConnectSocketfd::_write_event_callback() {
+    LOG_TRACE << "tcp connect socketfd write event encountered, id: " << _id;
+
+    // if write event is triggered at this poll, it means the local did not
+    // close its write end when starting this poll, and the close event will be
+    // triggered at least till the next poll; but if the close event is also
+    // triggered at this poll, then it suggests that there might be something
+    // wrong with the peer and the local should stop sending data
+    if (_is_stopped()) {
+        return;
+    }
+
+    // the write end might just shutdown in the previous read event
+    if (_state.is_write_end_shutdown) {
+        return;
+    }
+
+    // might be empty if the outside wants to deal with the writing by himself
+    if (!_output_queue.empty()) {
+        // output queue -- W --> fd
+        _send_as_many_queued_data();
+
+        // the peer might have closed the connection abruptly
+        if (_is_stopped()) {
+            return;
+        }
+
+        _update_output_backpressure();
+
+        // TCP buffer is full, leave what's left till the next time
+        if (!_output_queue.empty()) {
+            return;
+        }
+    }
+
+    // might be re-enabled by the outside, so disable it first for it to be
+    // overwritten
+    _pollable_file_descriptor.disable_write_event();
+
+    if (_write_complete_callback) {
+        _write_complete_callback(this);
     }
 
     // shutdown write if (1) all data is read and processed, (2) the peer closed
     // its write end first, and (3) no data needs to be sent to the peer
-    if (!_is_reading() && !_is_writing()) {
+    //
+    // - the write complete callback might have sent more in corked mode
+    if (!_is_reading() && !is_writing()) {
         shutdown_write();
     }
+
+    _shutdown_write_if_idle_and_asked_to();
 }
 
 void TcpConnectSocketfd::_close_event_callback() {
@@ -330,6 +850,13 @@ void TcpConnectSocketfd::_close_event_callback() {
     // the loop
     _pollable_file_descriptor.detach_from_poller();
 
+    _disarm_deadline_timer();
+
+    _release_worker_loop_reference_later();
+
+    // nothing will be sent anymore
+    _update_output_backpressure();
+
     // [NOTE]: the local still needs to read in the data inside the local buffer
     // even though the peer has closed its write end, which can be done within
     // this iteration
@@ -339,119 +866,832 @@ void TcpConnectSocketfd::_close_event_callback() {
     }
 }
 
-void TcpConnectSocketfd::_error_event_callback() {
-    LOG_TRACE << "tcp connect socketfd error event encountered, id: " << _id;
+void TcpConnectSocketfd::_shutdown_write_if_idle_and_asked_to() {
+    if (!_state.need_shutdown_write_when_idle || _is_stopped()
+        || _state.is_write_end_shutdown || !is_idle()) {
+
+        return;
+    }
+
+    LOG_TRACE << "TCP connection became idle, shutting down write end, id: "
+              << _id;
+
+    shutdown_write();
+}
+
+void TcpConnectSocketfd::_release_worker_loop_reference_later() {
+    if (!_state.is_held_by_worker_loop) {
+        return;
+    }
+
+    _state.is_held_by_worker_loop = false;
+
+    _loop->decrement_number_of_connections();
+
+    _loop->run_at_end_of_iteration([this]() {
+        _release_worker_loop_reference();
+    });
+}
+
+void TcpConnectSocketfd::_release_worker_loop_reference() {
+    if (!_zero_copy_owners.empty()) {
+        _hand_over_pending_zero_copy_sends();
+    }
+
+    if (!could_be_recycled() || !try_releasing_for_reuse()) {
+        release_local_reference();
+
+        return;
+    }
+
+    _recycle();
+
+    _get_loop_local_state(_loop).recycled_tcp_connect_socketfds.emplace_back(
+        this
+    );
+}
+
+void TcpConnectSocketfd::_hand_over_pending_zero_copy_sends() {
+    // the completions could only be read while the socket is open
+    if (!_state.is_reset) {
+        _receive_zero_copy_completions();
+
+        if (_zero_copy_owners.empty()) {
+            return;
+        }
+    }
+
+    auto lingering_socket_ptr = std::make_unique<LingeringSocket>(
+        _state.is_reset ? -1 : _pollable_file_descriptor.get_fd(),
+        _loop,
+        std::move(_zero_copy_owners)
+    );
+
+    _zero_copy_owners.clear();
+
+    if (!_state.is_reset) {
+        _state.is_fd_handed_over = true;
+    }
+
+    auto &lingering_sockets = _get_loop_local_state(_loop).lingering_sockets;
+
+    lingering_sockets.emplace(
+        lingering_socket_ptr.get(), std::move(lingering_socket_ptr)
+    );
+}
+
+void TcpConnectSocketfd::_recycle() {
+    if (!_state.is_reset && !_state.is_fd_handed_over) {
+        _pollable_file_descriptor.close_fd();
+    }
+
+    _close_splice_pipe();
+
+    // the memory is kept, but not the resources held by the data
+    _input_buffer.clear();
+    _output_queue.release();
+
+    clear_context();
+
+    _message_callback = {};
+    _write_complete_callback = {};
+    _close_callback = {};
+    _timeout_callback = {};
+    _high_water_mark_callback = {};
+    _low_water_mark_callback = {};
+
+    _state.is_recycled = true;
+
+    LOG_TRACE << "TCP connection recycled, id: " << _id;
+}
+
+void TcpConnectSocketfd::_reuse(
+    int fd,
+    const uint64_t &id,
+    const InetAddress &local_address,
+    const InetAddress &remote_address,
+    util::TimePoint time_stamp
+) {
+    _id = id;
+    _local_address = local_address;
+    _remote_address = remote_address;
+
+    _time_stamp.store(time_stamp, std::memory_order_relaxed);
+
+    _state = State{};
+
+    _state.last_read_time_point = time_stamp;
+    _state.last_write_time_point = time_stamp;
+
+    _pollable_file_descriptor.reuse_for(fd);
+}
+
+void TcpConnectSocketfd::_error_event_callback() {
+    LOG_TRACE << "tcp connect socketfd error event encountered, id: " << _id;
+
+    // zero-copy completions are also reported as error events
+    if (_state.is_zero_copy_enabled || !_zero_copy_owners.empty()) {
+        _receive_zero_copy_completions();
+    }
+
+    auto socketfd_errno = get_socketfd_errno(_pollable_file_descriptor.get_fd());
+
+    if (socketfd_errno == 0) {
+        return;
+    }
+
+    errno = socketfd_errno;
+
+    LOG_SYS_ERROR << "TCP connection socket error, id: " << _id;
+}
+
+void TcpConnectSocketfd::_check_and_abort_impl(
+    const PredicateType &predicate
+) {
+    LOG_TRACE << "enter event: _check_and_abort_impl";
+
+    if (predicate()) {
+        abort_from_event_loop();
+    }
+}
+
+util::TimePoint TcpConnectSocketfd::_get_earliest_deadline() const {
+    const util::TimeInterval forever{util::TimeInterval::FOREVER};
+
+    util::TimePoint earliest_deadline{util::TimePoint::FOREVER};
+
+    if (_state.idle_timeout < forever) {
+        earliest_deadline = std::min(
+            earliest_deadline,
+            std::max(_state.last_read_time_point, _state.last_write_time_point)
+                + _state.idle_timeout
+        );
+    }
+
+    if (_state.read_timeout < forever && _is_reading()) {
+        earliest_deadline = std::min(
+            earliest_deadline, _state.last_read_time_point + _state.read_timeout
+        );
+    }
+
+    if (_state.write_timeout < forever && _is_writing()) {
+        earliest_deadline = std::min(
+            earliest_deadline,
+            _state.last_write_time_point + _state.write_timeout
+        );
+    }
+
+    return earliest_deadline;
+}
+
+void TcpConnectSocketfd::_arm_deadline_timer() {
+    auto earliest_deadline = _get_earliest_deadline();
+
+    if (earliest_deadline == util::TimePoint::FOREVER) {
+        return;
+    }
+
+    // the armed one will find out the later deadline by itself
+    if (_state.is_deadline_timer_armed) {
+        if (_state.deadline_timer_expiration_time_point <= earliest_deadline) {
+            return;
+        }
+
+        _loop->cancel_a_timer(_state.deadline_timer_identifier);
+    }
+
+    // [NOTE]: the timer is cancelled as soon as the connection gets detached,
+    // which drops the reference held by it
+    _state.deadline_timer_identifier = _loop->run_at_time_point(
+        earliest_deadline,
+        0,
+        0,
+        [tcp_connect_socketfd_ptr = LocalTcpConnectSocketfdPtr(this)]() {
+            tcp_connect_socketfd_ptr->_deadline_timer_callback();
+        }
+    );
+
+    _state.is_deadline_timer_armed = true;
+    _state.deadline_timer_expiration_time_point = earliest_deadline;
+}
+
+void TcpConnectSocketfd::_disarm_deadline_timer() {
+    // [NOTE]: the timer is released by the loop right after it expires, so it
+    // must not be cancelled again after that
+    if (!_state.is_deadline_timer_armed) {
+        return;
+    }
+
+    _loop->cancel_a_timer(_state.deadline_timer_identifier);
+
+    _state.is_deadline_timer_armed = false;
+}
+
+void TcpConnectSocketfd::_deadline_timer_callback() {
+    _state.is_deadline_timer_armed = false;
+
+    if (_is_stopped()) {
+        return;
+    }
+
+    const util::TimeInterval forever{util::TimeInterval::FOREVER};
+
+    util::TimePoint current_time_point;
+
+    TimeoutType timeout_type;
+
+    if (_state.idle_timeout < forever
+        && std::max(_state.last_read_time_point, _state.last_write_time_point)
+                   + _state.idle_timeout
+               <= current_time_point) {
+
+        timeout_type = TimeoutType::IDLE;
+    }
+
+    else if (_state.read_timeout < forever && _is_reading()
+             && _state.last_read_time_point + _state.read_timeout
+                    <= current_time_point) {
+
+        timeout_type = TimeoutType::READ;
+    }
+
+    else if (_state.write_timeout < forever && _is_writing()
+             && _state.last_write_time_point + _state.write_timeout
+                    <= current_time_point) {
+
+        timeout_type = TimeoutType::WRITE;
+    }
+
+    // refreshed by the activities since the timer was armed
+    else {
+        _arm_deadline_timer();
+
+        return;
+    }
+
+    LOG_TRACE << "TCP connection timed out, id: " << _id
+              << ", type: " << static_cast<int>(timeout_type);
+
+    if (!_timeout_callback) {
+        abort_from_event_loop();
+
+        return;
+    }
+
+    _timeout_callback(this, timeout_type);
+
+    if (_is_stopped()) {
+        return;
+    }
+
+    if (timeout_type != TimeoutType::WRITE) {
+        _state.last_read_time_point = current_time_point;
+    }
+
+    if (timeout_type != TimeoutType::READ) {
+        _state.last_write_time_point = current_time_point;
+    }
+
+    _arm_deadline_timer();
+}
+
+void TcpConnectSocketfd::_start_writing() {
+    _state.last_write_time_point = _loop->get_iteration_time_point();
+
+    _pollable_file_descriptor.enable_write_event();
+
+    if (_state.write_timeout
+        < util::TimeInterval{util::TimeInterval::FOREVER}) {
+        _arm_deadline_timer();
+    }
+}
+
+void TcpConnectSocketfd::_update_output_backpressure() {
+    // nothing will be sent once stopped, so the output no longer counts
+    auto number_of_bytes_buffered =
+        _is_stopped() ? 0 : _output_queue.get_in_memory_size();
+
+    if (number_of_bytes_buffered > _state.number_of_output_bytes_accounted) {
+        _loop->increase_number_of_buffered_output_bytes(
+            number_of_bytes_buffered - _state.number_of_output_bytes_accounted
+        );
+    }
+
+    else if (number_of_bytes_buffered
+             < _state.number_of_output_bytes_accounted) {
+        _loop->decrease_number_of_buffered_output_bytes(
+            _state.number_of_output_bytes_accounted - number_of_bytes_buffered
+        );
+    }
+
+    _state.number_of_output_bytes_accounted = number_of_bytes_buffered;
+
+    if (_is_stopped()) {
+        return;
+    }
+
+    if (!_state.is_output_backpressured) {
+        // [NOTE]: only the connections that hold some output are paused by the
+        // loop-wide cap, since they are the ones that will drain and resume
+        // by themselves
+        if (number_of_bytes_buffered == 0
+            || !((_state.high_water_mark > 0
+                  && number_of_bytes_buffered >= _state.high_water_mark)
+                 || _loop->is_buffered_output_capped())) {
+
+            return;
+        }
+
+        _state.is_output_backpressured = true;
+
+        _pollable_file_descriptor.pause_read_event();
+
+        LOG_TRACE << "TCP connection reading paused, id: " << _id
+                  << ", buffered: " << number_of_bytes_buffered;
+
+        if (_high_water_mark_callback) {
+            _high_water_mark_callback(this, number_of_bytes_buffered);
+        }
+
+        return;
+    }
+
+    if (number_of_bytes_buffered > _state.low_water_mark) {
+        return;
+    }
+
+    _state.is_output_backpressured = false;
+
+    _pollable_file_descriptor.resume_read_event();
+
+    LOG_TRACE << "TCP connection reading resumed, id: " << _id
+              << ", buffered: " << number_of_bytes_buffered;
+
+    if (_low_water_mark_callback) {
+        _low_water_mark_callback(this, number_of_bytes_buffered);
+    }
+}
+
+size_t TcpConnectSocketfd::_receive_all_data() {
+#ifdef __USE_IO_URING_POLLER
+    if (_pollable_file_descriptor.get_read_mode()
+        == PollableFileDescriptor::READ_MODE_MULTISHOT_RECEIVE) {
+
+        return _receive_all_completed_data();
+    }
+#endif
+
+    char overflow_buffer[_RECEIVE_OVERFLOW_BUFFER_SIZE];
+
+    size_t total_bytes_read = 0;
+
+    while (true) {
+        iovec iovecs[_MAX_NUMBER_OF_RECEIVE_IOVECS + 1];
+
+        auto number_of_iovecs = _input_buffer.get_writable_iovecs(
+            iovecs, _MAX_NUMBER_OF_RECEIVE_IOVECS
+        );
+
+        size_t writable_size = 0;
+
+        for (int i = 0; i < number_of_iovecs; i++) {
+            writable_size += iovecs[i].iov_len;
+        }
+
+        iovecs[number_of_iovecs].iov_base = overflow_buffer;
+        iovecs[number_of_iovecs].iov_len = _RECEIVE_OVERFLOW_BUFFER_SIZE;
+
+        // reads into the spare space of the input buffer first, and the stack
+        // only if it is not enough
+        ssize_t bytes_read = ::readv(
+            _pollable_file_descriptor.get_fd(), iovecs, number_of_iovecs + 1
+        );
+
+        LOG_TRACE << "bytes_read: " << bytes_read;
+
+        // have read in some data but maybe not all
+        if (bytes_read > 0) {
+            auto number_of_bytes_read = static_cast<size_t>(bytes_read);
+
+            if (number_of_bytes_read <= writable_size) {
+                _input_buffer.forward_write_position(number_of_bytes_read);
+            }
+
+            else {
+                _input_buffer.forward_write_position(writable_size);
+
+                // only the overflowed part is copied, after which the buffer
+                // will have grown large enough for the next time
+                _input_buffer.append(
+                    overflow_buffer, number_of_bytes_read - writable_size
+                );
+            }
+
+            total_bytes_read += number_of_bytes_read;
+
+            continue;
+        }
+
+        // the peer have closed its write end
+        else if (bytes_read == 0) {
+            LOG_TRACE << "disable read event";
+
+            _pollable_file_descriptor.disable_read_event();
+
+            break;
+        }
+
+        // read falis
+        else {
+            // current iteration of reading is finished
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+
+            else if (errno == EINTR) {
+                continue;
+            }
+
+            // actual error occured
+            else {
+                // get system errno
+                LOG_SYS_ERROR << "falied when reading from the socket";
+
+                // get socketfd errno
+                _error_event_callback();
+
+                break;
+            }
+        }
+    }
+
+    return total_bytes_read;
+}
+
+#ifdef __USE_IO_URING_POLLER
+size_t TcpConnectSocketfd::_receive_all_completed_data() {
+    auto &event_poller = _loop->get_event_poller();
+
+    auto &completions = _pollable_file_descriptor.get_completions();
+
+    size_t total_bytes_read = 0;
+
+    for (const auto &completion : completions) {
+        LOG_TRACE << "bytes_read: " << completion.result;
+
+        if (completion.result > 0) {
+            auto buffer_id = static_cast<uint16_t>(
+                completion.flags >> IORING_CQE_BUFFER_SHIFT
+            );
+
+            auto number_of_bytes_read = static_cast<size_t>(completion.result);
+
+            _input_buffer.append(
+                event_poller.get_provided_buffer(buffer_id),
+                number_of_bytes_read
+            );
+
+            event_poller.recycle_provided_buffer(buffer_id);
+
+            total_bytes_read += number_of_bytes_read;
+        }
+
+        // the peer have closed its write end
+        else if (completion.result == 0) {
+            LOG_TRACE << "disable read event";
+
+            _pollable_file_descriptor.disable_read_event();
+        }
+
+        // actual error occured
+        else {
+            errno = -completion.result;
+
+            LOG_SYS_ERROR << "falied when receiving from the socket";
+
+            _error_event_callback();
+        }
+    }
+
+    completions.clear();
+
+    return total_bytes_read;
+}
+#endif
+
+size_t TcpConnectSocketfd::_send_as_many_data(
+    const char *data, size_t data_size, bool has_more
+) {
+    if (data_size == 0) {
+        return 0;
+    }
+
+    size_t total_number_of_bytes_sent = 0;
+
+    while (total_number_of_bytes_sent < data_size) {
+        ssize_t current_number_of_bytes_sent = ::send(
+            _pollable_file_descriptor.get_fd(),
+            data + total_number_of_bytes_sent,
+            data_size - total_number_of_bytes_sent,
+            MSG_NOSIGNAL // prevent shutting down by a single SIGPIPE
+                | (has_more ? MSG_MORE : 0)
+        );
+
+        if (current_number_of_bytes_sent >= 0) {
+            total_number_of_bytes_sent +=
+                static_cast<size_t>(current_number_of_bytes_sent);
+
+            _state.last_write_time_point = _loop->get_iteration_time_point();
+        }
+
+        else if (current_number_of_bytes_sent == -1) {
+            // socket's send buffer is full
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+
+            // the peer abruptly closed its read end (or the whole connection)
+            else if (errno == EPIPE || errno == ECONNRESET) {
+                LOG_TRACE << "EPIPE or ECONNRESET encountered, connection "
+                             "abort, id: "
+                          << _id;
+
+                // the peer does not care what we send to him, so we won't care
+                // what he sends to us either
+                abort_from_event_loop();
+
+                return data_size; // fake
+            }
+
+            // actual error occured
+            else {
+                // get system errno
+                LOG_SYS_ERROR << "falied when writing to the socket";
+
+                // get socketfd errno
+                _error_event_callback();
+
+                break;
+            }
+        }
+    }
+
+    return total_number_of_bytes_sent;
+}
+
+size_t TcpConnectSocketfd::_send_as_many_iovecs(
+    const iovec *iovecs, int number_of_iovecs, bool has_more
+) {
+    size_t total_number_of_bytes_sent = 0;
+
+    // the front iovec might be partially sent, so the iovecs are sent through
+    // a copy of them
+    iovec remaining_iovecs[_MAX_NUMBER_OF_IOVECS];
+
+    int next_iovec_index = 0;
+    size_t next_iovec_offset = 0;
+
+    while (true) {
+        int number_of_remaining_iovecs = 0;
+
+        int i = next_iovec_index;
+
+        for (; i < number_of_iovecs
+               && number_of_remaining_iovecs < _MAX_NUMBER_OF_IOVECS;
+             i++) {
+
+            auto offset = i == next_iovec_index ? next_iovec_offset : 0;
+
+            if (iovecs[i].iov_len == offset) {
+                continue;
+            }
+
+            remaining_iovecs[number_of_remaining_iovecs].iov_base =
+                static_cast<char *>(iovecs[i].iov_base) + offset;
+            remaining_iovecs[number_of_remaining_iovecs].iov_len =
+                iovecs[i].iov_len - offset;
 
-    errno = get_socketfd_errno(_pollable_file_descriptor.get_fd());
+            ++number_of_remaining_iovecs;
+        }
 
-    LOG_SYS_ERROR << "TCP connection socket error, id: " << _id;
-}
+        if (number_of_remaining_iovecs == 0) {
+            break;
+        }
 
-void TcpConnectSocketfd::_check_and_abort_impl(PredicateType predicate) {
-    LOG_TRACE << "enter event: _check_and_abort_impl";
+        msghdr message{};
 
-    if (predicate()) {
-        abort_from_event_loop();
-    }
-}
+        message.msg_iov = remaining_iovecs;
+        message.msg_iovlen = static_cast<size_t>(number_of_remaining_iovecs);
 
-size_t TcpConnectSocketfd::_receive_all_data() {
-    size_t total_bytes_read = 0;
+        // the iovecs that did not fit this time also count as more to come
+        bool is_more_coming = has_more || i < number_of_iovecs;
 
-    while (true) {
-        // reads into the stack first
-        ssize_t bytes_read = ::recv(
+        ssize_t current_number_of_bytes_sent = ::sendmsg(
             _pollable_file_descriptor.get_fd(),
-            recv_buffer,
-            _RECEIVE_DATA_SIZE,
-            0
+            &message,
+            MSG_NOSIGNAL // prevent shutting down by a single SIGPIPE
+                | (is_more_coming ? MSG_MORE : 0)
         );
 
-        LOG_TRACE << "bytes_read: " << bytes_read;
+        if (current_number_of_bytes_sent >= 0) {
+            auto number_of_bytes_sent =
+                static_cast<size_t>(current_number_of_bytes_sent);
 
-        // have read in some data but maybe not all
-        if (bytes_read > 0) {
-            // writes to TCP buffer only after the size is known
-            _input_buffer.append(recv_buffer, bytes_read);
+            total_number_of_bytes_sent += number_of_bytes_sent;
 
-            total_bytes_read += bytes_read;
+            _state.last_write_time_point = _loop->get_iteration_time_point();
 
-            // [NOTE]: here the read-first-and-then-write kind of operation
-            // might seem a little redundant at first, but considering the fact
-            // that making space in-place inside the TCP buffer in the first
-            // place may cause the entire TCP buffer to be reallocated and
-            // copied all over again, a little loss of double-copying a
-            // temporary buffer looks just insignificant right away
+            // advances the position by the bytes sent
+            number_of_bytes_sent += next_iovec_offset;
 
-            continue;
-        }
+            while (next_iovec_index < number_of_iovecs
+                   && number_of_bytes_sent
+                          >= iovecs[next_iovec_index].iov_len) {
 
-        // the peer have closed its write end
-        else if (bytes_read == 0) {
-            LOG_TRACE << "disable read event";
+                number_of_bytes_sent -= iovecs[next_iovec_index].iov_len;
 
-            _pollable_file_descriptor.disable_read_event();
+                ++next_iovec_index;
+            }
 
-            break;
+            next_iovec_offset = number_of_bytes_sent;
         }
 
-        // read falis
         else {
-            // current iteration of reading is finished
+            // socket's send buffer is full
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 break;
             }
 
+            else if (errno == EINTR) {
+                continue;
+            }
+
+            // the peer abruptly closed its read end (or the whole connection)
+            else if (errno == EPIPE || errno == ECONNRESET) {
+                LOG_TRACE << "EPIPE or ECONNRESET encountered, connection "
+                             "abort, id: "
+                          << _id;
+
+                // the peer does not care what we send to him, so we won't care
+                // what he sends to us either
+                abort_from_event_loop();
+
+                break;
+            }
+
             // actual error occured
             else {
                 // get system errno
-                LOG_SYS_ERROR << "falied when reading from the socket";
+                LOG_SYS_ERROR << "falied when writing to the socket";
 
                 // get socketfd errno
                 _error_event_callback();
+
+                break;
             }
         }
     }
 
-    return total_bytes_read;
+    return total_number_of_bytes_sent;
 }
 
-size_t
-TcpConnectSocketfd::_send_as_many_data(const char *data, size_t data_size) {
-    if (data_size == 0) {
-        return 0;
-    }
+size_t TcpConnectSocketfd::_send_as_many_queued_data() {
+    auto fd = _pollable_file_descriptor.get_fd();
 
     size_t total_number_of_bytes_sent = 0;
 
-    while (total_number_of_bytes_sent < data_size) {
-        ssize_t current_number_of_bytes_sent = ::send(
-            _pollable_file_descriptor.get_fd(),
-            data + total_number_of_bytes_sent,
-            data_size - total_number_of_bytes_sent,
-            MSG_NOSIGNAL // prevent shutting down by a single SIGPIPE
-        );
+    while (!_output_queue.empty()) {
+        ssize_t current_number_of_bytes_sent;
+
+        if (_output_queue.is_front_file_range()) {
+            // [NOTE]: SIGPIPE raised here is blocked by the loop thread, see
+            // `EventLoop::EventLoop`
+            auto &file_range = _output_queue.front();
+
+            if (file_range.is_splice_needed()) {
+                current_number_of_bytes_sent = _splice_file_range(file_range);
+            }
+
+            else {
+                auto file_offset = file_range.get_file_offset();
+
+                current_number_of_bytes_sent = ::sendfile(
+                    fd, file_range.get_fd(), &file_offset, file_range.get_size()
+                );
+
+                // not supported by the file system; try splicing it next time
+                if (current_number_of_bytes_sent == -1
+                    && (errno == EINVAL || errno == ENOSYS)) {
+                    file_range.set_splice_needed();
+
+                    continue;
+                }
+            }
+
+            // the file itself could not be read, e.g. an I/O error of the
+            // disk, after which the response could never be completed; the
+            // socketfd is fine, so its error must not be looked up
+            if (current_number_of_bytes_sent == -1 && errno != EAGAIN
+                && errno != EWOULDBLOCK && errno != EINTR && errno != EPIPE
+                && errno != ECONNRESET) {
+
+                LOG_SYS_ERROR << "failed when reading the file range to send, "
+                                 "connection abort, id: "
+                              << _id;
+
+                abort_from_event_loop();
+
+                break;
+            }
+
+            // the file is shorter than what was promised, e.g. truncated after
+            // being queued, so the peer would be left waiting for the bytes
+            // that never come, or take whatever follows as part of the file
+            if (current_number_of_bytes_sent == 0) {
+                LOG_ERROR << "unexpected end of file when sending file range, "
+                             "connection abort, id: "
+                          << _id;
+
+                abort_from_event_loop();
+
+                break;
+            }
+        }
+
+        else if (_state.is_zero_copy_enabled
+                 && _output_queue.front().get_size()
+                        >= _state.zero_copy_threshold) {
+
+            current_number_of_bytes_sent = _send_front_segment_with_zero_copy();
+        }
+
+        else {
+            iovec iovecs[_MAX_NUMBER_OF_IOVECS];
+
+            msghdr message{};
+
+            // large segments are left to be sent alone with zero-copy
+            message.msg_iov = iovecs;
+            message.msg_iovlen = static_cast<size_t>(
+                _output_queue.gather_leading_memory_segments(
+                    iovecs,
+                    _MAX_NUMBER_OF_IOVECS,
+                    _state.is_zero_copy_enabled ? _state.zero_copy_threshold
+                                          : static_cast<size_t>(-1)
+                )
+            );
+
+            size_t number_of_bytes_gathered = 0;
+
+            for (size_t i = 0; i < message.msg_iovlen; i++) {
+                number_of_bytes_gathered += iovecs[i].iov_len;
+            }
+
+            // more is coming right after, e.g. a file range after a response
+            // header, which the kernel could put into the same segment
+            bool is_more_coming =
+                number_of_bytes_gathered < _output_queue.get_readable_size();
+
+            current_number_of_bytes_sent = ::sendmsg(
+                fd,
+                &message,
+                MSG_NOSIGNAL // prevent shutting down by a single SIGPIPE
+                    | (is_more_coming ? MSG_MORE : 0)
+            );
+        }
 
         if (current_number_of_bytes_sent >= 0) {
-            total_number_of_bytes_sent +=
+            auto number_of_bytes_sent =
                 static_cast<size_t>(current_number_of_bytes_sent);
+
+            _output_queue.forward(number_of_bytes_sent);
+
+            total_number_of_bytes_sent += number_of_bytes_sent;
+
+            _state.last_write_time_point = _loop->get_iteration_time_point();
         }
 
-        else if (current_number_of_bytes_sent == -1) {
+        else {
             // socket's send buffer is full
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 break;
             }
 
+            else if (errno == EINTR) {
+                continue;
+            }
+
             // the peer abruptly closed its read end (or the whole connection)
-            else if (errno == EPIPE) {
-                LOG_TRACE << "EPIPE encountered, connection abort, id: " << _id;
+            else if (errno == EPIPE || errno == ECONNRESET) {
+                LOG_TRACE << "EPIPE or ECONNRESET encountered, connection "
+                             "abort, id: "
+                          << _id;
 
                 // the peer does not care what we send to him, so we won't care
                 // what he sends to us either
                 abort_from_event_loop();
 
-                return data_size; // fake
+                break;
             }
 
             // actual error occured
@@ -461,6 +1701,8 @@ TcpConnectSocketfd::_send_as_many_data(const char *data, size_t data_size) {
 
                 // get socketfd errno
                 _error_event_callback();
+
+                break;
             }
         }
     }
@@ -468,4 +1710,325 @@ TcpConnectSocketfd::_send_as_many_data(const char *data, size_t data_size) {
     return total_number_of_bytes_sent;
 }
 
+void TcpConnectSocketfd::_send_queued_data() {
+    // leave the writing to the event callback if already started listening
+    if (_is_writing()) {
+        _update_output_backpressure();
+
+        return;
+    }
+
+    if (_state.use_corked_mode) {
+        _schedule_corked_output_flush();
+
+        _update_output_backpressure();
+
+        return;
+    }
+
+    _flush_queued_data();
+}
+
+void TcpConnectSocketfd::_flush_queued_data() {
+    // try sending the data right now
+    _send_as_many_queued_data();
+
+    if (_is_stopped()) {
+        return;
+    }
+
+    // no need for further writing if all data is sent
+    if (_output_queue.empty()) {
+        if (_write_complete_callback) {
+            _write_complete_callback(this);
+        }
+
+        return;
+    }
+
+    // otherwise leave what's left to the callback as well
+    _start_writing();
+
+    _update_output_backpressure();
+}
+
+void TcpConnectSocketfd::_schedule_corked_output_flush() {
+    if (_state.is_corked_output_flush_scheduled) {
+        return;
+    }
+
+    _state.is_corked_output_flush_scheduled = true;
+
+    // keeps the connection alive till the end of the iteration
+    _loop->run_at_end_of_iteration(std::bind(
+        &TcpConnectSocketfd::_flush_corked_output,
+        LocalTcpConnectSocketfdPtr(this)
+    ));
+}
+
+void TcpConnectSocketfd::_flush_corked_output() {
+    _state.is_corked_output_flush_scheduled = false;
+
+    // the output is dropped by closing or shutting down in the meanwhile
+    if (_is_stopped() || _state.is_write_end_shutdown) {
+        return;
+    }
+
+    // left to the write event callback if enabled in the meanwhile, e.g. by
+    // turning the corked mode off
+    if (_is_writing()) {
+        return;
+    }
+
+    _flush_queued_data();
+
+    if (_is_stopped() || _state.is_write_end_shutdown) {
+        return;
+    }
+
+    // same as in the write event callback, since the peer might have closed
+    // its write end while the output was held back
+    if (!_is_reading() && !is_writing()) {
+        shutdown_write();
+    }
+
+    _shutdown_write_if_idle_and_asked_to();
+}
+
+ssize_t
+TcpConnectSocketfd::_splice_file_range(TcpOutputQueue::Segment &file_range) {
+    if (_splice_pipe_fds[0] == -1
+        && ::pipe2(_splice_pipe_fds, O_NONBLOCK | O_CLOEXEC) == -1) {
+        LOG_SYS_ERROR << "failed to create splice pipe, id: " << _id;
+
+        return -1;
+    }
+
+    auto number_of_bytes_not_in_pipe =
+        file_range.get_size() - _number_of_bytes_in_splice_pipe;
+
+    // file -- W --> pipe
+    if (number_of_bytes_not_in_pipe > 0) {
+        auto file_offset =
+            file_range.get_file_offset()
+            + static_cast<off_t>(_number_of_bytes_in_splice_pipe);
+
+        auto number_of_bytes_spliced = ::splice(
+            file_range.get_fd(),
+            file_range.is_seekable() ? &file_offset : nullptr,
+            _splice_pipe_fds[1],
+            nullptr,
+            number_of_bytes_not_in_pipe,
+            SPLICE_F_MOVE | SPLICE_F_NONBLOCK
+        );
+
+        if (number_of_bytes_spliced > 0) {
+            _number_of_bytes_in_splice_pipe +=
+                static_cast<size_t>(number_of_bytes_spliced);
+        }
+
+        // the pipe is full (which is fine) or an actual error occured
+        else if (number_of_bytes_spliced == -1 && errno != EAGAIN) {
+            return -1;
+        }
+
+        // end of file
+        else if (number_of_bytes_spliced == 0
+                 && _number_of_bytes_in_splice_pipe == 0) {
+            return 0;
+        }
+    }
+
+    if (_number_of_bytes_in_splice_pipe == 0) {
+        errno = EAGAIN;
+
+        return -1;
+    }
+
+    // pipe -- W --> fd
+    auto number_of_bytes_sent = ::splice(
+        _splice_pipe_fds[0],
+        nullptr,
+        _pollable_file_descriptor.get_fd(),
+        nullptr,
+        _number_of_bytes_in_splice_pipe,
+        SPLICE_F_MOVE | SPLICE_F_NONBLOCK
+    );
+
+    if (number_of_bytes_sent > 0) {
+        _number_of_bytes_in_splice_pipe -=
+            static_cast<size_t>(number_of_bytes_sent);
+    }
+
+    return number_of_bytes_sent;
+}
+
+void TcpConnectSocketfd::_close_splice_pipe() {
+    if (_splice_pipe_fds[0] == -1) {
+        return;
+    }
+
+    ::close(_splice_pipe_fds[0]);
+    ::close(_splice_pipe_fds[1]);
+
+    _splice_pipe_fds[0] = -1;
+    _splice_pipe_fds[1] = -1;
+
+    _number_of_bytes_in_splice_pipe = 0;
+}
+
+void TcpConnectSocketfd::_enable_zero_copy() {
+    int set = 1;
+
+    if (::setsockopt(
+            _pollable_file_descriptor.get_fd(),
+            SOL_SOCKET,
+            SO_ZEROCOPY,
+            &set,
+            static_cast<socklen_t>(sizeof set)
+        )
+        == -1) {
+
+        // not supported by the kernel (before 4.14) or the socket; falls back
+        // to copying silently
+        LOG_TRACE << "failed to enable SO_ZEROCOPY, id: " << _id;
+
+        return;
+    }
+
+    _state.is_zero_copy_enabled = true;
+}
+
+ssize_t TcpConnectSocketfd::_send_front_segment_with_zero_copy() {
+    auto fd = _pollable_file_descriptor.get_fd();
+
+    // shared before sending so that the data pointer stays the same
+    auto shared_owner = _output_queue.share_front();
+
+    auto &segment = _output_queue.front();
+
+    auto number_of_bytes_sent = ::send(
+        fd,
+        segment.get_data(),
+        segment.get_size(),
+        MSG_NOSIGNAL | MSG_ZEROCOPY
+    );
+
+    // the kernel counts only the sends that actually queued some data
+    if (number_of_bytes_sent > 0) {
+        _zero_copy_owners.push_back(
+            {_state.next_zero_copy_sequence_number++, std::move(shared_owner)}
+        );
+    }
+
+    // the locked memory limit of the socket is reached; falls back to copying
+    // this time
+    else if (number_of_bytes_sent == -1 && errno == ENOBUFS) {
+        number_of_bytes_sent = ::send(
+            fd, segment.get_data(), segment.get_size(), MSG_NOSIGNAL
+        );
+    }
+
+    return number_of_bytes_sent;
+}
+
+void TcpConnectSocketfd::_receive_zero_copy_completions() {
+    // the kernel fell back to copying (e.g. over loopback or with a NIC
+    // lacking scatter-gather), so pinning pages only costs more from now on
+    if (_read_zero_copy_completions(
+            _pollable_file_descriptor.get_fd(), _zero_copy_owners
+        )) {
+
+        _state.is_zero_copy_enabled = false;
+    }
+}
+
+bool TcpConnectSocketfd::_read_zero_copy_completions(
+    int fd, std::deque<ZeroCopyOwner> &zero_copy_owners
+) {
+    bool is_copied = false;
+
+    while (true) {
+        char control[128];
+
+        msghdr message{};
+
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        if (::recvmsg(fd, &message, MSG_ERRQUEUE) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_SYS_ERROR << "failed when reading the error queue, fd: "
+                              << fd;
+            }
+
+            break;
+        }
+
+        for (auto control_message = CMSG_FIRSTHDR(&message); control_message;
+             control_message = CMSG_NXTHDR(&message, control_message)) {
+
+            bool is_socket_error =
+                (control_message->cmsg_level == SOL_IP
+                 && control_message->cmsg_type == IP_RECVERR)
+                || (control_message->cmsg_level == SOL_IPV6
+                    && control_message->cmsg_type == IPV6_RECVERR);
+
+            if (!is_socket_error) {
+                continue;
+            }
+
+            auto socket_error = reinterpret_cast<const sock_extended_err *>(
+                CMSG_DATA(control_message)
+            );
+
+            if (socket_error->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+
+            if (socket_error->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                is_copied = true;
+            }
+
+            // the range is inclusive and might cover multiple sends
+            _release_zero_copy_owners(
+                zero_copy_owners, socket_error->ee_info, socket_error->ee_data
+            );
+        }
+    }
+
+    return is_copied;
+}
+
+void TcpConnectSocketfd::_release_zero_copy_owners(
+    std::deque<ZeroCopyOwner> &zero_copy_owners,
+    uint32_t first_sequence_number,
+    uint32_t last_sequence_number
+) {
+    // the sequence numbers might wrap around
+    auto range_length = last_sequence_number - first_sequence_number;
+
+    for (auto &zero_copy_owner : zero_copy_owners) {
+        if (zero_copy_owner.sequence_number - first_sequence_number
+            <= range_length) {
+
+            zero_copy_owner.shared_owner.reset();
+        }
+    }
+
+    // completions are usually reported in order
+    while (!zero_copy_owners.empty()
+           && !zero_copy_owners.front().shared_owner) {
+
+        zero_copy_owners.pop_front();
+    }
+}
+
+std::atomic<size_t>
+    TcpConnectSocketfd::_max_number_of_recycled_connections_per_loop{256};
+
 } // namespace xubinh_server
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "log_builder.h"
+#include "tcp_output_queue.h"
+
+namespace xubinh_server {
+
+TcpOutputQueue::Segment::Segment(StringType &&owned_bytes) noexcept
+    : _type(OWNED_BYTES)
+    , _owned_bytes(std::move(owned_bytes))
+    , _size(_owned_bytes.size()) {
+}
+
+TcpOutputQueue::Segment::Segment(
+    SharedOwnerType &&shared_owner, const char *data, size_t data_size
+) noexcept
+    : _type(SHARED_SLICE)
+    , _shared_owner(std::move(shared_owner))
+    , _data(data)
+    , _size(data_size) {
+}
+
+TcpOutputQueue::Segment::Segment(
+    void *mapped_address, size_t mapped_length
+) noexcept
+    : _type(MAPPED_REGION)
+    , _data(static_cast<const char *>(mapped_address))
+    , _size(mapped_length) {
+}
+
+TcpOutputQueue::Segment::Segment(
+    int fd, off_t offset, size_t size, bool need_close_fd, bool is_seekable
+) noexcept
+    : _type(FILE_RANGE)
+    , _fd(fd)
+    , _file_offset(offset)
+    , _need_close_fd(need_close_fd)
+    , _is_seekable(is_seekable)
+    , _is_splice_needed(!is_seekable)
+    , _size(size) {
+}
+
+TcpOutputQueue::Segment::Segment(Segment &&other) noexcept
+    : _type(other._type)
+    , _owned_bytes(std::move(other._owned_bytes))
+    , _shared_owner(std::move(other._shared_owner))
+    , _data(other._data)
+    , _fd(other._fd)
+    , _file_offset(other._file_offset)
+    , _need_close_fd(other._need_close_fd)
+    , _is_seekable(other._is_seekable)
+    , _is_splice_needed(other._is_splice_needed)
+    , _size(other._size)
+    , _number_of_bytes_consumed(other._number_of_bytes_consumed) {
+
+    // disarm the moved-from segment so that the resources are not released
+    // twice
+    other._data = nullptr;
+    other._fd = -1;
+    other._need_close_fd = false;
+}
+
+void TcpOutputQueue::Segment::_release() noexcept {
+    switch (_type) {
+    case MAPPED_REGION:
+        if (_data && ::munmap(const_cast<char *>(_data), _size) == -1) {
+            LOG_SYS_ERROR << "failed to munmap the output region";
+        }
+
+        _data = nullptr;
+
+        break;
+
+    case FILE_RANGE:
+        if (_need_close_fd && _fd != -1 && ::close(_fd) == -1) {
+            LOG_SYS_ERROR << "failed to close the output file, fd: " << _fd;
+        }
+
+        _fd = -1;
+
+        break;
+
+    default:
+        break;
+    }
+}
+
+void TcpOutputQueue::append(const char *data, size_t data_size) {
+    if (data_size == 0) {
+        return;
+    }
+
+    if (!_segments.empty()) {
+        auto &last_segment = _segments.back();
+
+        if (last_segment._type == OWNED_BYTES
+            && last_segment._owned_bytes.size() < _MAX_COALESCING_SIZE) {
+
+            last_segment._owned_bytes.append(data, data_size);
+            last_segment._size += data_size;
+
+            _readable_size += data_size;
+            _in_memory_size += data_size;
+
+            return;
+        }
+    }
+
+    _segments.emplace_back(StringType(data, data_size));
+
+    _readable_size += data_size;
+    _in_memory_size += data_size;
+}
+
+void TcpOutputQueue::append(StringType &&data) {
+    if (data.empty()) {
+        return;
+    }
+
+    _readable_size += data.size();
+    _in_memory_size += data.size();
+
+    _segments.emplace_back(std::move(data));
+}
+
+void TcpOutputQueue::append_shared_slice(
+    SharedOwnerType shared_owner, const char *data, size_t data_size
+) {
+    if (data_size == 0) {
+        return;
+    }
+
+    _segments.emplace_back(std::move(shared_owner), data, data_size);
+
+    _readable_size += data_size;
+    _in_memory_size += data_size;
+}
+
+void TcpOutputQueue::append_mapped_region(
+    void *mapped_address, size_t mapped_length
+) {
+    // nothing could have been mapped, and `munmap(2)` rejects an empty range
+    if (mapped_length == 0) {
+        return;
+    }
+
+    _segments.emplace_back(mapped_address, mapped_length);
+
+    _readable_size += mapped_length;
+    _in_memory_size += mapped_length;
+}
+
+void TcpOutputQueue::append_file_range(
+    int fd, off_t offset, size_t size, bool need_close_fd, bool is_seekable
+) {
+    // constructs the segment even if empty so that the fd is released properly
+    _segments.emplace_back(fd, offset, size, need_close_fd, is_seekable);
+
+    _readable_size += size;
+
+    if (size == 0) {
+        _segments.pop_back();
+    }
+}
+
+int TcpOutputQueue::gather_leading_memory_segments(
+    iovec *iovecs, int max_number_of_iovecs, size_t max_segment_size
+) const {
+    int number_of_iovecs = 0;
+
+    for (const auto &segment : _segments) {
+        if (number_of_iovecs == max_number_of_iovecs
+            || !segment.is_in_memory()
+            || segment.get_size() >= max_segment_size) {
+            break;
+        }
+
+        iovecs[number_of_iovecs].iov_base =
+            const_cast<char *>(segment.get_data());
+        iovecs[number_of_iovecs].iov_len = segment.get_size();
+
+        ++number_of_iovecs;
+    }
+
+    return number_of_iovecs;
+}
+
+TcpOutputQueue::SharedOwnerType TcpOutputQueue::share_front() {
+    auto &segment = _segments.front();
+
+    switch (segment._type) {
+    case OWNED_BYTES: {
+        // [NOTE]: the data pointer must be taken after the move, since short
+        // strings are stored inline
+        auto owned_bytes =
+            std::make_shared<StringType>(std::move(segment._owned_bytes));
+
+        segment._data = owned_bytes->c_str();
+        segment._shared_owner = std::move(owned_bytes);
+        segment._type = SHARED_SLICE;
+
+        break;
+    }
+
+    case MAPPED_REGION: {
+        auto mapped_length = segment._size;
+
+        segment._shared_owner = SharedOwnerType(
+            segment._data,
+            [mapped_length](const void *mapped_address) {
+                if (::munmap(const_cast<void *>(mapped_address), mapped_length)
+                    == -1) {
+                    LOG_SYS_ERROR << "failed to munmap the output region";
+                }
+            }
+        );
+        segment._type = SHARED_SLICE;
+
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    return segment._shared_owner;
+}
+
+void TcpOutputQueue::forward(size_t number_of_bytes_sent) {
+    while (number_of_bytes_sent > 0 && !_segments.empty()) {
+        auto &first_segment = _segments.front();
+
+        auto number_of_bytes_consumed =
+            std::min(number_of_bytes_sent, first_segment.get_size());
+
+        first_segment.forward(number_of_bytes_consumed);
+
+        number_of_bytes_sent -= number_of_bytes_consumed;
+        _readable_size -= number_of_bytes_consumed;
+
+        if (first_segment.is_in_memory()) {
+            _in_memory_size -= number_of_bytes_consumed;
+        }
+
+        if (first_segment.get_size() == 0) {
+            _segments.pop_front();
+        }
+    }
+}
+
+} // namespace xubinh_server
@@ -1,8 +1,12 @@
+#include <limits>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
 #include "tcp_server.h"
 #include "log_builder.h"
 #include "log_collector.h"
 #include "util/mutex_guard.h"
-#include "util/this_thread.h"
 #include "util/time_point.h"
 
 namespace xubinh_server {
@@ -14,19 +18,26 @@ TcpServer::~TcpServer() {
 
     LOG_INFO << "entering destructor: TcpServer";
 
-    // deal with those connections that were too late to be even registered in
-    // the event loops of worker threads
-    if (!_tcp_connect_socketfds.empty()) {
-        LOG_WARN << "TCP server stopped when there are still connections "
-                    "left, total number: "
-                 << _tcp_connect_socketfds.size()
-                 << ", closing them abruptly...";
+    // the main loop goes on running after `stop()` if the thread pool is
+    // disabled, so the connections it has not finished draining are aborted
+    // here, together with the drain deadline that refers to the server
+    if (_thread_pool_capacity == 0 && !_connection_tables.empty()) {
+        auto &connection_table = *_connection_tables[0];
+
+        if (connection_table.is_drain_timer_armed) {
+            _loop->cancel_a_timer(connection_table.drain_timer_identifier);
 
-        // do the work for worker threads
-        for (auto &pair : _tcp_connect_socketfds) {
-            auto &tcp_connect_socketfd_ptr = pair.second;
+            connection_table.is_drain_timer_armed = false;
+        }
+
+        _abort_remaining_tcp_connect_socketfds(_loop);
+    }
 
-            tcp_connect_socketfd_ptr->reset_connection();
+    // the worker loops have closed their own connections before being joined
+    // (see `stop`)
+    for (auto &connection_table_ptr : _connection_tables) {
+        if (!connection_table_ptr->tcp_connect_socketfds.empty()) {
+            LOG_FATAL << "assert: no connection is left after stopping";
         }
     }
 
@@ -40,15 +51,64 @@ TcpServer::~TcpServer() {
     LOG_INFO << "finished joining TCP connection destroying thread";
 #endif
 
+    std::string max_numbers_of_connections;
+
+    for (auto &connection_table_ptr : _connection_tables) {
+        if (!max_numbers_of_connections.empty()) {
+            max_numbers_of_connections += ", ";
+        }
+
+        max_numbers_of_connections +=
+            std::to_string(connection_table_ptr->max_number_of_tcp_connections);
+    }
+
+    LOG_INFO << "max number of connections per loop: "
+             << max_numbers_of_connections;
+
+    auto number_of_dispatch_batches = get_number_of_dispatch_batches();
+
+    if (number_of_dispatch_batches > 0) {
+        LOG_INFO << "dispatch batches: " << number_of_dispatch_batches
+                 << ", average size: "
+                 << static_cast<double>(get_number_of_dispatched_connections())
+                        / static_cast<double>(number_of_dispatch_batches)
+                 << ", max size: " << get_max_dispatch_batch_size();
+    }
+
     LOG_INFO << "exit destructor: TcpServer";
 
     // for the case where worker threads got blocked and thread pool
     // couldn't get destroyed
     LogCollector::flush();
+}
 
-    ::fprintf(
-        stderr, "Max number of connections: %ld\n", _max_number_of_connections
-    );
+uint64_t TcpServer::get_number_of_accepted_connections() const {
+    uint64_t number_of_accepted_connections = 0;
+
+    if (_listen_socketfd) {
+        number_of_accepted_connections +=
+            _listen_socketfd->get_number_of_accepted_connections();
+    }
+
+    for (const auto &listen_socketfd_ptr : _worker_listen_socketfds) {
+        number_of_accepted_connections +=
+            listen_socketfd_ptr->get_number_of_accepted_connections();
+    }
+
+    return number_of_accepted_connections;
+}
+
+size_t TcpServer::get_number_of_tcp_connections() const {
+    size_t number_of_tcp_connections = 0;
+
+    for (const auto &connection_table_ptr : _connection_tables) {
+        number_of_tcp_connections +=
+            connection_table_ptr->number_of_tcp_connections.load(
+                std::memory_order_relaxed
+            );
+    }
+
+    return number_of_tcp_connections;
 }
 
 void TcpServer::start() {
@@ -62,38 +122,25 @@ void TcpServer::start() {
         LOG_FATAL << "missing message callback";
     }
 
-    auto listen_socketfd = Socketfd::create_socketfd();
+    auto number_of_connection_tables =
+        std::max(_thread_pool_capacity, static_cast<size_t>(1));
 
-    ListenSocketfd::set_socketfd_as_address_reusable(listen_socketfd);
-    ListenSocketfd::bind(listen_socketfd, _local_address);
-    ListenSocketfd::listen(listen_socketfd);
-    _listen_socketfd.reset(new ListenSocketfd(listen_socketfd, _loop));
-    _listen_socketfd->register_new_connection_callback(
-        [this](
-            int connect_socketfd,
-            const InetAddress &peer_address,
-            util::TimePoint time_stamp
-        ) {
-            _new_connection_callback(
-                connect_socketfd, peer_address, time_stamp
-            );
-        }
-    );
-    // _listen_socketfd->set_max_number_of_new_connections_at_a_time(
-    //     std::max(_thread_pool_capacity, static_cast<size_t>(1))
-    // );
-
-    _listen_socketfd->start();
+    for (size_t i = 0; i < number_of_connection_tables; i++) {
+        _connection_tables.emplace_back(new ConnectionTable);
+    }
 
 #ifdef __USE_SHARED_PTR_DESTRUCTION_TRANSFERING
-    _tcp_connect_socketfd_destroying_thread_ptr.reset(
-        new EventLoopThread("tcp-cleanup", {})
-    );
+    // each loop hands over its connections through a functor queue of its own
+    _tcp_connect_socketfd_destroying_thread_ptr.reset(new EventLoopThread(
+        "tcp-cleanup", {}, 0, number_of_connection_tables
+    ));
     _tcp_connect_socketfd_destroying_thread_ptr->start();
 
-    _current_vector_of_tcp_connect_socketfds_to_be_destroyed.reserve(
-        _MAX_SIZE_OF_CURRENT_VECTOR_OF_TCP_CONNECT_SOCKETFDS_TO_BE_DESTROYED
-    );
+    for (auto &connection_table_ptr : _connection_tables) {
+        connection_table_ptr->tcp_connect_socketfds_to_be_destroyed.reserve(
+            _MAX_SIZE_OF_CURRENT_VECTOR_OF_TCP_CONNECT_SOCKETFDS_TO_BE_DESTROYED
+        );
+    }
 #endif
 
     if (_thread_pool_capacity > 0) {
@@ -107,11 +154,67 @@ void TcpServer::start() {
             );
         }
 
+        _thread_pool_ptr->set_loop_selection_policy(_loop_selection_policy);
+
+        if (_loop_selector) {
+            _thread_pool_ptr->register_loop_selector(_loop_selector);
+        }
+
         _thread_pool_ptr->start();
 
+        if (_max_busy_poll_budget) {
+            for (size_t i = 0; i < _thread_pool_ptr->size(); i++) {
+                auto worker_loop = _thread_pool_ptr->get_loop(i);
+                auto max_busy_poll_budget = _max_busy_poll_budget;
+
+                worker_loop->run([worker_loop, max_busy_poll_budget]() {
+                    worker_loop->set_max_busy_poll_budget(max_busy_poll_budget
+                    );
+                });
+            }
+        }
+
+        if (_max_number_of_buffered_output_bytes > 0) {
+            for (size_t i = 0; i < _thread_pool_ptr->size(); i++) {
+                auto worker_loop = _thread_pool_ptr->get_loop(i);
+                auto max_number_of_buffered_output_bytes =
+                    _max_number_of_buffered_output_bytes;
+
+                worker_loop->run(
+                    [worker_loop, max_number_of_buffered_output_bytes]() {
+                        worker_loop->set_max_number_of_buffered_output_bytes(
+                            max_number_of_buffered_output_bytes
+                        );
+                    }
+                );
+            }
+        }
+
         LOG_INFO << "finished starting thread pool";
     }
 
+    // the main loop serves the connections by itself
+    else if (_max_number_of_buffered_output_bytes > 0) {
+        auto loop = _loop;
+        auto max_number_of_buffered_output_bytes =
+            _max_number_of_buffered_output_bytes;
+
+        _loop->run([loop, max_number_of_buffered_output_bytes]() {
+            loop->set_max_number_of_buffered_output_bytes(
+                max_number_of_buffered_output_bytes
+            );
+        });
+    }
+
+    // worker loops must be running before listening in them
+    if (_use_reuse_port && _thread_pool_capacity > 0) {
+        _start_listening_in_worker_loops();
+    }
+
+    else {
+        _start_listening_in_main_loop();
+    }
+
     _is_started = true;
 
     LOG_INFO << "TCP server has started";
@@ -132,36 +235,90 @@ void TcpServer::stop() {
 
     // stop listening to new connection event (but still can accept new
     // connections in the current round of loop)
-    _listen_socketfd->stop();
+    if (_listen_socketfd) {
+        _listen_socketfd->stop();
+    }
+
+    // worker listen socketfds are stopped in their own loops, before the loops
+    // start draining, so that the loops are able to exit afterwards
+    for (size_t i = 0; i < _worker_listen_socketfds.size(); i++) {
+        auto listen_socketfd_ptr = _worker_listen_socketfds[i].get();
+
+        _thread_pool_ptr->get_loop(i)->run([listen_socketfd_ptr]() {
+            listen_socketfd_ptr->stop();
+        });
+    }
 
     LOG_INFO << "finished stopping listening for new connections";
 
-    if (_thread_pool_capacity > 0) {
-        LOG_INFO << "shutting down thread pool...";
+    LOG_INFO << "draining connections...";
 
-        _thread_pool_ptr->stop();
+    {
+        util::MutexGuard lock(_mutex_for_number_of_loops_being_drained);
+
+        _number_of_loops_being_drained = _connection_tables.size();
+    }
 
-        LOG_INFO << "thread pool stopped";
+    // [NOTE]: posted after the functors above, as well as the ones handing
+    // over the connections accepted so far, so that the loops have nothing
+    // left to accept by the time they start draining
+    for (size_t i = 0; i < _connection_tables.size(); i++) {
+        auto loop =
+            _thread_pool_capacity > 0 ? _thread_pool_ptr->get_loop(i) : _loop;
 
-        // join the worker threads first, for stopping generating callbacks
-        // since the main event loop is about to die, too
+        loop->run([this, loop]() {
+            _start_draining(loop);
+        });
+    }
+
+    if (_thread_pool_capacity > 0) {
+        // woken up by the last worker loop that gets drained, instead of
+        // polling for it
         while (true) {
-            util::this_thread::sleep_for(util::TimeInterval::SECOND);
+            util::MutexGuard lock(_mutex_for_number_of_loops_being_drained);
 
-#ifndef __USE_LOCK_FREE_QUEUE
-            // blocking queue has a capacity which would cause deadlock; must
-            // make sure to clean it up before joining the worker threads
-            _loop->invoke_all_functors();
-#endif
+            auto is_drained = [this]() {
+                return _number_of_loops_being_drained == 0;
+            };
 
-            if (_thread_pool_ptr->is_joinable()) {
-                _thread_pool_ptr->join();
+#ifdef __USE_LOCK_FREE_QUEUE
+            _cond_for_number_of_loops_being_drained.wait(lock, is_drained);
+
+            break;
+#else
+            if (_cond_for_number_of_loops_being_drained.wait_for(
+                    lock, _FUNCTOR_QUEUE_CLEANING_INTERVAL, is_drained
+                )) {
 
                 break;
             }
+
+            // blocking queue has a capacity which would cause deadlock if a
+            // worker loop got blocked on posting to the main loop; must make
+            // sure to clean it up while waiting
+            _loop->invoke_all_functors();
+#endif
+        }
+
+        LOG_INFO << "finished draining connections";
+
+        // [NOTE]: posted before asking the loops to stop, so that whatever
+        // slipped through the draining is still closed inside its own loop,
+        // which is then able to release it before exiting
+        for (size_t i = 0; i < _thread_pool_ptr->size(); i++) {
+            auto loop = _thread_pool_ptr->get_loop(i);
+
+            loop->run([this, loop]() {
+                _abort_remaining_tcp_connect_socketfds(loop);
+            });
         }
 
-        LOG_INFO << "thread pool joined";
+        LOG_INFO << "shutting down thread pool...";
+
+        // the worker loops are able to exit right away since they serve no
+        // connections anymore
+        _thread_pool_ptr->stop();
+        _thread_pool_ptr->join();
 
         LOG_INFO << "finished shutting down thread pool";
     }
@@ -174,165 +331,638 @@ void TcpServer::stop() {
 void TcpServer::run_for_each_connection(
     const RunForEachConnectionCallbackType &callback
 ) {
-    LOG_TRACE << "register event -> main: run_for_each_connection";
-
-    _loop->run([=]() {
-        LOG_TRACE << "enter event: run_for_each_connection";
-
-        for (const auto &pair : _tcp_connect_socketfds) {
-            callback(pair.second);
-        }
-    });
+    run_for_each_connection(RunForEachConnectionCallbackType(callback));
 }
 
 void TcpServer::run_for_each_connection(
     RunForEachConnectionCallbackType &&callback
 ) {
-    LOG_TRACE << "register event -> main: run_for_each_connection";
+    auto number_of_loops = _connection_tables.size();
+
+    for (size_t i = 0; i < number_of_loops; i++) {
+        auto loop =
+            _thread_pool_capacity > 0 ? _thread_pool_ptr->get_loop(i) : _loop;
+
+        auto connection_table_ptr = _connection_tables[i].get();
+
+        auto callback_wrapper =
+            [connection_table_ptr](
+                RunForEachConnectionCallbackType &this_callback
+            ) {
+                LOG_TRACE << "enter event: run_for_each_connection";
+
+                // the callback might close some of the connections, which
+                // removes them from the table, so they are collected first
+                std::vector<TcpConnectSocketfdPtr> tcp_connect_socketfds;
+
+                tcp_connect_socketfds.reserve(
+                    connection_table_ptr->tcp_connect_socketfds.size()
+                );
+
+                connection_table_ptr->tcp_connect_socketfds.for_each(
+                    [&](uint64_t,
+                        const TcpConnectSocketfdPtr &tcp_connect_socketfd_ptr) {
+                        tcp_connect_socketfds.push_back(tcp_connect_socketfd_ptr
+                        );
+                    }
+                );
+
+                for (const auto &tcp_connect_socketfd_ptr :
+                     tcp_connect_socketfds) {
+
+                    this_callback(tcp_connect_socketfd_ptr);
+                }
+            };
+
+        LOG_TRACE << "register event -> worker: run_for_each_connection";
+
+        // the last loop takes the callback itself instead of a copy
+        loop->run(std::bind(
+            std::move(callback_wrapper),
+            i + 1 < number_of_loops ? RunForEachConnectionCallbackType(callback)
+                                    : std::move(callback)
+        ));
+    }
+}
+
+void TcpServer::_start_listening_in_main_loop() {
+    auto listen_socketfd = Socketfd::create_socketfd();
+
+    ListenSocketfd::set_socketfd_as_address_reusable(listen_socketfd);
+    ListenSocketfd::bind(listen_socketfd, _local_address);
+    ListenSocketfd::listen(listen_socketfd);
+    _listen_socketfd.reset(new ListenSocketfd(listen_socketfd, _loop));
+    _listen_socketfd->set_max_number_of_new_connections_at_a_time(
+        _max_number_of_new_connections_at_a_time
+    );
+    _listen_socketfd->register_new_connection_callback(
+        [this](
+            int connect_socketfd,
+            const InetAddress &peer_address,
+            util::TimePoint time_stamp
+        ) {
+            _new_connection_callback(
+                connect_socketfd, peer_address, time_stamp
+            );
+        }
+    );
+
+    // new connections are handed over to the worker loops in batches, instead
+    // of each of them posting a functor to its loop
+    if (_thread_pool_capacity > 0) {
+        _pending_tcp_connections.resize(_thread_pool_ptr->size());
+
+        _listen_socketfd->register_accept_batch_end_callback([this]() {
+            _dispatch_pending_tcp_connections();
+        });
+    }
+
+    _listen_socketfd->start();
+}
+
+void TcpServer::_start_listening_in_worker_loops() {
+    LOG_INFO << "listening in worker loops with SO_REUSEPORT...";
+
+    auto number_of_worker_loops = _thread_pool_ptr->size();
 
-    auto callback_wrapper =
-        [this](RunForEachConnectionCallbackType &this_callback) {
-            LOG_TRACE << "enter event: run_for_each_connection";
+    int first_listen_socketfd = -1;
 
-            for (const auto &pair : _tcp_connect_socketfds) {
-                this_callback(pair.second);
+    // [NOTE]: the index of a socketfd within the reuseport group is the order
+    // in which it started listening, so the socketfds must be created in the
+    // same order as the worker loops
+    for (size_t i = 0; i < number_of_worker_loops; i++) {
+        auto listen_socketfd = Socketfd::create_socketfd();
+
+        ListenSocketfd::set_socketfd_as_address_reusable(listen_socketfd);
+        ListenSocketfd::set_socketfd_as_port_reusable(listen_socketfd);
+        ListenSocketfd::bind(listen_socketfd, _local_address);
+        ListenSocketfd::listen(listen_socketfd);
+
+        if (i == 0) {
+            first_listen_socketfd = listen_socketfd;
+        }
+
+        auto worker_loop = _thread_pool_ptr->get_loop(i);
+
+        _worker_listen_socketfds.emplace_back(
+            new ListenSocketfd(listen_socketfd, worker_loop)
+        );
+        _worker_listen_socketfds.back()
+            ->set_max_number_of_new_connections_at_a_time(
+                _max_number_of_new_connections_at_a_time
+            );
+        _worker_listen_socketfds.back()->register_new_connection_callback(
+            [this, worker_loop](
+                int connect_socketfd,
+                const InetAddress &peer_address,
+                util::TimePoint time_stamp
+            ) {
+                _new_connection_callback_in_worker_loop(
+                    worker_loop, connect_socketfd, peer_address, time_stamp
+                );
             }
-        };
+        );
+    }
+
+    if (_use_cpu_steering) {
+        _steer_connections_to_cpus_of_worker_loops(first_listen_socketfd);
+    }
+
+    // each listen socketfd must be started inside its own loop
+    for (size_t i = 0; i < number_of_worker_loops; i++) {
+        auto listen_socketfd_ptr = _worker_listen_socketfds[i].get();
+
+        _thread_pool_ptr->get_loop(i)->run([listen_socketfd_ptr]() {
+            listen_socketfd_ptr->start();
+        });
+    }
+
+    LOG_INFO << "finished listening in worker loops";
+}
+
+void TcpServer::_steer_connections_to_cpus_of_worker_loops(
+    int first_listen_socketfd
+) {
+    auto number_of_worker_loops = _thread_pool_ptr->size();
+
+    cpu_set_t allowed_cpu_set;
+
+    CPU_ZERO(&allowed_cpu_set);
+
+    if (::sched_getaffinity(0, sizeof(allowed_cpu_set), &allowed_cpu_set)
+        == -1) {
+
+        LOG_SYS_ERROR << "failed when getting the CPUs allowed to run on, "
+                         "CPU steering is skipped";
+
+        return;
+    }
+
+    std::vector<int> cpus_of_worker_loops;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed_cpu_set)) {
+            cpus_of_worker_loops.push_back(cpu);
+        }
+    }
 
-    _loop->run(std::bind(std::move(callback_wrapper), std::move(callback)));
+    // [NOTE]: each CPU must be owned by exactly one worker loop, otherwise
+    // either some CPU would have no worker loop to steer its connections to,
+    // or some worker loop would never be steered any connection
+    if (cpus_of_worker_loops.size() != number_of_worker_loops) {
+        LOG_WARN << "CPU steering is skipped since it requires one worker "
+                    "loop per CPU allowed to run on, number of CPUs: "
+                 << cpus_of_worker_loops.size()
+                 << ", number of worker loops: " << number_of_worker_loops;
+
+        return;
+    }
+
+    if (!ListenSocketfd::attach_cpu_steering_program_to_reuse_port_group(
+            first_listen_socketfd, cpus_of_worker_loops
+        )) {
+
+        return;
+    }
+
+    // pins each worker thread to the CPU whose connections are steered to it
+    for (size_t i = 0; i < number_of_worker_loops; i++) {
+        auto cpu = cpus_of_worker_loops[i];
+
+        _thread_pool_ptr->get_loop(i)->run([cpu]() {
+            cpu_set_t cpu_set;
+
+            CPU_ZERO(&cpu_set);
+            CPU_SET(cpu, &cpu_set);
+
+            if (::pthread_setaffinity_np(
+                    ::pthread_self(), sizeof(cpu_set), &cpu_set
+                )
+                != 0) {
+
+                LOG_ERROR << "failed to pin worker thread to CPU " << cpu;
+            }
+        });
+    }
 }
 
 void TcpServer::_new_connection_callback(
     int connect_socketfd,
     const InetAddress &peer_address,
     util::TimePoint time_stamp
+) {
+    EventLoop *chosen_loop = _thread_pool_capacity > 0
+                                 ? _thread_pool_ptr->get_next_loop(&peer_address)
+                                 : _loop;
+
+    if (chosen_loop == _loop) {
+        _set_up_and_start_tcp_connect_socketfd(_create_tcp_connect_socketfd(
+            chosen_loop, connect_socketfd, peer_address, time_stamp
+        ));
+
+        return;
+    }
+
+    _pending_tcp_connections[chosen_loop->get_loop_index()].push_back(
+        PendingTcpConnection{connect_socketfd, peer_address, time_stamp}
+    );
+}
+
+void TcpServer::_dispatch_pending_tcp_connections() {
+    for (size_t i = 0; i < _pending_tcp_connections.size(); i++) {
+        auto &pending_tcp_connections = _pending_tcp_connections[i];
+
+        if (pending_tcp_connections.empty()) {
+            continue;
+        }
+
+        uint64_t batch_size = pending_tcp_connections.size();
+
+        _number_of_dispatch_batches.store(
+            _number_of_dispatch_batches.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed
+        );
+        _number_of_dispatched_connections.store(
+            _number_of_dispatched_connections.load(std::memory_order_relaxed)
+                + batch_size,
+            std::memory_order_relaxed
+        );
+        _max_dispatch_batch_size.store(
+            std::max(
+                _max_dispatch_batch_size.load(std::memory_order_relaxed),
+                batch_size
+            ),
+            std::memory_order_relaxed
+        );
+
+        LOG_TRACE << "register event -> worker: dispatch_tcp_connections";
+
+        auto worker_loop = _thread_pool_ptr->get_loop(i);
+
+        // [NOTE]: the connections are created and started right inside the
+        // worker loop, so that no more functors are posted for registering
+        // their events
+        worker_loop->run(
+            [this, worker_loop, batch = std::move(pending_tcp_connections)]() {
+                LOG_TRACE << "enter event: dispatch_tcp_connections";
+
+                for (const auto &pending_tcp_connection : batch) {
+                    _set_up_and_start_tcp_connect_socketfd(
+                        _create_tcp_connect_socketfd(
+                            worker_loop,
+                            pending_tcp_connection.connect_socketfd,
+                            pending_tcp_connection.peer_address,
+                            pending_tcp_connection.time_stamp
+                        )
+                    );
+                }
+            }
+        );
+
+        // the moved-from vector is left in an unspecified state
+        pending_tcp_connections.clear();
+    }
+}
+
+void TcpServer::_new_connection_callback_in_worker_loop(
+    EventLoop *loop,
+    int connect_socketfd,
+    const InetAddress &peer_address,
+    util::TimePoint time_stamp
+) {
+    _set_up_and_start_tcp_connect_socketfd(_create_tcp_connect_socketfd(
+        loop, connect_socketfd, peer_address, time_stamp
+    ));
+}
+
+TcpServer::TcpConnectSocketfdPtr TcpServer::_create_tcp_connect_socketfd(
+    EventLoop *loop,
+    int connect_socketfd,
+    const InetAddress &peer_address,
+    util::TimePoint time_stamp
 ) {
     uint64_t id =
         _tcp_connection_id_counter.fetch_add(1, std::memory_order_relaxed);
-    LOG_TRACE << "TCP connection already exist: "
-              << (_tcp_connect_socketfds.find(id)
-                  != _tcp_connect_socketfds.end())
-              << ", id: " << id;
-    EventLoop *chosen_loop =
-        _thread_pool_capacity > 0 ? _thread_pool_ptr->get_next_loop() : _loop;
     InetAddress local_address{connect_socketfd, InetAddress::LOCAL};
 
-    auto insert_result = _tcp_connect_socketfds.emplace(
-        id,
-        // std::make_shared<TcpConnectSocketfd>(
-        //     connect_socketfd, loop, id, local_address, peer_address,
-        //     time_stamp
-        // )
-        std::allocate_shared<TcpConnectSocketfd>(
-            // util::StaticSemiLockFreeSlabAllocator<TcpConnectSocketfd>(),
-            util::StaticThreadLocalSlabAllocator<TcpConnectSocketfd>(),
+    if (id % 10000 == 0) {
+        LOG_DEBUG << "TCP connection establishment checkpoint, id: " << id;
+    }
+
+    if (_max_busy_poll_budget) {
+        Socketfd::enable_socketfd_busy_polling(
             connect_socketfd,
-            chosen_loop,
-            id,
-            local_address,
-            peer_address,
-            time_stamp
-        )
+            static_cast<int>(std::min(
+                _max_busy_poll_budget.nanoseconds / 1000,
+                static_cast<int64_t>(std::numeric_limits<int>::max())
+            ))
+        );
+    }
+
+    return TcpConnectSocketfd::create(
+        connect_socketfd, loop, id, local_address, peer_address, time_stamp
     );
+}
+
+void TcpServer::_set_up_and_start_tcp_connect_socketfd(
+    const TcpConnectSocketfdPtr &tcp_connect_socketfd_ptr
+) {
+    auto &connection_table =
+        _get_connection_table(tcp_connect_socketfd_ptr->get_loop());
+
+    if (!connection_table.tcp_connect_socketfds.insert(
+            tcp_connect_socketfd_ptr->get_id(), tcp_connect_socketfd_ptr
+        )) {
 
-    if (!insert_result.second) {
         LOG_FATAL << "execution flow never reaches here (in real world case)";
     }
 
-    _max_number_of_connections =
-        std::max(_max_number_of_connections, _tcp_connect_socketfds.size());
+    auto number_of_tcp_connections =
+        connection_table.tcp_connect_socketfds.size();
 
-    auto &new_tcp_connect_socketfd_ptr = insert_result.first->second;
+    connection_table.number_of_tcp_connections.store(
+        number_of_tcp_connections, std::memory_order_relaxed
+    );
+    connection_table.max_number_of_tcp_connections = std::max(
+        connection_table.max_number_of_tcp_connections,
+        number_of_tcp_connections
+    );
 
     if (_connect_success_callback) {
-        _connect_success_callback(new_tcp_connect_socketfd_ptr);
+        _connect_success_callback(tcp_connect_socketfd_ptr);
     }
 
-    new_tcp_connect_socketfd_ptr->register_message_callback(_message_callback);
-    new_tcp_connect_socketfd_ptr->register_write_complete_callback(
-        _write_complete_callback
+    // forwarders only capture the server, so that they fit inline and no
+    // copy of the user callbacks is made for each connection
+    tcp_connect_socketfd_ptr->register_message_callback(
+        [this](
+            TcpConnectSocketfd *this_tcp_connect_socketfd_ptr,
+            TcpInputBuffer *input_buffer,
+            util::TimePoint time_stamp
+        ) {
+            _message_callback(
+                this_tcp_connect_socketfd_ptr, input_buffer, time_stamp
+            );
+        }
     );
-    auto chosen_loop_index = chosen_loop->get_loop_index();
-    new_tcp_connect_socketfd_ptr->register_close_callback(
-        [this,
-         chosen_loop_index](TcpConnectSocketfd *tcp_connect_socketfd_ptr) {
-            _close_callback(tcp_connect_socketfd_ptr, chosen_loop_index);
+    if (_write_complete_callback) {
+        tcp_connect_socketfd_ptr->register_write_complete_callback(
+            [this](TcpConnectSocketfd *this_tcp_connect_socketfd_ptr) {
+                _write_complete_callback(this_tcp_connect_socketfd_ptr);
+            }
+        );
+    }
+    if (_timeout_callback) {
+        tcp_connect_socketfd_ptr->register_timeout_callback(
+            [this](
+                TcpConnectSocketfd *this_tcp_connect_socketfd_ptr,
+                TcpConnectSocketfd::TimeoutType timeout_type
+            ) {
+                _timeout_callback(this_tcp_connect_socketfd_ptr, timeout_type);
+            }
+        );
+    }
+    if (_high_water_mark_callback) {
+        tcp_connect_socketfd_ptr->register_high_water_mark_callback(
+            [this](
+                TcpConnectSocketfd *this_tcp_connect_socketfd_ptr,
+                size_t number_of_bytes_buffered
+            ) {
+                _high_water_mark_callback(
+                    this_tcp_connect_socketfd_ptr, number_of_bytes_buffered
+                );
+            }
+        );
+    }
+    if (_low_water_mark_callback) {
+        tcp_connect_socketfd_ptr->register_low_water_mark_callback(
+            [this](
+                TcpConnectSocketfd *this_tcp_connect_socketfd_ptr,
+                size_t number_of_bytes_buffered
+            ) {
+                _low_water_mark_callback(
+                    this_tcp_connect_socketfd_ptr, number_of_bytes_buffered
+                );
+            }
+        );
+    }
+    tcp_connect_socketfd_ptr->set_output_water_marks(
+        _high_water_mark, _low_water_mark
+    );
+    tcp_connect_socketfd_ptr->set_if_use_corked_mode(_use_corked_mode);
+    tcp_connect_socketfd_ptr->set_zero_copy_threshold(_zero_copy_threshold);
+    tcp_connect_socketfd_ptr->set_idle_timeout(_idle_timeout);
+    tcp_connect_socketfd_ptr->set_read_timeout(_read_timeout);
+    tcp_connect_socketfd_ptr->set_write_timeout(_write_timeout);
+    tcp_connect_socketfd_ptr->register_close_callback(
+        [this](TcpConnectSocketfd *this_tcp_connect_socketfd_ptr) {
+            _close_callback(this_tcp_connect_socketfd_ptr);
         }
     );
 
-    new_tcp_connect_socketfd_ptr->start();
+    tcp_connect_socketfd_ptr->start();
 
-    if (id % 10000 == 0) {
-        LOG_DEBUG << "TCP connection establishment checkpoint, id: " << id;
+    // handed over after the loop started draining
+    if (connection_table.is_draining) {
+        _drain_tcp_connect_socketfd(tcp_connect_socketfd_ptr.get());
     }
 }
 
-void TcpServer::_close_callback(
-    TcpConnectSocketfd *tcp_connect_socketfd_ptr,
-    size_t functor_blocking_queue_index
+void TcpServer::_close_callback(TcpConnectSocketfd *tcp_connect_socketfd_ptr
 ) {
-    LOG_TRACE << "register event -> main: _close_callback";
+    auto loop = tcp_connect_socketfd_ptr->get_loop();
+
+    auto &connection_table = _get_connection_table(loop);
 
     auto connection_id = tcp_connect_socketfd_ptr->get_id();
 
-    // must be executed inside the main loop
-    _loop->run(
-        [this, connection_id]() {
-            LOG_TRACE << "enter event: _close_callback";
+    auto tcp_connect_socketfd_ptr_in_table =
+        connection_table.tcp_connect_socketfds.find(connection_id);
 
-            auto iterator_to_tcp_connect_socketfd_to_be_destroyed =
-                _tcp_connect_socketfds.find(connection_id);
+    if (!tcp_connect_socketfd_ptr_in_table) {
+        LOG_FATAL << "never reaches here";
+    }
 
-            // a connection will either be registered onto the worker thread
-            // event loop and closed by it, or just sit in the std::map of the
-            // server and wait to get aborted by the main thread
-            if (iterator_to_tcp_connect_socketfd_to_be_destroyed
-                == _tcp_connect_socketfds.end()) {
+    LOG_TRACE << "TCP connection reference count: "
+              << tcp_connect_socketfd_ptr->get_number_of_references()
+              << ", id: " << connection_id;
 
-                LOG_FATAL << "never reaches here";
-            }
+#ifdef __USE_SHARED_PTR_DESTRUCTION_TRANSFERING
+    // transfers the reference, unless the loop is going to take the connection
+    // back for reuse, which costs nothing to be moved elsewhere
+    if (!tcp_connect_socketfd_ptr->could_be_recycled()) {
+        connection_table.tcp_connect_socketfds_to_be_destroyed.emplace_back(
+            std::move(*tcp_connect_socketfd_ptr_in_table)
+        );
 
-            LOG_TRACE << "TCP connection use count: "
-                      << iterator_to_tcp_connect_socketfd_to_be_destroyed
-                             ->second.use_count()
-                      << ", id: " << connection_id;
+        if (connection_table.tcp_connect_socketfds_to_be_destroyed.size()
+            >= _MAX_SIZE_OF_CURRENT_VECTOR_OF_TCP_CONNECT_SOCKETFDS_TO_BE_DESTROYED) {
 
-#ifdef __USE_SHARED_PTR_DESTRUCTION_TRANSFERING
-            auto &tcp_connect_socketfd_to_be_destroyed =
-                iterator_to_tcp_connect_socketfd_to_be_destroyed->second;
+            _transfer_tcp_connections_to_background_thread(
+                connection_table, loop->get_loop_index()
+            );
+        }
+    }
+#endif
 
-            // transfers control block and the underlying object being managed
-            _current_vector_of_tcp_connect_socketfds_to_be_destroyed
-                .emplace_back(std::move(tcp_connect_socketfd_to_be_destroyed));
+    // [NOTE]: the connection is still kept alive by its loop till the end of
+    // the iteration
+    connection_table.tcp_connect_socketfds.erase(connection_id);
 
-            if (_current_vector_of_tcp_connect_socketfds_to_be_destroyed.size()
-                >= _MAX_SIZE_OF_CURRENT_VECTOR_OF_TCP_CONNECT_SOCKETFDS_TO_BE_DESTROYED) {
+    connection_table.number_of_tcp_connections.store(
+        connection_table.tcp_connect_socketfds.size(),
+        std::memory_order_relaxed
+    );
+
+    LOG_TRACE << "TCP connection erased, id: " << connection_id;
+
+    _finish_draining_if_drained(loop);
+}
+
+void TcpServer::_start_draining(EventLoop *loop) {
+    LOG_TRACE << "enter event: _start_draining";
+
+    auto &connection_table = _get_connection_table(loop);
+
+    connection_table.is_draining = true;
+
+    // draining might close some of the connections, which removes them from
+    // the table, so they are collected first
+    std::vector<TcpConnectSocketfdPtr> tcp_connect_socketfds;
+
+    tcp_connect_socketfds.reserve(connection_table.tcp_connect_socketfds.size()
+    );
 
-                _transfer_tcp_connections_to_background_thread();
+    connection_table.tcp_connect_socketfds.for_each(
+        [&](uint64_t, const TcpConnectSocketfdPtr &tcp_connect_socketfd_ptr) {
+            tcp_connect_socketfds.push_back(tcp_connect_socketfd_ptr);
+        }
+    );
+
+    for (const auto &tcp_connect_socketfd_ptr : tcp_connect_socketfds) {
+        _drain_tcp_connect_socketfd(tcp_connect_socketfd_ptr.get());
+    }
+
+    LOG_INFO << "started draining loop " << loop->get_loop_index()
+             << ", number of connections: " << tcp_connect_socketfds.size();
+
+    if (_drain_timeout.nanoseconds != util::TimeInterval::FOREVER) {
+        connection_table.drain_timer_identifier = loop->run_after_time_interval(
+            _drain_timeout,
+            0,
+            1,
+            [this, loop]() {
+                _get_connection_table(loop).is_drain_timer_armed = false;
+
+                _abort_undrained_tcp_connect_socketfds(loop);
             }
-#endif
+        );
 
-            _tcp_connect_socketfds.erase(
-                iterator_to_tcp_connect_socketfd_to_be_destroyed
-            );
+        connection_table.is_drain_timer_armed = true;
+    }
+
+    _finish_draining_if_drained(loop);
+}
+
+void TcpServer::_drain_tcp_connect_socketfd(
+    TcpConnectSocketfd *tcp_connect_socketfd_ptr
+) {
+    if (tcp_connect_socketfd_ptr->is_stopped()
+        || tcp_connect_socketfd_ptr->is_write_end_shutdown()) {
+
+        return;
+    }
+
+    if (_drain_callback) {
+        _drain_callback(tcp_connect_socketfd_ptr);
+    }
+
+    else {
+        tcp_connect_socketfd_ptr->shutdown_write_when_idle();
+    }
+}
+
+void TcpServer::_abort_undrained_tcp_connect_socketfds(EventLoop *loop) {
+    auto &connection_table = _get_connection_table(loop);
+
+    if (!connection_table.is_draining || connection_table.is_drained) {
+        return;
+    }
+
+    LOG_WARN << "drain timeout exceeded in loop " << loop->get_loop_index();
+
+    _abort_remaining_tcp_connect_socketfds(loop);
+}
+
+void TcpServer::_abort_remaining_tcp_connect_socketfds(EventLoop *loop) {
+    auto &connection_table = _get_connection_table(loop);
+
+    if (connection_table.tcp_connect_socketfds.empty()) {
+        return;
+    }
 
-            LOG_TRACE << "TCP connection erased, id: " << connection_id;
-        },
-        functor_blocking_queue_index
+    // aborting removes the connections from the table
+    std::vector<TcpConnectSocketfdPtr> tcp_connect_socketfds;
+
+    tcp_connect_socketfds.reserve(connection_table.tcp_connect_socketfds.size()
     );
+
+    connection_table.tcp_connect_socketfds.for_each(
+        [&](uint64_t, const TcpConnectSocketfdPtr &tcp_connect_socketfd_ptr) {
+            tcp_connect_socketfds.push_back(tcp_connect_socketfd_ptr);
+        }
+    );
+
+    LOG_WARN << "aborting the connections left in loop "
+             << loop->get_loop_index()
+             << ", number: " << tcp_connect_socketfds.size();
+
+    for (const auto &tcp_connect_socketfd_ptr : tcp_connect_socketfds) {
+        if (!tcp_connect_socketfd_ptr->is_stopped()) {
+            tcp_connect_socketfd_ptr->abort_from_event_loop();
+        }
+    }
+}
+
+void TcpServer::_finish_draining_if_drained(EventLoop *loop) {
+    auto &connection_table = _get_connection_table(loop);
+
+    if (!connection_table.is_draining || connection_table.is_drained
+        || !connection_table.tcp_connect_socketfds.empty()) {
+
+        return;
+    }
+
+    connection_table.is_drained = true;
+
+    if (connection_table.is_drain_timer_armed) {
+        loop->cancel_a_timer(connection_table.drain_timer_identifier);
+
+        connection_table.is_drain_timer_armed = false;
+    }
+
+    {
+        util::MutexGuard lock(_mutex_for_number_of_loops_being_drained);
+
+        --_number_of_loops_being_drained;
+    }
+
+    _cond_for_number_of_loops_being_drained.notify_all();
 }
 
 #ifdef __USE_SHARED_PTR_DESTRUCTION_TRANSFERING
-void TcpServer::_transfer_tcp_connections_to_background_thread() {
+void TcpServer::_transfer_tcp_connections_to_background_thread(
+    ConnectionTable &connection_table, size_t functor_blocking_queue_index
+) {
     {
         util::MutexGuard lock(
             _mutex_for_vectors_of_tcp_connect_socketfds_to_be_destroyed
         );
 
-        std::vector<std::shared_ptr<void>> temporary_vector;
+        std::vector<TcpConnectSocketfdPtr> temporary_vector;
 
         temporary_vector.swap(
-            _current_vector_of_tcp_connect_socketfds_to_be_destroyed
+            connection_table.tcp_connect_socketfds_to_be_destroyed
         );
 
         _vectors_of_tcp_connect_socketfds_to_be_destroyed.emplace_back(
@@ -340,12 +970,12 @@ void TcpServer::_transfer_tcp_connections_to_background_thread() {
         );
     }
 
-    _current_vector_of_tcp_connect_socketfds_to_be_destroyed.reserve(
+    connection_table.tcp_connect_socketfds_to_be_destroyed.reserve(
         _MAX_SIZE_OF_CURRENT_VECTOR_OF_TCP_CONNECT_SOCKETFDS_TO_BE_DESTROYED
     );
 
     auto functor = [this]() {
-        std::vector<std::shared_ptr<void>>
+        std::vector<TcpConnectSocketfdPtr>
             picked_vector_of_tcp_connect_socketfds_to_be_destroyed;
 
         {
@@ -368,9 +998,10 @@ void TcpServer::_transfer_tcp_connections_to_background_thread() {
         LOG_TRACE << "finished destroying picked TCP connections";
     };
 
-    // this is all the background thread needs to do: destroying shared_ptr's
+    // this is all the background thread needs to do: releasing the last
+    // references
     _tcp_connect_socketfd_destroying_thread_ptr->get_loop()->run(
-        std::move(functor)
+        std::move(functor), functor_blocking_queue_index
     );
 }
 #endif
@@ -1,23 +1,25 @@
 #include "timer_container.h"
+#include "timing_wheel_timer_container.h"
 
 namespace xubinh_server {
 
-void TimerContainer::insert_one(const Timer *timer_ptr) {
-    const auto &expiration_time_point = timer_ptr->get_expiration_time_point();
+std::unique_ptr<TimerContainer> TimerContainer::create(Type type) {
+    switch (type) {
+    case Type::TIMING_WHEEL:
+        return std::unique_ptr<TimerContainer>(new TimingWheelTimerContainer);
 
-    _timers.insert({expiration_time_point, timer_ptr});
+    default:
+        return std::unique_ptr<TimerContainer>(new OrderedSetTimerContainer);
+    }
 }
 
-void TimerContainer::insert_all(const std::vector<const Timer *> &timers) {
-    for (const Timer *timer_ptr : timers) {
-        const auto &expiration_time_point =
-            timer_ptr->get_expiration_time_point();
+void OrderedSetTimerContainer::insert_one(const Timer *timer_ptr) {
+    const auto &expiration_time_point = timer_ptr->get_expiration_time_point();
 
-        _timers.insert({expiration_time_point, timer_ptr});
-    }
+    _timers.insert({expiration_time_point, timer_ptr});
 }
 
-bool TimerContainer::remove_one(const Timer *timer_ptr) {
+bool OrderedSetTimerContainer::remove_one(const Timer *timer_ptr) {
     TimePoint expiration_time_point = timer_ptr->get_expiration_time_point();
 
     const int &number_of_removed_timers =
@@ -26,26 +28,20 @@ bool TimerContainer::remove_one(const Timer *timer_ptr) {
     return static_cast<bool>(number_of_removed_timers);
 }
 
-std::vector<const Timer *>
-TimerContainer::move_out_before_or_at(TimePoint expiration_time_point) {
-    std::vector<const Timer *> timers_to_be_returned;
-
+void OrderedSetTimerContainer::move_out_before_or_at(
+    TimePoint expiration_time_point, std::vector<const Timer *> &timers
+) {
     auto range_begin = _timers.begin();
 
     auto range_end = _timers.lower_bound(
         {expiration_time_point + static_cast<int64_t>(1), nullptr}
     );
 
-    // optional for bidirectional iterator
-    // timers_to_be_returned.reserve(std::distance(range_begin, range_end));
-
     for (auto it = range_begin; it != range_end; it++) {
-        timers_to_be_returned.push_back(it->second);
+        timers.push_back(it->second);
     }
 
     _timers.erase(range_begin, range_end);
-
-    return timers_to_be_returned;
 }
 
 } // namespace xubinh_server
@@ -0,0 +1,399 @@
+#include <algorithm>
+
+#include "timing_wheel_timer_container.h"
+
+namespace xubinh_server {
+
+TimingWheelTimerContainer::TimingWheelTimerContainer()
+    : _current_tick(_get_tick_rounded_down(TimePoint())) {
+}
+
+TimingWheelTimerContainer::TimePoint
+TimingWheelTimerContainer::get_earliest_expiration_time_point() {
+    if (!_is_earliest_tick_valid) {
+        _earliest_tick = _NO_TICK;
+
+        for (int level = 0; level < _NUMBER_OF_LEVELS; level++) {
+            auto slot_number = _find_first_non_empty_slot_number(
+                level, _get_first_pending_slot_number(level)
+            );
+
+            if (slot_number == _NO_TICK) {
+                continue;
+            }
+
+            // slots of the first level contain one single tick each
+            if (level == 0) {
+                _earliest_tick = slot_number;
+
+                continue;
+            }
+
+            // no need to look into a slot that starts later than the current
+            // candidate
+            if ((slot_number << _get_shift(level)) >= _earliest_tick) {
+                continue;
+            }
+
+            for (Timer *timer_ptr = _slots[level][slot_number
+                                                  & static_cast<uint64_t>(
+                                                      _get_number_of_slots(level)
+                                                      - 1
+                                                  )];
+                 timer_ptr;
+                 timer_ptr = timer_ptr->_wheel_hook.next) {
+
+                _earliest_tick =
+                    std::min(_earliest_tick, timer_ptr->_wheel_hook.tick);
+            }
+        }
+
+        _is_earliest_tick_valid = true;
+    }
+
+    return _earliest_tick == _NO_TICK
+               ? TimePoint(TimePoint::FOREVER)
+               : TimePoint(
+                     static_cast<int64_t>(_earliest_tick) * _NANOSECONDS_PER_TICK
+                 );
+}
+
+void TimingWheelTimerContainer::insert_one(const Timer *timer_ptr) {
+    auto mutable_timer_ptr = const_cast<Timer *>(timer_ptr);
+
+    auto &hook = mutable_timer_ptr->_wheel_hook;
+
+    // timers that are already expired are expired at the next processing
+    hook.tick = std::max(
+        _get_tick_rounded_up(timer_ptr->get_expiration_time_point()),
+        _current_tick
+    );
+
+    _link(mutable_timer_ptr);
+
+    ++_size;
+
+    if (_is_earliest_tick_valid) {
+        _earliest_tick = std::min(_earliest_tick, hook.tick);
+    }
+}
+
+bool TimingWheelTimerContainer::remove_one(const Timer *timer_ptr) {
+    auto mutable_timer_ptr = const_cast<Timer *>(timer_ptr);
+
+    // might be moved out already
+    if (mutable_timer_ptr->_wheel_hook.level == -1) {
+        return false;
+    }
+
+    _unlink(mutable_timer_ptr);
+
+    --_size;
+
+    if (mutable_timer_ptr->_wheel_hook.tick == _earliest_tick) {
+        _is_earliest_tick_valid = false;
+    }
+
+    return true;
+}
+
+void TimingWheelTimerContainer::move_out_before_or_at(
+    TimePoint expiration_time_point, std::vector<const Timer *> &timers
+) {
+    auto target_tick = _get_tick_rounded_down(expiration_time_point);
+
+    // all timers are rounded up to the current tick or later
+    if (target_tick < _current_tick) {
+        return;
+    }
+
+    _is_earliest_tick_valid = false;
+
+    if (target_tick - _current_tick >= _RANGE_OF_WHEEL) {
+        _move_out_all_before_or_at(target_tick, timers);
+
+        return;
+    }
+
+    // jumps directly over the ticks that have nothing to do
+    while (_size > 0) {
+        auto next_tick = _find_next_tick_to_be_processed();
+
+        if (next_tick > target_tick) {
+            break;
+        }
+
+        _current_tick = next_tick;
+
+        _process_current_tick(timers);
+    }
+
+    _current_tick = target_tick + 1;
+}
+
+uint64_t TimingWheelTimerContainer::_get_tick_rounded_up(TimePoint time_point) {
+    auto nanoseconds = static_cast<uint64_t>(
+        std::max(time_point.nanoseconds_from_epoch, static_cast<int64_t>(0))
+    );
+
+    auto nanoseconds_per_tick = static_cast<uint64_t>(_NANOSECONDS_PER_TICK);
+
+    return nanoseconds / nanoseconds_per_tick
+           + static_cast<uint64_t>(nanoseconds % nanoseconds_per_tick != 0);
+}
+
+uint64_t
+TimingWheelTimerContainer::_get_tick_rounded_down(TimePoint time_point) {
+    return static_cast<uint64_t>(
+               std::max(
+                   time_point.nanoseconds_from_epoch, static_cast<int64_t>(0)
+               )
+           )
+           / static_cast<uint64_t>(_NANOSECONDS_PER_TICK);
+}
+
+void TimingWheelTimerContainer::_link(Timer *timer_ptr) {
+    auto &hook = timer_ptr->_wheel_hook;
+
+    // timers beyond the range are parked at the end of the top level
+    auto tick_for_placement =
+        std::min(hook.tick, _current_tick + _RANGE_OF_WHEEL - 1);
+
+    auto delta = tick_for_placement - _current_tick;
+
+    int level = 0;
+
+    while (level + 1 < _NUMBER_OF_LEVELS
+           && delta >= (static_cast<uint64_t>(1) << _get_shift(level + 1))) {
+        ++level;
+    }
+
+    auto slot_index = static_cast<int>(
+        (tick_for_placement >> _get_shift(level))
+        & static_cast<uint64_t>(_get_number_of_slots(level) - 1)
+    );
+
+    auto &head = _slots[level][slot_index];
+
+    hook.previous = nullptr;
+    hook.next = head;
+    hook.level = level;
+    hook.slot = slot_index;
+
+    if (head) {
+        head->_wheel_hook.previous = timer_ptr;
+    }
+
+    head = timer_ptr;
+
+    _bitmaps[level][slot_index >> 6] |= static_cast<uint64_t>(1)
+                                        << (slot_index & 63);
+}
+
+void TimingWheelTimerContainer::_unlink(Timer *timer_ptr) {
+    auto &hook = timer_ptr->_wheel_hook;
+
+    if (hook.previous) {
+        hook.previous->_wheel_hook.next = hook.next;
+    }
+
+    else {
+        _slots[hook.level][hook.slot] = hook.next;
+
+        if (!hook.next) {
+            _bitmaps[hook.level][hook.slot >> 6] &=
+                ~(static_cast<uint64_t>(1) << (hook.slot & 63));
+        }
+    }
+
+    if (hook.next) {
+        hook.next->_wheel_hook.previous = hook.previous;
+    }
+
+    hook.previous = nullptr;
+    hook.next = nullptr;
+    hook.level = -1;
+}
+
+uint64_t
+TimingWheelTimerContainer::_get_first_pending_slot_number(int level) const {
+    auto mask = (static_cast<uint64_t>(1) << _get_shift(level)) - 1;
+
+    // the slot containing the current tick is already cascaded unless the
+    // current tick is right at its beginning
+    return (_current_tick >> _get_shift(level))
+           + static_cast<uint64_t>((_current_tick & mask) != 0);
+}
+
+uint64_t TimingWheelTimerContainer::_find_first_non_empty_slot_number(
+    int level, uint64_t slot_number
+) const {
+    const auto number_of_slots = _get_number_of_slots(level);
+    const auto number_of_words = (number_of_slots + 63) / 64;
+    const auto start_index = static_cast<int>(
+        slot_number & static_cast<uint64_t>(number_of_slots - 1)
+    );
+    const auto &bitmap = _bitmaps[level];
+
+    // one more round for wrapping back to the bits before the start index
+    for (int i = 0; i <= number_of_words; i++) {
+        int word_index = ((start_index >> 6) + i) % number_of_words;
+
+        uint64_t bits = bitmap[word_index];
+
+        if (i == 0) {
+            bits &= ~static_cast<uint64_t>(0) << (start_index & 63);
+        }
+
+        else if (i == number_of_words) {
+            bits &= (static_cast<uint64_t>(1) << (start_index & 63)) - 1;
+        }
+
+        if (bits) {
+            int index = word_index * 64 + __builtin_ctzll(bits);
+
+            return slot_number
+                   + static_cast<uint64_t>(
+                       (index - start_index + number_of_slots) % number_of_slots
+                   );
+        }
+    }
+
+    return _NO_TICK;
+}
+
+uint64_t TimingWheelTimerContainer::_find_next_tick_to_be_processed() const {
+    uint64_t next_tick = _NO_TICK;
+
+    for (int level = 0; level < _NUMBER_OF_LEVELS; level++) {
+        auto slot_number = _find_first_non_empty_slot_number(
+            level, _get_first_pending_slot_number(level)
+        );
+
+        if (slot_number != _NO_TICK) {
+            next_tick =
+                std::min(next_tick, slot_number << _get_shift(level));
+        }
+    }
+
+    return next_tick;
+}
+
+void TimingWheelTimerContainer::_process_current_tick(
+    std::vector<const Timer *> &timers
+) {
+    for (int level = _NUMBER_OF_LEVELS - 1; level > 0; level--) {
+        auto shift = _get_shift(level);
+
+        if (_current_tick & ((static_cast<uint64_t>(1) << shift) - 1)) {
+            continue;
+        }
+
+        auto slot_index = static_cast<int>(
+            (_current_tick >> shift)
+            & static_cast<uint64_t>(_get_number_of_slots(level) - 1)
+        );
+
+        Timer *timer_ptr = _slots[level][slot_index];
+
+        _slots[level][slot_index] = nullptr;
+        _bitmaps[level][slot_index >> 6] &=
+            ~(static_cast<uint64_t>(1) << (slot_index & 63));
+
+        // cascades down to the lower levels
+        while (timer_ptr) {
+            Timer *next_timer_ptr = timer_ptr->_wheel_hook.next;
+
+            _link(timer_ptr);
+
+            timer_ptr = next_timer_ptr;
+        }
+    }
+
+    auto slot_index = static_cast<int>(
+        _current_tick
+        & static_cast<uint64_t>(_get_number_of_slots(0) - 1)
+    );
+
+    Timer *timer_ptr = _slots[0][slot_index];
+
+    _slots[0][slot_index] = nullptr;
+    _bitmaps[0][slot_index >> 6] &=
+        ~(static_cast<uint64_t>(1) << (slot_index & 63));
+
+    while (timer_ptr) {
+        Timer *next_timer_ptr = timer_ptr->_wheel_hook.next;
+
+        timer_ptr->_wheel_hook.previous = nullptr;
+        timer_ptr->_wheel_hook.next = nullptr;
+        timer_ptr->_wheel_hook.level = -1;
+
+        timers.push_back(timer_ptr);
+
+        --_size;
+
+        timer_ptr = next_timer_ptr;
+    }
+
+    ++_current_tick;
+}
+
+void TimingWheelTimerContainer::_move_out_all_before_or_at(
+    uint64_t tick, std::vector<const Timer *> &timers
+) {
+    std::vector<Timer *> all_timers;
+
+    all_timers.reserve(_size);
+
+    for (int level = 0; level < _NUMBER_OF_LEVELS; level++) {
+        for (int slot_index = 0; slot_index < _get_number_of_slots(level);
+             slot_index++) {
+
+            for (Timer *timer_ptr = _slots[level][slot_index]; timer_ptr;
+                 timer_ptr = timer_ptr->_wheel_hook.next) {
+
+                all_timers.push_back(timer_ptr);
+            }
+
+            _slots[level][slot_index] = nullptr;
+        }
+
+        std::fill(
+            std::begin(_bitmaps[level]),
+            std::end(_bitmaps[level]),
+            static_cast<uint64_t>(0)
+        );
+    }
+
+    _current_tick = tick + 1;
+    _size = 0;
+
+    auto number_of_timers_before = timers.size();
+
+    for (Timer *timer_ptr : all_timers) {
+        if (timer_ptr->_wheel_hook.tick <= tick) {
+            timer_ptr->_wheel_hook.previous = nullptr;
+            timer_ptr->_wheel_hook.next = nullptr;
+            timer_ptr->_wheel_hook.level = -1;
+
+            timers.push_back(timer_ptr);
+        }
+
+        else {
+            _link(timer_ptr);
+
+            ++_size;
+        }
+    }
+
+    // keeps the expiration order as the other paths do
+    std::sort(
+        timers.begin() + static_cast<std::ptrdiff_t>(number_of_timers_before),
+        timers.end(),
+        [](const Timer *lhs, const Timer *rhs) {
+            return lhs->_wheel_hook.tick < rhs->_wheel_hook.tick;
+        }
+    );
+}
+
+} // namespace xubinh_server
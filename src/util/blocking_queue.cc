@@ -1,5 +1,3 @@
-#include <functional>
-
 #include "util/blocking_queue.h"
 
 namespace xubinh_server {
@@ -92,7 +90,7 @@ BlockingQueue<ManagedType>::pop_all() {
 }
 
 // explicit instantiation
-template class BlockingQueue<std::function<void()>>;
+template class BlockingQueue<InplaceFunction<void()>>;
 
 } // namespace util
 
@@ -0,0 +1,212 @@
+#include <cstring>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+#include "util/delimiter_scan.h"
+
+namespace xubinh_server {
+
+namespace util {
+
+namespace delimiter_scan {
+
+namespace {
+
+const char *_find_byte_scalar(
+    const char *begin, const char *end, char byte
+) noexcept {
+    for (auto position = begin; position < end; position++) {
+        if (*position == byte) {
+            return position;
+        }
+    }
+
+    return nullptr;
+}
+
+const char *_find_byte_pair_scalar(
+    const char *begin, const char *end, char first_byte, char second_byte
+) noexcept {
+    for (auto position = begin; position + 1 < end; position++) {
+        if (position[0] == first_byte && position[1] == second_byte) {
+            return position;
+        }
+    }
+
+    return nullptr;
+}
+
+#ifdef __x86_64__
+
+// [NOTE]: `__builtin_cpu_init` is needed since this runs during static
+// initialization; callers that come even earlier see `false` and simply take
+// the SSE2 path
+const bool _is_avx2_supported = []() {
+    __builtin_cpu_init();
+
+    return __builtin_cpu_supports("avx2") != 0;
+}();
+
+const char *_find_byte_sse2(
+    const char *begin, const char *end, char byte
+) noexcept {
+    auto pattern = _mm_set1_epi8(byte);
+
+    auto position = begin;
+
+    for (; position + 16 <= end; position += 16) {
+        auto block =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(position));
+
+        auto mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern));
+
+        if (mask) {
+            return position + __builtin_ctz(static_cast<unsigned int>(mask));
+        }
+    }
+
+    return _find_byte_scalar(position, end, byte);
+}
+
+// the second byte is matched against the block shifted by one, so that a
+// pair is found by a single AND of the two masks
+const char *_find_byte_pair_sse2(
+    const char *begin, const char *end, char first_byte, char second_byte
+) noexcept {
+    auto first_pattern = _mm_set1_epi8(first_byte);
+    auto second_pattern = _mm_set1_epi8(second_byte);
+
+    auto position = begin;
+
+    for (; position + 17 <= end; position += 16) {
+        auto block =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(position));
+        auto next_block =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(position + 1));
+
+        auto mask = _mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(block, first_pattern),
+            _mm_cmpeq_epi8(next_block, second_pattern)
+        ));
+
+        if (mask) {
+            return position + __builtin_ctz(static_cast<unsigned int>(mask));
+        }
+    }
+
+    return _find_byte_pair_scalar(position, end, first_byte, second_byte);
+}
+
+__attribute__((target("avx2"))) const char *_find_byte_avx2(
+    const char *begin, const char *end, char byte
+) noexcept {
+    auto pattern = _mm256_set1_epi8(byte);
+
+    auto position = begin;
+
+    for (; position + 32 <= end; position += 32) {
+        auto block =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(position));
+
+        auto mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, pattern));
+
+        if (mask) {
+            return position + __builtin_ctz(static_cast<unsigned int>(mask));
+        }
+    }
+
+    return _find_byte_sse2(position, end, byte);
+}
+
+__attribute__((target("avx2"))) const char *_find_byte_pair_avx2(
+    const char *begin, const char *end, char first_byte, char second_byte
+) noexcept {
+    auto first_pattern = _mm256_set1_epi8(first_byte);
+    auto second_pattern = _mm256_set1_epi8(second_byte);
+
+    auto position = begin;
+
+    for (; position + 33 <= end; position += 32) {
+        auto block =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(position));
+        auto next_block =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(position + 1));
+
+        auto mask = _mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_cmpeq_epi8(block, first_pattern),
+            _mm256_cmpeq_epi8(next_block, second_pattern)
+        ));
+
+        if (mask) {
+            return position + __builtin_ctz(static_cast<unsigned int>(mask));
+        }
+    }
+
+    return _find_byte_pair_sse2(position, end, first_byte, second_byte);
+}
+
+#endif
+
+} // namespace
+
+const char *find_byte(const char *begin, const char *end, char byte) noexcept {
+#ifdef __x86_64__
+    return _is_avx2_supported ? _find_byte_avx2(begin, end, byte)
+                              : _find_byte_sse2(begin, end, byte);
+#else
+    return _find_byte_scalar(begin, end, byte);
+#endif
+}
+
+const char *find_byte_pair(
+    const char *begin, const char *end, char first_byte, char second_byte
+) noexcept {
+#ifdef __x86_64__
+    return _is_avx2_supported
+               ? _find_byte_pair_avx2(begin, end, first_byte, second_byte)
+               : _find_byte_pair_sse2(begin, end, first_byte, second_byte);
+#else
+    return _find_byte_pair_scalar(begin, end, first_byte, second_byte);
+#endif
+}
+
+const char *find_sequence(
+    const char *begin,
+    const char *end,
+    const char *sequence,
+    size_t sequence_size
+) noexcept {
+    if (sequence_size == 0) {
+        return begin;
+    }
+
+    if (sequence_size == 1) {
+        return find_byte(begin, end, sequence[0]);
+    }
+
+    // candidates are located by the leading pair, which is already selective
+    // for delimiters like "\r\n\r\n"
+    while (true) {
+        auto position = find_byte_pair(begin, end, sequence[0], sequence[1]);
+
+        if (!position
+            || static_cast<size_t>(end - position) < sequence_size) {
+
+            return nullptr;
+        }
+
+        if (::memcmp(position + 2, sequence + 2, sequence_size - 2) == 0) {
+            return position;
+        }
+
+        begin = position + 1;
+    }
+}
+
+} // namespace delimiter_scan
+
+} // namespace util
+
+} // namespace xubinh_server
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "event_loop_thread_pool.h"
+
+using xubinh_server::EventLoopThreadPool;
+using xubinh_server::InetAddress;
+
+using LoopSelectionPolicy = EventLoopThreadPool::LoopSelectionPolicy;
+
+namespace {
+
+constexpr size_t NUMBER_OF_LOOPS = 4;
+
+class EventLoopThreadPoolTest : public testing::Test {
+protected:
+    void SetUp() override {
+        thread_pool.start();
+    }
+
+    void TearDown() override {
+        // restores the counters so that they don't leak into other tests
+        for (size_t i = 0; i < NUMBER_OF_LOOPS; i++) {
+            auto loop = thread_pool.get_loop(i);
+
+            while (loop->get_number_of_connections() > 0) {
+                loop->decrement_number_of_connections();
+            }
+        }
+
+        thread_pool.stop();
+        thread_pool.join();
+    }
+
+    // loop `i` gets `loads[i]` connections
+    void set_up_loads(const std::vector<size_t> &loads) {
+        for (size_t i = 0; i < NUMBER_OF_LOOPS; i++) {
+            for (size_t j = 0; j < loads[i]; j++) {
+                thread_pool.get_loop(i)->increment_number_of_connections();
+            }
+        }
+    }
+
+    EventLoopThreadPool thread_pool{NUMBER_OF_LOOPS};
+};
+
+} // namespace
+
+TEST_F(EventLoopThreadPoolTest, RoundRobin) {
+    for (size_t i = 0; i < 2 * NUMBER_OF_LOOPS; i++) {
+        EXPECT_EQ(
+            thread_pool.get_next_loop()->get_loop_index(), i % NUMBER_OF_LOOPS
+        );
+    }
+}
+
+TEST_F(EventLoopThreadPoolTest, LeastConnections) {
+    thread_pool.set_loop_selection_policy(LoopSelectionPolicy::LEAST_CONNECTIONS
+    );
+
+    set_up_loads({3, 1, 2, 5});
+
+    for (size_t expected_loop_index : {1, 1, 2, 0, 1, 2}) {
+        auto loop = thread_pool.get_next_loop();
+
+        EXPECT_EQ(loop->get_loop_index(), expected_loop_index);
+
+        loop->increment_number_of_connections();
+    }
+}
+
+TEST_F(EventLoopThreadPoolTest, PowerOfTwoChoicesNeverPicksTheMostLoaded) {
+    thread_pool.set_loop_selection_policy(
+        LoopSelectionPolicy::POWER_OF_TWO_CHOICES_BY_CONNECTIONS
+    );
+
+    set_up_loads({0, 0, 100, 0});
+
+    std::set<uint64_t> chosen_loop_indices;
+
+    for (int i = 0; i < 1000; i++) {
+        chosen_loop_indices.insert(thread_pool.get_next_loop()->get_loop_index()
+        );
+    }
+
+    EXPECT_EQ(chosen_loop_indices, (std::set<uint64_t>{0, 1, 3}));
+}
+
+TEST_F(EventLoopThreadPoolTest, HashByPeerAddress) {
+    thread_pool.set_loop_selection_policy(
+        LoopSelectionPolicy::HASH_BY_PEER_ADDRESS
+    );
+
+    std::set<uint64_t> chosen_loop_indices;
+
+    for (int i = 0; i < 64; i++) {
+        InetAddress peer_address(
+            "10.0.0." + std::to_string(i), 10000, InetAddress::IPv4
+        );
+
+        auto loop_index =
+            thread_pool.get_next_loop(&peer_address)->get_loop_index();
+
+        // the port does not matter
+        InetAddress same_peer_address(
+            "10.0.0." + std::to_string(i), 20000, InetAddress::IPv4
+        );
+
+        EXPECT_EQ(
+            thread_pool.get_next_loop(&same_peer_address)->get_loop_index(),
+            loop_index
+        );
+
+        chosen_loop_indices.insert(loop_index);
+    }
+
+    EXPECT_EQ(chosen_loop_indices.size(), NUMBER_OF_LOOPS);
+}
+
+TEST_F(EventLoopThreadPoolTest, CustomLoopSelector) {
+    thread_pool.set_loop_selection_policy(LoopSelectionPolicy::LEAST_CONNECTIONS
+    );
+
+    thread_pool.register_loop_selector(
+        [](const EventLoopThreadPool &this_thread_pool, const InetAddress *) {
+            return this_thread_pool.size() - 1;
+        }
+    );
+
+    EXPECT_EQ(
+        thread_pool.get_next_loop()->get_loop_index(), NUMBER_OF_LOOPS - 1
+    );
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+
+    // Disable output capturing
+    testing::FLAGS_gtest_catch_exceptions = false;
+
+    return RUN_ALL_TESTS();
+}
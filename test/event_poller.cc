@@ -0,0 +1,533 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "event_loop_thread.h"
+#include "event_poller.h"
+#include "eventfd.h"
+
+using xubinh_server::EventLoop;
+using xubinh_server::EventLoopThread;
+using xubinh_server::EventPoller;
+using xubinh_server::Eventfd;
+using xubinh_server::PollableFileDescriptor;
+using xubinh_server::util::TimeInterval;
+using xubinh_server::util::TimePoint;
+
+namespace {
+
+constexpr int64_t MILLISECOND = TimeInterval::SECOND / 1000;
+
+// [NOTE]: the tests run against whichever backend the library is built with,
+// i.e. they also cover `__USE_IO_URING_POLLER`, whose non-blocking polls must
+// not miss the readiness that arrives after the fd is watched, and the ones
+// about the requests made by the io_uring poller on behalf of the fds only
+// run with it
+
+TEST(EventPollerTest, ReportsReadinessOfWatchedFds) {
+    EventPoller poller;
+
+    int eventfd = Eventfd::create_eventfd(0);
+
+    ASSERT_NE(eventfd, -1);
+
+    PollableFileDescriptor pollable_file_descriptor(eventfd, nullptr);
+
+    epoll_event event{};
+
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = &pollable_file_descriptor;
+
+    poller.register_event_for_fd(eventfd, &event);
+
+    uint64_t value = 1;
+
+    ASSERT_EQ(::write(eventfd, &value, sizeof(value)), sizeof(value));
+
+    std::vector<PollableFileDescriptor *> event_dispatchers;
+
+    poller.poll_for_active_events_of_all_fds(event_dispatchers);
+
+    ASSERT_EQ(event_dispatchers.size(), 1);
+    EXPECT_EQ(event_dispatchers[0], &pollable_file_descriptor);
+
+    poller.detach_fd(eventfd);
+
+    ::close(eventfd);
+}
+
+TEST(EventPollerTest, NonBlockingPollSeesNewReadiness) {
+    EventPoller poller;
+
+    int eventfd = Eventfd::create_eventfd(0);
+
+    ASSERT_NE(eventfd, -1);
+
+    PollableFileDescriptor pollable_file_descriptor(eventfd, nullptr);
+
+    epoll_event event{};
+
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = &pollable_file_descriptor;
+
+    poller.register_event_for_fd(eventfd, &event);
+
+    std::vector<PollableFileDescriptor *> event_dispatchers;
+
+    // starts watching the fd while it is not ready yet
+    poller.poll_for_active_events_of_all_fds(event_dispatchers, false);
+
+    EXPECT_TRUE(event_dispatchers.empty());
+
+    uint64_t value = 1;
+
+    ASSERT_EQ(::write(eventfd, &value, sizeof(value)), sizeof(value));
+
+    TimePoint deadline = TimePoint() + TimeInterval::SECOND;
+
+    while (event_dispatchers.empty() && TimePoint() < deadline) {
+        poller.poll_for_active_events_of_all_fds(event_dispatchers, false);
+    }
+
+    ASSERT_EQ(event_dispatchers.size(), 1);
+    EXPECT_EQ(event_dispatchers[0], &pollable_file_descriptor);
+
+    poller.detach_fd(eventfd);
+
+    ::close(eventfd);
+}
+
+#ifdef __USE_IO_URING_POLLER
+
+// polls until the poller has handed over at least the given number of results
+// to the fd
+void poll_for_completions(
+    EventPoller &poller,
+    PollableFileDescriptor &pollable_file_descriptor,
+    size_t number_of_completions
+) {
+    std::vector<PollableFileDescriptor *> event_dispatchers;
+
+    while (pollable_file_descriptor.get_completions().size()
+           < number_of_completions) {
+
+        poller.poll_for_active_events_of_all_fds(event_dispatchers);
+    }
+}
+
+TEST(EventPollerTest, MultishotAcceptHandsOverConnections) {
+    EventPoller poller;
+
+    int listen_socketfd =
+        ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    ASSERT_NE(listen_socketfd, -1);
+
+    sockaddr_in address{};
+
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    socklen_t address_length = sizeof(address);
+
+    ASSERT_EQ(
+        ::bind(
+            listen_socketfd,
+            reinterpret_cast<sockaddr *>(&address),
+            address_length
+        ),
+        0
+    );
+    ASSERT_EQ(::listen(listen_socketfd, 16), 0);
+    ASSERT_EQ(
+        ::getsockname(
+            listen_socketfd,
+            reinterpret_cast<sockaddr *>(&address),
+            &address_length
+        ),
+        0
+    );
+
+    PollableFileDescriptor pollable_file_descriptor(
+        listen_socketfd, nullptr, false
+    );
+
+    pollable_file_descriptor.set_read_mode(
+        PollableFileDescriptor::READ_MODE_MULTISHOT_ACCEPT
+    );
+
+    epoll_event event{};
+
+    event.events = EPOLLIN;
+    event.data.ptr = &pollable_file_descriptor;
+
+    poller.register_event_for_fd(listen_socketfd, &event);
+
+    constexpr size_t NUMBER_OF_CLIENTS = 3;
+
+    std::vector<int> client_socketfds;
+
+    for (size_t i = 0; i < NUMBER_OF_CLIENTS; i++) {
+        int client_socketfd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+        ASSERT_NE(client_socketfd, -1);
+        ASSERT_EQ(
+            ::connect(
+                client_socketfd,
+                reinterpret_cast<sockaddr *>(&address),
+                address_length
+            ),
+            0
+        );
+
+        client_socketfds.push_back(client_socketfd);
+    }
+
+    poll_for_completions(poller, pollable_file_descriptor, NUMBER_OF_CLIENTS);
+
+    auto &completions = pollable_file_descriptor.get_completions();
+
+    ASSERT_EQ(completions.size(), NUMBER_OF_CLIENTS);
+
+    for (const auto &completion : completions) {
+        ASSERT_GE(completion.result, 0);
+
+        // the accepted fds are non-blocking, just like the ones accepted by
+        // `ListenSocketfd`
+        EXPECT_TRUE(::fcntl(completion.result, F_GETFL) & O_NONBLOCK);
+
+        ::close(completion.result);
+    }
+
+    completions.clear();
+
+    poller.detach_fd(listen_socketfd);
+
+    for (auto client_socketfd : client_socketfds) {
+        ::close(client_socketfd);
+    }
+
+    ::close(listen_socketfd);
+}
+
+TEST(EventPollerTest, MultishotReceiveFillsProvidedBuffers) {
+    EventPoller poller;
+
+    int socketfds[2];
+
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, socketfds), 0);
+
+    PollableFileDescriptor pollable_file_descriptor(socketfds[0], nullptr);
+
+    pollable_file_descriptor.set_read_mode(
+        PollableFileDescriptor::READ_MODE_MULTISHOT_RECEIVE
+    );
+
+    epoll_event event{};
+
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = &pollable_file_descriptor;
+
+    poller.register_event_for_fd(socketfds[0], &event);
+
+    // the poller falls back to readiness without provided buffer rings
+    if (pollable_file_descriptor.get_read_mode()
+        != PollableFileDescriptor::READ_MODE_MULTISHOT_RECEIVE) {
+
+        poller.detach_fd(socketfds[0]);
+
+        ::close(socketfds[0]);
+        ::close(socketfds[1]);
+
+        GTEST_SKIP() << "provided buffer rings are not supported";
+    }
+
+    const std::string message = "hello, io_uring";
+
+    ASSERT_EQ(
+        ::write(socketfds[1], message.c_str(), message.size()),
+        static_cast<ssize_t>(message.size())
+    );
+
+    // EOF is handed over as a result of zero
+    ::shutdown(socketfds[1], SHUT_WR);
+
+    auto &completions = pollable_file_descriptor.get_completions();
+
+    std::string received_data;
+
+    while (completions.empty() || completions.back().result != 0) {
+        poll_for_completions(poller, pollable_file_descriptor, 1);
+
+        for (const auto &completion : completions) {
+            if (completion.result <= 0) {
+                continue;
+            }
+
+            ASSERT_TRUE(completion.flags & IORING_CQE_F_BUFFER);
+
+            auto buffer_id = static_cast<uint16_t>(
+                completion.flags >> IORING_CQE_BUFFER_SHIFT
+            );
+
+            received_data.append(
+                poller.get_provided_buffer(buffer_id),
+                static_cast<size_t>(completion.result)
+            );
+
+            poller.recycle_provided_buffer(buffer_id);
+        }
+
+        if (completions.back().result != 0) {
+            completions.clear();
+        }
+    }
+
+    EXPECT_EQ(received_data, message);
+
+    completions.clear();
+
+    poller.detach_fd(socketfds[0]);
+
+    ::close(socketfds[0]);
+    ::close(socketfds[1]);
+}
+
+TEST(EventPollerTest, PausedReceiveKeepsDataInFlight) {
+    EventPoller poller;
+
+    int socketfds[2];
+
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, socketfds), 0);
+
+    PollableFileDescriptor pollable_file_descriptor(socketfds[0], nullptr);
+
+    pollable_file_descriptor.set_read_mode(
+        PollableFileDescriptor::READ_MODE_MULTISHOT_RECEIVE
+    );
+
+    epoll_event event{};
+
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = &pollable_file_descriptor;
+
+    poller.register_event_for_fd(socketfds[0], &event);
+
+    if (pollable_file_descriptor.get_read_mode()
+        != PollableFileDescriptor::READ_MODE_MULTISHOT_RECEIVE) {
+
+        poller.detach_fd(socketfds[0]);
+
+        ::close(socketfds[0]);
+        ::close(socketfds[1]);
+
+        GTEST_SKIP() << "provided buffer rings are not supported";
+    }
+
+    std::vector<PollableFileDescriptor *> event_dispatchers;
+
+    // arms the receive request
+    poller.poll_for_active_events_of_all_fds(event_dispatchers, false);
+
+    ASSERT_TRUE(event_dispatchers.empty());
+
+    const std::string message = "sent right before the pause";
+
+    ASSERT_EQ(
+        ::write(socketfds[1], message.c_str(), message.size()),
+        static_cast<ssize_t>(message.size())
+    );
+
+    // pauses the same way as `PollableFileDescriptor::pause_read_event`, i.e.
+    // cancels the receive request while the data might be on its way
+    event.events = EPOLLET;
+
+    poller.register_event_for_fd(socketfds[0], &event);
+
+    for (int i = 0; i < 16; i++) {
+        poller.poll_for_active_events_of_all_fds(event_dispatchers, false);
+
+        EXPECT_TRUE(event_dispatchers.empty());
+    }
+
+    // nothing is dispatched while being paused, and no data is dropped after
+    // resuming, whether it was received before the cancellation or not
+    event.events = EPOLLIN | EPOLLET;
+
+    poller.register_event_for_fd(socketfds[0], &event);
+
+    auto &completions = pollable_file_descriptor.get_completions();
+
+    std::string received_data;
+
+    while (received_data.size() < message.size()) {
+        poll_for_completions(poller, pollable_file_descriptor, 1);
+
+        for (const auto &completion : completions) {
+            ASSERT_GT(completion.result, 0);
+
+            auto buffer_id = static_cast<uint16_t>(
+                completion.flags >> IORING_CQE_BUFFER_SHIFT
+            );
+
+            received_data.append(
+                poller.get_provided_buffer(buffer_id),
+                static_cast<size_t>(completion.result)
+            );
+
+            poller.recycle_provided_buffer(buffer_id);
+        }
+
+        completions.clear();
+    }
+
+    EXPECT_EQ(received_data, message);
+
+    poller.detach_fd(socketfds[0]);
+
+    ::close(socketfds[0]);
+    ::close(socketfds[1]);
+}
+
+#endif
+
+class BusyPollingLoopTest : public testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, socketfds), 0);
+
+        loop_thread.start();
+
+        loop = loop_thread.get_loop();
+
+        run_and_wait([this]() {
+            loop->set_max_busy_poll_budget(
+                TimeInterval(MAX_BUSY_POLL_BUDGET)
+            );
+
+            pollable_file_descriptor.reset(
+                new PollableFileDescriptor(socketfds[0], loop)
+            );
+
+            pollable_file_descriptor->register_read_event_callback(
+                [this](TimePoint) {
+                    char buffer[64];
+
+                    while (::read(socketfds[0], buffer, sizeof(buffer)) > 0) {
+                    }
+
+                    number_of_reads.fetch_add(1, std::memory_order_release);
+                }
+            );
+
+            pollable_file_descriptor->enable_read_event();
+        });
+    }
+
+    void TearDown() override {
+        run_and_wait([this]() {
+            pollable_file_descriptor->detach_from_poller();
+        });
+
+        loop->ask_to_stop();
+
+        loop_thread.join();
+
+        ::close(socketfds[0]);
+        ::close(socketfds[1]);
+    }
+
+    template <typename FunctorType>
+    void run_and_wait(FunctorType functor) {
+        std::atomic<bool> is_done{false};
+
+        loop->run([&functor, &is_done]() {
+            functor();
+
+            is_done.store(true, std::memory_order_release);
+        });
+
+        while (!is_done.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    int64_t get_busy_poll_budget() {
+        int64_t busy_poll_budget = 0;
+
+        run_and_wait([this, &busy_poll_budget]() {
+            busy_poll_budget = loop->get_busy_poll_budget().nanoseconds;
+        });
+
+        return busy_poll_budget;
+    }
+
+    static constexpr int64_t MAX_BUSY_POLL_BUDGET = 2 * TimeInterval::SECOND;
+
+    int socketfds[2];
+    EventLoopThread loop_thread{"busy-poll-loop", nullptr};
+    EventLoop *loop = nullptr;
+    std::unique_ptr<PollableFileDescriptor> pollable_file_descriptor;
+    std::atomic<int> number_of_reads{0};
+};
+
+} // namespace
+
+TEST_F(BusyPollingLoopTest, SeesReadinessWhileSpinning) {
+    TimePoint deadline = TimePoint() + 10 * TimeInterval::SECOND;
+
+    int64_t busy_poll_budget;
+
+    // the budget grows whenever the loop gets woken up shortly after it
+    // stopped spinning and blocked, so wake it up right after each spinning
+    // until the loop spins for long enough
+    while ((busy_poll_budget = get_busy_poll_budget()) < TimeInterval::SECOND
+           && TimePoint() < deadline) {
+
+        std::this_thread::sleep_for(
+            std::chrono::nanoseconds(busy_poll_budget + MILLISECOND)
+        );
+    }
+
+    ASSERT_GE(busy_poll_budget, TimeInterval::SECOND);
+
+    // each write lands while the loop is spinning, which should see it long
+    // before the spinning would end
+    for (int i = 1; i <= 5; i++) {
+        ASSERT_EQ(::write(socketfds[1], "x", 1), 1);
+
+        TimePoint write_time_point;
+
+        while (number_of_reads.load(std::memory_order_acquire) < i
+               && TimePoint() - write_time_point
+                      < TimeInterval(MAX_BUSY_POLL_BUDGET * 2)) {
+
+            std::this_thread::yield();
+        }
+
+        EXPECT_EQ(number_of_reads.load(std::memory_order_acquire), i);
+        EXPECT_LT(
+            (TimePoint() - write_time_point).nanoseconds, 100 * MILLISECOND
+        );
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+
+    // Disable output capturing
+    testing::FLAGS_gtest_catch_exceptions = false;
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <unordered_map>
+
+#include "util/flat_id_map.h"
+
+using xubinh_server::util::FlatIdMap;
+
+TEST(FlatIdMapTest, InsertsFindsAndErases) {
+    FlatIdMap<int> map;
+
+    EXPECT_TRUE(map.empty());
+
+    EXPECT_TRUE(map.insert(0, 10));
+    EXPECT_TRUE(map.insert(1, 11));
+    EXPECT_FALSE(map.insert(1, 12));
+
+    EXPECT_EQ(map.size(), 2);
+    ASSERT_NE(map.find(1), nullptr);
+    EXPECT_EQ(*map.find(1), 11);
+    EXPECT_EQ(map.find(2), nullptr);
+
+    EXPECT_TRUE(map.erase(0));
+    EXPECT_FALSE(map.erase(0));
+
+    EXPECT_EQ(map.find(0), nullptr);
+    EXPECT_EQ(map.size(), 1);
+}
+
+TEST(FlatIdMapTest, GrowsAndKeepsEverything) {
+    FlatIdMap<uint64_t> map;
+
+    auto initial_capacity = map.get_capacity();
+
+    for (uint64_t id = 0; id < 1000; id++) {
+        ASSERT_TRUE(map.insert(id, id * 2));
+    }
+
+    EXPECT_GT(map.get_capacity(), initial_capacity);
+    EXPECT_LE(map.size() * 2, map.get_capacity());
+
+    for (uint64_t id = 0; id < 1000; id++) {
+        ASSERT_NE(map.find(id), nullptr);
+        EXPECT_EQ(*map.find(id), id * 2);
+    }
+
+    uint64_t sum = 0;
+
+    map.for_each([&](uint64_t id, uint64_t value) {
+        EXPECT_EQ(value, id * 2);
+
+        sum += id;
+    });
+
+    EXPECT_EQ(sum, 999 * 1000 / 2);
+}
+
+// connections come and go in no particular order
+TEST(FlatIdMapTest, AgreesWithStandardMapUnderChurn) {
+    FlatIdMap<uint64_t> map;
+    std::unordered_map<uint64_t, uint64_t> expected_map;
+
+    std::mt19937_64 random_engine(42);
+
+    uint64_t next_id = 0;
+
+    for (int i = 0; i < 200000; i++) {
+        if (expected_map.size() < 300 && random_engine() % 2 == 0) {
+            auto id = next_id++;
+
+            ASSERT_TRUE(map.insert(id, id + 1));
+
+            expected_map.emplace(id, id + 1);
+        }
+
+        else if (!expected_map.empty()) {
+            // ids close to the latest ones are the most likely to collide
+            auto id = next_id - 1
+                      - random_engine() % std::min<uint64_t>(next_id, 400);
+
+            ASSERT_EQ(map.erase(id), expected_map.erase(id) == 1);
+        }
+    }
+
+    ASSERT_EQ(map.size(), expected_map.size());
+
+    for (const auto &pair : expected_map) {
+        ASSERT_NE(map.find(pair.first), nullptr);
+        EXPECT_EQ(*map.find(pair.first), pair.second);
+    }
+
+    size_t number_of_entries = 0;
+
+    map.for_each([&](uint64_t, uint64_t) {
+        ++number_of_entries;
+    });
+
+    EXPECT_EQ(number_of_entries, expected_map.size());
+}
+
+TEST(FlatIdMapTest, ReleasesErasedValues) {
+    FlatIdMap<std::shared_ptr<int>> map;
+
+    auto value = std::make_shared<int>(1);
+
+    for (uint64_t id = 0; id < 100; id++) {
+        map.insert(id, value);
+    }
+
+    EXPECT_EQ(value.use_count(), 101);
+
+    for (uint64_t id = 0; id < 50; id++) {
+        map.erase(id);
+    }
+
+    EXPECT_EQ(value.use_count(), 51);
+
+    map.clear();
+
+    EXPECT_EQ(value.use_count(), 1);
+    EXPECT_TRUE(map.empty());
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+
+    // Disable output capturing
+    testing::FLAGS_gtest_catch_exceptions = false;
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,166 @@
+#include <array>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "util/inplace_function.h"
+
+using xubinh_server::util::InplaceFunction;
+
+namespace {
+
+int add(int a, int b) {
+    return a + b;
+}
+
+// counts the instances alive, for checking that nothing is leaked or destroyed
+// twice
+struct Counted {
+    static int number_of_instances;
+
+    Counted() {
+        ++number_of_instances;
+    }
+
+    Counted(const Counted &) {
+        ++number_of_instances;
+    }
+
+    Counted(Counted &&) noexcept {
+        ++number_of_instances;
+    }
+
+    ~Counted() {
+        --number_of_instances;
+    }
+};
+
+int Counted::number_of_instances = 0;
+
+} // namespace
+
+TEST(InplaceFunctionTest, EmptyByDefault) {
+    InplaceFunction<void()> f;
+
+    EXPECT_FALSE(f);
+
+    InplaceFunction<void()> g = nullptr;
+
+    EXPECT_FALSE(g);
+
+    int (*null_function_pointer)(int, int) = nullptr;
+
+    InplaceFunction<int(int, int)> h = null_function_pointer;
+
+    EXPECT_FALSE(h);
+}
+
+TEST(InplaceFunctionTest, InvokesFunctionPointersAndLambdas) {
+    InplaceFunction<int(int, int)> f = add;
+
+    EXPECT_TRUE(f);
+    EXPECT_EQ(f(1, 2), 3);
+
+    int offset = 10;
+
+    f = [offset](int a, int b) {
+        return a + b + offset;
+    };
+
+    EXPECT_EQ(f(1, 2), 13);
+
+    // results are discarded if the return type is `void`
+    InplaceFunction<void(int, int)> g = add;
+
+    g(1, 2);
+}
+
+TEST(InplaceFunctionTest, AcceptsMoveOnlyCallables) {
+    auto value = std::unique_ptr<int>(new int(42));
+
+    InplaceFunction<int()> f = [value = std::move(value)]() {
+        return *value;
+    };
+
+    InplaceFunction<int()> g = std::move(f);
+
+    EXPECT_FALSE(f);
+    EXPECT_TRUE(g);
+    EXPECT_EQ(g(), 42);
+}
+
+TEST(InplaceFunctionTest, ForwardsArguments) {
+    InplaceFunction<std::string(std::unique_ptr<std::string>, std::string &)>
+        f = [](std::unique_ptr<std::string> a, std::string &b) {
+            b += "!";
+
+            return *a + b;
+        };
+
+    std::string b = "b";
+
+    EXPECT_EQ(f(std::unique_ptr<std::string>(new std::string("a")), b), "ab!");
+    EXPECT_EQ(b, "b!");
+}
+
+TEST(InplaceFunctionTest, StoresSmallCallablesInline) {
+    using FunctionType = InplaceFunction<void()>;
+
+    auto small_callable = [pointer = static_cast<void *>(nullptr)]() {
+        static_cast<void>(pointer);
+    };
+
+    auto large_callable = [array = std::array<char, FunctionType::CAPACITY + 1>(
+                           )]() {
+        static_cast<void>(array);
+    };
+
+    EXPECT_TRUE(FunctionType::is_stored_inline<decltype(small_callable)>());
+    EXPECT_FALSE(FunctionType::is_stored_inline<decltype(large_callable)>());
+    EXPECT_EQ(sizeof(FunctionType), 64);
+}
+
+TEST(InplaceFunctionTest, DestroysCallablesExactlyOnce) {
+    {
+        InplaceFunction<void()> f = [counted = Counted()]() {
+        };
+
+        EXPECT_EQ(Counted::number_of_instances, 1);
+
+        InplaceFunction<void()> g = std::move(f);
+
+        EXPECT_EQ(Counted::number_of_instances, 1);
+
+        // callables stored on the heap
+        InplaceFunction<void()> h =
+            [counted = Counted(),
+             array = std::array<char, InplaceFunction<void()>::CAPACITY>()]() {
+                static_cast<void>(array);
+            };
+
+        EXPECT_EQ(Counted::number_of_instances, 2);
+
+        g = std::move(h);
+
+        EXPECT_EQ(Counted::number_of_instances, 1);
+
+        g = nullptr;
+
+        EXPECT_EQ(Counted::number_of_instances, 0);
+
+        g = [counted = Counted()]() {
+        };
+    }
+
+    EXPECT_EQ(Counted::number_of_instances, 0);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+
+    // Disable output capturing
+    testing::FLAGS_gtest_catch_exceptions = false;
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,247 @@
+#include <atomic>
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "util/intrusive_ptr.h"
+
+using xubinh_server::util::IntrusivePtr;
+using xubinh_server::util::IntrusiveReferenceCounted;
+using xubinh_server::util::LocalIntrusivePtr;
+
+namespace {
+
+std::atomic<int> _number_of_live_objects{0};
+std::atomic<int> _number_of_live_allocations{0};
+
+// stateless, as `IntrusiveReferenceCounted` assumes
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    T *allocate(size_t n) {
+        _number_of_live_allocations.fetch_add(1, std::memory_order_relaxed);
+
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *pointer, size_t n) {
+        _number_of_live_allocations.fetch_sub(1, std::memory_order_relaxed);
+
+        std::allocator<T>().deallocate(pointer, n);
+    }
+};
+
+class Object
+    : public IntrusiveReferenceCounted<Object, CountingAllocator<Object>> {
+public:
+    explicit Object(int initial_value, bool need_throw = false)
+        : value(initial_value) {
+
+        if (need_throw) {
+            throw std::runtime_error("failed to construct");
+        }
+
+        _number_of_live_objects.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Object() {
+        _number_of_live_objects.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    int value;
+};
+
+class IntrusivePtrTest : public testing::Test {
+protected:
+    void TearDown() override {
+        EXPECT_EQ(_number_of_live_objects.load(), 0);
+        EXPECT_EQ(_number_of_live_allocations.load(), 0);
+    }
+};
+
+} // namespace
+
+TEST_F(IntrusivePtrTest, CountsReferencesAndDestroysWithTheLastOne) {
+    auto object_ptr = Object::create(42);
+
+    EXPECT_EQ(object_ptr->value, 42);
+    EXPECT_EQ(object_ptr->get_number_of_references(), 1);
+    EXPECT_EQ(_number_of_live_objects.load(), 1);
+
+    auto copied_object_ptr = object_ptr;
+
+    EXPECT_EQ(object_ptr->get_number_of_references(), 2);
+    EXPECT_EQ(copied_object_ptr, object_ptr);
+
+    auto moved_object_ptr = std::move(copied_object_ptr);
+
+    EXPECT_FALSE(copied_object_ptr);
+    EXPECT_EQ(object_ptr->get_number_of_references(), 2);
+
+    moved_object_ptr.reset();
+
+    EXPECT_EQ(object_ptr->get_number_of_references(), 1);
+    EXPECT_EQ(_number_of_live_objects.load(), 1);
+
+    object_ptr = nullptr;
+
+    EXPECT_EQ(_number_of_live_objects.load(), 0);
+}
+
+TEST_F(IntrusivePtrTest, ReleasesTheMemoryIfConstructionThrows) {
+    EXPECT_THROW(Object::create(0, true), std::runtime_error);
+}
+
+// the local references together hold a single atomic one
+TEST_F(IntrusivePtrTest, CountsLocalReferencesApart) {
+    auto object_ptr = Object::create(0);
+
+    LocalIntrusivePtr<Object> local_object_ptr(object_ptr.get());
+
+    EXPECT_EQ(object_ptr->get_number_of_references(), 2);
+
+    {
+        std::vector<LocalIntrusivePtr<Object>> local_object_ptrs(
+            100, local_object_ptr
+        );
+
+        EXPECT_EQ(object_ptr->get_number_of_references(), 2);
+    }
+
+    // the object survives the atomic reference being gone
+    object_ptr.reset();
+
+    EXPECT_EQ(local_object_ptr->get_number_of_references(), 1);
+    EXPECT_EQ(_number_of_live_objects.load(), 1);
+
+    local_object_ptr.reset();
+
+    EXPECT_EQ(_number_of_live_objects.load(), 0);
+}
+
+// the owner thread keeps copying its local references while the others copy
+// and release atomic ones, and whoever releases the last reference destroys
+// the object
+TEST_F(IntrusivePtrTest, HandsReferencesOffBetweenThreads) {
+    for (int round = 0; round < 100; round++) {
+        auto object_ptr = Object::create(round);
+
+        LocalIntrusivePtr<Object> local_object_ptr(object_ptr.get());
+
+        std::atomic<bool> is_started{false};
+
+        std::vector<std::thread> threads;
+
+        for (int i = 0; i < 4; i++) {
+            // each thread takes its own atomic reference along
+            threads.emplace_back([&is_started, object_ptr]() mutable {
+                while (!is_started.load(std::memory_order_acquire)) {
+                }
+
+                for (int j = 0; j < 1000; j++) {
+                    auto copied_object_ptr = object_ptr;
+
+                    EXPECT_GE(copied_object_ptr->value, 0);
+                }
+            });
+        }
+
+        object_ptr.reset();
+
+        is_started.store(true, std::memory_order_release);
+
+        for (int j = 0; j < 1000; j++) {
+            auto copied_local_object_ptr = local_object_ptr;
+
+            EXPECT_EQ(copied_local_object_ptr->value, round);
+        }
+
+        // the other threads might still be holding theirs
+        local_object_ptr.reset();
+
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        ASSERT_EQ(_number_of_live_objects.load(), 0);
+    }
+}
+
+// the way a pool takes the objects back, e.g. the recycled connections
+TEST_F(IntrusivePtrTest, ReleasesForReuseOnlyWithTheLastLocalReference) {
+    auto object_ptr = Object::create(1);
+
+    auto object = object_ptr.get();
+
+    object->add_local_reference();
+
+    // an atomic reference is still held
+    EXPECT_FALSE(object->try_releasing_for_reuse());
+    EXPECT_EQ(object->get_number_of_references(), 2);
+
+    object_ptr.reset();
+
+    // another local reference is still held
+    object->add_local_reference();
+
+    EXPECT_FALSE(object->try_releasing_for_reuse());
+
+    object->release_local_reference();
+
+    EXPECT_TRUE(object->try_releasing_for_reuse());
+    EXPECT_EQ(object->get_number_of_references(), 0);
+    EXPECT_EQ(_number_of_live_objects.load(), 1);
+
+    // reused with the counts starting over
+    object->value = 2;
+
+    IntrusivePtr<Object> reused_object_ptr(object);
+
+    EXPECT_EQ(reused_object_ptr->get_number_of_references(), 1);
+
+    {
+        LocalIntrusivePtr<Object> local_object_ptr(object);
+
+        EXPECT_EQ(object->get_number_of_references(), 2);
+    }
+
+    reused_object_ptr.reset();
+
+    EXPECT_EQ(_number_of_live_objects.load(), 0);
+}
+
+// references released in other threads are seen before the object is reused
+TEST_F(IntrusivePtrTest, ReleasesForReuseAfterOtherThreadsLetGo) {
+    auto object_ptr = Object::create(0);
+
+    auto object = object_ptr.get();
+
+    object->add_local_reference();
+
+    std::thread thread([object_ptr = std::move(object_ptr)]() mutable {
+        object_ptr->value = 1;
+
+        object_ptr.reset();
+    });
+
+    while (!object->try_releasing_for_reuse()) {
+    }
+
+    EXPECT_EQ(object->value, 1);
+
+    thread.join();
+
+    IntrusivePtr<Object> reused_object_ptr(object);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+
+    // Disable output capturing
+    testing::FLAGS_gtest_catch_exceptions = false;
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,304 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "event_loop_thread.h"
+#include "inet_address.h"
+#include "tcp_connect_socketfd.h"
+#include "util/iovec_builder.h"
+
+using xubinh_server::EventLoop;
+using xubinh_server::EventLoopThread;
+using xubinh_server::InetAddress;
+using xubinh_server::TcpConnectSocketfd;
+using xubinh_server::TcpInputBuffer;
+using xubinh_server::util::IovecBuilder;
+using xubinh_server::util::TimePoint;
+
+namespace {
+
+std::string _get_iovec_string(const iovec &iovec_entry) {
+    return std::string(
+        static_cast<const char *>(iovec_entry.iov_base), iovec_entry.iov_len
+    );
+}
+
+} // namespace
+
+TEST(IovecBuilderTest, MergesAdjacentPieces) {
+    IovecBuilder<> iovec_builder;
+
+    const char data[] = "header: value\r\nbody";
+
+    EXPECT_TRUE(iovec_builder.append(data, 6));
+    EXPECT_TRUE(iovec_builder.append(data + 6, 9));
+
+    // empty pieces are skipped
+    EXPECT_TRUE(iovec_builder.append(data, 0));
+    EXPECT_TRUE(iovec_builder.append(""));
+
+    std::string body = "body";
+
+    EXPECT_TRUE(iovec_builder.append(body.data(), body.size()));
+
+    ASSERT_EQ(iovec_builder.get_number_of_iovecs(), 2);
+    EXPECT_EQ(iovec_builder.get_total_size(), 15 + body.size());
+
+    EXPECT_EQ(
+        _get_iovec_string(iovec_builder.get_iovecs()[0]), "header: value\r\n"
+    );
+    EXPECT_EQ(_get_iovec_string(iovec_builder.get_iovecs()[1]), "body");
+
+    iovec_builder.clear();
+
+    EXPECT_EQ(iovec_builder.get_number_of_iovecs(), 0);
+    EXPECT_EQ(iovec_builder.get_total_size(), 0);
+}
+
+TEST(IovecBuilderTest, RefusesPiecesBeyondCapacity) {
+    IovecBuilder<2> iovec_builder;
+
+    const char data[] = "abcdef";
+
+    EXPECT_TRUE(iovec_builder.append(data, 1));
+    EXPECT_TRUE(iovec_builder.append(data + 2, 1));
+
+    // nothing is appended once full
+    EXPECT_FALSE(iovec_builder.append(data + 4, 1));
+
+    EXPECT_EQ(iovec_builder.get_number_of_iovecs(), 2);
+    EXPECT_EQ(iovec_builder.get_total_size(), 2);
+
+    // but an adjacent piece still takes no new entry
+    EXPECT_TRUE(iovec_builder.append(data + 3, 1));
+
+    EXPECT_EQ(iovec_builder.get_number_of_iovecs(), 2);
+    EXPECT_EQ(iovec_builder.get_total_size(), 3);
+    EXPECT_EQ(_get_iovec_string(iovec_builder.get_iovecs()[1]), "cd");
+
+    iovec_builder.clear();
+
+    EXPECT_TRUE(iovec_builder.append(data + 4, 1));
+}
+
+namespace {
+
+// a connection of a worker loop, whose peer is read by the test
+class IovecSendingTest : public testing::Test {
+protected:
+    void SetUp() override {
+        int listen_socketfd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+        ASSERT_NE(listen_socketfd, -1);
+
+        sockaddr_in address{};
+
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+
+        socklen_t address_length = sizeof(address);
+
+        ASSERT_EQ(
+            ::bind(
+                listen_socketfd,
+                reinterpret_cast<sockaddr *>(&address),
+                address_length
+            ),
+            0
+        );
+        ASSERT_EQ(::listen(listen_socketfd, 1), 0);
+        ASSERT_EQ(
+            ::getsockname(
+                listen_socketfd,
+                reinterpret_cast<sockaddr *>(&address),
+                &address_length
+            ),
+            0
+        );
+
+        peer_socketfd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+        ASSERT_NE(peer_socketfd, -1);
+
+        // small buffers on both sides so that a single send could not take
+        // everything
+        int buffer_size = 4096;
+
+        ::setsockopt(
+            peer_socketfd,
+            SOL_SOCKET,
+            SO_RCVBUF,
+            &buffer_size,
+            sizeof(buffer_size)
+        );
+
+        ASSERT_EQ(
+            ::connect(
+                peer_socketfd,
+                reinterpret_cast<sockaddr *>(&address),
+                address_length
+            ),
+            0
+        );
+
+        int connect_socketfd =
+            ::accept4(listen_socketfd, nullptr, nullptr, SOCK_NONBLOCK);
+
+        ASSERT_NE(connect_socketfd, -1);
+
+        ::close(listen_socketfd);
+
+        ::setsockopt(
+            connect_socketfd,
+            SOL_SOCKET,
+            SO_SNDBUF,
+            &buffer_size,
+            sizeof(buffer_size)
+        );
+
+        loop_thread.start();
+
+        loop = loop_thread.get_loop();
+
+        run_and_wait([this, connect_socketfd]() {
+            tcp_connect_socketfd_ptr = TcpConnectSocketfd::create(
+                connect_socketfd,
+                loop,
+                0,
+                InetAddress(connect_socketfd, InetAddress::LOCAL),
+                InetAddress(connect_socketfd, InetAddress::PEER),
+                TimePoint()
+            );
+
+            tcp_connect_socketfd_ptr->register_message_callback(
+                [](TcpConnectSocketfd *, TcpInputBuffer *input_buffer,
+                   TimePoint) {
+                    input_buffer->forward_read_position(
+                        input_buffer->get_readable_size()
+                    );
+                }
+            );
+
+            tcp_connect_socketfd_ptr->start();
+        });
+    }
+
+    void TearDown() override {
+        run_and_wait([this]() {
+            if (!tcp_connect_socketfd_ptr->is_stopped()) {
+                tcp_connect_socketfd_ptr->abort_from_event_loop();
+            }
+
+            tcp_connect_socketfd_ptr.reset();
+        });
+
+        loop->ask_to_stop();
+
+        loop_thread.join();
+
+        ::close(peer_socketfd);
+    }
+
+    template <typename FunctorType>
+    void run_and_wait(FunctorType functor) {
+        std::atomic<bool> is_done{false};
+
+        loop->run([&functor, &is_done]() {
+            functor();
+
+            is_done.store(true, std::memory_order_release);
+        });
+
+        while (!is_done.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::string receive(size_t size) {
+        std::string received_data;
+
+        char buffer[4096];
+
+        while (received_data.size() < size) {
+            auto number_of_bytes_read =
+                ::read(peer_socketfd, buffer, sizeof(buffer));
+
+            if (number_of_bytes_read <= 0) {
+                break;
+            }
+
+            received_data.append(
+                buffer, static_cast<size_t>(number_of_bytes_read)
+            );
+        }
+
+        return received_data;
+    }
+
+    int peer_socketfd{-1};
+    EventLoopThread loop_thread{"iovec-sending-loop", nullptr};
+    EventLoop *loop = nullptr;
+    TcpConnectSocketfd::TcpConnectSocketfdPtr tcp_connect_socketfd_ptr;
+};
+
+} // namespace
+
+// what the socket could not take right away is copied into the output queue,
+// resuming from the middle of a piece, so that the pieces need not outlive the
+// call
+TEST_F(IovecSendingTest, ResumesAfterPartialSend) {
+    std::string header = "header\r\n";
+    std::string first_piece(256 * 1024, 'a');
+    std::string second_piece(256 * 1024, 'b');
+
+    for (size_t i = 0; i < first_piece.size(); i++) {
+        first_piece[i] = static_cast<char>('a' + i % 26);
+        second_piece[i] = static_cast<char>('A' + i % 26);
+    }
+
+    std::string expected_data = header + first_piece + second_piece;
+
+    size_t number_of_bytes_queued = 0;
+
+    run_and_wait([&]() {
+        IovecBuilder<> iovec_builder;
+
+        iovec_builder.append(header.data(), header.size());
+        iovec_builder.append(first_piece.data(), first_piece.size());
+        iovec_builder.append(second_piece.data(), second_piece.size());
+
+        tcp_connect_socketfd_ptr->send(
+            iovec_builder.get_iovecs(), iovec_builder.get_number_of_iovecs()
+        );
+
+        number_of_bytes_queued =
+            tcp_connect_socketfd_ptr->get_number_of_buffered_output_bytes();
+
+        header.assign(header.size(), '\0');
+        first_piece.assign(first_piece.size(), '\0');
+        second_piece.assign(second_piece.size(), '\0');
+    });
+
+    EXPECT_GT(number_of_bytes_queued, 0);
+    EXPECT_LT(number_of_bytes_queued, expected_data.size());
+
+    auto received_data = receive(expected_data.size());
+
+    ASSERT_EQ(received_data.size(), expected_data.size());
+    EXPECT_TRUE(received_data == expected_data);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+
+    // Disable output capturing
+    testing::FLAGS_gtest_catch_exceptions = false;
+
+    return RUN_ALL_TESTS();
+}
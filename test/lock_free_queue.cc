@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <atomic>
 #include <gtest/gtest.h>
+#include <memory>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "util/lock_free_queue.h"
 
@@ -20,6 +26,357 @@ TEST(LockFreeQueueTest, PushAndPop) {
     }
 }
 
+TEST(MpscLockFreeQueueTest, PushAndPop) {
+    xubinh_server::util::MpscLockFreeQueue<std::string> q;
+
+    EXPECT_TRUE(q.empty());
+
+    q.push("1");
+    q.push(std::string("2"));
+    q.push(1, '3');
+
+    std::string element;
+
+    EXPECT_TRUE(q.pop(element));
+    EXPECT_EQ(element, "1");
+    EXPECT_TRUE(q.pop(element));
+    EXPECT_EQ(element, "2");
+    EXPECT_TRUE(q.pop(element));
+    EXPECT_EQ(element, "3");
+    EXPECT_FALSE(q.pop(element));
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(MpscLockFreeQueueTest, PopAllStopsAtTheTailSeenAtTheBeginning) {
+    xubinh_server::util::MpscLockFreeQueue<int> q;
+
+    for (int i = 0; i < 3; i++) {
+        q.push(i);
+    }
+
+    std::vector<int> elements;
+
+    // elements pushed while draining belong to the next batch
+    auto number_of_elements = q.pop_all([&](int &element) {
+        elements.push_back(element);
+
+        q.push(element + 3);
+    });
+
+    EXPECT_EQ(number_of_elements, 3);
+    EXPECT_EQ(elements, (std::vector<int>{0, 1, 2}));
+
+    elements.clear();
+
+    q.pop_all([&](int &element) {
+        elements.push_back(element);
+    });
+
+    EXPECT_EQ(elements, (std::vector<int>{3, 4, 5}));
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(MpscLockFreeQueueTest, ReleasesElementsLeftInside) {
+    auto counter = std::make_shared<int>(0);
+
+    {
+        xubinh_server::util::MpscLockFreeQueue<std::shared_ptr<int>> q;
+
+        for (int i = 0; i < 10; i++) {
+            q.push(counter);
+        }
+
+        std::shared_ptr<int> element;
+
+        q.pop(element);
+    }
+
+    EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(MpscLockFreeQueueTest, KeepsOrderOfEachProducer) {
+    constexpr int number_of_producers = 8;
+    constexpr int number_of_elements_per_producer = 100000;
+
+    xubinh_server::util::MpscLockFreeQueue<std::pair<int, int>> q;
+
+    std::atomic<bool> is_started{false};
+    std::vector<std::thread> producers;
+
+    for (int i = 0; i < number_of_producers; i++) {
+        producers.emplace_back([&, i]() {
+            while (!is_started.load(std::memory_order_acquire)) {
+            }
+
+            for (int j = 0; j < number_of_elements_per_producer; j++) {
+                q.push(i, j);
+            }
+        });
+    }
+
+    is_started.store(true, std::memory_order_release);
+
+    std::vector<int> next_expected_elements(number_of_producers, 0);
+    int number_of_elements_left =
+        number_of_producers * number_of_elements_per_producer;
+    bool is_in_order = true;
+
+    while (number_of_elements_left > 0) {
+        number_of_elements_left -=
+            static_cast<int>(q.pop_all([&](std::pair<int, int> &element) {
+                is_in_order =
+                    is_in_order
+                    && element.second
+                           == next_expected_elements[element.first]++;
+            }));
+    }
+
+    for (auto &producer : producers) {
+        producer.join();
+    }
+
+    EXPECT_TRUE(is_in_order);
+    EXPECT_TRUE(q.empty());
+
+    for (auto next_expected_element : next_expected_elements) {
+        EXPECT_EQ(next_expected_element, number_of_elements_per_producer);
+    }
+}
+
+TEST(SpscLockFreeRingQueueTest, PushAndPop) {
+    xubinh_server::util::SpscLockFreeRingQueue<std::string> q(3);
+
+    EXPECT_EQ(q.capacity(), 4);
+    EXPECT_TRUE(q.empty());
+
+    // wraps around the ring several times
+    for (int round = 0; round < 3; round++) {
+        EXPECT_TRUE(q.try_push("1"));
+        EXPECT_TRUE(q.try_push(std::string("2")));
+        EXPECT_TRUE(q.try_push(1, '3'));
+        EXPECT_TRUE(q.try_push("4"));
+        EXPECT_FALSE(q.try_push("5"));
+
+        std::string element;
+
+        for (auto expected_element : {"1", "2", "3", "4"}) {
+            EXPECT_TRUE(q.try_pop(element));
+            EXPECT_EQ(element, expected_element);
+        }
+
+        EXPECT_FALSE(q.try_pop(element));
+        EXPECT_TRUE(q.empty());
+    }
+}
+
+TEST(SpscLockFreeRingQueueTest, PushAndPopInBulk) {
+    xubinh_server::util::SpscLockFreeRingQueue<std::unique_ptr<int>> q(8);
+
+    std::vector<std::unique_ptr<int>> elements;
+
+    for (int i = 0; i < 10; i++) {
+        elements.emplace_back(new int(i));
+    }
+
+    // only as many as there is room for are moved
+    EXPECT_EQ(q.try_push_bulk(elements.begin(), elements.size()), 8);
+    EXPECT_EQ(elements[7], nullptr);
+    EXPECT_NE(elements[8], nullptr);
+
+    std::vector<int> popped_elements;
+
+    auto consumer = [&](std::unique_ptr<int> &element) {
+        popped_elements.push_back(*element);
+    };
+
+    EXPECT_EQ(q.pop_all(consumer, 3), 3);
+    EXPECT_EQ(q.try_push_bulk(elements.begin() + 8, 2), 2);
+    EXPECT_EQ(q.pop_all(consumer), 7);
+    EXPECT_EQ(
+        popped_elements, (std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9})
+    );
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(SpscLockFreeRingQueueTest, OverflowsWhenFull) {
+    xubinh_server::util::SpscLockFreeRingQueue<int> q(4);
+
+    // never blocks, even though nobody is consuming
+    for (int i = 0; i < 10; i++) {
+        q.push(i);
+    }
+
+    // the ring is not refilled before the overflow list is drained
+    EXPECT_FALSE(q.try_push(10));
+
+    std::vector<int> popped_elements;
+
+    auto consumer = [&](int &element) {
+        popped_elements.push_back(element);
+    };
+
+    EXPECT_EQ(q.pop_all(consumer, 6), 6);
+
+    q.push(10);
+
+    int element;
+
+    EXPECT_TRUE(q.try_pop(element));
+    EXPECT_EQ(element, 6);
+
+    // the consumer might push into the same queue
+    auto pushing_consumer = [&](int &popped_element) {
+        popped_elements.push_back(popped_element);
+
+        if (popped_element == 10) {
+            q.push(11);
+        }
+    };
+
+    EXPECT_EQ(q.pop_all(pushing_consumer), 4);
+
+    EXPECT_FALSE(q.empty());
+    EXPECT_EQ(q.pop_all(consumer), 1);
+    EXPECT_EQ(
+        popped_elements,
+        (std::vector<int>{0, 1, 2, 3, 4, 5, 7, 8, 9, 10, 11})
+    );
+    EXPECT_TRUE(q.empty());
+    EXPECT_TRUE(q.try_push(12));
+}
+
+TEST(SpscLockFreeRingQueueTest, ReleasesElementsLeftInside) {
+    auto counter = std::make_shared<int>(0);
+
+    {
+        xubinh_server::util::SpscLockFreeRingQueue<std::shared_ptr<int>> q(16);
+
+        for (int i = 0; i < 10; i++) {
+            q.push(counter);
+        }
+
+        std::shared_ptr<int> element;
+
+        q.try_pop(element);
+    }
+
+    EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(SpscLockFreeRingQueueTest, StressWithConcurrentProducerAndConsumer) {
+    constexpr uint64_t number_of_elements = 1000000;
+
+    // a small ring makes both sides run into the boundaries frequently
+    xubinh_server::util::SpscLockFreeRingQueue<uint64_t> q(64);
+
+    std::thread producer([&]() {
+        std::vector<uint64_t> batch;
+
+        for (uint64_t i = 0; i < number_of_elements;) {
+            // mixes single and bulk pushes
+            if (i % 3 == 0) {
+                q.push(i++);
+
+                continue;
+            }
+
+            batch.clear();
+
+            for (uint64_t j = i; j < std::min(i + 10, number_of_elements);
+                 j++) {
+                batch.push_back(j);
+            }
+
+            auto number_of_elements_pushed =
+                q.try_push_bulk(batch.begin(), batch.size());
+
+            // gives the other side a chance on machines with few cores
+            if (number_of_elements_pushed == 0) {
+                std::this_thread::yield();
+            }
+
+            i += number_of_elements_pushed;
+        }
+    });
+
+    uint64_t next_expected_element = 0;
+    bool is_in_order = true;
+
+    while (next_expected_element < number_of_elements) {
+        // mixes single and bulk pops
+        uint64_t element;
+
+        if (next_expected_element % 2 == 0 && q.try_pop(element)) {
+            is_in_order =
+                is_in_order && element == next_expected_element++;
+
+            continue;
+        }
+
+        auto number_of_elements_popped = q.pop_all(
+            [&](uint64_t &this_element) {
+                is_in_order =
+                    is_in_order && this_element == next_expected_element++;
+            },
+            7
+        );
+
+        // gives the other side a chance on machines with few cores
+        if (number_of_elements_popped == 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+
+    EXPECT_TRUE(is_in_order);
+    EXPECT_EQ(next_expected_element, number_of_elements);
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(SpscLockFreeRingQueueTest, KeepsOrderWhileOverflowingConcurrently) {
+    constexpr uint64_t number_of_elements = 1000000;
+
+    // a tiny ring keeps the producer spilling into the overflow list, and
+    // the consumer switching between the ring and the list
+    xubinh_server::util::SpscLockFreeRingQueue<uint64_t> q(2);
+
+    std::thread producer([&]() {
+        for (uint64_t i = 0; i < number_of_elements; i++) {
+            q.push(i);
+        }
+    });
+
+    uint64_t next_expected_element = 0;
+    bool is_in_order = true;
+
+    while (next_expected_element < number_of_elements) {
+        uint64_t element;
+
+        if (next_expected_element % 2 == 0) {
+            if (q.try_pop(element)) {
+                is_in_order =
+                    is_in_order && element == next_expected_element++;
+            }
+
+            continue;
+        }
+
+        q.pop_all(
+            [&](uint64_t &this_element) {
+                is_in_order =
+                    is_in_order && this_element == next_expected_element++;
+            },
+            3
+        );
+    }
+
+    producer.join();
+
+    EXPECT_TRUE(is_in_order);
+    EXPECT_TRUE(q.empty());
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
 
@@ -23,7 +23,7 @@ TEST(LogBuilderTest, BasicLogMessage) {
     LOG_INFO << p;
 
     delete p;
-    delete a;
+    delete[] a;
 }
 
 int main(int argc, char **argv) {
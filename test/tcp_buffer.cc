@@ -0,0 +1,396 @@
+#include <gtest/gtest.h>
+#include <string>
+
+#include "tcp_buffer.h"
+#include "util/delimiter_scan.h"
+
+using xubinh_server::MutableSizeTcpBuffer;
+using xubinh_server::RingTcpBuffer;
+using xubinh_server::SlabChainTcpBuffer;
+
+namespace delimiter_scan = xubinh_server::util::delimiter_scan;
+
+namespace {
+
+template <typename BufferType>
+std::string get_readable_string(BufferType &buffer) {
+    auto readable_size = buffer.get_readable_size();
+
+    return std::string(buffer.linearize(readable_size), readable_size);
+}
+
+template <typename BufferType>
+class TcpBufferTest : public testing::Test {
+protected:
+    BufferType tcp_buffer;
+};
+
+using BufferTypes = testing::
+    Types<MutableSizeTcpBuffer, RingTcpBuffer, SlabChainTcpBuffer>;
+
+TYPED_TEST_SUITE(TcpBufferTest, BufferTypes);
+
+} // namespace
+
+TYPED_TEST(TcpBufferTest, AppendsAndForwards) {
+    auto &buffer = this->tcp_buffer;
+
+    EXPECT_EQ(buffer.get_readable_size(), 0);
+
+    buffer.append("hello", 5);
+    buffer.append_space();
+    buffer.append("world", 5);
+
+    EXPECT_EQ(get_readable_string(buffer), "hello world");
+
+    buffer.forward_read_position(6);
+
+    EXPECT_EQ(get_readable_string(buffer), "world");
+
+    // never goes beyond the readable data
+    buffer.forward_read_position(100);
+
+    EXPECT_EQ(buffer.get_readable_size(), 0);
+}
+
+TYPED_TEST(TcpBufferTest, WritesIntoSpareSpaceDirectly) {
+    auto &buffer = this->tcp_buffer;
+
+    buffer.ensure_writable_size(3);
+
+    ASSERT_GE(buffer.get_writable_size(), 3);
+
+    ::memcpy(buffer.get_write_position(), "abc", 3);
+
+    buffer.forward_write_position(3);
+
+    EXPECT_EQ(get_readable_string(buffer), "abc");
+}
+
+TYPED_TEST(TcpBufferTest, FindsDelimiters) {
+    auto &buffer = this->tcp_buffer;
+
+    buffer.append("GET / HTTP/1.1\r\nHost: a\r\n");
+
+    auto crlf_position = buffer.get_next_crlf_position();
+
+    ASSERT_NE(crlf_position, nullptr);
+    EXPECT_EQ(crlf_position - buffer.get_read_position(), 14);
+
+    buffer.forward_read_position(16);
+
+    EXPECT_EQ(
+        buffer.get_next_newline_position() - buffer.get_read_position(), 8
+    );
+
+    buffer.forward_read_position(9);
+
+    EXPECT_EQ(buffer.get_next_crlf_position(), nullptr);
+
+    // a lone carriage return at the end is not a delimiter yet
+    buffer.append("x\r");
+
+    EXPECT_EQ(buffer.get_next_crlf_position(), nullptr);
+}
+
+TYPED_TEST(TcpBufferTest, FindsDelimitersTricklingIn) {
+    auto &buffer = this->tcp_buffer;
+
+    std::string request =
+        "GET / HTTP/1.1\r\nHost: a\r\nAccept: */*\r\n\r\n";
+
+    // one byte at a time, as a slow client would send
+    for (size_t i = 0; i + 1 < request.size(); i++) {
+        buffer.append(request.c_str() + i, 1);
+
+        if (i < 15) {
+            EXPECT_EQ(buffer.get_next_crlf_position(), nullptr);
+        }
+
+        EXPECT_EQ(buffer.get_next_double_crlf_position(), nullptr);
+    }
+
+    buffer.append(request.c_str() + request.size() - 1, 1);
+
+    ASSERT_NE(buffer.get_next_double_crlf_position(), nullptr);
+    EXPECT_EQ(
+        buffer.get_next_double_crlf_position() - buffer.get_read_position(),
+        static_cast<long>(request.size() - 4)
+    );
+
+    // consumes the lines one by one
+    for (size_t line_size : {16, 9, 13}) {
+        auto crlf_position = buffer.get_next_crlf_position();
+
+        ASSERT_NE(crlf_position, nullptr);
+        EXPECT_EQ(
+            crlf_position - buffer.get_read_position(),
+            static_cast<long>(line_size - 2)
+        );
+
+        buffer.forward_read_position(line_size);
+    }
+
+    EXPECT_EQ(buffer.get_next_crlf_position(), buffer.get_read_position());
+    EXPECT_EQ(buffer.get_next_delimiter_position("\r\n\r\n", 4), nullptr);
+    EXPECT_EQ(
+        buffer.get_next_delimiter_position("\n", 1),
+        buffer.get_read_position() + 1
+    );
+}
+
+TYPED_TEST(TcpBufferTest, KeepsDataAcrossGrowthAndReuse) {
+    auto &buffer = this->tcp_buffer;
+
+    std::string expected_string;
+
+    // interleaves reading and writing so that the data moves around
+    for (int i = 0; i < 2000; i++) {
+        auto piece = std::to_string(i) + ",";
+
+        buffer.append(piece.c_str(), piece.size());
+        expected_string += piece;
+
+        if (i % 3 == 0) {
+            buffer.forward_read_position(piece.size());
+            expected_string.erase(0, piece.size());
+        }
+
+        ASSERT_EQ(get_readable_string(buffer), expected_string);
+    }
+
+    buffer.release();
+
+    EXPECT_EQ(buffer.get_readable_size(), 0);
+
+    buffer.append("again", 5);
+
+    EXPECT_EQ(get_readable_string(buffer), "again");
+}
+
+TYPED_TEST(TcpBufferTest, StartsOverAfterClearing) {
+    auto &buffer = this->tcp_buffer;
+
+    buffer.append("GET / HTTP/1.0\r\n", 16);
+
+    ASSERT_NE(buffer.get_next_crlf_position(), nullptr);
+
+    buffer.clear();
+
+    EXPECT_EQ(buffer.get_readable_size(), 0);
+
+    // the recorded scan offsets must not outlive the data
+    buffer.append("ab\r\n", 4);
+
+    EXPECT_EQ(buffer.get_next_crlf_position() - buffer.get_read_position(), 2);
+    EXPECT_EQ(get_readable_string(buffer), "ab\r\n");
+}
+
+TEST(MutableSizeTcpBufferTest, KeepsSmallMemoryAcrossClearing) {
+    MutableSizeTcpBuffer buffer;
+
+    buffer.ensure_writable_size(1024);
+
+    auto capacity = buffer.get_capacity();
+    auto write_position = buffer.get_write_position();
+
+    buffer.append("abc", 3);
+    buffer.clear();
+
+    EXPECT_EQ(buffer.get_capacity(), capacity);
+    EXPECT_EQ(buffer.get_write_position(), write_position);
+
+    // too large to be kept
+    constexpr size_t MAX_RETAINED_CAPACITY =
+        MutableSizeTcpBuffer::MAX_RETAINED_CAPACITY;
+
+    std::string large_piece(2 * MAX_RETAINED_CAPACITY, 'x');
+
+    buffer.append(large_piece.c_str(), large_piece.size());
+    buffer.clear();
+
+    EXPECT_LE(buffer.get_capacity(), MAX_RETAINED_CAPACITY);
+    EXPECT_EQ(buffer.get_readable_size(), 0);
+}
+
+TEST(RingTcpBufferTest, ReadableDataStaysContiguousAcrossTheEnd) {
+    RingTcpBuffer buffer;
+
+    buffer.ensure_writable_size(1);
+
+    auto capacity = buffer.get_capacity();
+
+    ASSERT_GT(capacity, 0);
+
+    // leaves a few bytes right before the end of the ring
+    std::string filler(capacity - 3, 'x');
+
+    buffer.append(filler.c_str(), filler.size());
+    buffer.forward_read_position(filler.size());
+
+    buffer.append("abcdef", 6);
+
+    EXPECT_EQ(buffer.get_capacity(), capacity);
+    EXPECT_EQ(get_readable_string(buffer), "abcdef");
+
+    // and keeps being so after growing, with the wrapped part moved
+    std::string large_piece(2 * capacity, 'y');
+
+    buffer.append(large_piece.c_str(), large_piece.size());
+
+    EXPECT_GT(buffer.get_capacity(), capacity);
+    EXPECT_EQ(get_readable_string(buffer), "abcdef" + large_piece);
+}
+
+TEST(SlabChainTcpBufferTest, GrowsBySlabsAndReadsThroughIovecs) {
+    SlabChainTcpBuffer buffer;
+
+    constexpr size_t SLAB_SIZE = SlabChainTcpBuffer::SLAB_SIZE;
+
+    std::string data;
+
+    for (size_t i = 0; data.size() < 5 * SLAB_SIZE + 100; i++) {
+        data += std::to_string(i) + ",";
+    }
+
+    data.resize(5 * SLAB_SIZE + 100);
+
+    buffer.append(data.c_str(), data.size());
+
+    EXPECT_EQ(buffer.get_readable_size(), data.size());
+    EXPECT_EQ(buffer.get_contiguous_readable_size(), SLAB_SIZE);
+    EXPECT_EQ(buffer.get_number_of_segments(), 6);
+
+    // gives the consumed slabs back right away
+    buffer.forward_read_position(2 * SLAB_SIZE + 1);
+    data.erase(0, 2 * SLAB_SIZE + 1);
+
+    EXPECT_EQ(buffer.get_contiguous_readable_size(), SLAB_SIZE - 1);
+
+    iovec iovecs[16];
+
+    auto number_of_iovecs = buffer.get_readable_iovecs(iovecs, 16);
+
+    std::string gathered_data;
+
+    for (int i = 0; i < number_of_iovecs; i++) {
+        gathered_data.append(
+            static_cast<const char *>(iovecs[i].iov_base), iovecs[i].iov_len
+        );
+    }
+
+    EXPECT_EQ(gathered_data, data);
+
+    // larger than a slab
+    EXPECT_EQ(
+        std::string(buffer.linearize(2 * SLAB_SIZE), 2 * SLAB_SIZE),
+        data.substr(0, 2 * SLAB_SIZE)
+    );
+    EXPECT_EQ(get_readable_string(buffer), data);
+
+    buffer.forward_read_position(data.size());
+
+    EXPECT_EQ(buffer.get_number_of_segments(), 0);
+}
+
+TEST(SlabChainTcpBufferTest, FindsDelimitersAcrossSlabBoundaries) {
+    SlabChainTcpBuffer buffer;
+
+    constexpr size_t SLAB_SIZE = SlabChainTcpBuffer::SLAB_SIZE;
+
+    for (size_t i = 1; i < 4; i++) {
+        // the delimiter starts `i` bytes before the end of the first slab
+        std::string filler(SLAB_SIZE - i, 'x');
+
+        buffer.append(filler.c_str(), filler.size());
+        buffer.append("\r\n\r\nabc", 7);
+
+        auto double_crlf_position = buffer.get_next_double_crlf_position();
+
+        ASSERT_NE(double_crlf_position, nullptr);
+        EXPECT_EQ(
+            double_crlf_position - buffer.get_read_position(),
+            static_cast<long>(filler.size())
+        );
+        EXPECT_EQ(std::string(double_crlf_position, 4), "\r\n\r\n");
+
+        auto crlf_position = buffer.get_next_crlf_position();
+
+        EXPECT_EQ(crlf_position, double_crlf_position);
+
+        buffer.forward_read_position(filler.size() + 4);
+
+        EXPECT_EQ(get_readable_string(buffer), "abc");
+
+        buffer.release();
+    }
+}
+
+TEST(SlabChainTcpBufferTest, MovesSlabsWithoutCopying) {
+    SlabChainTcpBuffer buffer;
+
+    constexpr size_t SLAB_SIZE = SlabChainTcpBuffer::SLAB_SIZE;
+
+    std::string data(2 * SLAB_SIZE + 10, 'x');
+
+    buffer.append(data.c_str(), data.size());
+
+    auto read_position = buffer.get_read_position();
+
+    SlabChainTcpBuffer moved_buffer(std::move(buffer));
+
+    EXPECT_EQ(buffer.get_readable_size(), 0);
+    EXPECT_EQ(buffer.get_number_of_segments(), 0);
+    EXPECT_EQ(moved_buffer.get_read_position(), read_position);
+    EXPECT_EQ(moved_buffer.get_number_of_segments(), 3);
+
+    buffer.append("abc", 3);
+
+    // gives its own slabs back before taking the other ones
+    buffer = std::move(moved_buffer);
+
+    EXPECT_EQ(buffer.get_read_position(), read_position);
+    EXPECT_EQ(get_readable_string(buffer), data);
+}
+
+TEST(DelimiterScanTest, AgreesWithPlainSearchAtEveryPosition) {
+    // long enough to go through the vectorized paths as well as the tails
+    for (size_t size = 0; size < 100; size++) {
+        for (size_t position = 0; position + 1 < size; position++) {
+            std::string data(size, 'a');
+
+            // decoys
+            if (position > 0) {
+                data[position - 1] = '\n';
+            }
+
+            data[position] = '\r';
+            data[position + 1] = '\n';
+
+            auto begin = data.c_str();
+            auto end = begin + size;
+
+            EXPECT_EQ(
+                delimiter_scan::find_byte(begin, end, '\r'), begin + position
+            );
+            EXPECT_EQ(
+                delimiter_scan::find_byte_pair(begin, end, '\r', '\n'),
+                begin + position
+            );
+            EXPECT_EQ(
+                delimiter_scan::find_sequence(begin, end, "\r\na", 3),
+                position + 2 < size ? begin + position : nullptr
+            );
+            EXPECT_EQ(delimiter_scan::find_byte(begin, end, 'b'), nullptr);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+
+    // Disable output capturing
+    testing::FLAGS_gtest_catch_exceptions = false;
+
+    return RUN_ALL_TESTS();
+}
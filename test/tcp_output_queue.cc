@@ -0,0 +1,405 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "tcp_output_queue.h"
+
+using xubinh_server::TcpOutputQueue;
+
+namespace {
+
+using StringType = TcpOutputQueue::StringType;
+
+// an anonymous file holding the given content, for file ranges
+int _create_file(const std::string &content) {
+    int fd = ::memfd_create("tcp_output_queue_test", 0);
+
+    if (fd == -1) {
+        return -1;
+    }
+
+    if (::write(fd, content.data(), content.size())
+        != static_cast<ssize_t>(content.size())) {
+
+        ::close(fd);
+
+        return -1;
+    }
+
+    return fd;
+}
+
+// a private anonymous mapping holding the given content
+void *_create_mapped_region(const std::string &content) {
+    auto mapped_address = ::mmap(
+        nullptr,
+        content.size(),
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0
+    );
+
+    if (mapped_address == MAP_FAILED) {
+        return nullptr;
+    }
+
+    std::memcpy(mapped_address, content.data(), content.size());
+
+    return mapped_address;
+}
+
+bool _is_fd_open(int fd) {
+    return ::fcntl(fd, F_GETFD) != -1 || errno != EBADF;
+}
+
+bool _is_mapped(void *mapped_address, size_t mapped_length) {
+    unsigned char residency[16];
+
+    // fails with `ENOMEM` for the pages that are not mapped
+    return ::mincore(mapped_address, mapped_length, residency) == 0;
+}
+
+// sends out at most the given number of bytes from the front of the queue the
+// way a connection does, i.e. in-memory segments are gathered and file ranges
+// are read from their fds, and returns what is sent
+std::string _send_partially(TcpOutputQueue &queue, size_t max_size) {
+    std::string sent_data;
+
+    if (queue.is_front_file_range()) {
+        auto &file_range = queue.front();
+
+        sent_data.resize(std::min(max_size, file_range.get_size()));
+
+        auto number_of_bytes_read = ::pread(
+            file_range.get_fd(),
+            &sent_data[0],
+            sent_data.size(),
+            file_range.get_file_offset()
+        );
+
+        EXPECT_EQ(number_of_bytes_read, static_cast<ssize_t>(sent_data.size()));
+    }
+
+    else {
+        iovec iovecs[4];
+
+        auto number_of_iovecs = queue.gather_leading_memory_segments(iovecs, 4);
+
+        for (int i = 0; i < number_of_iovecs && sent_data.size() < max_size;
+             i++) {
+
+            sent_data.append(
+                static_cast<const char *>(iovecs[i].iov_base),
+                std::min(iovecs[i].iov_len, max_size - sent_data.size())
+            );
+        }
+    }
+
+    queue.forward(sent_data.size());
+
+    return sent_data;
+}
+
+} // namespace
+
+TEST(TcpOutputQueueTest, CoalescesSmallCopies) {
+    TcpOutputQueue queue;
+
+    queue.append("abc", 3);
+    queue.append("def", 3);
+    queue.append("", 0);
+
+    EXPECT_EQ(queue.get_number_of_segments(), 1);
+    EXPECT_EQ(queue.get_readable_size(), 6);
+    EXPECT_EQ(queue.get_in_memory_size(), 6);
+    EXPECT_EQ(std::string(queue.front().get_data(), 6), "abcdef");
+
+    // a shared slice is never appended to
+    auto shared_data = std::make_shared<std::string>("ghi");
+
+    queue.append_shared_slice(shared_data, shared_data->data(), 3);
+    queue.append("jkl", 3);
+
+    EXPECT_EQ(queue.get_number_of_segments(), 3);
+
+    // owned segments stop growing once large enough
+    std::string large_data(128 * 1024, 'x');
+
+    queue.append(StringType(large_data.data(), large_data.size()));
+    queue.append("mno", 3);
+
+    EXPECT_EQ(queue.get_number_of_segments(), 5);
+    EXPECT_EQ(queue.get_readable_size(), 12 + large_data.size() + 3);
+}
+
+TEST(TcpOutputQueueTest, GathersLeadingMemorySegments) {
+    TcpOutputQueue queue;
+
+    std::string mapped_data = "mapped";
+
+    auto mapped_address = _create_mapped_region(mapped_data);
+
+    ASSERT_NE(mapped_address, nullptr);
+
+    int fd = _create_file("file");
+
+    ASSERT_NE(fd, -1);
+
+    auto shared_data = std::make_shared<std::string>("shared");
+
+    queue.append("owned", 5);
+    queue.append_shared_slice(shared_data, shared_data->data(), 6);
+    queue.append_mapped_region(mapped_address, mapped_data.size());
+    queue.append_file_range(fd, 0, 4, true);
+    queue.append("tail", 4);
+
+    EXPECT_EQ(queue.get_readable_size(), 5 + 6 + 6 + 4 + 4);
+    EXPECT_EQ(queue.get_in_memory_size(), 5 + 6 + 6 + 4);
+
+    iovec iovecs[8];
+
+    // stops at the file range
+    ASSERT_EQ(queue.gather_leading_memory_segments(iovecs, 8), 3);
+
+    EXPECT_EQ(
+        std::string(static_cast<char *>(iovecs[0].iov_base), iovecs[0].iov_len),
+        "owned"
+    );
+    EXPECT_EQ(
+        std::string(static_cast<char *>(iovecs[1].iov_base), iovecs[1].iov_len),
+        "shared"
+    );
+    EXPECT_EQ(
+        std::string(static_cast<char *>(iovecs[2].iov_base), iovecs[2].iov_len),
+        "mapped"
+    );
+
+    // stops at the limit of entries
+    EXPECT_EQ(queue.gather_leading_memory_segments(iovecs, 2), 2);
+
+    // stops at the first segment that is large enough to be sent on its own
+    EXPECT_EQ(queue.gather_leading_memory_segments(iovecs, 8, 6), 1);
+
+    // resumes in the middle of a segment
+    queue.forward(7);
+
+    ASSERT_EQ(queue.gather_leading_memory_segments(iovecs, 8), 2);
+
+    EXPECT_EQ(
+        std::string(static_cast<char *>(iovecs[0].iov_base), iovecs[0].iov_len),
+        "ared"
+    );
+
+    queue.forward(4 + 6);
+
+    EXPECT_TRUE(queue.is_front_file_range());
+    EXPECT_EQ(queue.gather_leading_memory_segments(iovecs, 8), 0);
+    EXPECT_EQ(queue.get_in_memory_size(), 4);
+}
+
+// the data comes out in order no matter how the sends split it
+TEST(TcpOutputQueueTest, SendsMixedSegmentsInPartialWrites) {
+    std::mt19937 random_engine(42);
+
+    for (int round = 0; round < 100; round++) {
+        TcpOutputQueue queue;
+
+        std::string expected_data;
+
+        for (int i = 0; i < 20; i++) {
+            std::string data(1 + random_engine() % 300, 'a');
+
+            for (auto &byte : data) {
+                byte = static_cast<char>('a' + random_engine() % 26);
+            }
+
+            switch (random_engine() % 4) {
+            case 0:
+                queue.append(data.data(), data.size());
+
+                break;
+
+            case 1: {
+                auto shared_data = std::make_shared<std::string>(data);
+
+                queue.append_shared_slice(
+                    shared_data, shared_data->data(), shared_data->size()
+                );
+
+                break;
+            }
+
+            case 2: {
+                auto mapped_address = _create_mapped_region(data);
+
+                ASSERT_NE(mapped_address, nullptr);
+
+                queue.append_mapped_region(mapped_address, data.size());
+
+                break;
+            }
+
+            default: {
+                // only a part of the file is sent, starting at an offset
+                std::string file_content = "header" + data + "trailer";
+
+                int fd = _create_file(file_content);
+
+                ASSERT_NE(fd, -1);
+
+                queue.append_file_range(fd, 6, data.size(), true);
+
+                break;
+            }
+            }
+
+            expected_data += data;
+        }
+
+        ASSERT_EQ(queue.get_readable_size(), expected_data.size());
+
+        std::string sent_data;
+
+        while (!queue.empty()) {
+            sent_data += _send_partially(queue, 1 + random_engine() % 200);
+
+            ASSERT_EQ(
+                queue.get_readable_size(),
+                expected_data.size() - sent_data.size()
+            );
+        }
+
+        EXPECT_EQ(sent_data, expected_data);
+        EXPECT_EQ(queue.get_readable_size(), 0);
+        EXPECT_EQ(queue.get_in_memory_size(), 0);
+    }
+}
+
+TEST(TcpOutputQueueTest, ReleasesOwnersOnceFullySent) {
+    TcpOutputQueue queue;
+
+    auto shared_data = std::make_shared<std::string>("shared");
+
+    std::string mapped_data(4096, 'm');
+
+    auto mapped_address = _create_mapped_region(mapped_data);
+
+    ASSERT_NE(mapped_address, nullptr);
+
+    int fd = _create_file("file");
+
+    ASSERT_NE(fd, -1);
+
+    queue.append_shared_slice(shared_data, shared_data->data(), 6);
+    queue.append_mapped_region(mapped_address, mapped_data.size());
+    queue.append_file_range(fd, 0, 4, true);
+
+    EXPECT_EQ(shared_data.use_count(), 2);
+
+    // a partially sent segment is kept
+    queue.forward(5);
+
+    EXPECT_EQ(shared_data.use_count(), 2);
+
+    queue.forward(1);
+
+    EXPECT_EQ(shared_data.use_count(), 1);
+
+    queue.forward(mapped_data.size() - 1);
+
+    EXPECT_TRUE(_is_mapped(mapped_address, mapped_data.size()));
+
+    queue.forward(1);
+
+    EXPECT_FALSE(_is_mapped(mapped_address, mapped_data.size()));
+
+    queue.forward(3);
+
+    EXPECT_TRUE(_is_fd_open(fd));
+
+    queue.forward(1);
+
+    EXPECT_FALSE(_is_fd_open(fd));
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(TcpOutputQueueTest, ReleasesEverythingLeftOnRelease) {
+    TcpOutputQueue queue;
+
+    auto shared_data = std::make_shared<std::string>("shared");
+
+    int fd = _create_file("file");
+
+    ASSERT_NE(fd, -1);
+
+    // the fd of an empty range is released right away
+    int empty_file_fd = _create_file("");
+
+    ASSERT_NE(empty_file_fd, -1);
+
+    queue.append_file_range(empty_file_fd, 0, 0, true);
+
+    EXPECT_FALSE(_is_fd_open(empty_file_fd));
+    EXPECT_TRUE(queue.empty());
+
+    queue.append("owned", 5);
+    queue.append_shared_slice(shared_data, shared_data->data(), 6);
+    queue.append_file_range(fd, 0, 4, true);
+
+    queue.forward(2);
+
+    queue.release();
+
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.get_readable_size(), 0);
+    EXPECT_EQ(queue.get_in_memory_size(), 0);
+    EXPECT_EQ(shared_data.use_count(), 1);
+    EXPECT_FALSE(_is_fd_open(fd));
+}
+
+// the data of the front segment could outlive it, e.g. for zero-copy sending
+TEST(TcpOutputQueueTest, SharedFrontOutlivesTheSegment) {
+    TcpOutputQueue queue;
+
+    std::string long_data(1024, 'l');
+
+    queue.append(StringType(long_data.data(), long_data.size()));
+    queue.append(StringType("short"));
+
+    auto data = queue.front().get_data();
+
+    auto shared_owner = queue.share_front();
+
+    EXPECT_EQ(queue.front().get_type(), TcpOutputQueue::SHARED_SLICE);
+    EXPECT_EQ(queue.front().get_data(), data);
+
+    queue.forward(long_data.size());
+
+    EXPECT_EQ(queue.get_number_of_segments(), 1);
+    EXPECT_EQ(std::string(data, long_data.size()), long_data);
+
+    // short strings are stored inline, and the data is moved along
+    auto short_shared_owner = queue.share_front();
+
+    EXPECT_EQ(std::string(queue.front().get_data(), 5), "short");
+
+    queue.forward(5);
+
+    EXPECT_EQ(short_shared_owner.use_count(), 1);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+
+    // Disable output capturing
+    testing::FLAGS_gtest_catch_exceptions = false;
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "timer_container.h"
+
+using xubinh_server::Timer;
+using xubinh_server::TimerContainer;
+using xubinh_server::util::TimeInterval;
+using xubinh_server::util::TimePoint;
+
+namespace {
+
+constexpr int64_t MILLISECOND = TimeInterval::SECOND / 1000;
+
+class TimerContainerTest
+    : public testing::TestWithParam<TimerContainer::Type> {
+protected:
+    void TearDown() override {
+        std::vector<const Timer *> timers;
+
+        container->move_out_before_or_at(TimePoint::FOREVER, timers);
+
+        for (auto timer_ptr : timers) {
+            delete timer_ptr;
+        }
+
+        for (auto timer_ptr : removed_timers) {
+            delete timer_ptr;
+        }
+    }
+
+    const Timer *insert(TimePoint expiration_time_point) {
+        auto timer_ptr = new Timer(expiration_time_point, 0, 0, []() {});
+
+        container->insert_one(timer_ptr);
+
+        return timer_ptr;
+    }
+
+    std::unique_ptr<TimerContainer> container =
+        TimerContainer::create(GetParam());
+    std::vector<const Timer *> removed_timers;
+    TimePoint now;
+};
+
+} // namespace
+
+TEST_P(TimerContainerTest, MovesOutInOrderAndNeverEarly) {
+    std::vector<int64_t> offsets = {
+        5 * MILLISECOND,
+        1 * MILLISECOND,
+        300 * MILLISECOND,
+        70 * TimeInterval::SECOND,
+        3 * MILLISECOND + 1,
+        20 * TimeInterval::SECOND,
+    };
+
+    for (auto offset : offsets) {
+        insert(now + offset);
+    }
+
+    EXPECT_EQ(container->size(), offsets.size());
+
+    std::sort(offsets.begin(), offsets.end());
+
+    std::vector<const Timer *> timers;
+    size_t number_of_timers_moved_out = 0;
+
+    for (int64_t offset = 0; offset <= 71 * TimeInterval::SECOND;
+         offset += MILLISECOND) {
+
+        auto time_point = now + offset;
+
+        timers.clear();
+        container->move_out_before_or_at(time_point, timers);
+
+        for (auto timer_ptr : timers) {
+            EXPECT_LE(timer_ptr->get_expiration_time_point(), time_point);
+
+            // no later than one tick of the coarsest container
+            EXPECT_GT(
+                timer_ptr->get_expiration_time_point() + 2 * MILLISECOND,
+                time_point
+            );
+
+            EXPECT_EQ(
+                timer_ptr->get_expiration_time_point(),
+                now + offsets[number_of_timers_moved_out]
+            );
+
+            ++number_of_timers_moved_out;
+
+            delete timer_ptr;
+        }
+    }
+
+    EXPECT_EQ(number_of_timers_moved_out, offsets.size());
+    EXPECT_TRUE(container->empty());
+}
+
+TEST_P(TimerContainerTest, RemovesTimers) {
+    auto first = insert(now + 10 * MILLISECOND);
+    auto second = insert(now + 20 * MILLISECOND);
+    auto third = insert(now + 100 * TimeInterval::SECOND);
+
+    EXPECT_TRUE(container->remove_one(first));
+    EXPECT_TRUE(container->remove_one(third));
+
+    removed_timers.push_back(first);
+    removed_timers.push_back(third);
+
+    EXPECT_EQ(container->size(), 1);
+    EXPECT_GE(
+        container->get_earliest_expiration_time_point(),
+        second->get_expiration_time_point()
+    );
+
+    std::vector<const Timer *> timers;
+
+    container->move_out_before_or_at(now + TimeInterval::SECOND, timers);
+
+    ASSERT_EQ(timers.size(), 1);
+    EXPECT_EQ(timers[0], second);
+
+    // already moved out
+    EXPECT_FALSE(container->remove_one(second));
+
+    delete second;
+
+    EXPECT_TRUE(container->empty());
+    EXPECT_EQ(
+        container->get_earliest_expiration_time_point(),
+        TimePoint(TimePoint::FOREVER)
+    );
+}
+
+TEST_P(TimerContainerTest, MatchesReferenceUnderRandomChurn) {
+    std::mt19937_64 engine(12345);
+    std::uniform_int_distribution<int64_t> offset_distribution(
+        0, 600 * TimeInterval::SECOND
+    );
+
+    std::vector<const Timer *> alive_timers;
+
+    for (int i = 0; i < 20000; i++) {
+        alive_timers.push_back(insert(now + offset_distribution(engine)));
+
+        // cancels about a third of them
+        if (engine() % 3 == 0) {
+            auto index = engine() % alive_timers.size();
+
+            EXPECT_TRUE(container->remove_one(alive_timers[index]));
+
+            removed_timers.push_back(alive_timers[index]);
+
+            alive_timers[index] = alive_timers.back();
+            alive_timers.pop_back();
+        }
+    }
+
+    EXPECT_EQ(container->size(), alive_timers.size());
+
+    std::vector<const Timer *> timers;
+    TimePoint time_point = now;
+
+    while (!container->empty()) {
+        auto earliest_expiration_time_point =
+            container->get_earliest_expiration_time_point();
+
+        EXPECT_GE(earliest_expiration_time_point, time_point);
+
+        time_point = earliest_expiration_time_point;
+
+        auto number_of_timers_before = timers.size();
+
+        container->move_out_before_or_at(time_point, timers);
+
+        // the alarm set at the earliest time point always expires something
+        EXPECT_GT(timers.size(), number_of_timers_before);
+    }
+
+    ASSERT_EQ(timers.size(), alive_timers.size());
+
+    EXPECT_TRUE(std::is_sorted(
+        timers.begin(),
+        timers.end(),
+        [](const Timer *lhs, const Timer *rhs) {
+            return lhs->get_expiration_time_point()
+                   < rhs->get_expiration_time_point();
+        }
+    ) || GetParam() == TimerContainer::Type::TIMING_WHEEL);
+
+    std::sort(alive_timers.begin(), alive_timers.end());
+    std::sort(timers.begin(), timers.end());
+
+    EXPECT_EQ(timers, alive_timers);
+
+    for (auto timer_ptr : timers) {
+        delete timer_ptr;
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    AllTypes,
+    TimerContainerTest,
+    testing::Values(
+        TimerContainer::Type::ORDERED_SET, TimerContainer::Type::TIMING_WHEEL
+    )
+);
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+
+    // Disable output capturing
+    testing::FLAGS_gtest_catch_exceptions = false;
+
+    return RUN_ALL_TESTS();
+}